@@ -10,3 +10,13 @@ include_guard(GLOBAL)
 include(${CMAKE_CURRENT_LIST_DIR}/vars.cmake)
 
 option(${PROJECT_NAME_UC}_DEMOS "Build the demo apps" OFF)
+option(${PROJECT_NAME_UC}_BENCHMARKS "Build the benchmarks" OFF)
+option(${PROJECT_NAME_UC}_USDT "Add static USDT probes for bpftrace, perf and SystemTap (requires sys/sdt.h)" OFF)
+
+if(${PROJECT_NAME_UC}_USDT)
+	include(CheckIncludeFileCXX)
+	check_include_file_cxx(sys/sdt.h ${PROJECT_NAME_UC}_HAVE_SYS_SDT_H)
+	if(NOT ${PROJECT_NAME_UC}_HAVE_SYS_SDT_H)
+		message(FATAL_ERROR "${PROJECT_NAME_UC}_USDT requires sys/sdt.h, e.g. from the systemtap-sdt-dev package")
+	endif()
+endif()
@@ -7,6 +7,10 @@
 
 #include "squid/basicstatement.h"
 #include "squid/ibackendstatement.h"
+#include "squid/ibackendconnection.h"
+
+#include "squid/detail/probes.h"
+#include "squid/detail/watchdog.h"
 
 #include <cassert>
 
@@ -18,6 +22,8 @@ basic_statement::basic_statement(std::shared_ptr<ibackend_connection> connection
     , named_results_{}
     , connection_{ connection }
     , statement_{ std::move(statement) }
+    , query_{}
+    , fetched_{}
 {
 }
 
@@ -27,6 +33,8 @@ basic_statement::basic_statement(std::shared_ptr<ibackend_connection> connection
     , named_results_{}
     , connection_{ connection }
     , statement_{}
+    , query_{}
+    , fetched_{}
 {
 }
 
@@ -55,6 +63,8 @@ basic_statement& basic_statement::bind(std::string_view name, const unsigned cha
 
 void basic_statement::execute()
 {
+	const auto start = probe_start(SQUID_PROBE_ENABLED(statement__execute));
+
 	if (!this->statement_)
 	{
 		if (!this->query_)
@@ -71,6 +81,8 @@ void basic_statement::execute()
 	{
 		throw error{ "Named result binding cannot be combined with sequential result binding" };
 	}
+	this->statement_->observe(this->connection_->observer());
+	this->statement_->account(&this->connection_->memory());
 	if (!this->named_results_.empty())
 	{
 		this->statement_->execute(this->parameters_, this->named_results_);
@@ -79,13 +91,67 @@ void basic_statement::execute()
 	{
 		this->statement_->execute(this->parameters_, this->results_);
 	}
+	this->fetched_ = 0;
+
+	if (SQUID_PROBE_ENABLED(statement__execute))
+	{
+		SQUID_PROBE(statement__execute, this, probe_sql(this->statement_->query()), probe_nanoseconds(start));
+	}
+}
+
+void basic_statement::execute(const std::chrono::steady_clock::time_point& deadline)
+{
+	if (std::chrono::steady_clock::now() >= deadline)
+	{
+		throw timeout_error{ "The deadline of the statement has passed" };
+	}
+
+	auto&      watchdog = watchdog::instance();
+	const auto ticket   = watchdog.arm(deadline, *this->connection_);
+	try
+	{
+		this->execute();
+	}
+	catch (...)
+	{
+		if (watchdog.disarm(ticket))
+		{
+			throw timeout_error{ "The statement was cancelled because its deadline passed" };
+		}
+		throw;
+	}
+	watchdog.disarm(ticket);
+}
+
+void basic_statement::execute(const std::chrono::milliseconds& timeout)
+{
+	this->execute(std::chrono::steady_clock::now() + timeout);
+}
+
+bool basic_statement::cancel()
+{
+	return this->connection_->cancel();
+}
+
+async_result<void> basic_statement::execute_async(executor& executor)
+{
+	return executor.submit(this->connection_, [this] { this->execute(); });
 }
 
 bool basic_statement::fetch()
 {
 	if (this->statement_)
 	{
-		return this->statement_->fetch();
+		const auto start   = probe_start(SQUID_PROBE_ENABLED(statement__fetch));
+		const auto has_row = this->statement_->fetch();
+		this->fetched_ += has_row ? 1u : 0u;
+
+		if (SQUID_PROBE_ENABLED(statement__fetch))
+		{
+			SQUID_PROBE(
+			    statement__fetch, this, probe_sql(this->statement_->query()), probe_nanoseconds(start), this->fetched_, has_row ? 1 : 0);
+		}
+		return has_row;
 	}
 	else
 	{
@@ -120,6 +186,31 @@ uint64_t basic_statement::affected_rows()
 	return this->statement_->affected_rows();
 }
 
+std::uint64_t basic_statement::result_bytes() const noexcept
+{
+	return this->statement_ ? this->statement_->result_bytes() : 0u;
+}
+
+const std::map<std::string, parameter>& basic_statement::bound_parameters() const noexcept
+{
+	return this->parameters_;
+}
+
+const std::vector<result>& basic_statement::bound_results() const noexcept
+{
+	return this->results_;
+}
+
+const std::map<std::string, result>& basic_statement::bound_named_results() const noexcept
+{
+	return this->named_results_;
+}
+
+const std::shared_ptr<ibackend_connection>& basic_statement::backend() const noexcept
+{
+	return this->connection_;
+}
+
 ibackend_statement& basic_statement::backend_statement() const
 {
 	if (!this->statement_)
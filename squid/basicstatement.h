@@ -11,6 +11,7 @@
 #include "squid/parameter.h"
 #include "squid/result.h"
 #include "squid/error.h"
+#include "squid/executor.h"
 #include "squid/config.h"
 
 #include "squid/detail/parameterbinder.h"
@@ -23,6 +24,8 @@
 #include "squid/detail/bind_iarchive.h"
 #endif
 
+#include <chrono>
+#include <cstdint>
 #include <map>
 #include <vector>
 #include <memory>
@@ -46,6 +49,7 @@ class SQUID_EXPORT basic_statement
 	std::shared_ptr<ibackend_connection> connection_;    /// backend connection
 	std::unique_ptr<ibackend_statement>  statement_;     /// backend statement
 	std::optional<std::ostringstream>    query_;         /// query stream
+	std::uint64_t                        fetched_;       /// rows fetched since the last execution
 
 	template<typename... Args>
 	void upsert_parameter(std::string_view name, Args&&... args)
@@ -56,6 +60,13 @@ class SQUID_EXPORT basic_statement
 	virtual std::unique_ptr<ibackend_statement> create_statement(std::shared_ptr<ibackend_connection> connection,
 	                                                             std::string_view                     query) = 0;
 
+protected:
+	/// Bindings and connection, for statements that are not executed by a backend statement
+	const std::map<std::string, parameter>&     bound_parameters() const noexcept;
+	const std::vector<result>&                  bound_results() const noexcept;
+	const std::map<std::string, result>&        bound_named_results() const noexcept;
+	const std::shared_ptr<ibackend_connection>& backend() const noexcept;
+
 public:
 	explicit basic_statement(std::shared_ptr<ibackend_connection> connection, std::unique_ptr<ibackend_statement>&& statement);
 	explicit basic_statement(std::shared_ptr<ibackend_connection> connection);
@@ -241,6 +252,65 @@ public:
 	/// Execute the statement.
 	void execute();
 
+	/// Execute the statement, cancelling it if it has not completed at @a deadline (see cancel).
+	/// Throws a timeout_error if it was cancelled because of the deadline, or if the deadline had passed already.
+	/// Fetching the rows afterwards is not bounded by the deadline.
+	void execute(const std::chrono::steady_clock::time_point& deadline);
+
+	/// Execute the statement, cancelling it if it has not completed within @a timeout, see above.
+	void execute(const std::chrono::milliseconds& timeout);
+
+	/// Request the server to cancel the statement that is executing on the connection of this statement.
+	/// May be called from any thread, e.g. while another thread executes the statement, which then fails.
+	/// Returns whether the request was sent, see ibackend_connection::cancel.
+	bool cancel();
+
+	/// Execute the statement on a worker thread of @a executor.
+	/// The statement must outlive the operation, and must not be used until the operation has completed.
+	/// Cancelling the operation while it runs cancels the statement on the server, if the backend supports it.
+	async_result<void> execute_async(executor& executor);
+
+	/// Execute the statement and fetch all rows, each into a T.
+	/// T is bound like with bind_results, so it is either a bindable struct or a type of a single column.
+	/// The result bindings of the statement are not used, and are left unchanged.
+	template<typename T>
+	std::vector<T> fetch_all()
+	{
+		T              row{};
+		std::vector<T> rows{};
+
+		auto results       = std::move(this->results_);
+		auto named_results = std::move(this->named_results_);
+		this->results_.clear();
+		this->named_results_.clear();
+		try
+		{
+			this->bind_results(row);
+			this->execute();
+			while (this->fetch())
+			{
+				rows.push_back(row);
+			}
+		}
+		catch (...)
+		{
+			this->results_       = std::move(results);
+			this->named_results_ = std::move(named_results);
+			throw;
+		}
+		this->results_       = std::move(results);
+		this->named_results_ = std::move(named_results);
+		return rows;
+	}
+
+	/// Like fetch_all, on a worker thread of @a executor.
+	/// The statement must outlive the operation, and must not be used until the operation has completed.
+	template<typename T>
+	async_result<std::vector<T>> fetch_all_async(executor& executor)
+	{
+		return executor.submit(this->connection_, [this] { return this->fetch_all<T>(); });
+	}
+
 	/// Fetch the next row.
 	/// Returns false when the last row was already fetched or when the statement
 	/// did not return any rows.
@@ -261,6 +331,10 @@ public:
 	/// Throws if the statement has not been executed.
 	std::uint64_t affected_rows();
 
+	/// Get the number of bytes that the backend buffers for the result of the last execution, 0 if the statement
+	/// has not been executed. See result_limits for the limits.
+	std::uint64_t result_bytes() const noexcept;
+
 	ibackend_statement& backend_statement() const;
 };
 
@@ -7,6 +7,7 @@
 
 #include "squid/connection.h"
 #include "squid/connectionpool.h"
+#include "squid/routingpool.h"
 #include "squid/ibackendconnectionfactory.h"
 #include "squid/ibackendconnection.h"
 
@@ -49,6 +50,21 @@ connection::connection(connection_pool& pool, const std::chrono::milliseconds& t
 	}
 }
 
+connection::connection(routing_pool& pool, access_mode mode)
+    : backend_{ pool.acquire(mode) }
+{
+	assert(this->backend_);
+}
+
+connection::connection(routing_pool& pool, access_mode mode, const std::chrono::milliseconds& timeout)
+    : backend_{ pool.acquire(mode, timeout) }
+{
+	if (!this->backend_)
+	{
+		throw no_connection_available{};
+	}
+}
+
 std::optional<connection> connection::create(connection_pool& pool)
 {
 	auto backend = pool.try_acquire();
@@ -84,4 +100,24 @@ const std::shared_ptr<ibackend_connection>& connection::backend() const
 	return this->backend_;
 }
 
+void connection::set_observer(std::shared_ptr<statement_observer> observer)
+{
+	this->backend_->set_observer(std::move(observer));
+}
+
+std::uint64_t connection::result_bytes() const noexcept
+{
+	return this->backend_->memory().bytes();
+}
+
+std::uint64_t connection::peak_result_bytes() const noexcept
+{
+	return this->backend_->memory().peak();
+}
+
+void connection::set_result_limits(const result_limits& limits)
+{
+	this->backend_->memory().set_limits(limits);
+}
+
 } // namespace squid
@@ -13,6 +13,7 @@
 #include <memory>
 #include <string_view>
 #include <chrono>
+#include <cstdint>
 #include <optional>
 
 namespace squid {
@@ -25,7 +26,11 @@ public:
 
 class ibackend_connection;
 class ibackend_connection_factory;
+class statement_observer;
+struct result_limits;
 class connection_pool;
+class routing_pool;
+enum class access_mode;
 
 class SQUID_EXPORT connection
 {
@@ -47,6 +52,14 @@ public:
 	/// Throws @c no_connection_available if no connection is available within the specified timeout.
 	explicit connection(connection_pool& pool, const std::chrono::milliseconds& timeout);
 
+	/// Create a connection that acquires a backend connection for @a mode from the routing @a pool.
+	/// Waits indefinitely until the pool has a connection available.
+	explicit connection(routing_pool& pool, access_mode mode);
+
+	/// Create a connection that acquires a backend connection for @a mode from the routing @a pool with a given @a timeout.
+	/// Throws @c no_connection_available if no connection is available within the specified timeout.
+	explicit connection(routing_pool& pool, access_mode mode, const std::chrono::milliseconds& timeout);
+
 	/// Create a connection that acquires a backend connection from the @a pool.
 	/// Returns std::nullopt immediately if no connection is available.
 	static SQUID_EXPORT std::optional<connection> create(connection_pool& pool);
@@ -67,6 +80,22 @@ public:
 
 	/// Get the backend connection
 	const std::shared_ptr<ibackend_connection>& backend() const;
+
+	/// Set the observer of the statements executed on the connection, or remove it if @a observer is nullptr.
+	/// The observer is set on the backend connection, so for a pooled connection it stays after the connection is
+	/// returned to the pool, until it is replaced.
+	void set_observer(std::shared_ptr<statement_observer> observer);
+
+	/// Bytes that the backend buffers for the results of the statements of the connection
+	std::uint64_t result_bytes() const noexcept;
+
+	/// Most bytes that the backend buffered at once for the results of the statements of the connection
+	std::uint64_t peak_result_bytes() const noexcept;
+
+	/// Set the limits of the bytes that the backend buffers for results, see result_limits.
+	/// The limits are set on the backend connection, so for a pooled connection they stay after the connection is
+	/// returned to the pool, until they are replaced.
+	void set_result_limits(const result_limits& limits);
 };
 
 } // namespace squid
@@ -11,139 +11,1377 @@
 #include "squid/ibackendstatement.h"
 #include "squid/error.h"
 
-#include <functional>
-#include <queue>
-#include <mutex>
+#include "squid/detail/concurrenthistogram.h"
+#include "squid/detail/probes.h"
+#include "squid/detail/prometheus.h"
+#include "squid/detail/waitcounter.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <locale>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace squid {
 
 namespace {
 
-class backend_connection_wrapper : public ibackend_connection
+constexpr std::size_t cache_line_size = 64;
+
+using clock_type = wait_counter::clock_type;
+
+/// Sequence number of the calling thread, assigned on first use.
+std::size_t thread_index() noexcept
+{
+	static std::atomic<std::size_t> next_index{};
+	thread_local const std::size_t  index = next_index.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
+
+/// Identifier of a new pool, never 0
+std::uint64_t next_pool_id() noexcept
+{
+	static std::atomic<std::uint64_t> next_id{ 1 };
+	return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+/// The connection that the calling thread released last to the pool with id @a pool, if that pool has thread affinity.
+/// The entries are direct-mapped on the pool id; the slot is only valid if the pool id of the entry matches.
+struct affinity_entry
+{
+	std::uint64_t pool;
+	void*         slot;
+};
+
+affinity_entry& affinity(std::uint64_t pool) noexcept
+{
+	thread_local std::array<affinity_entry, 4> entries{};
+	return entries[pool % entries.size()];
+}
+
+/// Whether the hold time of the next acquisition of the calling thread is recorded.
+/// Reading the clock costs about as much as an uncontended acquisition, so only one in hold_time_sampling
+/// acquisitions of a thread is timed.
+bool sample_hold_time() noexcept
+{
+	thread_local std::uint32_t acquisitions{};
+	return acquisitions++ % connection_pool_stats::hold_time_sampling == 0;
+}
+
+} // namespace
+
+class connection_pool::impl
 {
-	using release_function_type = std::function<void(std::shared_ptr<ibackend_connection>&&)>;
+	/// Size of the storage for the control block of the shared pointers handed out by the pool.
+	/// The control block holds the counters, the (empty) deleter and the allocator, i.e. a pointer to the slot.
+	static constexpr std::size_t control_block_size = 64;
+
+	/// Weight of a new sample in the moving average of the acquire wait time
+	static constexpr double wait_time_smoothing = 0.3;
+
+	static constexpr std::size_t priority_count = 3;
+
+	/// A pooled backend connection.
+	/// The slot embeds the storage of the control block of the shared pointer that is handed out on acquisition,
+	/// so acquiring and releasing a connection does not allocate.
+	/// A slot without connection is closed; it is then not in any idle stack but in the list of closed slots.
+	struct slot
+	{
+		impl*                                pool;
+		std::shared_ptr<ibackend_connection> connection;
+		clock_type::time_point               opened;
+		clock_type::time_point               acquired; // time of acquisition if the hold time is sampled, else the epoch
+		std::atomic<clock_type::rep>         released;  // time of the last release, if idle eviction or health checks are enabled
+		std::atomic<clock_type::rep>         validated; // time of the last health check
+		std::atomic<std::uint32_t>           next_idle; // index + 1 of the next slot in the idle stack, 0 if none
+		std::atomic<std::uint32_t>           parked;    // 1 if parked for the thread that released it last
+		std::atomic<std::uint64_t>           claims;    // number of acquisitions of the slot while it was parked
+
+		std::vector<std::unique_ptr<ibackend_statement>> statements; // registered statements, see statement_indices_
+
+		alignas(std::max_align_t) unsigned char control_block[control_block_size];
+	};
+
+	/// Allocator of the control block of a shared pointer to the connection of a slot.
+	/// The control block is deallocated when the last shared (and weak) pointer to the connection is gone,
+	/// which is exactly when the connection can be given back to the pool.
+	template<class T>
+	class slot_allocator
+	{
+		template<class U>
+		friend class slot_allocator;
+
+		slot* slot_;
+
+	public:
+		using value_type = T;
+
+		explicit slot_allocator(slot& slot) noexcept
+		    : slot_{ &slot }
+		{
+		}
+
+		template<class U>
+		slot_allocator(const slot_allocator<U>& other) noexcept
+		    : slot_{ other.slot_ }
+		{
+		}
+
+		T* allocate(std::size_t n)
+		{
+			static_assert(sizeof(T) <= control_block_size, "control_block_size is too small for this standard library");
+			static_assert(alignof(T) <= alignof(std::max_align_t));
+			assert(n == 1);
+			(void)n;
+			return reinterpret_cast<T*>(this->slot_->control_block);
+		}
+
+		void deallocate(T*, std::size_t) noexcept
+		{
+			this->slot_->pool->release(*this->slot_);
+		}
 
-	std::shared_ptr<ibackend_connection> connection_;
-	release_function_type                release_function_;
+		template<class U>
+		bool operator==(const slot_allocator<U>& other) const noexcept
+		{
+			return this->slot_ == other.slot_;
+		}
+	};
+
+	/// Deleter of the shared pointer to the connection of a slot.
+	/// The pool keeps owning the connection, so it does nothing; it identifies the slot of a handed out connection.
+	struct slot_deleter
+	{
+		slot* slot_;
 
-	std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override
+		void operator()(ibackend_connection*) const noexcept
+		{
+		}
+	};
+
+	/// Lock-free stack of idle slots, with the statistics of the threads that prefer the shard.
+	/// The head holds the index + 1 of the top slot in the low 32 bits and the number of pops (modulo 2^32) in the
+	/// high 32 bits. A slot can only return to the top of the stack after it was popped, so the pop count protects
+	/// the compare-and-swap loops against ABA, and it counts the acquisitions without any extra cost.
+	struct alignas(cache_line_size) shard
 	{
-		return this->connection_->create_statement(query);
+		std::atomic<std::uint64_t> head{};
+		concurrent_histogram       acquire_wait{}; // acquisitions that had to wait
+		concurrent_histogram       hold_time{};    // sampled
+
+		// Pop count extended to 64 bits, guarded by maintenance_mutex_
+		std::uint32_t last_pop_tag{};
+		std::uint64_t pops{};
+	};
+
+	/// An idle slot that maintenance has to close or validate, and where it was taken from
+	struct sweep_candidate
+	{
+		slot*       candidate;
+		std::size_t shard; // shard_count_ if the slot was parked
+		bool        close;
+		bool        taken;
+	};
+
+	using optional_deadline = std::optional<clock_type::time_point>;
+
+	const ibackend_connection_factory& factory_;
+	const std::string                  connection_info_;
+	const connection_pool_options      options_;
+	const std::size_t                  min_size_;
+	const std::size_t                  max_size_;
+	const bool                         stamp_releases_; // whether the release time of slots is needed
+	const std::uint64_t                id_;             // key of the thread affinity entries
+
+	// Index of the registered statements in the statements of a slot, by name
+	std::map<std::string_view, std::size_t, std::less<>> statement_indices_;
+
+	std::unique_ptr<slot[]>  slots_;
+	std::unique_ptr<shard[]> shards_;
+	std::size_t              shard_count_;
+	std::atomic<int>         waiters_; // number of threads waiting for an idle slot
+
+	// Per priority: the number of waiting threads, and a counter that is incremented to wake them up
+	std::array<std::atomic<int>, priority_count> waiting_;
+	std::array<wait_counter, priority_count>     releases_;
+
+	// Nanoseconds per acquisition while threads had to wait, 0 if not known yet
+	std::atomic<std::int64_t> service_nanoseconds_;
+
+	// Observed acquire wait times, only recorded when an acquisition had to wait
+	std::atomic<std::uint64_t> waited_acquisitions_;
+	std::atomic<std::uint64_t> waited_nanoseconds_;
+
+	// Counters of the slow paths
+	std::uint64_t              maintenance_pops_; // pops that were not acquisitions, guarded by maintenance_mutex_
+	std::atomic<std::uint64_t> timeouts_;
+	std::atomic<std::uint64_t> rejections_;
+	std::atomic<std::uint64_t> connections_created_;
+	std::atomic<std::uint64_t> connections_destroyed_;
+	std::atomic<std::uint64_t> connect_failures_total_;
+
+	// Maintenance state, guarded by maintenance_mutex_
+	std::mutex              maintenance_mutex_;
+	std::condition_variable maintenance_cv_;
+	std::vector<slot*>      closed_;           // slots without connection
+	std::vector<slot*>      broken_;           // slots released with a broken connection, still counted in size_
+	std::size_t             size_;             // number of open slots and slots being opened
+	std::size_t             growth_requests_;  // number of connections requested by waiting threads
+	std::size_t             floor_;            // size below which the controller does not evict idle connections
+	double                  average_wait_;     // moving average of the acquire wait time in seconds
+	unsigned                connect_failures_; // number of consecutive failures to open a connection
+	clock_type::time_point  next_connect_;     // no connections are opened before this time
+	std::minstd_rand        random_;           // jitter of the reconnect backoff
+	bool                    stopping_;
+	std::thread             maintainer_;
+
+	/// The shard that the calling thread prefers.
+	std::size_t home_shard() const noexcept
+	{
+		return this->shard_count_ == 1 ? 0 : thread_index() % this->shard_count_;
 	}
 
-	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override
+	void push(shard& shard, slot& slot) noexcept
 	{
-		return this->connection_->create_prepared_statement(query);
+		const auto    index = static_cast<std::uint64_t>(&slot - this->slots_.get()) + 1u;
+		auto          head  = shard.head.load(std::memory_order_relaxed);
+		std::uint64_t new_head{};
+		do
+		{
+			slot.next_idle.store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+			new_head = (head & ~std::uint64_t{ UINT32_MAX }) | index;
+		} while (!shard.head.compare_exchange_weak(head, new_head, std::memory_order_seq_cst, std::memory_order_relaxed));
 	}
 
-	void execute(const std::string& query) override
+	slot* pop(shard& shard) noexcept
 	{
-		this->connection_->execute(query);
+		auto head = shard.head.load(std::memory_order_seq_cst);
+		while (const auto index = static_cast<std::uint32_t>(head))
+		{
+			// The slot may be popped and reused by another thread meanwhile, then the pop count makes the exchange fail.
+			auto&      slot     = this->slots_[index - 1u];
+			const auto new_head = ((head >> 32) + 1u) << 32 | slot.next_idle.load(std::memory_order_relaxed);
+			if (shard.head.compare_exchange_weak(head, new_head, std::memory_order_acquire, std::memory_order_acquire))
+			{
+				return &slot;
+			}
+		}
+		return nullptr;
 	}
 
-public:
-	explicit backend_connection_wrapper(std::shared_ptr<ibackend_connection>&& connection, release_function_type&& release_function)
-	    : connection_{ std::move(connection) }
-	    , release_function_{ std::move(release_function) }
+	/// Pops an idle slot from the home shard, or else steals one from another shard.
+	/// With thread affinity, takes a slot that is parked for another thread when the shards are empty.
+	slot* pop_any() noexcept
 	{
+		const auto home = this->home_shard();
+		for (std::size_t n = 0; n < this->shard_count_; ++n)
+		{
+			if (auto slot = this->pop(this->shards_[(home + n) % this->shard_count_]))
+			{
+				return slot;
+			}
+		}
+		return this->options_.thread_affinity ? this->take_parked() : nullptr;
 	}
 
-	~backend_connection_wrapper()
+	/// Takes the slot that is parked for the calling thread, or else pops an idle slot.
+	slot* acquire_idle() noexcept
 	{
-		this->release_function_(std::move(this->connection_));
+		if (this->options_.thread_affinity)
+		{
+			const auto& entry = affinity(this->id_);
+			if (entry.pool == this->id_)
+			{
+				auto& own = *static_cast<slot*>(entry.slot);
+				if (this->unpark(own))
+				{
+					own.claims.store(own.claims.load(std::memory_order_relaxed) + 1u, std::memory_order_relaxed);
+					return &own;
+				}
+			}
+		}
+		return this->pop_any();
 	}
-};
 
-} // namespace
+	/// Takes a slot that is parked for another thread.
+	/// The scan starts at an offset that depends on the calling thread, so that threads do not all go for the same slot.
+	slot* take_parked() noexcept
+	{
+		const auto start = thread_index();
+		for (std::size_t n = 0; n < this->max_size_; ++n)
+		{
+			auto& slot = this->slots_[(start + n) % this->max_size_];
+			// Sequentially consistent, see park
+			if (slot.parked.load() && this->unpark(slot))
+			{
+				slot.claims.store(slot.claims.load(std::memory_order_relaxed) + 1u, std::memory_order_relaxed);
+				return &slot;
+			}
+		}
+		return nullptr;
+	}
 
-class connection_pool::impl
-{
-	std::queue<std::shared_ptr<ibackend_connection>> queue_;
-	std::mutex                                       mutex_;
-	std::condition_variable                          cv_;
+	/// Takes @a slot out of the parked state, returns false if it was not parked.
+	bool unpark(slot& slot) noexcept
+	{
+		std::uint32_t expected{ 1 };
+		return slot.parked.load(std::memory_order_relaxed) == 1u && slot.parked.compare_exchange_strong(expected, 0u);
+	}
 
-	using lock_type = std::unique_lock<std::mutex>;
+	/// Parks @a slot for the thread that released it last, or makes it idle if threads are waiting.
+	/// A thread that starts waiting announces itself before it looks for parked slots, and this stores the parked
+	/// state before it looks for waiting threads, so that either the waiting thread finds the slot, or this finds
+	/// the waiting thread.
+	void park(slot& slot) noexcept
+	{
+		slot.parked.store(1u);
+		if (this->waiters_.load() > 0 && this->unpark(slot))
+		{
+			this->push_idle(slot, this->home_shard());
+		}
+	}
 
-public:
-	impl(const ibackend_connection_factory& factory, std::string_view connection_info, std::size_t count)
+	/// Makes an idle slot available and wakes up a waiting thread, if any.
+	void make_idle(slot& slot, std::size_t shard_index) noexcept
+	{
+		if (this->stamp_releases_)
+		{
+			slot.released.store(clock_type::now().time_since_epoch().count(), std::memory_order_relaxed);
+		}
+		this->push_idle(slot, shard_index);
+	}
+
+	/// Like make_idle, without updating the release time of the slot.
+	void push_idle(slot& slot, std::size_t shard_index) noexcept
+	{
+		this->push(this->shards_[shard_index], slot);
+		this->notify_waiter();
+	}
+
+	/// Wakes up a thread of the highest priority that has waiting threads, if any.
+	/// The slot was pushed before, so a thread that starts waiting after the lanes were looked at here finds it.
+	void notify_waiter() noexcept
+	{
+		if (this->waiters_.load() > 0)
+		{
+			for (std::size_t lane = 0; lane < priority_count; ++lane)
+			{
+				if (this->waiting_[lane].load() > 0)
+				{
+					this->releases_[lane].increment_and_notify(1);
+					return;
+				}
+			}
+		}
+	}
+
+	/// Wakes up @a count threads of every priority that has waiting threads.
+	void notify_waiters(int count) noexcept
+	{
+		if (this->waiters_.load() > 0)
+		{
+			for (std::size_t lane = 0; lane < priority_count; ++lane)
+			{
+				if (this->waiting_[lane].load() > 0)
+				{
+					this->releases_[lane].increment_and_notify(count);
+				}
+			}
+		}
+	}
+
+	/// Whether a shard has an idle slot.
+	bool has_idle() const noexcept
+	{
+		for (std::size_t n = 0; n < this->shard_count_; ++n)
+		{
+			if (static_cast<std::uint32_t>(this->shards_[n].head.load()))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// Whether threads with a priority of @a lane or higher are waiting, if @a inclusive,
+	/// or else with a priority higher than @a lane.
+	bool others_wait(std::size_t lane, bool inclusive) const noexcept
+	{
+		if (this->waiters_.load() == 0)
+		{
+			return false;
+		}
+		for (std::size_t higher = 0; higher < lane + (inclusive ? 1u : 0u); ++higher)
+		{
+			if (this->waiting_[higher].load() > 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// Pops an idle slot, unless threads of a higher priority are waiting for one.
+	slot* pop_for(std::size_t lane) noexcept
+	{
+		return this->others_wait(lane, false) ? nullptr : this->pop_any();
+	}
+
+	/// Whether a thread with priority @a lane that starts waiting now is expected to get a slot before @a deadline.
+	bool can_make(std::size_t lane, const clock_type::time_point& deadline) const noexcept
+	{
+		const auto service = this->service_nanoseconds_.load(std::memory_order_relaxed);
+		if (!this->options_.reject_unreachable_deadlines || service == 0)
+		{
+			return true;
+		}
+
+		std::int64_t ahead{};
+		for (std::size_t higher = 0; higher <= lane; ++higher)
+		{
+			ahead += std::max(this->waiting_[higher].load(), 0);
+		}
+		return clock_type::now() + std::chrono::nanoseconds{ (ahead + 1) * service } <= deadline;
+	}
+
+	/// Whether a thread with priority @a lane may start waiting.
+	bool admit(std::size_t lane, const optional_deadline& deadline) noexcept
+	{
+		const auto admitted = (this->options_.max_waiters == 0 ||
+		                       static_cast<std::size_t>(std::max(this->waiters_.load(), 0)) < this->options_.max_waiters) &&
+		                      (!deadline || this->can_make(lane, *deadline));
+		if (!admitted)
+		{
+			this->rejections_.fetch_add(1, std::memory_order_relaxed);
+		}
+		return admitted;
+	}
+
+	/// Pops an idle slot, or waits for one until @a deadline if given.
+	/// Returns nullptr on timeout, or if the thread was not admitted to wait.
+	slot* pop_or_wait(const optional_deadline& deadline, std::size_t lane)
+	{
+		if (!this->others_wait(lane, true))
+		{
+			if (auto slot = this->acquire_idle())
+			{
+				return slot;
+			}
+		}
+
+		if (!this->admit(lane, deadline))
+		{
+			return nullptr;
+		}
+
+		const auto start = clock_type::now();
+		this->request_growth();
+
+		auto& waiting  = this->waiting_[lane];
+		auto& releases = this->releases_[lane];
+
+		slot* slot{ nullptr };
+		for (;;)
+		{
+			// Announce the waiter before looking for an idle slot again, so that a concurrent release
+			// is either seen by that look, or increments the release counter after it was read here.
+			waiting.fetch_add(1);
+			this->waiters_.fetch_add(1);
+			const auto released = releases.load();
+			slot                = this->pop_for(lane);
+			const auto in_time  = slot || releases.wait(released, deadline);
+			this->waiters_.fetch_sub(1);
+			waiting.fetch_sub(1);
+
+			if (slot || (slot = this->pop_for(lane)) || !in_time)
+			{
+				break;
+			}
+		}
+
+		if (!slot || this->has_idle())
+		{
+			// Threads of a lower priority may have let an idle slot pass for this one, or releases that happened
+			// together may all have woken this thread; either way, another waiting thread can have the idle slot.
+			this->notify_waiter();
+		}
+
+		const auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start);
+		this->waited_acquisitions_.fetch_add(1, std::memory_order_relaxed);
+		this->waited_nanoseconds_.fetch_add(static_cast<std::uint64_t>(waited.count()), std::memory_order_relaxed);
+		if (slot)
+		{
+			this->shards_[this->home_shard()].acquire_wait.record(waited);
+		}
+		else
+		{
+			this->timeouts_.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		return slot;
+	}
+
+	/// @a start is the time the acquisition started, if the acquire probe is enabled
+	std::shared_ptr<ibackend_connection> make_handle(slot* slot, const clock_type::time_point& start)
+	{
+		if (SQUID_PROBE_ENABLED(pool__acquire))
+		{
+			SQUID_PROBE(pool__acquire, this, slot ? slot->connection.get() : nullptr, probe_nanoseconds(start));
+		}
+		if (!slot)
+		{
+			return nullptr;
+		}
+
+		slot->acquired = sample_hold_time() ? clock_type::now() : clock_type::time_point{};
+
+		// The slot is released when the allocator deallocates the control block
+		return std::shared_ptr<ibackend_connection>{ slot->connection.get(), slot_deleter{ slot }, slot_allocator<char>{ *slot } };
+	}
+
+	void release(slot& slot) noexcept
+	{
+		const auto broken = slot.connection->is_broken();
+		if (SQUID_PROBE_ENABLED(pool__release))
+		{
+			SQUID_PROBE(pool__release, this, slot.connection.get(), broken ? 1 : 0);
+		}
+
+		if (slot.acquired != clock_type::time_point{})
+		{
+			this->shards_[this->home_shard()].hold_time.record(clock_type::now() - slot.acquired);
+		}
+
+		if (broken)
+		{
+			this->discard(slot);
+		}
+		else if (this->options_.thread_affinity)
+		{
+			if (this->stamp_releases_)
+			{
+				slot.released.store(clock_type::now().time_since_epoch().count(), std::memory_order_relaxed);
+			}
+			affinity(this->id_) = affinity_entry{ this->id_, &slot };
+			this->park(slot);
+		}
+		else
+		{
+			this->make_idle(slot, this->home_shard());
+		}
+	}
+
+	/// Hands a slot with a broken connection to the maintenance thread, which closes and replaces it.
+	void discard(slot& slot) noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock{ this->maintenance_mutex_ };
+			this->broken_.push_back(&slot); // capacity is reserved for all slots
+		}
+		this->maintenance_cv_.notify_one();
+	}
+
+	/// Opens the connection of a closed slot and prepares the registered statements on it, outside of any lock.
+	void open(slot& slot)
+	{
+		try
+		{
+			slot.connection = this->factory_.create_backend_connection(this->connection_info_);
+			if (this->options_.observer)
+			{
+				slot.connection->set_observer(this->options_.observer);
+			}
+			slot.connection->memory().set_limits(this->options_.result_limits);
+			slot.statements.reserve(this->statement_indices_.size());
+			for (const auto& [name, query] : this->options_.statements)
+			{
+				slot.statements.push_back(slot.connection->create_prepared_statement(query));
+				slot.statements.back()->prepare();
+			}
+		}
+		catch (...)
+		{
+			slot.statements.clear();
+			slot.connection.reset();
+			this->connect_failures_total_.fetch_add(1, std::memory_order_relaxed);
+			throw;
+		}
+		slot.opened = clock_type::now();
+		this->connections_created_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// Opens @a count connections, with up to options.connect_concurrency threads.
+	void open_initial_connections(std::size_t count)
 	{
 		if (count == 0)
 		{
-			throw std::invalid_argument{ "count must be greater than zero" };
+			return;
+		}
+
+		// The first connection is opened on this thread, so that backend libraries can initialize safely.
+		auto& first = this->slots_[0];
+		this->open(first);
+
+		auto thread_count = this->options_.connect_concurrency ? this->options_.connect_concurrency
+		                                                       : std::max<std::size_t>(1u, std::thread::hardware_concurrency());
+		thread_count      = std::min(thread_count, count - 1);
+
+		std::atomic<std::size_t> next_index{ 1 };
+		std::exception_ptr       failure{};
+		std::mutex               failure_mutex{};
+
+		auto worker = [&] {
+			for (auto index = next_index.fetch_add(1); index < count; index = next_index.fetch_add(1))
+			{
+				try
+				{
+					this->open(this->slots_[index]);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock{ failure_mutex };
+					if (!failure)
+					{
+						failure = std::current_exception();
+					}
+					next_index = count;
+				}
+			}
+		};
+
+		std::vector<std::thread> threads{};
+		threads.reserve(thread_count);
+		for (std::size_t n = 1; n < thread_count; ++n)
+		{
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (auto& thread : threads)
+		{
+			thread.join();
 		}
 
-		while (count--)
+		if (failure)
 		{
-			this->queue_.push(factory.create_backend_connection(connection_info));
+			std::rethrow_exception(failure);
 		}
 	}
 
-	/// Waits indefinitely until the pool has a connection available.
-	std::shared_ptr<ibackend_connection> acquire()
+	/// Called by a thread that has to wait for a connection.
+	void request_growth()
 	{
-		lock_type lock(mutex_);
+		if (this->min_size_ == this->max_size_)
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ this->maintenance_mutex_ };
+			if (this->size_ + this->growth_requests_ >= this->max_size_)
+			{
+				return;
+			}
+			++this->growth_requests_;
+		}
+		this->maintenance_cv_.notify_one();
+	}
+
+	/// Opens a connection in a closed slot, if the maximum size is not reached.
+	/// Returns false if that was not possible, after scheduling the next attempt if opening the connection failed.
+	bool grow(std::unique_lock<std::mutex>& lock)
+	{
+		if (this->size_ >= this->max_size_ || this->closed_.empty())
+		{
+			return false;
+		}
+
+		auto& slot = *this->closed_.back();
+		this->closed_.pop_back();
+		++this->size_;
+
+		lock.unlock();
+		try
+		{
+			this->open(slot);
+		}
+		catch (...)
+		{
+			lock.lock();
+			this->closed_.push_back(&slot);
+			--this->size_;
+			this->back_off();
+			return false;
+		}
+		this->make_idle(slot, this->home_shard());
+		lock.lock();
+
+		this->connect_failures_ = 0;
+		return true;
+	}
 
-		while (this->queue_.empty())
+	/// Postpones the next attempt to open a connection after a failure.
+	/// The delay grows exponentially and is jittered, so that pools do not reconnect to a recovering server in lockstep.
+	void back_off()
+	{
+		auto delay = this->options_.reconnect_backoff;
+		for (auto n = this->connect_failures_; n && delay < this->options_.max_reconnect_backoff; --n)
 		{
-			this->cv_.wait(lock);
+			delay *= 2;
 		}
+		delay = std::min(delay, this->options_.max_reconnect_backoff);
+		++this->connect_failures_;
 
-		return this->acquire_from_front_of_queue(lock);
+		const auto half   = delay / 2;
+		const auto jitter = std::uniform_int_distribution<std::chrono::milliseconds::rep>{ 0, half.count() }(this->random_);
+		this->next_connect_ = clock_type::now() + (delay - half) + std::chrono::milliseconds{ jitter };
 	}
 
-	/// Returns nullptr if no connection is available within the specified timeout.
-	std::shared_ptr<ibackend_connection> acquire(const std::chrono::milliseconds& timeout)
+	/// Whether connections must be opened, for waiting threads or to reach the floor of the pool size.
+	bool wants_connections() const noexcept
 	{
-		lock_type lock(mutex_);
+		return this->size_ < this->max_size_ && (this->growth_requests_ > 0 || this->size_ < this->floor_);
+	}
 
-		while (this->queue_.empty())
+	/// Opens the connections that are wanted, unless opening connections is backing off after a failure.
+	void replenish(std::unique_lock<std::mutex>& lock)
+	{
+		while (!this->stopping_ && this->wants_connections() && clock_type::now() >= this->next_connect_)
 		{
-			if (this->cv_.wait_for(lock, timeout) == std::cv_status::timeout)
+			// Take the request before growing: the new connection may be acquired before the lock is taken again,
+			// and then the next waiting thread must be able to request growth.
+			const auto requested = this->growth_requests_ > 0;
+			if (requested)
 			{
-				return nullptr;
+				--this->growth_requests_;
 			}
+			if (!this->grow(lock))
+			{
+				if (requested)
+				{
+					++this->growth_requests_;
+				}
+				break;
+			}
+		}
+		if (this->size_ >= this->max_size_)
+		{
+			this->growth_requests_ = 0;
 		}
+	}
 
-		return this->acquire_from_front_of_queue(lock);
+	/// Closes the connections of @a slots outside of the lock, and makes the slots available for new connections.
+	void close(std::unique_lock<std::mutex>& lock, const std::vector<slot*>& slots)
+	{
+		if (slots.empty())
+		{
+			return;
+		}
+
+		this->size_ -= slots.size();
+
+		lock.unlock();
+		for (auto slot : slots)
+		{
+			slot->statements.clear();
+			slot->connection.reset();
+		}
+		this->connections_destroyed_.fetch_add(slots.size(), std::memory_order_relaxed);
+		lock.lock();
+
+		this->closed_.insert(this->closed_.end(), slots.begin(), slots.end());
 	}
 
-	std::shared_ptr<ibackend_connection> try_acquire()
+	/// Closes the connections that were broken when they were released.
+	/// They were in use, so they are replaced regardless of the floor of the pool size.
+	void close_broken(std::unique_lock<std::mutex>& lock, std::vector<slot*>& closing)
 	{
-		lock_type lock(mutex_);
+		closing.assign(this->broken_.begin(), this->broken_.end());
+		this->broken_.clear();
+		this->growth_requests_ += closing.size();
+		this->close(lock, closing);
+	}
 
-		if (this->queue_.empty())
+	/// Validates the idle connections in @a due, which were taken out of the pool, and puts the healthy ones back where
+	/// they were taken from. The others are closed.
+	void validate(std::unique_lock<std::mutex>& lock, const std::vector<sweep_candidate>& due, std::vector<slot*>& failed)
+	{
+		failed.clear();
+		if (due.empty())
 		{
-			return nullptr;
+			return;
+		}
+
+		lock.unlock();
+		for (const auto& entry : due)
+		{
+			auto& slot    = *entry.candidate;
+			auto  healthy = false;
+			try
+			{
+				healthy = slot.connection->ping();
+			}
+			catch (...)
+			{
+			}
+
+			if (healthy)
+			{
+				slot.validated.store(clock_type::now().time_since_epoch().count(), std::memory_order_relaxed);
+				if (entry.shard == this->shard_count_)
+				{
+					this->park(slot);
+				}
+				else
+				{
+					this->push_idle(slot, entry.shard);
+				}
+			}
+			else
+			{
+				failed.push_back(&slot);
+			}
+		}
+		lock.lock();
+
+		this->close(lock, failed);
+	}
+
+	/// Closes idle connections that exceeded their lifetime or that were idle for too long, and collects the idle
+	/// connections that are due for a health check in @a due.
+	/// The stacks are first walked without taking anything, so nothing is disturbed when no connection is due.
+	/// Only the slots above the deepest due one are then popped from a stack, and pushed back in their order; parked slots
+	/// are only taken when they are due themselves.
+	void sweep(std::unique_lock<std::mutex>&  lock,
+	           std::vector<sweep_candidate>& candidates,
+	           std::vector<slot*>&           popped,
+	           std::vector<slot*>&           expired,
+	           std::vector<sweep_candidate>& due)
+	{
+		candidates.clear();
+		expired.clear();
+		due.clear();
+
+		const auto now       = clock_type::now();
+		auto       evictable = this->options_.idle_timeout.count() && this->size_ > this->floor_ ? this->size_ - this->floor_ : 0u;
+		if (!this->options_.max_lifetime.count() && !evictable && !this->options_.health_check_interval.count())
+		{
+			return;
+		}
+
+		const auto idle_for = [&](const slot& slot) {
+			return now - clock_type::time_point{ clock_type::duration{ slot.released.load(std::memory_order_relaxed) } };
+		};
+		const auto expired_lifetime = [&](const slot& slot) {
+			return this->options_.max_lifetime.count() && now - slot.opened >= this->options_.max_lifetime;
+		};
+		const auto must_validate = [&](const slot& slot) {
+			const auto last_seen = std::max(slot.released.load(std::memory_order_relaxed), slot.validated.load(std::memory_order_relaxed));
+			return this->options_.health_check_interval.count() &&
+			       now - clock_type::time_point{ clock_type::duration{ last_seen } } >= this->options_.health_check_interval;
+		};
+		const auto is_due = [&](const slot& slot) {
+			return expired_lifetime(slot) || (evictable && idle_for(slot) >= this->options_.idle_timeout) || must_validate(slot);
+		};
+		// A candidate that was acquired and released again since the walk may not be due anymore
+		const auto still_due = [&](const sweep_candidate& entry) {
+			const auto& slot = *entry.candidate;
+			return entry.close ? expired_lifetime(slot) || idle_for(slot) >= this->options_.idle_timeout : must_validate(slot);
+		};
+
+		const auto listed = [&](const slot& slot) {
+			const auto same = [&](const sweep_candidate& entry) { return entry.candidate == &slot; };
+			return std::any_of(candidates.begin(), candidates.end(), same);
+		};
+
+		// The stacks may change while they are walked, so a slot may be seen twice; it is looked at again when it is taken
+		for (std::size_t n = 0; n < this->shard_count_; ++n)
+		{
+			auto index = static_cast<std::uint32_t>(this->shards_[n].head.load(std::memory_order_acquire));
+			for (std::size_t depth = 0; index && depth < this->max_size_; ++depth)
+			{
+				auto& slot = this->slots_[index - 1u];
+				if (is_due(slot) && !listed(slot))
+				{
+					candidates.push_back(sweep_candidate{ &slot, n, false, false });
+				}
+				index = slot.next_idle.load(std::memory_order_relaxed);
+			}
+		}
+		if (this->options_.thread_affinity)
+		{
+			for (std::size_t index = 0; index < this->max_size_; ++index)
+			{
+				auto& slot = this->slots_[index];
+				if (slot.parked.load(std::memory_order_relaxed) && is_due(slot))
+				{
+					candidates.push_back(sweep_candidate{ &slot, this->shard_count_, false, false });
+				}
+			}
+		}
+		if (candidates.empty())
+		{
+			return;
+		}
+
+		// Longest idle first, so that those are evicted
+		std::sort(candidates.begin(), candidates.end(), [](const sweep_candidate& a, const sweep_candidate& b) {
+			return a.candidate->released.load(std::memory_order_relaxed) < b.candidate->released.load(std::memory_order_relaxed);
+		});
+		std::size_t wanted{};
+		for (auto& entry : candidates)
+		{
+			const auto& slot = *entry.candidate;
+			if (expired_lifetime(slot))
+			{
+				entry.close = true;
+			}
+			else if (evictable && idle_for(slot) >= this->options_.idle_timeout)
+			{
+				entry.close = true;
+				--evictable;
+			}
+			else if (!must_validate(slot))
+			{
+				continue;
+			}
+			candidates[wanted++] = entry;
+		}
+		candidates.resize(wanted);
+
+		const auto find = [&](const slot* slot, std::size_t shard) {
+			return std::find_if(candidates.begin(), candidates.end(), [&](const sweep_candidate& entry) {
+				return entry.candidate == slot && entry.shard == shard;
+			});
+		};
+
+		for (std::size_t n = 0; n <= this->shard_count_; ++n)
+		{
+			auto remaining = static_cast<std::size_t>(
+			    std::count_if(candidates.begin(), candidates.end(), [n](const sweep_candidate& entry) { return entry.shard == n; }));
+			if (remaining == 0)
+			{
+				continue;
+			}
+			if (n == this->shard_count_)
+			{
+				for (auto& entry : candidates)
+				{
+					if (entry.shard == n && this->unpark(*entry.candidate))
+					{
+						entry.taken = still_due(entry);
+						if (!entry.taken)
+						{
+							this->park(*entry.candidate);
+						}
+					}
+				}
+				continue;
+			}
+
+			// Pop down to the deepest candidate; a candidate that was acquired meanwhile empties the stack
+			popped.clear();
+			auto& shard = this->shards_[n];
+			while (remaining)
+			{
+				auto slot = this->pop(shard);
+				if (!slot)
+				{
+					break;
+				}
+				++this->maintenance_pops_;
+				if (const auto entry = find(slot, n); entry != candidates.end() && !entry->taken)
+				{
+					entry->taken = still_due(*entry);
+					--remaining;
+					if (!entry->taken)
+					{
+						popped.push_back(slot);
+					}
+				}
+				else
+				{
+					popped.push_back(slot);
+				}
+			}
+			for (auto slot = popped.rbegin(); slot != popped.rend(); ++slot)
+			{
+				this->push(shard, **slot);
+			}
+			if (!popped.empty())
+			{
+				this->notify_waiters(static_cast<int>(popped.size()));
+			}
+		}
+
+		for (const auto& entry : candidates)
+		{
+			if (entry.taken)
+			{
+				if (entry.close)
+				{
+					expired.push_back(entry.candidate);
+				}
+				else
+				{
+					due.push_back(entry);
+				}
+			}
+		}
+
+		this->close(lock, expired);
+	}
+
+	/// Adjusts the floor of the pool size from the observed acquire wait times.
+	void control(std::uint64_t& last_waited_acquisitions, std::uint64_t& last_waited_nanoseconds)
+	{
+		const auto waited_acquisitions = this->waited_acquisitions_.load(std::memory_order_relaxed);
+		const auto waited_nanoseconds  = this->waited_nanoseconds_.load(std::memory_order_relaxed);
+		const auto acquisitions        = waited_acquisitions - last_waited_acquisitions;
+		const auto sample = acquisitions ? static_cast<double>(waited_nanoseconds - last_waited_nanoseconds) / acquisitions / 1e9 : 0.0;
+		last_waited_acquisitions = waited_acquisitions;
+		last_waited_nanoseconds  = waited_nanoseconds;
+
+		this->average_wait_ = wait_time_smoothing * sample + (1.0 - wait_time_smoothing) * this->average_wait_;
+
+		const auto target = std::chrono::duration<double>{ this->options_.target_acquire_wait }.count();
+		if (this->average_wait_ > target)
+		{
+			// Too slow: keep what we have and grow ahead of demand
+			this->floor_ = std::min(this->max_size_, std::max(this->floor_, this->size_) + 1u);
+		}
+		else if (this->average_wait_ < target / 2 && this->floor_ > this->min_size_)
+		{
+			--this->floor_;
+		}
+	}
+
+	/// Estimates the time per acquisition while threads have to wait, which is the rate at which waiting threads are
+	/// served. Without served waiters, the estimate decays, so that rejections based on it cannot persist.
+	void estimate_service_time(clock_type::duration elapsed, std::uint64_t& last_acquisitions, std::uint64_t& last_served)
+	{
+		const auto timeouts     = this->timeouts_.load(std::memory_order_relaxed);
+		const auto served       = this->waited_acquisitions_.load(std::memory_order_relaxed) - timeouts;
+		const auto acquisitions = this->count_acquisitions();
+		const auto previous     = this->service_nanoseconds_.load(std::memory_order_relaxed);
+
+		if (served > last_served && acquisitions > last_acquisitions)
+		{
+			const auto sample  = std::chrono::duration<double, std::nano>{ elapsed }.count() / (acquisitions - last_acquisitions);
+			const auto average = previous ? wait_time_smoothing * sample + (1.0 - wait_time_smoothing) * previous : sample;
+			this->service_nanoseconds_.store(std::max<std::int64_t>(1, std::llround(average)), std::memory_order_relaxed);
 		}
 		else
 		{
-			return this->acquire_from_front_of_queue(lock);
+			this->service_nanoseconds_.store(previous / 2, std::memory_order_relaxed);
+		}
+
+		last_acquisitions = acquisitions;
+		last_served       = served;
+	}
+
+	/// Extends the pop counts of the shards to 64 bits and returns the number of acquisitions.
+	/// Must be called with the maintenance mutex locked, at least once per 2^32 pops of a shard.
+	std::uint64_t count_acquisitions() noexcept
+	{
+		std::uint64_t pops{};
+		for (std::size_t n = 0; n < this->shard_count_; ++n)
+		{
+			auto&      shard = this->shards_[n];
+			const auto tag   = static_cast<std::uint32_t>(shard.head.load(std::memory_order_relaxed) >> 32);
+			shard.pops += static_cast<std::uint32_t>(tag - shard.last_pop_tag);
+			shard.last_pop_tag = tag;
+			pops += shard.pops;
+		}
+		if (this->options_.thread_affinity)
+		{
+			for (std::size_t index = 0; index < this->max_size_; ++index)
+			{
+				pops += this->slots_[index].claims.load(std::memory_order_relaxed);
+			}
+		}
+		return pops - this->maintenance_pops_;
+	}
+
+	/// Approximate number of idle slots, the stacks may change while they are walked.
+	std::size_t count_idle() const noexcept
+	{
+		std::size_t count{};
+		for (std::size_t n = 0; n < this->shard_count_; ++n)
+		{
+			auto index = static_cast<std::uint32_t>(this->shards_[n].head.load(std::memory_order_acquire));
+			for (; index && count < this->max_size_; ++count)
+			{
+				index = this->slots_[index - 1u].next_idle.load(std::memory_order_relaxed);
+			}
+		}
+		if (this->options_.thread_affinity)
+		{
+			for (std::size_t index = 0; index < this->max_size_; ++index)
+			{
+				count += this->slots_[index].parked.load(std::memory_order_relaxed);
+			}
+		}
+		return count;
+	}
+
+	void maintain()
+	{
+		std::vector<sweep_candidate> candidates{}, due{};
+		std::vector<slot*>           popped{}, expired{};
+		candidates.reserve(2 * this->max_size_);
+		due.reserve(this->max_size_);
+		popped.reserve(this->max_size_);
+		expired.reserve(this->max_size_);
+
+		std::uint64_t last_waited_acquisitions{}, last_waited_nanoseconds{}, last_acquisitions{}, last_served{};
+
+		const auto has_work = [this] {
+			return this->stopping_ || !this->broken_.empty() || (this->wants_connections() && clock_type::now() >= this->next_connect_);
+		};
+
+		std::unique_lock<std::mutex> lock{ this->maintenance_mutex_ };
+		auto                         last_tick = clock_type::now();
+		auto                         next_tick = last_tick + this->options_.maintenance_interval;
+		while (!this->stopping_)
+		{
+			const auto wake_up = this->wants_connections() ? std::min(next_tick, this->next_connect_) : next_tick;
+			this->maintenance_cv_.wait_until(lock, wake_up, has_work);
+			if (this->stopping_)
+			{
+				break;
+			}
+
+			this->close_broken(lock, expired);
+			this->replenish(lock);
+
+			if (const auto now = clock_type::now(); now >= next_tick)
+			{
+				this->estimate_service_time(now - last_tick, last_acquisitions, last_served);
+				this->sweep(lock, candidates, popped, expired, due);
+				this->validate(lock, due, expired);
+				this->control(last_waited_acquisitions, last_waited_nanoseconds);
+				this->replenish(lock);
+				last_tick = now;
+				next_tick = clock_type::now() + this->options_.maintenance_interval;
+			}
+		}
+	}
+
+public:
+	impl(const ibackend_connection_factory& factory,
+	     std::string_view                   connection_info,
+	     std::size_t                        count,
+	     const connection_pool_options&     options)
+	    : factory_{ factory }
+	    , connection_info_{ connection_info }
+	    , options_{ options }
+	    , min_size_{ options.min_connections.value_or(count) }
+	    , max_size_{ count }
+	    , stamp_releases_{ options.idle_timeout.count() || options.health_check_interval.count() }
+	    , id_{ next_pool_id() }
+	    , statement_indices_{}
+	    , slots_{}
+	    , shards_{}
+	    , shard_count_{ options.shards ? options.shards : std::max<std::size_t>(1u, std::thread::hardware_concurrency()) }
+	    , waiters_{}
+	    , waiting_{}
+	    , releases_{}
+	    , service_nanoseconds_{}
+	    , waited_acquisitions_{}
+	    , waited_nanoseconds_{}
+	    , maintenance_pops_{}
+	    , timeouts_{}
+	    , rejections_{}
+	    , connections_created_{}
+	    , connections_destroyed_{}
+	    , connect_failures_total_{}
+	    , maintenance_mutex_{}
+	    , maintenance_cv_{}
+	    , closed_{}
+	    , broken_{}
+	    , size_{ min_size_ }
+	    , growth_requests_{}
+	    , floor_{ min_size_ }
+	    , average_wait_{}
+	    , connect_failures_{}
+	    , next_connect_{}
+	    , random_{ static_cast<std::minstd_rand::result_type>(clock_type::now().time_since_epoch().count()) }
+	    , stopping_{}
+	    , maintainer_{}
+	{
+		if (count == 0)
+		{
+			throw std::invalid_argument{ "count must be greater than zero" };
+		}
+		if (count > UINT32_MAX - 1u)
+		{
+			throw std::invalid_argument{ "count is too large" };
+		}
+		if (this->min_size_ > this->max_size_)
+		{
+			throw std::invalid_argument{ "min_connections must not be greater than count" };
+		}
+		if (this->options_.maintenance_interval <= std::chrono::milliseconds::zero())
+		{
+			throw std::invalid_argument{ "maintenance_interval must be greater than zero" };
+		}
+		if (this->options_.reconnect_backoff <= std::chrono::milliseconds::zero() ||
+		    this->options_.max_reconnect_backoff < this->options_.reconnect_backoff)
+		{
+			throw std::invalid_argument{ "reconnect_backoff must be greater than zero and not greater than max_reconnect_backoff" };
+		}
+
+		this->shard_count_ = std::min(this->shard_count_, count);
+		this->slots_       = std::make_unique<slot[]>(count);
+		this->shards_      = std::make_unique<shard[]>(this->shard_count_);
+
+		for (std::size_t index = 0; index < count; ++index)
+		{
+			this->slots_[index].pool = this;
+		}
+		for (const auto& [name, query] : this->options_.statements)
+		{
+			this->statement_indices_.emplace(name, this->statement_indices_.size());
+		}
+
+		this->open_initial_connections(this->min_size_);
+
+		// Distribute the open connections evenly over the shards
+		for (std::size_t index = 0; index < this->min_size_; ++index)
+		{
+			this->make_idle(this->slots_[index], index % this->shard_count_);
 		}
+
+		this->closed_.reserve(count);
+		this->broken_.reserve(count);
+		for (auto index = count; index-- > this->min_size_;)
+		{
+			this->closed_.push_back(&this->slots_[index]);
+		}
+
+		this->maintainer_ = std::thread{ [this] { this->maintain(); } };
+	}
+
+	~impl() noexcept
+	{
+		if (this->maintainer_.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock{ this->maintenance_mutex_ };
+				this->stopping_ = true;
+			}
+			this->maintenance_cv_.notify_one();
+			this->maintainer_.join();
+		}
+	}
+
+	/// Waits indefinitely until the pool has a connection available.
+	std::shared_ptr<ibackend_connection> acquire(connection_priority priority)
+	{
+		const auto start = probe_start(SQUID_PROBE_ENABLED(pool__acquire));
+
+		// Without deadline, only a rejection returns no slot
+		auto slot = this->pop_or_wait(std::nullopt, static_cast<std::size_t>(priority));
+		if (!slot)
+		{
+			throw error{ "Too many threads are waiting for a connection" };
+		}
+		return this->make_handle(slot, start);
 	}
 
-private:
-	std::shared_ptr<ibackend_connection> acquire_from_front_of_queue(const lock_type&)
+	/// Returns nullptr if no connection is available before the deadline.
+	std::shared_ptr<ibackend_connection> acquire_until(const clock_type::time_point& deadline, connection_priority priority)
 	{
-		auto connection = this->queue_.front();
-		this->queue_.pop();
+		const auto start = probe_start(SQUID_PROBE_ENABLED(pool__acquire));
+		return this->make_handle(this->pop_or_wait(deadline, static_cast<std::size_t>(priority)), start);
+	}
 
-		return std::make_shared<backend_connection_wrapper>(
-		    std::move(connection), [this](std::shared_ptr<ibackend_connection>&& connection) { this->release(std::move(connection)); });
+	std::shared_ptr<ibackend_connection> try_acquire(connection_priority priority)
+	{
+		const auto start = probe_start(SQUID_PROBE_ENABLED(pool__acquire));
+		const auto lane  = static_cast<std::size_t>(priority);
+		return this->make_handle(this->others_wait(lane, true) ? nullptr : this->acquire_idle(), start);
 	}
 
-	void release(std::shared_ptr<ibackend_connection>&& connection)
+	static ibackend_statement* registered_statement(const std::shared_ptr<ibackend_connection>& connection, std::string_view name) noexcept
 	{
+		const auto deleter = std::get_deleter<slot_deleter>(connection);
+		if (!deleter)
 		{
-			lock_type lock(mutex_);
-			this->queue_.push(connection);
+			return nullptr;
 		}
-		this->cv_.notify_one();
+		const auto& slot    = *deleter->slot_;
+		const auto& indices = slot.pool->statement_indices_;
+		const auto  it      = indices.find(name);
+		return it == indices.end() ? nullptr : slot.statements[it->second].get();
+	}
+
+	std::size_t capacity() const noexcept
+	{
+		return this->max_size_;
+	}
+
+	std::size_t size()
+	{
+		std::lock_guard<std::mutex> lock{ this->maintenance_mutex_ };
+		return this->size_;
+	}
+
+	connection_pool_stats stats()
+	{
+		connection_pool_stats stats{};
+
+		for (std::size_t n = 0; n < this->shard_count_; ++n)
+		{
+			this->shards_[n].acquire_wait.add_to(stats.acquire_wait);
+			this->shards_[n].hold_time.add_to(stats.hold_time);
+		}
+
+		std::uint64_t acquisitions{};
+		{
+			std::lock_guard<std::mutex> lock{ this->maintenance_mutex_ };
+			acquisitions = this->count_acquisitions();
+			stats.total  = this->size_;
+		}
+
+		// Acquisitions that did not wait are not recorded individually
+		const auto waited = stats.acquire_wait.count();
+		stats.acquire_wait.counts[0] += acquisitions > waited ? acquisitions - waited : 0u;
+
+		stats.idle                  = std::min(this->count_idle(), stats.total);
+		stats.in_use                = stats.total - stats.idle;
+		stats.waiters               = static_cast<std::size_t>(std::max(this->waiters_.load(), 0));
+		stats.acquisitions          = acquisitions;
+		stats.timeouts              = this->timeouts_.load(std::memory_order_relaxed);
+		stats.rejections            = this->rejections_.load(std::memory_order_relaxed);
+		stats.connections_created   = this->connections_created_.load(std::memory_order_relaxed);
+		stats.connections_destroyed = this->connections_destroyed_.load(std::memory_order_relaxed);
+		stats.connect_failures      = this->connect_failures_total_.load(std::memory_order_relaxed);
+
+		return stats;
 	}
 };
 
-connection_pool::connection_pool(const ibackend_connection_factory& factory, std::string_view connection_info, std::size_t count)
-    : pimpl_{ std::make_unique<impl>(factory, connection_info, count) }
+connection_pool::connection_pool(const ibackend_connection_factory& factory,
+                                 std::string_view                   connection_info,
+                                 std::size_t                        count,
+                                 const connection_pool_options&     options)
+    : pimpl_{ std::make_unique<impl>(factory, connection_info, count, options) }
 {
 }
 
@@ -151,19 +1389,77 @@ connection_pool::~connection_pool() noexcept
 {
 }
 
-std::shared_ptr<ibackend_connection> connection_pool::acquire()
+std::shared_ptr<ibackend_connection> connection_pool::acquire(connection_priority priority)
+{
+	return this->pimpl_->acquire(priority);
+}
+
+std::shared_ptr<ibackend_connection> connection_pool::acquire(const std::chrono::milliseconds& timeout, connection_priority priority)
+{
+	return this->pimpl_->acquire_until(std::chrono::steady_clock::now() + timeout, priority);
+}
+
+std::shared_ptr<ibackend_connection> connection_pool::acquire_until(const std::chrono::steady_clock::time_point& deadline,
+                                                                    connection_priority                          priority)
 {
-	return this->pimpl_->acquire();
+	return this->pimpl_->acquire_until(deadline, priority);
 }
 
-std::shared_ptr<ibackend_connection> connection_pool::acquire(const std::chrono::milliseconds& timeout)
+std::shared_ptr<ibackend_connection> connection_pool::try_acquire(connection_priority priority)
 {
-	return this->pimpl_->acquire(timeout);
+	return this->pimpl_->try_acquire(priority);
 }
 
-std::shared_ptr<ibackend_connection> connection_pool::try_acquire()
+std::size_t connection_pool::size() const
 {
-	return this->pimpl_->try_acquire();
+	return this->pimpl_->size();
+}
+
+std::size_t connection_pool::capacity() const
+{
+	return this->pimpl_->capacity();
+}
+
+connection_pool_stats connection_pool::stats() const
+{
+	return this->pimpl_->stats();
+}
+
+ibackend_statement* connection_pool::registered_statement(const std::shared_ptr<ibackend_connection>& connection,
+                                                          std::string_view                            name) noexcept
+{
+	return impl::registered_statement(connection, name);
+}
+
+std::string to_prometheus_text(const connection_pool_stats& stats, std::string_view pool_name, std::string_view prefix)
+{
+	std::ostringstream out{};
+	out.imbue(std::locale::classic());
+	out.precision(9);
+
+	write_metric(out, prefix, "connections", "gauge", "Number of open connections.", pool_name, stats.total);
+	write_metric(out, prefix, "idle_connections", "gauge", "Number of open connections that are not acquired.", pool_name, stats.idle);
+	write_metric(out, prefix, "in_use_connections", "gauge", "Number of acquired connections.", pool_name, stats.in_use);
+	write_metric(out, prefix, "waiters", "gauge", "Number of threads waiting for a connection.", pool_name, stats.waiters);
+	write_metric(out, prefix, "acquisitions_total", "counter", "Number of connections handed out.", pool_name, stats.acquisitions);
+	write_metric(out, prefix, "timeouts_total", "counter", "Number of acquisitions that timed out.", pool_name, stats.timeouts);
+	write_metric(
+	    out, prefix, "rejections_total", "counter", "Number of acquisitions rejected without waiting.", pool_name, stats.rejections);
+	write_metric(
+	    out, prefix, "connections_created_total", "counter", "Number of connections opened.", pool_name, stats.connections_created);
+	write_metric(
+	    out, prefix, "connections_destroyed_total", "counter", "Number of connections closed.", pool_name, stats.connections_destroyed);
+	write_metric(out,
+	             prefix,
+	             "connect_failures_total",
+	             "counter",
+	             "Number of failed attempts to open a connection.",
+	             pool_name,
+	             stats.connect_failures);
+	write_histogram(out, prefix, "acquire_wait", "Time that acquisitions waited for a connection.", pool_name, stats.acquire_wait);
+	write_histogram(out, prefix, "hold_time", "Time from acquisition until release of a connection.", pool_name, stats.hold_time);
+
+	return out.str();
 }
 
 } // namespace squid
@@ -8,25 +8,157 @@
 #pragma once
 
 #include "squid/api.h"
+#include "squid/durationhistogram.h"
+#include "squid/resultmemory.h"
 
+#include <map>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <chrono>
+#include <cstdint>
+#include <optional>
 
 namespace squid {
 
 class ibackend_connection;
 class ibackend_connection_factory;
+class statement_observer;
+class ibackend_statement;
 
+/// Options of a connection_pool
+struct SQUID_EXPORT connection_pool_options
+{
+	/// Number of shards of idle connections, 0 means one per hardware thread.
+	/// Each shard is a lock-free stack. A thread prefers the shard it was assigned to (round robin, on first use),
+	/// and steals from the other shards when that one is empty. Multiple shards reduce contention on many-core hosts.
+	std::size_t shards = 1;
+
+	/// Minimum number of open connections. When not set, the pool has a fixed size.
+	/// Otherwise, the pool grows in the background up to its maximum size when threads have to wait for a connection,
+	/// and idle connections above the minimum are closed after @a idle_timeout.
+	std::optional<std::size_t> min_connections = std::nullopt;
+
+	/// Time after which an idle connection above the minimum is closed, 0 disables idle eviction.
+	std::chrono::milliseconds idle_timeout = std::chrono::milliseconds::zero();
+
+	/// Time after which a connection is closed and replaced by a new one, 0 disables recycling.
+	std::chrono::milliseconds max_lifetime = std::chrono::milliseconds::zero();
+
+	/// Acquire wait time that the sizing controller aims for.
+	/// While the average wait time of acquisitions that had to wait exceeds this target, idle connections are kept
+	/// open and the pool is grown ahead of demand.
+	std::chrono::milliseconds target_acquire_wait = std::chrono::milliseconds{ 1 };
+
+	/// Time after which an idle connection is validated with ibackend_connection::ping, 0 (the default) disables validation.
+	/// Validation is done by the maintenance thread; a connection is taken out of the pool while it is validated.
+	/// Broken connections are replaced either way when they are released.
+	std::chrono::milliseconds health_check_interval = std::chrono::milliseconds::zero();
+
+	/// Initial delay between attempts to replace a broken connection when opening a connection fails.
+	/// The delay doubles after every failed attempt, up to @a max_reconnect_backoff, and is jittered by up to half its value.
+	std::chrono::milliseconds reconnect_backoff = std::chrono::milliseconds{ 100 };
+
+	/// Maximum delay between attempts to open a connection.
+	std::chrono::milliseconds max_reconnect_backoff = std::chrono::seconds{ 30 };
+
+	/// Interval of the background maintenance: idle eviction, recycling, health checks and sizing.
+	std::chrono::milliseconds maintenance_interval = std::chrono::seconds{ 1 };
+
+	/// Number of threads that open the initial connections, 0 means one per hardware thread.
+	/// The first connection is always opened on the calling thread, so that backend libraries can initialize.
+	std::size_t connect_concurrency = 0;
+
+	/// Maximum number of threads waiting for a connection, 0 means unbounded.
+	/// Acquisitions that would exceed it are rejected immediately.
+	std::size_t max_waiters = 0;
+
+	/// Whether an acquisition with a timeout is rejected immediately when it is not expected to be served in time.
+	/// The expected wait time is estimated from the number of threads waiting ahead and the rate at which connections
+	/// were acquired while threads had to wait. This is an admission control knob for overloaded services, which would
+	/// rather fail fast than wait in vain; since the estimate can be wrong, it is off by default.
+	bool reject_unreachable_deadlines = false;
+
+	/// Whether a thread preferentially gets back the connection that it released last.
+	/// A released connection is then parked for the releasing thread, unless threads are waiting for a connection.
+	/// Other threads take parked connections only when the shards have no idle connection left. This keeps the
+	/// server-side prepared statements of a thread on its connection, and the connection in the caches of its core.
+	bool thread_affinity = false;
+
+	/// Queries to prepare on every connection, by name.
+	/// A new connection prepares them before it is handed out, whether it is opened on construction, to replace a
+	/// broken or recycled connection, or to grow the pool. Failing to prepare one of them counts as failing to open
+	/// the connection. Use prepared_statement::registered to execute them without preparing them again.
+	std::map<std::string, std::string, std::less<>> statements = {};
+
+	/// Observer of the statements executed on every connection, see statement_observer.
+	/// Set on a new connection before the registered statements are prepared.
+	std::shared_ptr<statement_observer> observer = nullptr;
+
+	/// Limits of the bytes buffered for results on every connection, see result_limits
+	squid::result_limits result_limits = {};
+};
+
+/// Priority of an acquisition.
+/// Threads waiting with a higher priority are served first, and an acquisition does not take an idle connection
+/// while threads of the same or a higher priority are waiting.
+enum class connection_priority
+{
+	high,
+	normal,
+	low
+};
+
+/// Snapshot of the state and the counters of a connection_pool.
+/// The values are read while the pool is in use, so they need not be exactly consistent with each other.
+struct SQUID_EXPORT connection_pool_stats
+{
+	/// One in this many acquisitions of a thread is timed for the hold time histogram
+	static constexpr std::uint32_t hold_time_sampling = 16;
+
+	std::size_t        total;                 /// number of open connections, including the ones being opened
+	std::size_t        idle;                  /// number of open connections that are not acquired
+	std::size_t        in_use;                /// number of open connections that are not idle, i.e. acquired or being checked
+	std::size_t        waiters;               /// number of threads waiting for a connection
+	std::uint64_t      acquisitions;          /// number of connections handed out
+	std::uint64_t      timeouts;              /// number of acquisitions with timeout that returned nullptr
+	std::uint64_t      rejections;            /// number of acquisitions rejected without waiting
+	std::uint64_t      connections_created;   /// number of connections opened
+	std::uint64_t      connections_destroyed; /// number of connections closed by the pool
+	std::uint64_t      connect_failures;      /// number of failed attempts to open a connection
+	duration_histogram acquire_wait;          /// time that acquisitions waited for a connection, 0 if one was idle
+	duration_histogram hold_time;             /// time from acquisition until release of a sample of the connections
+};
+
+/// Format @a stats in the Prometheus text exposition format.
+/// The metric names start with @a prefix. If @a pool_name is not empty, all samples get a label pool="@a pool_name".
+/// The histograms are exported with fixed bucket limits from 1 µs to 10 s.
+SQUID_EXPORT std::string to_prometheus_text(const connection_pool_stats& stats,
+                                            std::string_view             pool_name = {},
+                                            std::string_view             prefix    = "squid_connection_pool");
+
+/// A pool of backend connections.
+/// Acquiring and releasing a connection does not allocate memory and takes no lock.
+/// The pool must outlive the connections acquired from it.
+/// A connection is returned to the pool when the last shared or weak pointer to it is released.
+/// A background thread opens and closes connections, so that the cost of doing that is not paid by the threads
+/// acquiring connections. A connection that is broken when it is released (see ibackend_connection::is_broken),
+/// or that fails its periodic health check, is closed and replaced in the background, so acquisition only hands
+/// out connections that were healthy when they were last released or checked.
 class SQUID_EXPORT connection_pool final
 {
 	class impl;
 	std::unique_ptr<impl> pimpl_;
 
 public:
-	/// Create a pool of @a count connections using the connection factory @a factory and a connection
+	/// Create a pool of at most @a count connections using the connection factory @a factory and a connection
 	/// string @a connection_info passed to the backend.
-	connection_pool(const ibackend_connection_factory& factory, std::string_view connection_info, std::size_t count);
+	/// Opens options.min_connections connections (@a count if not set) before returning.
+	/// If the pool opens connections later on (elastic sizing, recycling), @a factory must outlive the pool.
+	connection_pool(const ibackend_connection_factory& factory,
+	                std::string_view                   connection_info,
+	                std::size_t                        count,
+	                const connection_pool_options&     options = {});
 	~connection_pool() noexcept;
 
 	connection_pool(const connection_pool&)            = delete;
@@ -36,15 +168,41 @@ public:
 
 	/// Acquire a backend connection
 	/// Waits indefinitely until the pool has a connection available.
-	std::shared_ptr<ibackend_connection> acquire();
+	/// Throws an error if the acquisition is rejected because options.max_waiters threads are waiting.
+	std::shared_ptr<ibackend_connection> acquire(connection_priority priority = connection_priority::normal);
 
 	/// Acquire a backend connection with timeout
-	/// Returns nullptr if no connection is available within the specified timeout.
-	std::shared_ptr<ibackend_connection> acquire(const std::chrono::milliseconds& timeout);
+	/// Returns nullptr if no connection is available within the specified timeout, or if the acquisition is rejected
+	/// because options.max_waiters threads are waiting or because it is not expected to be served in time.
+	std::shared_ptr<ibackend_connection> acquire(const std::chrono::milliseconds& timeout,
+	                                             connection_priority              priority = connection_priority::normal);
+
+	/// Acquire a backend connection with deadline
+	/// Like acquire with timeout.
+	std::shared_ptr<ibackend_connection> acquire_until(const std::chrono::steady_clock::time_point& deadline,
+	                                                   connection_priority                          priority = connection_priority::normal);
 
 	/// Acquire a backend connection
-	/// Immediately returns nullptr if no connection is available.
-	std::shared_ptr<ibackend_connection> try_acquire();
+	/// Immediately returns nullptr if no connection is available, or if threads of the same or a higher priority
+	/// are waiting for one.
+	std::shared_ptr<ibackend_connection> try_acquire(connection_priority priority = connection_priority::normal);
+
+	/// Number of open connections, including the ones being opened
+	std::size_t size() const;
+
+	/// Maximum number of open connections
+	std::size_t capacity() const;
+
+	/// Current state and counters of the pool.
+	/// Acquisitions are counted by the idle stacks themselves, so the only cost for the acquire/release fast path is
+	/// reading the clock for one in connection_pool_stats::hold_time_sampling acquisitions.
+	connection_pool_stats stats() const;
+
+	/// The statement registered as @a name (see connection_pool_options::statements), as prepared on @a connection.
+	/// Returns nullptr if @a connection was not acquired from a connection_pool, or if no statement is registered
+	/// as @a name. The statement belongs to the connection, and may only be used while the connection is acquired.
+	static ibackend_statement* registered_statement(const std::shared_ptr<ibackend_connection>& connection,
+	                                                std::string_view                            name) noexcept;
 };
 
 } // namespace squid
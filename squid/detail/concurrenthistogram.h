@@ -0,0 +1,47 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/durationhistogram.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace squid {
+
+/// Lock-free recorder of a duration_histogram.
+/// Recording is one relaxed increment of a bucket counter and one relaxed addition to the sum of the durations.
+/// A snapshot taken while durations are being recorded may miss the most recent ones.
+class concurrent_histogram final
+{
+	std::array<std::atomic<std::uint64_t>, duration_histogram::bucket_count> counts_{};
+	std::atomic<std::uint64_t>                                                total_nanoseconds_{};
+
+public:
+	void record(std::chrono::nanoseconds duration) noexcept
+	{
+		const auto nanoseconds = static_cast<std::uint64_t>(std::max(duration.count(), std::chrono::nanoseconds::rep{}));
+		this->counts_[duration_histogram::bucket_of(nanoseconds)].fetch_add(1u, std::memory_order_relaxed);
+		this->total_nanoseconds_.fetch_add(nanoseconds, std::memory_order_relaxed);
+	}
+
+	/// Adds the recorded durations to @a histogram
+	void add_to(duration_histogram& histogram) const noexcept
+	{
+		for (std::size_t bucket = 0; bucket < duration_histogram::bucket_count; ++bucket)
+		{
+			histogram.counts[bucket] += this->counts_[bucket].load(std::memory_order_relaxed);
+		}
+		histogram.total_nanoseconds += this->total_nanoseconds_.load(std::memory_order_relaxed);
+	}
+};
+
+} // namespace squid
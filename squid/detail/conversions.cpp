@@ -5,10 +5,6 @@
 // http://www.boost.org/LICENSE_1_0.txt)
 //
 
-#if defined(_MSC_VER)
-#define _CRT_SECURE_NO_WARNINGS
-#endif
-
 #include "squid/detail/conversions.h"
 #include "squid/config.h"
 
@@ -17,11 +13,8 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #endif
 
-#include <optional>
-#include <regex>
-#include <cstring>
-#include <cstdio>
-#include <cmath>
+#include <cstdint>
+#include <iterator>
 #include <cassert>
 
 #if defined(_MSC_VER)
@@ -32,55 +25,199 @@ namespace squid {
 
 namespace {
 
+/// Forward-only scanner over the text representation of a date and/or time.
+/// It works directly on the input and never allocates.
+class scanner
+{
+	const char* pos_;
+	const char* end_;
+
+public:
+	explicit scanner(std::string_view in)
+	    : pos_{ in.data() }
+	    , end_{ in.data() + in.length() }
+	{
+	}
+
+	bool at_end() const
+	{
+		return this->pos_ == this->end_;
+	}
+
+	bool accept(char c)
+	{
+		if (this->pos_ != this->end_ && *this->pos_ == c)
+		{
+			++this->pos_;
+			return true;
+		}
+		return false;
+	}
+
+	bool accept_digit(unsigned& out)
+	{
+		if (this->pos_ != this->end_)
+		{
+			const auto digit = static_cast<unsigned>(static_cast<unsigned char>(*this->pos_)) - unsigned{ '0' };
+			if (digit <= 9u)
+			{
+				++this->pos_;
+				out = digit;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// Parses exactly @a count digits.
+	bool fixed_digits(int count, unsigned& out)
+	{
+		if (this->end_ - this->pos_ < count)
+		{
+			return false;
+		}
+
+		unsigned value{};
+		for (int i = 0; i < count; ++i)
+		{
+			const auto digit = static_cast<unsigned>(static_cast<unsigned char>(this->pos_[i])) - unsigned{ '0' };
+			if (digit > 9u)
+			{
+				return false;
+			}
+			value = value * 10u + digit;
+		}
+
+		this->pos_ += count;
+		out = value;
+		return true;
+	}
+
+	/// Parses at least 1 and at most @a max_count digits.
+	bool variable_digits(int max_count, unsigned& out)
+	{
+		unsigned value{}, digit{};
+		int      count{};
+		while (count < max_count && this->accept_digit(digit))
+		{
+			value = value * 10u + digit;
+			++count;
+		}
+		out = value;
+		return count > 0;
+	}
+
+	/// Parses the (possibly empty) digit sequence after the decimal point of the seconds.
+	/// The result is rounded to microseconds.
+	void fraction(std::uint32_t& microseconds)
+	{
+		std::uint32_t value{};
+		unsigned      digit{};
+		int           count{};
+		for (; count < 6 && this->accept_digit(digit); ++count)
+		{
+			value = value * 10u + digit;
+		}
+		for (int i = count; i < 6; ++i)
+		{
+			value *= 10u;
+		}
+		if (count == 6 && this->accept_digit(digit) && digit >= 5u)
+		{
+			++value;
+		}
+		while (this->accept_digit(digit))
+		{
+		}
+		microseconds = value;
+	}
+
+	/// Parses an optional UTC offset in the format ` ?[+-]HH(:?MM)?`.
+	/// Returns true if there is no more input or if a valid UTC offset was parsed.
+	bool utc_offset(int& minutes)
+	{
+		if (this->at_end())
+		{
+			return true;
+		}
+
+		this->accept(' ');
+
+		int sign{};
+		if (this->accept('+'))
+		{
+			sign = 1;
+		}
+		else if (this->accept('-'))
+		{
+			sign = -1;
+		}
+		else
+		{
+			return false;
+		}
+
+		unsigned hours{}, mins{};
+		if (!this->fixed_digits(2, hours))
+		{
+			return false;
+		}
+		if (this->accept(':'))
+		{
+			if (!this->fixed_digits(2, mins))
+			{
+				return false;
+			}
+		}
+		else if (!this->at_end() && !this->fixed_digits(2, mins))
+		{
+			return false;
+		}
+
+		minutes = sign * static_cast<int>(hours * 60u + mins);
+		return true;
+	}
+};
+
 struct parsed_time_point
 {
-	int                   year;
-	unsigned              month;
-	unsigned              day;
-	unsigned              hours;
-	unsigned              minutes;
-	unsigned              seconds;
-	std::optional<double> fracseconds;
-	std::optional<int>    utc_offset_minutes;
+	int           year;
+	unsigned      month;
+	unsigned      day;
+	unsigned      hours;
+	unsigned      minutes;
+	unsigned      seconds;
+	std::uint32_t microseconds;
+	int           utc_offset_minutes;
 };
 
 parsed_time_point parse_time_point(std::string_view in)
 {
-	parsed_time_point out{};
+	// Format: YYYY-MM-DD[T ]HH:MM:SS(.f*)?( ?[+-]HH(:?MM)?|Z)?
 
-	static const std::regex re{ R"(^(\d{4})-(\d{2})-(\d{2})[T ](\d{2}):(\d{2}):(\d{2})(\.\d*)?( ?([+-]\d{2})(:?(\d{2}))?|Z)?$)" };
-	//                              1       2       3          4       5       6      7       8  9          10 11
+	parsed_time_point out{};
+	scanner           s{ in };
+	unsigned          year{};
 
-	std::match_results<std::string_view::const_iterator> matches;
-	if (!std::regex_match(in.begin(), in.end(), matches, re) || matches.size() != 1 + 11)
+	if (!(s.fixed_digits(4, year) && s.accept('-') && s.fixed_digits(2, out.month) && s.accept('-') && s.fixed_digits(2, out.day) &&
+	      (s.accept('T') || s.accept(' ')) && s.fixed_digits(2, out.hours) && s.accept(':') && s.fixed_digits(2, out.minutes) &&
+	      s.accept(':') && s.fixed_digits(2, out.seconds)))
 	{
 		throw std::invalid_argument{ "invalid time point format" };
 	}
 
-	out.year    = string_to_number<int>(matches[1].str());
-	out.month   = string_to_number<unsigned>(matches[2].str());
-	out.day     = string_to_number<unsigned>(matches[3].str());
-	out.hours   = string_to_number<unsigned>(matches[4].str());
-	out.minutes = string_to_number<unsigned>(matches[5].str());
-	out.seconds = string_to_number<unsigned>(matches[6].str());
-
-	if (matches.length(7) > 1)
+	if (s.accept('.'))
 	{
-		out.fracseconds = string_to_number<double>(matches[7].str());
+		s.fraction(out.microseconds);
 	}
 
-	if (matches.length(9))
+	if (!((s.accept('Z') || s.utc_offset(out.utc_offset_minutes)) && s.at_end()))
 	{
-		const auto hours            = matches[9].str();
-		const auto utc_offset_hours = string_to_number<int>((hours.front() == '+') ? &hours[1] : hours);
-		out.utc_offset_minutes      = utc_offset_hours * 60;
-
-		if (matches.length(11))
-		{
-			out.utc_offset_minutes.value() += string_to_number<int>(matches[11].str()) * (utc_offset_hours < 0 ? -1 : 1);
-		}
+		throw std::invalid_argument{ "invalid time point format" };
 	}
 
+	out.year = static_cast<int>(year);
+
 	return out;
 }
 
@@ -93,69 +230,120 @@ struct parsed_date
 
 parsed_date parse_date(std::string_view in)
 {
-	parsed_date out;
+	// Format: -?Y{1,4}-MM-DD
 
-	static const std::regex re{ R"(^(-?\d{1,4})-(\d{2})-(\d{2})$)" };
-	//                              1       2       3
+	parsed_date out{};
+	scanner     s{ in };
+	unsigned    year{};
 
-	std::match_results<std::string_view::const_iterator> matches;
-	if (!std::regex_match(in.begin(), in.end(), matches, re) || matches.size() != 1 + 3)
+	const auto negative = s.accept('-');
+	if (!(s.variable_digits(4, year) && s.accept('-') && s.fixed_digits(2, out.month) && s.accept('-') && s.fixed_digits(2, out.day) &&
+	      s.at_end()))
 	{
 		throw std::invalid_argument{ "invalid date format" };
 	}
 
-	out.year  = string_to_number<int>(matches[1].str());
-	out.month = string_to_number<unsigned>(matches[2].str());
-	out.day   = string_to_number<unsigned>(matches[3].str());
+	out.year = negative ? -static_cast<int>(year) : static_cast<int>(year);
 
 	return out;
 }
 
 struct parsed_time_of_day
 {
-	unsigned              hours;
-	unsigned              minutes;
-	unsigned              seconds;
-	std::optional<double> fracseconds;
-	std::optional<int>    utc_offset_minutes;
+	unsigned      hours;
+	unsigned      minutes;
+	unsigned      seconds;
+	std::uint32_t microseconds;
+	int           utc_offset_minutes;
 };
 
 parsed_time_of_day parse_time_of_day(std::string_view in)
 {
-	parsed_time_of_day out;
+	// Format: HH:MM:SS(.f*)?( ?[+-]HH(:?MM)?)?
 
-	static const std::regex re{ R"(^(\d{2}):(\d{2}):(\d{2})(\.\d*)?( ?([+-]\d{2})(:?(\d{2}))?)?$)" };
-	//                              1       2       3      4       5  6          7  8
+	parsed_time_of_day out{};
+	scanner            s{ in };
 
-	std::match_results<std::string_view::const_iterator> matches;
-	if (!std::regex_match(in.begin(), in.end(), matches, re) || matches.size() != 1 + 8)
+	if (!(s.fixed_digits(2, out.hours) && s.accept(':') && s.fixed_digits(2, out.minutes) && s.accept(':') &&
+	      s.fixed_digits(2, out.seconds)))
 	{
 		throw std::invalid_argument{ "invalid time of day format" };
 	}
 
-	out.hours   = string_to_number<unsigned>(matches[1].str());
-	out.minutes = string_to_number<unsigned>(matches[2].str());
-	out.seconds = string_to_number<unsigned>(matches[3].str());
+	if (s.accept('.'))
+	{
+		s.fraction(out.microseconds);
+	}
 
-	if (matches.length(4) > 1)
+	if (!(s.utc_offset(out.utc_offset_minutes) && s.at_end()))
 	{
-		out.fracseconds = string_to_number<double>(matches[4].str());
+		throw std::invalid_argument{ "invalid time of day format" };
 	}
 
-	if (matches.length(6))
+	return out;
+}
+
+/// Forward-only writer of the text representation of a date and/or time into a caller provided buffer.
+class char_writer
+{
+	char* pos_;
+	char* last_;
+	bool  overflow_;
+
+public:
+	char_writer(char* first, char* last)
+	    : pos_{ first }
+	    , last_{ last }
+	    , overflow_{}
 	{
-		const auto hours            = matches[6].str();
-		const auto utc_offset_hours = string_to_number<int>((hours.front() == '+') ? &hours[1] : hours);
-		out.utc_offset_minutes      = utc_offset_hours * 60;
+	}
 
-		if (matches.length(8))
+	char_writer& put(char c)
+	{
+		if (this->pos_ == this->last_)
 		{
-			out.utc_offset_minutes.value() += string_to_number<int>(matches[8].str()) * (utc_offset_hours < 0 ? -1 : 1);
+			this->overflow_ = true;
 		}
+		else if (!this->overflow_)
+		{
+			*this->pos_++ = c;
+		}
+		return *this;
 	}
 
-	return out;
-}
+	/// Writes @a value left-padded with zeroes to at least @a width digits.
+	char_writer& padded(std::uint64_t value, int width)
+	{
+		char digits[20];
+		const auto res    = std::to_chars(std::begin(digits), std::end(digits), value);
+		const auto length = static_cast<int>(res.ptr - digits);
+		for (int i = length; i < width; ++i)
+		{
+			this->put('0');
+		}
+		for (const char* it = digits; it != res.ptr; ++it)
+		{
+			this->put(*it);
+		}
+		return *this;
+	}
+
+	/// Writes @a year like printf's "%04d".
+	char_writer& year(int year)
+	{
+		return year < 0 ? this->put('-').padded(static_cast<std::uint64_t>(-static_cast<std::int64_t>(year)), 3)
+		                : this->padded(static_cast<std::uint64_t>(year), 4);
+	}
+
+	std::to_chars_result result() const
+	{
+		if (this->overflow_)
+		{
+			return std::to_chars_result{ this->last_, std::errc::value_too_large };
+		}
+		return std::to_chars_result{ this->pos_, std::errc{} };
+	}
+};
 
 } // namespace
 
@@ -171,15 +359,8 @@ void string_to_time_point(std::string_view in, time_point& out)
 	out = std::chrono::sys_days{ std::chrono::year{ parsed.year } / std::chrono::month{ parsed.month } / parsed.day } +
 	      std::chrono::hours{ parsed.hours } + std::chrono::minutes{ parsed.minutes } + std::chrono::seconds{ parsed.seconds };
 
-	if (parsed.fracseconds)
-	{
-		out += std::chrono::microseconds{ static_cast<uint32_t>(parsed.fracseconds.value() * 1e6 + .5) };
-	}
-
-	if (parsed.utc_offset_minutes)
-	{
-		out -= std::chrono::minutes{ parsed.utc_offset_minutes.value() };
-	}
+	out += std::chrono::microseconds{ parsed.microseconds };
+	out -= std::chrono::minutes{ parsed.utc_offset_minutes };
 }
 
 time_point string_to_time_point(std::string_view in)
@@ -219,15 +400,8 @@ void string_to_time_of_day(std::string_view in, time_of_day& out)
 
 	std::chrono::microseconds tmp{ (3600LL * parsed.hours + 60 * parsed.minutes + parsed.seconds) * 1000000LL };
 
-	if (parsed.fracseconds)
-	{
-		tmp += std::chrono::microseconds{ static_cast<uint32_t>(parsed.fracseconds.value() * 1e6 + .5) };
-	}
-
-	if (parsed.utc_offset_minutes)
-	{
-		tmp -= std::chrono::minutes{ parsed.utc_offset_minutes.value() };
-	}
+	tmp += std::chrono::microseconds{ parsed.microseconds };
+	tmp -= std::chrono::minutes{ parsed.utc_offset_minutes };
 
 	out = time_of_day{ tmp };
 }
@@ -239,40 +413,40 @@ time_of_day string_to_time_of_day(std::string_view in)
 	return result;
 }
 
-void time_point_to_string(const time_point& in, std::string& out)
+std::to_chars_result time_point_to_chars(char* first, char* last, const time_point& in)
 {
-	// TODO: use std::format when it becomes available in libstdc++
 	using namespace std::chrono;
-	auto           dp = floor<days>(in);
-	year_month_day date{ dp };
-	hh_mm_ss       time{ floor<microseconds>(in - dp) };
-
+	const auto           dp = floor<days>(in);
+	const year_month_day date{ dp };
+	const hh_mm_ss       time{ floor<microseconds>(in - dp) };
+
+	char_writer out{ first, last };
+	out.year(static_cast<int>(date.year()))
+	    .put('-')
+	    .padded(static_cast<unsigned>(date.month()), 2)
+	    .put('-')
+	    .padded(static_cast<unsigned>(date.day()), 2)
+	    .put(' ')
+	    .padded(static_cast<std::uint64_t>(time.hours().count()), 2)
+	    .put(':')
+	    .padded(static_cast<std::uint64_t>(time.minutes().count()), 2)
+	    .put(':')
+	    .padded(static_cast<std::uint64_t>(time.seconds().count()), 2);
 	if (time.subseconds().count())
 	{
-		out.resize(10 * 3 + 19 * 4 + 6 + 1 + 1);
-		std::sprintf(out.data(),
-		             "%04d-%02u-%02u %02ld:%02ld:%02ld.%06ldZ",
-		             static_cast<int>(date.year()),
-		             static_cast<unsigned>(date.month()),
-		             static_cast<unsigned>(date.day()),
-		             static_cast<long>(time.hours().count()),
-		             static_cast<long>(time.minutes().count()),
-		             static_cast<long>(time.seconds().count()),
-		             static_cast<long>(time.subseconds().count()));
-	}
-	else
-	{
-		out.resize(10 * 3 + 19 * 3 + 5 + 1 + 1);
-		std::sprintf(out.data(),
-		             "%04d-%02u-%02u %02ld:%02ld:%02ldZ",
-		             static_cast<int>(date.year()),
-		             static_cast<unsigned>(date.month()),
-		             static_cast<unsigned>(date.day()),
-		             static_cast<long>(time.hours().count()),
-		             static_cast<long>(time.minutes().count()),
-		             static_cast<long>(time.seconds().count()));
+		out.put('.').padded(static_cast<std::uint64_t>(time.subseconds().count()), 6);
 	}
-	out.resize(std::strlen(out.data()));
+	out.put('Z');
+
+	return out.result();
+}
+
+void time_point_to_string(const time_point& in, std::string& out)
+{
+	char       buffer[max_date_time_chars];
+	const auto res = time_point_to_chars(std::begin(buffer), std::end(buffer), in);
+	assert(res.ec == std::errc{});
+	out.assign(buffer, res.ptr);
 }
 
 std::string time_point_to_string(const time_point& in)
@@ -282,13 +456,23 @@ std::string time_point_to_string(const time_point& in)
 	return result;
 }
 
+std::to_chars_result date_to_chars(char* first, char* last, const date& in)
+{
+	char_writer out{ first, last };
+	out.year(static_cast<int>(in.year()))
+	    .put('-')
+	    .padded(static_cast<unsigned>(in.month()), 2)
+	    .put('-')
+	    .padded(static_cast<unsigned>(in.day()), 2);
+	return out.result();
+}
+
 void date_to_string(const date& in, std::string& out)
 {
-	// TODO: use std::format when it becomes available in libstdc++
-	out.resize(10 * 3 + 3 + 1);
-	std::sprintf(
-	    out.data(), "%04d-%02u-%02u", static_cast<int>(in.year()), static_cast<unsigned>(in.month()), static_cast<unsigned>(in.day()));
-	out.resize(std::strlen(out.data()));
+	char       buffer[max_date_time_chars];
+	const auto res = date_to_chars(std::begin(buffer), std::end(buffer), in);
+	assert(res.ec == std::errc{});
+	out.assign(buffer, res.ptr);
 }
 
 std::string date_to_string(const date& in)
@@ -298,29 +482,27 @@ std::string date_to_string(const date& in)
 	return result;
 }
 
-void time_of_day_to_string(const time_of_day& in, std::string& out)
+std::to_chars_result time_of_day_to_chars(char* first, char* last, const time_of_day& in)
 {
-	// TODO: use std::format when it becomes available in libstdc++
+	char_writer out{ first, last };
+	out.padded(static_cast<std::uint64_t>(in.hours().count()), 2)
+	    .put(':')
+	    .padded(static_cast<std::uint64_t>(in.minutes().count()), 2)
+	    .put(':')
+	    .padded(static_cast<std::uint64_t>(in.seconds().count()), 2);
 	if (in.subseconds().count())
 	{
-		out.resize(19 * 4 + 3 + 1);
-		std::sprintf(out.data(),
-		             "%02ld:%02ld:%02ld.%06ld",
-		             static_cast<long>(in.hours().count()),
-		             static_cast<long>(in.minutes().count()),
-		             static_cast<long>(in.seconds().count()),
-		             static_cast<long>(in.subseconds().count()));
-	}
-	else
-	{
-		out.resize(19 * 3 + 2 + 1);
-		std::sprintf(out.data(),
-		             "%02ld:%02ld:%02ld",
-		             static_cast<long>(in.hours().count()),
-		             static_cast<long>(in.minutes().count()),
-		             static_cast<long>(in.seconds().count()));
+		out.put('.').padded(static_cast<std::uint64_t>(in.subseconds().count()), 6);
 	}
-	out.resize(std::strlen(out.data()));
+	return out.result();
+}
+
+void time_of_day_to_string(const time_of_day& in, std::string& out)
+{
+	char       buffer[max_date_time_chars];
+	const auto res = time_of_day_to_chars(std::begin(buffer), std::end(buffer), in);
+	assert(res.ec == std::errc{});
+	out.assign(buffer, res.ptr);
 }
 
 std::string time_of_day_to_string(const time_of_day& in)
@@ -378,15 +560,8 @@ void string_to_boost_ptime(std::string_view in, boost::posix_time::ptime& out)
 		                                                    static_cast<short unsigned int>(parsed.day) },
 		                            boost::posix_time::time_duration{ parsed.hours, parsed.minutes, parsed.seconds } };
 
-	if (parsed.fracseconds)
-	{
-		out += boost::posix_time::microseconds{ static_cast<uint32_t>(parsed.fracseconds.value() * 1e6 + .5) };
-	}
-
-	if (parsed.utc_offset_minutes)
-	{
-		out -= boost::posix_time::minutes{ parsed.utc_offset_minutes.value() };
-	}
+	out += boost::posix_time::microseconds{ parsed.microseconds };
+	out -= boost::posix_time::minutes{ parsed.utc_offset_minutes };
 }
 
 boost::posix_time::ptime string_to_boost_ptime(std::string_view in)
@@ -423,15 +598,8 @@ void string_to_boost_time_duration(std::string_view in, boost::posix_time::time_
 
 	out = boost::posix_time::time_duration{ parsed.hours, parsed.minutes, parsed.seconds };
 
-	if (parsed.fracseconds)
-	{
-		out += boost::posix_time::microseconds{ static_cast<uint32_t>(parsed.fracseconds.value() * 1e6 + .5) };
-	}
-
-	if (parsed.utc_offset_minutes)
-	{
-		out -= boost::posix_time::minutes{ parsed.utc_offset_minutes.value() };
-	}
+	out += boost::posix_time::microseconds{ parsed.microseconds };
+	out -= boost::posix_time::minutes{ parsed.utc_offset_minutes };
 }
 
 boost::posix_time::time_duration string_to_boost_time_duration(std::string_view in)
@@ -24,6 +24,8 @@
 #include <iomanip>
 #include <chrono>
 #include <string_view>
+#include <string>
+#include <cstddef>
 
 namespace squid {
 
@@ -57,6 +59,22 @@ inline T string_to_number(std::string_view in)
 	return out;
 }
 
+/// Writes the shortest text representation of @a in from which it can be read back exactly into [first, last).
+/// Returns a pointer past the last written character. Throws if the buffer is too small.
+template<typename T, class = typename std::enable_if<std::is_arithmetic_v<T>>::type>
+inline char* number_to_chars(char* first, char* last, T in)
+{
+	std::to_chars_result res = std::to_chars(first, last, in);
+	if (res.ec != std::errc{})
+	{
+		throw std::system_error{ std::error_code(static_cast<int>(res.ec), std::generic_category()) };
+	}
+	return res.ptr;
+}
+
+/// Size of a buffer that can hold the text written by any of the *_to_chars functions below, including a terminating null character.
+inline constexpr std::size_t max_date_time_chars = 32;
+
 // Remark: The time_point resolution is intentionally limited to microseconds
 // to avoid different behaviour depending on the platform.
 
@@ -69,6 +87,13 @@ date SQUID_EXPORT string_to_date(std::string_view in);
 void SQUID_EXPORT        string_to_time_of_day(std::string_view in, time_of_day& out);
 time_of_day SQUID_EXPORT string_to_time_of_day(std::string_view in);
 
+/// Write the text representation of @a in into [first, last), without a terminating null character.
+/// The functions behave like std::to_chars: on success, the returned ptr points past the last written character,
+/// if the buffer is too small, ec is std::errc::value_too_large.
+std::to_chars_result SQUID_EXPORT time_point_to_chars(char* first, char* last, const time_point& in);
+std::to_chars_result SQUID_EXPORT date_to_chars(char* first, char* last, const date& in);
+std::to_chars_result SQUID_EXPORT time_of_day_to_chars(char* first, char* last, const time_of_day& in);
+
 void SQUID_EXPORT        time_point_to_string(const time_point& in, std::string& out);
 std::string SQUID_EXPORT time_point_to_string(const time_point& in);
 
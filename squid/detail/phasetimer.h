@@ -0,0 +1,132 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/statementobserver.h"
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <string_view>
+
+namespace squid {
+
+/// Times consecutive phases of the execution of @a query for its observer, and reports the execution as failed if
+/// the timer is destroyed by an exception. Without observer, nothing is timed and every call is a single branch.
+class phase_timer final
+{
+	using clock_type = std::chrono::steady_clock;
+
+	statement_observer*                     observer_;
+	std::string_view                        query_;
+	const std::map<std::string, parameter>* parameters_;
+	int                                     exceptions_;
+	clock_type::time_point                  start_;
+
+public:
+	explicit phase_timer(statement_observer*                     observer,
+	                     std::string_view                        query,
+	                     const std::map<std::string, parameter>* parameters = nullptr) noexcept
+	    : observer_{ observer }
+	    , query_{ query }
+	    , parameters_{ parameters }
+	    , exceptions_{ observer ? std::uncaught_exceptions() : 0 }
+	    , start_{ observer ? clock_type::now() : clock_type::time_point{} }
+	{
+	}
+
+	~phase_timer() noexcept
+	{
+		if (this->observer_ && std::uncaught_exceptions() > this->exceptions_)
+		{
+			this->observer_->on_error(this->query_);
+		}
+	}
+
+	phase_timer(const phase_timer&)            = delete;
+	phase_timer(phase_timer&& src)             = delete;
+	phase_timer& operator=(const phase_timer&) = delete;
+	phase_timer& operator=(phase_timer&&)      = delete;
+
+	explicit operator bool() const noexcept
+	{
+		return this->observer_ != nullptr;
+	}
+
+	/// Reports @a phase, which ends now, and starts timing the next phase
+	void lap(statement_phase phase, std::uint64_t rows = 0, std::uint64_t bytes = 0) noexcept
+	{
+		if (this->observer_)
+		{
+			const auto end = clock_type::now();
+			this->observer_->on_phase(statement_event{ .phase      = phase,
+			                                           .query      = this->query_,
+			                                           .start      = this->start_,
+			                                           .duration   = end - this->start_,
+			                                           .rows       = rows,
+			                                           .bytes      = bytes,
+			                                           .parameters = this->parameters_ });
+			this->start_ = clock_type::now();
+		}
+	}
+};
+
+/// Sums a phase that is spread over the fetched rows of a statement, and reports it once
+class phase_accumulator final
+{
+	using clock_type = std::chrono::steady_clock;
+
+	bool                     started_;
+	clock_type::time_point   start_;
+	std::chrono::nanoseconds duration_;
+	std::uint64_t            rows_;
+	std::uint64_t            bytes_;
+
+public:
+	phase_accumulator() noexcept
+	    : started_{}
+	    , start_{}
+	    , duration_{}
+	    , rows_{}
+	    , bytes_{}
+	{
+	}
+
+	/// Adds the processing of @a rows rows, from @a start until now
+	void add(clock_type::time_point start, std::uint64_t rows = 1, std::uint64_t bytes = 0) noexcept
+	{
+		if (!this->started_)
+		{
+			this->started_ = true;
+			this->start_   = start;
+		}
+		this->duration_ += clock_type::now() - start;
+		this->rows_ += rows;
+		this->bytes_ += bytes;
+	}
+
+	/// Reports what was added since the last report as @a phase to @a observer, if anything
+	void report(statement_observer* observer, statement_phase phase, std::string_view query) noexcept
+	{
+		if (observer && this->started_)
+		{
+			observer->on_phase(statement_event{ .phase    = phase,
+			                                    .query    = query,
+			                                    .start    = this->start_,
+			                                    .duration = this->duration_,
+			                                    .rows     = this->rows_,
+			                                    .bytes    = this->bytes_ });
+		}
+		this->started_  = false;
+		this->duration_ = {};
+		this->rows_     = 0;
+		this->bytes_    = 0;
+	}
+};
+
+} // namespace squid
@@ -0,0 +1,103 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+//
+// Static USDT probes of provider "squid", for bpftrace, perf and SystemTap.
+// Only compiled in when SQUID_USDT is defined (CMake option SQUID_USDT), otherwise every macro expands to nothing.
+//
+// A probe site is a single nop while no tracer is attached. Each probe has a semaphore that an attached tracer
+// increments, so that its arguments, e.g. durations that need a clock read, are only computed when traced. The
+// operands of SQUID_PROBE are always evaluated, so a probe whose arguments cost anything (a clock read, a virtual
+// call) is only fired when it is enabled:
+//
+//   const auto start = SQUID_PROBE_ENABLED(statement__execute) ? clock_type::now() : clock_type::time_point{};
+//   ...
+//   if (SQUID_PROBE_ENABLED(statement__execute))
+//   {
+//       SQUID_PROBE(statement__execute, this, sql, nanoseconds(start));
+//   }
+//
+// Probes and their arguments (SQL pointers are NUL terminated, or nullptr if the text is not known):
+//
+//   statement__execute  statement*, sql, duration ns                     after a successful execution
+//   statement__fetch    statement*, sql, duration ns, rows, has_row      after every fetch, rows fetched so far
+//   backend__prepare    backend name, sql, duration ns                  after a backend prepared a statement
+//   pool__acquire       pool*, connection* (nullptr if none), wait ns   when an acquisition returns
+//   pool__release       pool*, connection*, broken                      when a connection returns to its pool
+//
+// E.g. bpftrace -e 'usdt:libsquid.so:squid:statement__execute { @[str(arg1)] = hist(arg2); }'
+//
+
+#ifdef SQUID_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+// The probe notes hold the link-time address of the semaphores, so every shared library has its own copy of them:
+// hidden, and weak so that the definitions of all translation units and static libraries are merged.
+#define SQUID_PROBE_SEMAPHORE(name) squid_##name##_semaphore
+#define SQUID_DEFINE_PROBE_SEMAPHORE(name)                                                                             \
+	__attribute__((weak, visibility("hidden"), section(".probes"))) unsigned short SQUID_PROBE_SEMAPHORE(name) = 0
+
+extern "C" {
+SQUID_DEFINE_PROBE_SEMAPHORE(statement__execute);
+SQUID_DEFINE_PROBE_SEMAPHORE(statement__fetch);
+SQUID_DEFINE_PROBE_SEMAPHORE(backend__prepare);
+SQUID_DEFINE_PROBE_SEMAPHORE(pool__acquire);
+SQUID_DEFINE_PROBE_SEMAPHORE(pool__release);
+}
+
+#define SQUID_PROBE(name, ...) STAP_PROBEV(squid, name, __VA_ARGS__)
+#define SQUID_PROBE_ENABLED(name) __builtin_expect(SQUID_PROBE_SEMAPHORE(name) != 0, 0)
+
+#else
+
+// The arguments are not evaluated, only named, so that variables that exist for a probe are not reported as unused
+#define SQUID_PROBE(name, ...) static_cast<void>(sizeof(::squid::probe_arguments(__VA_ARGS__)))
+#define SQUID_PROBE_ENABLED(name) false
+
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+namespace squid {
+
+/// Operand of SQUID_PROBE when probes are not compiled in
+template<typename... Args>
+constexpr int probe_arguments(const Args&...) noexcept
+{
+	return 0;
+}
+
+/// Nanoseconds since @a start for a probe argument, 0 if @a start is not set because the probe was not enabled
+inline std::uint64_t probe_nanoseconds(const std::chrono::steady_clock::time_point& start) noexcept
+{
+	if (start == std::chrono::steady_clock::time_point{})
+	{
+		return 0;
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+/// Start time for a probe argument if @a enabled, else a time_point that is not set
+inline std::chrono::steady_clock::time_point probe_start(bool enabled) noexcept
+{
+	return enabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+}
+
+/// SQL pointer of @a query for a probe argument, nullptr if the query is empty
+inline const char* probe_sql(std::string_view query) noexcept
+{
+	return query.empty() ? nullptr : query.data();
+}
+
+} // namespace squid
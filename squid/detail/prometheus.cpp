@@ -0,0 +1,136 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/detail/prometheus.h"
+
+#include <chrono>
+#include <utility>
+
+namespace squid {
+
+void write_labels(std::ostream& out, std::string_view pool_name, std::string_view le)
+{
+	if (pool_name.empty() && le.empty())
+	{
+		return;
+	}
+
+	out << '{';
+	if (!pool_name.empty())
+	{
+		out << "pool=\"";
+		for (const auto c : pool_name)
+		{
+			switch (c)
+			{
+			case '\\':
+				out << "\\\\";
+				break;
+			case '"':
+				out << "\\\"";
+				break;
+			case '\n':
+				out << "\\n";
+				break;
+			default:
+				out << c;
+			}
+		}
+		out << '"';
+		if (!le.empty())
+		{
+			out << ',';
+		}
+	}
+	if (!le.empty())
+	{
+		out << "le=\"" << le << '"';
+	}
+	out << '}';
+}
+
+namespace {
+
+template<typename T>
+void write_sample(std::ostream&    out,
+                  std::string_view prefix,
+                  std::string_view name,
+                  std::string_view type,
+                  std::string_view help,
+                  std::string_view pool_name,
+                  T                value)
+{
+	out << "# HELP " << prefix << '_' << name << ' ' << help << '\n';
+	out << "# TYPE " << prefix << '_' << name << ' ' << type << '\n';
+	out << prefix << '_' << name;
+	write_labels(out, pool_name);
+	out << ' ' << value << '\n';
+}
+
+} // namespace
+
+void write_metric(std::ostream&    out,
+                  std::string_view prefix,
+                  std::string_view name,
+                  std::string_view type,
+                  std::string_view help,
+                  std::string_view pool_name,
+                  std::uint64_t    value)
+{
+	write_sample(out, prefix, name, type, help, pool_name, value);
+}
+
+void write_metric(std::ostream&    out,
+                  std::string_view prefix,
+                  std::string_view name,
+                  std::string_view type,
+                  std::string_view help,
+                  std::string_view pool_name,
+                  double           value)
+{
+	write_sample(out, prefix, name, type, help, pool_name, value);
+}
+
+void write_histogram(std::ostream&             out,
+                     std::string_view          prefix,
+                     std::string_view          name,
+                     std::string_view          help,
+                     std::string_view          pool_name,
+                     const duration_histogram& histogram)
+{
+	// 1-2.5-5 series from 1 µs to 10 s
+	static constexpr std::pair<std::chrono::nanoseconds::rep, std::string_view> limits[] = {
+		{ 1'000, "1e-06" },          { 2'500, "2.5e-06" },        { 5'000, "5e-06" },         { 10'000, "1e-05" },
+		{ 25'000, "2.5e-05" },       { 50'000, "5e-05" },         { 100'000, "0.0001" },      { 250'000, "0.00025" },
+		{ 500'000, "0.0005" },       { 1'000'000, "0.001" },      { 2'500'000, "0.0025" },    { 5'000'000, "0.005" },
+		{ 10'000'000, "0.01" },      { 25'000'000, "0.025" },     { 50'000'000, "0.05" },     { 100'000'000, "0.1" },
+		{ 250'000'000, "0.25" },     { 500'000'000, "0.5" },      { 1'000'000'000, "1" },     { 2'500'000'000, "2.5" },
+		{ 5'000'000'000, "5" },      { 10'000'000'000, "10" },
+	};
+
+	out << "# HELP " << prefix << '_' << name << "_seconds " << help << '\n';
+	out << "# TYPE " << prefix << '_' << name << "_seconds histogram\n";
+	for (const auto& [nanoseconds, le] : limits)
+	{
+		out << prefix << '_' << name << "_seconds_bucket";
+		write_labels(out, pool_name, le);
+		out << ' ' << histogram.count_at_most(std::chrono::nanoseconds{ nanoseconds }) << '\n';
+	}
+
+	const auto count = histogram.count();
+	out << prefix << '_' << name << "_seconds_bucket";
+	write_labels(out, pool_name, "+Inf");
+	out << ' ' << count << '\n';
+	out << prefix << '_' << name << "_seconds_sum";
+	write_labels(out, pool_name);
+	out << ' ' << std::chrono::duration<double>{ std::chrono::nanoseconds{ histogram.total_nanoseconds } }.count() << '\n';
+	out << prefix << '_' << name << "_seconds_count";
+	write_labels(out, pool_name);
+	out << ' ' << count << '\n';
+}
+
+} // namespace squid
@@ -0,0 +1,48 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/durationhistogram.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+namespace squid {
+
+/// Writers of the Prometheus text exposition format.
+/// If @a pool_name is not empty, all samples get a label pool="@a pool_name".
+
+void write_labels(std::ostream& out, std::string_view pool_name, std::string_view le = {});
+
+/// Write a metric of a single sample named @a prefix_@a name
+void write_metric(std::ostream&    out,
+                  std::string_view prefix,
+                  std::string_view name,
+                  std::string_view type,
+                  std::string_view help,
+                  std::string_view pool_name,
+                  std::uint64_t    value);
+
+void write_metric(std::ostream&    out,
+                  std::string_view prefix,
+                  std::string_view name,
+                  std::string_view type,
+                  std::string_view help,
+                  std::string_view pool_name,
+                  double           value);
+
+/// Write @a histogram as a metric named @a prefix_@a name_seconds with fixed bucket limits from 1 µs to 10 s
+void write_histogram(std::ostream&             out,
+                     std::string_view          prefix,
+                     std::string_view          name,
+                     std::string_view          help,
+                     std::string_view          pool_name,
+                     const duration_histogram& histogram);
+
+} // namespace squid
@@ -0,0 +1,95 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/detail/waitcounter.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+
+namespace squid {
+
+#ifdef __linux__
+namespace {
+
+long futex(std::atomic<std::uint32_t>& word, int op, std::uint32_t value, const timespec* timeout)
+{
+	static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+	return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), op, value, timeout, nullptr, 0);
+}
+
+} // namespace
+#endif
+
+wait_counter::wait_counter() noexcept
+    : value_{}
+{
+}
+
+std::uint32_t wait_counter::load() const noexcept
+{
+	return this->value_.load();
+}
+
+void wait_counter::increment_and_notify(int count) noexcept
+{
+#ifdef __linux__
+	this->value_.fetch_add(1);
+	futex(this->value_, FUTEX_WAKE_PRIVATE, static_cast<std::uint32_t>(count), nullptr);
+#else
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		this->value_.fetch_add(1);
+	}
+	if (count == 1)
+	{
+		this->cv_.notify_one();
+	}
+	else
+	{
+		this->cv_.notify_all();
+	}
+#endif
+}
+
+bool wait_counter::wait(std::uint32_t expected, const std::optional<clock_type::time_point>& deadline)
+{
+#ifdef __linux__
+	if (!deadline)
+	{
+		futex(this->value_, FUTEX_WAIT_PRIVATE, expected, nullptr);
+		return true;
+	}
+
+	const auto now = clock_type::now();
+	if (now >= deadline.value())
+	{
+		return false;
+	}
+
+	const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.value() - now).count();
+	timespec   timeout{};
+	timeout.tv_sec  = static_cast<time_t>(remaining / 1000000000);
+	timeout.tv_nsec = static_cast<long>(remaining % 1000000000);
+	futex(this->value_, FUTEX_WAIT_PRIVATE, expected, &timeout);
+
+	return clock_type::now() < deadline.value() || this->value_.load() != expected;
+#else
+	std::unique_lock<std::mutex> lock{ this->mutex_ };
+	if (!deadline)
+	{
+		this->cv_.wait(lock, [&] { return this->value_.load() != expected; });
+		return true;
+	}
+	return this->cv_.wait_until(lock, deadline.value(), [&] { return this->value_.load() != expected; });
+#endif
+}
+
+} // namespace squid
@@ -0,0 +1,53 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#ifndef __linux__
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace squid {
+
+/// A 32-bit counter that threads can wait on until it changes, optionally with a deadline.
+/// On Linux, waiting and waking is done with the futex system call, so a wakeup costs no lock.
+/// Elsewhere, a mutex and condition variable are used.
+class wait_counter final
+{
+	std::atomic<std::uint32_t> value_;
+#ifndef __linux__
+	std::mutex              mutex_;
+	std::condition_variable cv_;
+#endif
+
+public:
+	using clock_type = std::chrono::steady_clock;
+
+	wait_counter() noexcept;
+
+	wait_counter(const wait_counter&)            = delete;
+	wait_counter(wait_counter&&)                 = delete;
+	wait_counter& operator=(const wait_counter&) = delete;
+	wait_counter& operator=(wait_counter&&)      = delete;
+
+	std::uint32_t load() const noexcept;
+
+	/// Increments the counter and wakes up @a count waiting threads.
+	void increment_and_notify(int count) noexcept;
+
+	/// Blocks while the counter equals @a expected, until @a deadline if given.
+	/// Returns false if the deadline has passed. May return spuriously.
+	bool wait(std::uint32_t expected, const std::optional<clock_type::time_point>& deadline);
+};
+
+} // namespace squid
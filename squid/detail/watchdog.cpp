@@ -0,0 +1,118 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/detail/watchdog.h"
+#include "squid/ibackendconnection.h"
+
+namespace squid {
+
+watchdog::watchdog()
+    : mutex_{}
+    , cv_{}
+    , deadlines_{}
+    , fired_{}
+    , next_token_{}
+    , cancelling_{}
+    , stopping_{}
+    , thread_{}
+{
+}
+
+watchdog::~watchdog() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		this->stopping_ = true;
+	}
+	this->cv_.notify_all();
+	if (this->thread_.joinable())
+	{
+		this->thread_.join();
+	}
+}
+
+/*static*/ watchdog& watchdog::instance()
+{
+	static watchdog instance{};
+	return instance;
+}
+
+void watchdog::run()
+{
+	std::unique_lock<std::mutex> lock{ this->mutex_ };
+	while (!this->stopping_)
+	{
+		if (this->deadlines_.empty())
+		{
+			this->cv_.wait(lock);
+			continue;
+		}
+
+		const auto first = this->deadlines_.begin();
+		if (clock_type::now() < first->first)
+		{
+			this->cv_.wait_until(lock, first->first);
+			continue;
+		}
+
+		const auto entry = first->second;
+		this->deadlines_.erase(first);
+		this->fired_.insert(entry.token);
+		this->cancelling_ = entry.token;
+
+		// Cancelling communicates with the server, so do not block arming and disarming meanwhile.
+		// A failure to cancel must not end this thread, the statement then just runs to completion.
+		lock.unlock();
+		try
+		{
+			entry.connection->cancel();
+		}
+		catch (...)
+		{
+		}
+		lock.lock();
+
+		this->cancelling_ = 0;
+		this->cv_.notify_all();
+	}
+}
+
+watchdog::ticket watchdog::arm(clock_type::time_point deadline, ibackend_connection& connection)
+{
+	std::lock_guard<std::mutex> lock{ this->mutex_ };
+	if (!this->thread_.joinable())
+	{
+		this->thread_ = std::thread{ [this] { this->run(); } };
+	}
+
+	const auto token = ++this->next_token_;
+	const auto it    = this->deadlines_.emplace(deadline, entry{ .token = token, .connection = &connection });
+	if (it == this->deadlines_.begin())
+	{
+		this->cv_.notify_all();
+	}
+	return ticket{ .deadline = deadline, .token = token };
+}
+
+bool watchdog::disarm(const ticket& ticket)
+{
+	std::unique_lock<std::mutex> lock{ this->mutex_ };
+	const auto [first, last] = this->deadlines_.equal_range(ticket.deadline);
+	for (auto it = first; it != last; ++it)
+	{
+		if (it->second.token == ticket.token)
+		{
+			this->deadlines_.erase(it);
+			return false;
+		}
+	}
+
+	this->cv_.wait(lock, [&] { return this->cancelling_ != ticket.token; });
+	return this->fired_.erase(ticket.token) > 0;
+}
+
+} // namespace squid
@@ -0,0 +1,75 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace squid {
+
+class ibackend_connection;
+
+/// A thread that cancels the statements executing on connections when their deadline passes.
+/// The thread is started when the first deadline is armed.
+class watchdog final
+{
+public:
+	using clock_type = std::chrono::steady_clock;
+
+	/// An armed deadline
+	struct ticket
+	{
+		clock_type::time_point deadline;
+		std::uint64_t          token;
+	};
+
+private:
+	struct entry
+	{
+		std::uint64_t        token;
+		ibackend_connection* connection;
+	};
+
+	std::mutex                                   mutex_;
+	std::condition_variable                      cv_;
+	std::multimap<clock_type::time_point, entry> deadlines_;
+	std::set<std::uint64_t>                      fired_;
+	std::uint64_t                                next_token_;
+	std::uint64_t                                cancelling_; // token of the connection being cancelled, 0 if none
+	bool                                         stopping_;
+	std::thread                                  thread_;
+
+	void run();
+
+public:
+	watchdog();
+	~watchdog() noexcept;
+
+	watchdog(const watchdog&)            = delete;
+	watchdog(watchdog&&)                 = delete;
+	watchdog& operator=(const watchdog&) = delete;
+	watchdog& operator=(watchdog&&)      = delete;
+
+	/// The watchdog of the process
+	static watchdog& instance();
+
+	/// Cancels the statement executing on @a connection at @a deadline (see ibackend_connection::cancel), unless
+	/// disarmed before. The connection must stay alive until disarmed.
+	ticket arm(clock_type::time_point deadline, ibackend_connection& connection);
+
+	/// Disarms the deadline of @a ticket, waiting for the cancellation if it is in progress.
+	/// Returns whether the connection was cancelled.
+	bool disarm(const ticket& ticket);
+};
+
+} // namespace squid
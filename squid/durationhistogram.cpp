@@ -0,0 +1,84 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/durationhistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace squid {
+
+static_assert(duration_histogram::bucket_of(0) == 0);
+static_assert(duration_histogram::bucket_of(15) == 15);
+static_assert(duration_histogram::bucket_of(16) == 16);
+static_assert(duration_histogram::bucket_of(31) == 31);
+static_assert(duration_histogram::bucket_of(32) == 32);
+static_assert(duration_histogram::bucket_of(33) == 32);
+static_assert(duration_histogram::lower_bound(33).count() == 34);
+static_assert(duration_histogram::bucket_of(UINT64_MAX) == duration_histogram::bucket_count - 1u);
+static_assert(duration_histogram::bucket_of((std::uint64_t{ 1 } << 45) - 1u) == duration_histogram::bucket_count - 1u);
+static_assert(duration_histogram::bucket_of(std::uint64_t{ 1 } << 45) == duration_histogram::bucket_count - 1u);
+
+std::uint64_t duration_histogram::count() const noexcept
+{
+	std::uint64_t count{};
+	for (const auto n : this->counts)
+	{
+		count += n;
+	}
+	return count;
+}
+
+std::chrono::nanoseconds duration_histogram::mean() const noexcept
+{
+	const auto count = this->count();
+	return std::chrono::nanoseconds{ count ? static_cast<std::chrono::nanoseconds::rep>(this->total_nanoseconds / count) : 0 };
+}
+
+std::chrono::nanoseconds duration_histogram::quantile(double quantile) const noexcept
+{
+	const auto count = this->count();
+	if (count == 0)
+	{
+		return std::chrono::nanoseconds::zero();
+	}
+
+	const auto rank = std::max<std::uint64_t>(1u, static_cast<std::uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * count)));
+
+	std::uint64_t seen{};
+	for (std::size_t bucket = 0; bucket < bucket_count; ++bucket)
+	{
+		seen += this->counts[bucket];
+		if (seen >= rank)
+		{
+			return upper_bound(bucket);
+		}
+	}
+	return upper_bound(bucket_count - 1u);
+}
+
+std::uint64_t duration_histogram::count_at_most(std::chrono::nanoseconds limit) const noexcept
+{
+	std::uint64_t count{};
+	for (std::size_t bucket = 0; bucket < bucket_count && upper_bound(bucket) <= limit + std::chrono::nanoseconds{ 1 }; ++bucket)
+	{
+		count += this->counts[bucket];
+	}
+	return count;
+}
+
+duration_histogram& duration_histogram::operator+=(const duration_histogram& other) noexcept
+{
+	for (std::size_t bucket = 0; bucket < bucket_count; ++bucket)
+	{
+		this->counts[bucket] += other.counts[bucket];
+	}
+	this->total_nanoseconds += other.total_nanoseconds;
+	return *this;
+}
+
+} // namespace squid
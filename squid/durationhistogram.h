@@ -0,0 +1,84 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/api.h"
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace squid {
+
+/// Histogram of durations with log-linear buckets, in the style of HdrHistogram.
+/// Durations are recorded in nanoseconds. Every power of two is split into 16 buckets of equal width, so the width
+/// of a bucket is at most 1/16 of its lower bound. Durations of 2^44 ns (about 4.9 hours) and more share the last bucket.
+struct SQUID_EXPORT duration_histogram
+{
+	static constexpr unsigned    sub_bucket_bits = 4;
+	static constexpr std::size_t sub_buckets     = std::size_t{ 1 } << sub_bucket_bits;
+	static constexpr unsigned    max_magnitude   = 44;
+	static constexpr std::size_t bucket_count    = sub_buckets * (max_magnitude - sub_bucket_bits + 2);
+
+	std::array<std::uint64_t, bucket_count> counts{};            /// number of durations per bucket
+	std::uint64_t                           total_nanoseconds{}; /// sum of all durations
+
+	/// Index of the bucket of a duration of @a nanoseconds
+	static constexpr std::size_t bucket_of(std::uint64_t nanoseconds) noexcept
+	{
+		if (nanoseconds < sub_buckets)
+		{
+			return static_cast<std::size_t>(nanoseconds);
+		}
+		const auto magnitude = static_cast<unsigned>(std::bit_width(nanoseconds)) - 1u;
+		if (magnitude > max_magnitude)
+		{
+			return bucket_count - 1u;
+		}
+		const auto sub_bucket = (nanoseconds >> (magnitude - sub_bucket_bits)) & (sub_buckets - 1u);
+		return sub_buckets * (magnitude - sub_bucket_bits + 1u) + static_cast<std::size_t>(sub_bucket);
+	}
+
+	/// Smallest duration in bucket @a bucket
+	static constexpr std::chrono::nanoseconds lower_bound(std::size_t bucket) noexcept
+	{
+		if (bucket < sub_buckets)
+		{
+			return std::chrono::nanoseconds{ static_cast<std::chrono::nanoseconds::rep>(bucket) };
+		}
+		const auto magnitude  = static_cast<unsigned>(bucket / sub_buckets) + sub_bucket_bits - 1u;
+		const auto sub_bucket = static_cast<std::uint64_t>(bucket % sub_buckets);
+		const auto lower      = (sub_buckets + sub_bucket) << (magnitude - sub_bucket_bits);
+		return std::chrono::nanoseconds{ static_cast<std::chrono::nanoseconds::rep>(lower) };
+	}
+
+	/// Smallest duration above bucket @a bucket
+	static constexpr std::chrono::nanoseconds upper_bound(std::size_t bucket) noexcept
+	{
+		return bucket + 1u < bucket_count ? lower_bound(bucket + 1u) : std::chrono::nanoseconds::max();
+	}
+
+	/// Number of recorded durations
+	std::uint64_t count() const noexcept;
+
+	/// Mean of the recorded durations, 0 if there are none
+	std::chrono::nanoseconds mean() const noexcept;
+
+	/// Upper bound of the bucket that contains the duration at @a quantile (0 to 1), 0 if there are no durations.
+	/// The result overestimates the exact quantile by at most 1/16.
+	std::chrono::nanoseconds quantile(double quantile) const noexcept;
+
+	/// Number of recorded durations less than or equal to @a limit, rounded down to whole buckets
+	std::uint64_t count_at_most(std::chrono::nanoseconds limit) const noexcept;
+
+	duration_histogram& operator+=(const duration_histogram& other) noexcept;
+};
+
+} // namespace squid
@@ -14,4 +14,14 @@ error::error(const std::string& message)
 {
 }
 
+timeout_error::timeout_error(const std::string& message)
+    : error{ message }
+{
+}
+
+result_limit_error::result_limit_error(const std::string& message)
+    : error{ message }
+{
+}
+
 } // namespace squid
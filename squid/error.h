@@ -21,4 +21,18 @@ public:
 	explicit error(const std::string& message);
 };
 
+/// Exception class for a statement that was cancelled because its deadline passed
+class SQUID_EXPORT timeout_error : public error
+{
+public:
+	explicit timeout_error(const std::string& message);
+};
+
+/// Exception class for a statement whose result exceeds a limit of result_limits
+class SQUID_EXPORT result_limit_error : public error
+{
+public:
+	explicit result_limit_error(const std::string& message);
+};
+
 } // namespace squid
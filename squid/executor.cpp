@@ -0,0 +1,397 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/executor.h"
+#include "squid/connectionpool.h"
+#include "squid/ibackendconnection.h"
+#include "squid/error.h"
+
+#include "squid/detail/waitcounter.h"
+
+#include <atomic>
+#include <deque>
+#include <thread>
+
+namespace squid {
+
+namespace {
+
+/// Makes an exception pointer to an error with @a message, without throwing
+std::exception_ptr make_error(const char* message) noexcept
+{
+	try
+	{
+		return std::make_exception_ptr(error{ message });
+	}
+	catch (...)
+	{
+		return std::current_exception();
+	}
+}
+
+} // namespace
+
+async_operation::callback::~callback() noexcept
+{
+}
+
+async_operation::async_operation()
+    : mutex_{}
+    , cv_{}
+    , status_{ status::pending }
+    , cancelled_{}
+    , cancelling_{}
+    , error_{}
+    , connection_{}
+    , callbacks_{}
+{
+}
+
+async_operation::~async_operation() noexcept
+{
+}
+
+bool async_operation::ready() const
+{
+	std::lock_guard<std::mutex> lock{ this->mutex_ };
+	return this->status_ == status::completed;
+}
+
+void async_operation::wait() const
+{
+	std::unique_lock<std::mutex> lock{ this->mutex_ };
+	this->cv_.wait(lock, [this] { return this->status_ == status::completed; });
+}
+
+bool async_operation::wait_until(const std::chrono::steady_clock::time_point& deadline) const
+{
+	std::unique_lock<std::mutex> lock{ this->mutex_ };
+	return this->cv_.wait_until(lock, deadline, [this] { return this->status_ == status::completed; });
+}
+
+bool async_operation::cancel()
+{
+	std::shared_ptr<ibackend_connection> connection{};
+	{
+		std::unique_lock<std::mutex> lock{ this->mutex_ };
+		switch (this->status_)
+		{
+		case status::pending:
+			lock.unlock();
+			this->complete(make_error("The operation was cancelled"));
+			return true;
+		case status::running:
+			this->cancelled_ = true;
+			connection       = this->connection_;
+			if (connection)
+			{
+				++this->cancelling_;
+			}
+			break;
+		case status::completed:
+			return false;
+		}
+	}
+	// Without connection yet, attach fails the operation
+	if (!connection)
+	{
+		return true;
+	}
+
+	// Cancelling communicates with the server, so do not block the operation meanwhile; complete waits for it
+	auto               sent = false;
+	std::exception_ptr error{};
+	try
+	{
+		sent = connection->cancel();
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	connection.reset();
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		--this->cancelling_;
+	}
+	this->cv_.notify_all();
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	return sent;
+}
+
+void async_operation::on_complete(std::shared_ptr<callback> callback)
+{
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		if (this->status_ != status::completed)
+		{
+			this->callbacks_.push_back(std::move(callback));
+			return;
+		}
+	}
+	callback->invoke();
+}
+
+void async_operation::rethrow() const
+{
+	std::lock_guard<std::mutex> lock{ this->mutex_ };
+	if (this->error_)
+	{
+		std::rethrow_exception(this->error_);
+	}
+}
+
+void async_operation::attach(std::shared_ptr<ibackend_connection> connection)
+{
+	std::lock_guard<std::mutex> lock{ this->mutex_ };
+	if (this->cancelled_)
+	{
+		throw error{ "The operation was cancelled" };
+	}
+	this->connection_ = std::move(connection);
+}
+
+void async_operation::run(connection_pool& pool) noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		if (this->status_ != status::pending)
+		{
+			return;
+		}
+		this->status_ = status::running;
+	}
+
+	std::exception_ptr error{};
+	try
+	{
+		this->invoke(pool);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	this->complete(error);
+}
+
+void async_operation::complete(std::exception_ptr error) noexcept
+{
+	std::vector<std::shared_ptr<callback>> callbacks{};
+	std::shared_ptr<ibackend_connection>   connection{};
+	{
+		std::unique_lock<std::mutex> lock{ this->mutex_ };
+		this->cv_.wait(lock, [this] { return this->cancelling_ == 0; });
+		if (this->status_ == status::completed)
+		{
+			return;
+		}
+		this->status_ = status::completed;
+		this->error_  = std::move(error);
+		callbacks.swap(this->callbacks_);
+		connection.swap(this->connection_);
+	}
+	// Release the connection before anyone can see the result, so that a pooled connection is available again
+	connection.reset();
+	this->cv_.notify_all();
+	for (const auto& callback : callbacks)
+	{
+		callback->invoke();
+	}
+}
+
+class executor::impl
+{
+	/// A queue of operations, taken from the back by its own worker thread and from the front by the others
+	struct worker
+	{
+		std::mutex                                   mutex;
+		std::deque<std::shared_ptr<async_operation>> operations;
+	};
+
+	connection_pool&         pool_;
+	std::vector<worker>      workers_;
+	std::atomic<std::size_t> next_;     // worker that gets the next operation submitted from another thread
+	std::atomic<int>         sleeping_; // number of worker threads that are about to wait, or waiting
+	wait_counter             signals_;  // incremented when operations are queued while worker threads sleep
+	std::atomic<bool>        stopping_;
+	std::vector<std::thread> threads_;
+
+	/// The executor of the calling thread, if it is a worker thread
+	static impl*& current_executor() noexcept
+	{
+		thread_local impl* current{};
+		return current;
+	}
+
+	/// The index of the worker of the calling thread, if it is a worker thread
+	static std::size_t& current_worker() noexcept
+	{
+		thread_local std::size_t current{};
+		return current;
+	}
+
+	/// Takes the last operation of worker @a index, or else the first one of another worker
+	std::shared_ptr<async_operation> take(std::size_t index)
+	{
+		for (std::size_t n = 0; n < this->workers_.size(); ++n)
+		{
+			auto&                       worker = this->workers_[(index + n) % this->workers_.size()];
+			std::lock_guard<std::mutex> lock{ worker.mutex };
+			if (!worker.operations.empty())
+			{
+				std::shared_ptr<async_operation> operation{};
+				if (n == 0)
+				{
+					operation = std::move(worker.operations.back());
+					worker.operations.pop_back();
+				}
+				else
+				{
+					operation = std::move(worker.operations.front());
+					worker.operations.pop_front();
+				}
+				return operation;
+			}
+		}
+		return nullptr;
+	}
+
+	void work(std::size_t index)
+	{
+		current_executor() = this;
+		current_worker()   = index;
+
+		while (!this->stopping_.load())
+		{
+			if (auto operation = this->take(index))
+			{
+				operation->run(this->pool_);
+				continue;
+			}
+
+			// Announce the sleep before looking for operations again, so that a concurrent post either is seen by
+			// that look, or sees this thread sleeping and increments the counter after it was read here.
+			// Likewise, stop() is either seen here, or increments the counter after it was read.
+			this->sleeping_.fetch_add(1);
+			const auto signals   = this->signals_.load();
+			auto       operation = this->stopping_.load() ? nullptr : this->take(index);
+			if (!operation && !this->stopping_.load())
+			{
+				this->signals_.wait(signals, std::nullopt);
+			}
+			this->sleeping_.fetch_sub(1);
+			if (operation)
+			{
+				operation->run(this->pool_);
+			}
+		}
+	}
+
+public:
+	impl(connection_pool& pool, const executor_options& options)
+	    : pool_{ pool }
+	    , workers_(options.threads ? options.threads : pool.capacity())
+	    , next_{}
+	    , sleeping_{}
+	    , signals_{}
+	    , stopping_{}
+	    , threads_{}
+	{
+		this->threads_.reserve(this->workers_.size());
+		try
+		{
+			for (std::size_t index = 0; index < this->workers_.size(); ++index)
+			{
+				this->threads_.emplace_back([this, index] { this->work(index); });
+			}
+		}
+		catch (...)
+		{
+			this->stop();
+			throw;
+		}
+	}
+
+	~impl() noexcept
+	{
+		this->stop();
+	}
+
+	/// Stops the worker threads after their current operation, and fails the operations that did not start
+	void stop() noexcept
+	{
+		this->stopping_.store(true);
+		this->signals_.increment_and_notify(static_cast<int>(this->threads_.size()));
+		for (auto& thread : this->threads_)
+		{
+			thread.join();
+		}
+		this->threads_.clear();
+
+		for (auto& worker : this->workers_)
+		{
+			std::deque<std::shared_ptr<async_operation>> operations{};
+			{
+				std::lock_guard<std::mutex> lock{ worker.mutex };
+				operations.swap(worker.operations);
+			}
+			for (const auto& operation : operations)
+			{
+				operation->complete(make_error("The executor was destroyed"));
+			}
+		}
+	}
+
+	void post(std::shared_ptr<async_operation> operation)
+	{
+		if (this->stopping_.load())
+		{
+			operation->complete(make_error("The executor was destroyed"));
+			return;
+		}
+
+		const auto index = current_executor() == this ? current_worker()
+		                                               : this->next_.fetch_add(1, std::memory_order_relaxed) % this->workers_.size();
+		{
+			auto&                       worker = this->workers_[index];
+			std::lock_guard<std::mutex> lock{ worker.mutex };
+			worker.operations.push_back(std::move(operation));
+		}
+		if (this->sleeping_.load() > 0)
+		{
+			this->signals_.increment_and_notify(1);
+		}
+	}
+
+	std::size_t thread_count() const noexcept
+	{
+		return this->workers_.size();
+	}
+};
+
+executor::executor(connection_pool& pool, const executor_options& options)
+    : pimpl_{ std::make_unique<impl>(pool, options) }
+{
+}
+
+executor::~executor() noexcept = default;
+
+void executor::post(std::shared_ptr<async_operation> operation)
+{
+	this->pimpl_->post(std::move(operation));
+}
+
+std::size_t executor::thread_count() const
+{
+	return this->pimpl_->thread_count();
+}
+
+} // namespace squid
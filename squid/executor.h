@@ -0,0 +1,318 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/api.h"
+#include "squid/connection.h"
+
+#include <memory>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace squid {
+
+class connection_pool;
+class ibackend_connection;
+class executor;
+
+/// Options of an executor
+struct SQUID_EXPORT executor_options
+{
+	/// Number of worker threads, 0 means the maximum number of connections of the pool.
+	/// With fewer threads than connections, not all connections can be used at the same time; with more, threads
+	/// wait for a connection.
+	std::size_t threads = 0;
+};
+
+/// The state shared by an asynchronous operation and its async_result.
+/// Not intended to be used directly.
+class SQUID_EXPORT async_operation
+{
+public:
+	/// A completion callback
+	class SQUID_EXPORT callback
+	{
+	public:
+		virtual ~callback() noexcept;
+
+		/// Called once when the operation has completed. Must not throw.
+		virtual void invoke() noexcept = 0;
+	};
+
+	async_operation();
+	virtual ~async_operation() noexcept;
+
+	async_operation(const async_operation&)            = delete;
+	async_operation(async_operation&& src)             = delete;
+	async_operation& operator=(const async_operation&) = delete;
+	async_operation& operator=(async_operation&&)      = delete;
+
+	/// See async_result
+	bool ready() const;
+	void wait() const;
+	bool wait_until(const std::chrono::steady_clock::time_point& deadline) const;
+	bool cancel();
+	void on_complete(std::shared_ptr<callback> callback);
+
+	/// Throws the error of the operation, if it failed
+	void rethrow() const;
+
+protected:
+	/// Sets the connection that the running operation uses, so that it can be cancelled (see
+	/// ibackend_connection::cancel). Throws an error if the operation was cancelled already.
+	void attach(std::shared_ptr<ibackend_connection> connection);
+
+private:
+	friend class executor;
+
+	enum class status
+	{
+		pending,
+		running,
+		completed
+	};
+
+	mutable std::mutex                     mutex_;
+	mutable std::condition_variable        cv_;
+	status                                 status_;
+	bool                                   cancelled_;
+	int                                    cancelling_; // number of cancel requests being sent over connection_
+	std::exception_ptr                     error_;
+	std::shared_ptr<ibackend_connection>   connection_;
+	std::vector<std::shared_ptr<callback>> callbacks_;
+
+	/// Runs the operation on the calling worker thread of an executor of @a pool
+	virtual void invoke(connection_pool& pool) = 0;
+
+	/// Runs the operation unless it was cancelled, and completes it
+	void run(connection_pool& pool) noexcept;
+
+	/// Completes the operation with @a error, unless it was completed already.
+	/// Waits until cancel requests that are being sent have been sent, so that the connection is not released meanwhile.
+	void complete(std::exception_ptr error) noexcept;
+};
+
+/// The result value of an asynchronous operation
+template<typename T>
+struct async_storage
+{
+	std::optional<T> value;
+
+	template<typename Function, typename... Args>
+	void store(Function& function, Args&... args)
+	{
+		this->value.emplace(function(args...));
+	}
+
+	T take()
+	{
+		return std::move(*this->value);
+	}
+};
+
+template<>
+struct async_storage<void>
+{
+	template<typename Function, typename... Args>
+	void store(Function& function, Args&... args)
+	{
+		function(args...);
+	}
+
+	void take()
+	{
+	}
+};
+
+/// The result of an asynchronous operation, see executor.
+/// Destroying the result neither waits for nor cancels the operation.
+template<typename T>
+class async_result final
+{
+	friend class executor;
+
+	class state : public async_operation
+	{
+	public:
+		async_storage<T> result;
+	};
+
+	std::shared_ptr<state> state_;
+
+	explicit async_result(std::shared_ptr<state> state)
+	    : state_{ std::move(state) }
+	{
+	}
+
+public:
+	/// Whether the operation has completed, successfully or not
+	bool ready() const
+	{
+		return this->state_->ready();
+	}
+
+	/// Wait until the operation has completed
+	void wait() const
+	{
+		this->state_->wait();
+	}
+
+	/// Wait until the operation has completed or until @a deadline, whichever comes first.
+	/// Returns whether the operation has completed.
+	bool wait_until(const std::chrono::steady_clock::time_point& deadline) const
+	{
+		return this->state_->wait_until(deadline);
+	}
+
+	/// Wait until the operation has completed or until @a timeout has passed, whichever comes first.
+	/// Returns whether the operation has completed.
+	bool wait_for(const std::chrono::milliseconds& timeout) const
+	{
+		return this->state_->wait_until(std::chrono::steady_clock::now() + timeout);
+	}
+
+	/// Wait until the operation has completed and get its result, or throw its error.
+	/// The result is moved out, so this must be called only once.
+	T get()
+	{
+		this->state_->wait();
+		this->state_->rethrow();
+		return this->state_->result.take();
+	}
+
+	/// Cancel the operation.
+	/// An operation that has not started yet does not run and fails with an error. For an operation that is running,
+	/// the server is requested to cancel the statement being executed, which makes the operation fail if the request
+	/// arrives in time (see ibackend_connection::cancel).
+	/// Returns false if the operation had already completed, or if the backend does not support cancellation.
+	bool cancel()
+	{
+		return this->state_->cancel();
+	}
+
+	/// Call @a callback, a callable without arguments, when the operation has completed.
+	/// It is called on the thread that completes the operation, or immediately on the calling thread if the operation
+	/// has completed already. It must not throw.
+	template<typename Callback>
+	void on_complete(Callback callback)
+	{
+		class typed_callback final : public async_operation::callback
+		{
+			Callback callback_;
+
+		public:
+			explicit typed_callback(Callback&& callback)
+			    : callback_{ std::move(callback) }
+			{
+			}
+
+			void invoke() noexcept override
+			{
+				this->callback_();
+			}
+		};
+
+		this->state_->on_complete(std::make_shared<typed_callback>(std::move(callback)));
+	}
+};
+
+/// A work-stealing pool of threads that run database operations asynchronously.
+/// Every worker thread has its own queue of operations. An operation submitted from a worker thread is queued on
+/// that thread, other operations are spread over the threads in turn, and a thread that runs out of operations
+/// takes them from the other threads.
+/// The executor must be destroyed before the connection pool. Operations that have not started when the executor
+/// is destroyed fail with an error, and destruction waits for the ones that are running.
+class SQUID_EXPORT executor final
+{
+	class impl;
+	std::unique_ptr<impl> pimpl_;
+
+	/// Queues @a operation
+	void post(std::shared_ptr<async_operation> operation);
+
+public:
+	explicit executor(connection_pool& pool, const executor_options& options = {});
+	~executor() noexcept;
+
+	executor(const executor&)            = delete;
+	executor(executor&& src)             = default;
+	executor& operator=(const executor&) = delete;
+	executor& operator=(executor&&)      = default;
+
+	/// Run @a function, a callable taking a connection&, on a worker thread with a connection acquired from the pool.
+	/// The result of the operation is the result of @a function.
+	template<typename Function>
+	async_result<std::invoke_result_t<Function&, connection&>> submit(Function function)
+	{
+		using result_type = std::invoke_result_t<Function&, connection&>;
+
+		class operation final : public async_result<result_type>::state
+		{
+			Function function_;
+
+			void invoke(connection_pool& pool) override
+			{
+				connection connection{ pool };
+				this->attach(connection.backend());
+				this->result.store(this->function_, connection);
+			}
+
+		public:
+			explicit operation(Function&& function)
+			    : function_{ std::move(function) }
+			{
+			}
+		};
+
+		auto state = std::make_shared<operation>(std::move(function));
+		this->post(state);
+		return async_result<result_type>{ std::move(state) };
+	}
+
+	/// Run @a function, a callable without arguments that uses @a backend, on a worker thread.
+	/// Cancelling the operation while it runs cancels the statement being executed on @a backend.
+	template<typename Function>
+	async_result<std::invoke_result_t<Function&>> submit(std::shared_ptr<ibackend_connection> backend, Function function)
+	{
+		using result_type = std::invoke_result_t<Function&>;
+
+		class operation final : public async_result<result_type>::state
+		{
+			std::shared_ptr<ibackend_connection> backend_;
+			Function                             function_;
+
+			void invoke(connection_pool&) override
+			{
+				this->attach(std::move(this->backend_));
+				this->result.store(this->function_);
+			}
+
+		public:
+			explicit operation(std::shared_ptr<ibackend_connection>&& backend, Function&& function)
+			    : backend_{ std::move(backend) }
+			    , function_{ std::move(function) }
+			{
+			}
+		};
+
+		auto state = std::make_shared<operation>(std::move(backend), std::move(function));
+		this->post(state);
+		return async_result<result_type>{ std::move(state) };
+	}
+
+	/// Number of worker threads
+	std::size_t thread_count() const;
+};
+
+} // namespace squid
@@ -0,0 +1,501 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/hedgedreader.h"
+#include "squid/routingpool.h"
+#include "squid/ibackendconnection.h"
+
+#include "squid/detail/concurrenthistogram.h"
+#include "squid/detail/prometheus.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <locale>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace squid {
+
+hedged_reader::call::~call() noexcept
+{
+}
+
+class hedged_reader::impl
+{
+	using clock_type = std::chrono::steady_clock;
+
+	/// The shared state of the attempts of a read.
+	/// The connection of an attempt is kept here while the attempt runs, so that the other attempt can cancel it
+	/// without the risk of cancelling a statement of a later user of the connection.
+	struct state
+	{
+		std::shared_ptr<call>                               read;
+		std::mutex                                          mutex;
+		std::condition_variable                             cv;
+		std::array<std::shared_ptr<ibackend_connection>, 2> connections;
+		std::size_t                                         started;
+		std::size_t                                         finished;
+		std::optional<std::size_t>                          winner;
+		std::exception_ptr                                  error;
+
+		explicit state(const std::shared_ptr<call>& read)
+		    : read{ read }
+		    , mutex{}
+		    , cv{}
+		    , connections{}
+		    , started{ 1 }
+		    , finished{}
+		    , winner{}
+		    , error{}
+		{
+		}
+	};
+
+	/// A second attempt of @a read on @a connection, waiting for a hedging thread
+	struct hedge_job
+	{
+		std::shared_ptr<state>               read;
+		std::shared_ptr<ibackend_connection> connection;
+	};
+
+	routing_pool&   pool_;
+	hedging_options options_;
+
+	concurrent_histogram         latency_;
+	std::atomic<clock_type::rep> delay_;
+	std::atomic<std::uint64_t>   reads_;
+	std::atomic<std::uint64_t>   hedges_;
+	std::atomic<std::uint64_t>   hedge_wins_;
+	std::atomic<std::uint64_t>   skipped_;
+	std::atomic<std::uint64_t>   cancellations_;
+
+	std::mutex                                                   mutex_;
+	std::condition_variable                                      cv_;      // wakes the timer thread
+	std::condition_variable                                      jobs_cv_; // wakes the hedging threads
+	std::multimap<clock_type::time_point, std::weak_ptr<state>> pending_; // reads by the deadline of their hedge
+	std::deque<hedge_job>                                        jobs_;
+	std::size_t                                                  hedgers_; // number of second attempts queued or running
+	bool                                                         stopping_; // the timer thread must stop
+	bool                                                         stopped_;  // the hedging threads must stop when idle
+	std::thread                                                  timer_;
+	std::vector<std::thread>                                     workers_;
+
+	/// Runs @a attempt of @a read on @a backend and settles the read if it is the first attempt to succeed
+	void run(state& read, std::size_t attempt, std::shared_ptr<ibackend_connection> backend)
+	{
+		const auto         start = clock_type::now();
+		std::exception_ptr error{};
+		try
+		{
+			connection connection{ std::shared_ptr<ibackend_connection>{ backend } };
+			read.read->invoke(connection, attempt);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		const auto elapsed = clock_type::now() - start;
+
+		std::shared_ptr<ibackend_connection> loser{};
+		bool                                 won{};
+		{
+			std::lock_guard<std::mutex> lock{ read.mutex };
+			read.connections[attempt].reset();
+			++read.finished;
+			if (!read.winner)
+			{
+				if (!error)
+				{
+					read.winner = attempt;
+					won         = true;
+					loser       = read.connections[1 - attempt];
+				}
+				else if (!read.error)
+				{
+					read.error = error;
+				}
+			}
+		}
+		read.cv.notify_all();
+		backend.reset();
+
+		if (!error)
+		{
+			this->latency_.record(elapsed);
+		}
+		if (won)
+		{
+			if (attempt == 1)
+			{
+				this->hedge_wins_.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (loser && loser->cancel())
+			{
+				this->cancellations_.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/// Starts the second attempt of @a weak if its first attempt is still running
+	void hedge(const std::weak_ptr<state>& weak)
+	{
+		const auto read = weak.lock();
+		if (!read)
+		{
+			return;
+		}
+
+		std::shared_ptr<ibackend_connection> first{};
+		{
+			std::lock_guard<std::mutex> lock{ read->mutex };
+			if (read->finished)
+			{
+				return;
+			}
+			first = read->connections[0];
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ this->mutex_ };
+			if (this->hedgers_ == this->options_.max_hedges)
+			{
+				this->skipped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			++this->hedgers_;
+		}
+
+		auto second = this->pool_.try_acquire_other(first);
+		first.reset();
+		if (!second)
+		{
+			this->skipped_.fetch_add(1, std::memory_order_relaxed);
+			this->end_hedge();
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ read->mutex };
+			if (read->finished)
+			{
+				second.reset();
+			}
+			else
+			{
+				read->connections[1] = second;
+				++read->started;
+			}
+		}
+		if (!second)
+		{
+			this->end_hedge();
+			return;
+		}
+
+		try
+		{
+			std::lock_guard<std::mutex> lock{ this->mutex_ };
+			this->jobs_.push_back(hedge_job{ read, std::move(second) });
+		}
+		catch (const std::bad_alloc&)
+		{
+			{
+				std::lock_guard<std::mutex> lock{ read->mutex };
+				read->connections[1].reset();
+				--read->started;
+			}
+			read->cv.notify_all();
+			this->end_hedge();
+			return;
+		}
+		this->hedges_.fetch_add(1, std::memory_order_relaxed);
+		this->jobs_cv_.notify_one();
+	}
+
+	/// Releases the place of a second attempt that was reserved in hedge()
+	void end_hedge()
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		--this->hedgers_;
+	}
+
+	/// Body of a hedging thread: runs the queued second attempts until the reader stops and the queue is empty
+	void work()
+	{
+		std::unique_lock<std::mutex> lock{ this->mutex_ };
+		for (;;)
+		{
+			this->jobs_cv_.wait(lock, [this] { return this->stopped_ || !this->jobs_.empty(); });
+			if (this->jobs_.empty())
+			{
+				return;
+			}
+			auto job = std::move(this->jobs_.front());
+			this->jobs_.pop_front();
+			lock.unlock();
+			this->run(*job.read, 1, std::move(job.connection));
+			job.read.reset();
+			this->end_hedge();
+			lock.lock();
+		}
+	}
+
+	/// Stops the timer thread, then the hedging threads once they have run the queued second attempts
+	void stop() noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock{ this->mutex_ };
+			this->stopping_ = true;
+		}
+		this->cv_.notify_all();
+		// The timer thread queues no second attempts after it has stopped
+		if (this->timer_.joinable())
+		{
+			this->timer_.join();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ this->mutex_ };
+			this->stopped_ = true;
+		}
+		this->jobs_cv_.notify_all();
+		for (auto& worker : this->workers_)
+		{
+			worker.join();
+		}
+	}
+
+	/// Sets the hedging delay to the quantile of the latencies recorded since @a previous, if there are enough of them
+	void update_delay(duration_histogram& previous)
+	{
+		duration_histogram current{};
+		this->latency_.add_to(current);
+
+		duration_histogram window{};
+		for (std::size_t bucket = 0; bucket < duration_histogram::bucket_count; ++bucket)
+		{
+			window.counts[bucket] = current.counts[bucket] - previous.counts[bucket];
+		}
+		previous = current;
+
+		if (window.count() >= this->options_.min_samples)
+		{
+			const auto delay = std::clamp<clock_type::duration>(window.quantile(this->options_.quantile),
+			                                                    this->options_.min_delay,
+			                                                    this->options_.max_delay);
+			this->delay_.store(delay.count(), std::memory_order_relaxed);
+		}
+	}
+
+	/// Body of the timer thread: starts second attempts when they are due, and updates the hedging delay
+	void time()
+	{
+		duration_histogram previous{};
+		auto               next_window = clock_type::now() + this->options_.window;
+
+		std::unique_lock<std::mutex> lock{ this->mutex_ };
+		while (!this->stopping_)
+		{
+			const auto wake = this->pending_.empty() ? next_window : std::min(next_window, this->pending_.begin()->first);
+			this->cv_.wait_until(lock, wake);
+
+			auto now = clock_type::now();
+			while (!this->stopping_ && !this->pending_.empty() && this->pending_.begin()->first <= now)
+			{
+				const auto read = std::move(this->pending_.begin()->second);
+				this->pending_.erase(this->pending_.begin());
+				lock.unlock();
+				this->hedge(read);
+				lock.lock();
+				now = clock_type::now();
+			}
+
+			if (now >= next_window)
+			{
+				lock.unlock();
+				this->update_delay(previous);
+				lock.lock();
+				next_window = now + this->options_.window;
+			}
+		}
+	}
+
+public:
+	impl(routing_pool& pool, const hedging_options& options)
+	    : pool_{ pool }
+	    , options_{ options }
+	    , latency_{}
+	    , delay_{ std::chrono::duration_cast<clock_type::duration>(options.max_delay).count() }
+	    , reads_{}
+	    , hedges_{}
+	    , hedge_wins_{}
+	    , skipped_{}
+	    , cancellations_{}
+	    , mutex_{}
+	    , cv_{}
+	    , jobs_cv_{}
+	    , pending_{}
+	    , jobs_{}
+	    , hedgers_{}
+	    , stopping_{}
+	    , stopped_{}
+	    , timer_{}
+	    , workers_{}
+	{
+		if (!(this->options_.quantile > 0.0 && this->options_.quantile <= 1.0))
+		{
+			throw std::invalid_argument{ "quantile must be greater than zero and not greater than one" };
+		}
+		if (this->options_.min_delay < std::chrono::milliseconds::zero() || this->options_.max_delay < this->options_.min_delay)
+		{
+			throw std::invalid_argument{ "min_delay must not be negative and not greater than max_delay" };
+		}
+		if (this->options_.window <= std::chrono::milliseconds::zero())
+		{
+			throw std::invalid_argument{ "window must be greater than zero" };
+		}
+		if (this->options_.max_hedges == 0u)
+		{
+			throw std::invalid_argument{ "max_hedges must be greater than zero" };
+		}
+
+		try
+		{
+			this->workers_.reserve(this->options_.max_hedges);
+			for (std::size_t n = 0; n < this->options_.max_hedges; ++n)
+			{
+				this->workers_.emplace_back([this] { this->work(); });
+			}
+			this->timer_ = std::thread{ [this] { this->time(); } };
+		}
+		catch (...)
+		{
+			this->stop();
+			throw;
+		}
+	}
+
+	~impl() noexcept
+	{
+		this->stop();
+	}
+
+	std::size_t execute(const std::shared_ptr<call>& call)
+	{
+		this->reads_.fetch_add(1, std::memory_order_relaxed);
+
+		auto       backend = this->pool_.acquire(access_mode::read_only);
+		const auto read    = std::make_shared<state>(call);
+		read->connections[0] = backend;
+
+		const auto deadline = clock_type::now() + clock_type::duration{ this->delay_.load(std::memory_order_relaxed) };
+		{
+			std::lock_guard<std::mutex> lock{ this->mutex_ };
+			const auto entry = this->pending_.emplace(deadline, read);
+			if (entry == this->pending_.begin())
+			{
+				this->cv_.notify_all();
+			}
+		}
+
+		this->run(*read, 0, std::move(backend));
+
+		// Unless the timer thread has already taken it, remove the read from the pending reads, so that it does not
+		// keep the memory of the state until its deadline
+		{
+			std::lock_guard<std::mutex> lock{ this->mutex_ };
+			const auto [first, last] = this->pending_.equal_range(deadline);
+			const auto entry         = std::find_if(first, last, [&read](const auto& pending) {
+				return !pending.second.owner_before(read) && !read.owner_before(pending.second);
+			});
+			if (entry != last)
+			{
+				this->pending_.erase(entry);
+			}
+		}
+
+		std::unique_lock<std::mutex> lock{ read->mutex };
+		read->cv.wait(lock, [&read] { return read->winner || read->finished == read->started; });
+		if (read->winner)
+		{
+			return *read->winner;
+		}
+		std::rethrow_exception(read->error);
+	}
+
+	hedging_stats stats() const
+	{
+		hedging_stats stats{};
+		stats.reads         = this->reads_.load(std::memory_order_relaxed);
+		stats.hedges        = this->hedges_.load(std::memory_order_relaxed);
+		stats.hedge_wins    = this->hedge_wins_.load(std::memory_order_relaxed);
+		stats.skipped       = this->skipped_.load(std::memory_order_relaxed);
+		stats.cancellations = this->cancellations_.load(std::memory_order_relaxed);
+		stats.delay         = clock_type::duration{ this->delay_.load(std::memory_order_relaxed) };
+		this->latency_.add_to(stats.latency);
+		return stats;
+	}
+};
+
+hedged_reader::hedged_reader(routing_pool& pool, const hedging_options& options)
+    : pimpl_{ std::make_unique<impl>(pool, options) }
+{
+}
+
+hedged_reader::~hedged_reader() noexcept = default;
+
+std::size_t hedged_reader::execute(const std::shared_ptr<call>& read)
+{
+	return this->pimpl_->execute(read);
+}
+
+hedging_stats hedged_reader::stats() const
+{
+	return this->pimpl_->stats();
+}
+
+std::string to_prometheus_text(const hedging_stats& stats, std::string_view pool_name, std::string_view prefix)
+{
+	std::ostringstream out{};
+	out.imbue(std::locale::classic());
+	out.precision(9);
+
+	write_metric(out, prefix, "reads_total", "counter", "Number of reads.", pool_name, stats.reads);
+	write_metric(out, prefix, "hedges_total", "counter", "Number of reads that were hedged.", pool_name, stats.hedges);
+	write_metric(
+	    out, prefix, "hedge_wins_total", "counter", "Number of reads answered by the hedged attempt.", pool_name, stats.hedge_wins);
+	write_metric(out,
+	             prefix,
+	             "hedges_skipped_total",
+	             "counter",
+	             "Number of reads that were due for a hedge without another replica or hedging thread available.",
+	             pool_name,
+	             stats.skipped);
+	write_metric(
+	    out, prefix, "cancellations_total", "counter", "Number of losing attempts that were cancelled.", pool_name, stats.cancellations);
+	write_metric(out,
+	             prefix,
+	             "delay_seconds",
+	             "gauge",
+	             "Time after which a read is hedged.",
+	             pool_name,
+	             std::chrono::duration<double>{ stats.delay }.count());
+	write_histogram(out, prefix, "latency", "Latency of the attempts that completed without error.", pool_name, stats.latency);
+
+	return out.str();
+}
+
+} // namespace squid
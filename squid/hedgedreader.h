@@ -0,0 +1,141 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/api.h"
+#include "squid/connection.h"
+#include "squid/durationhistogram.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace squid {
+
+class routing_pool;
+
+/// Options of a hedged_reader
+struct SQUID_EXPORT hedging_options
+{
+	/// Quantile of the latency of reads after which a read is hedged
+	double quantile = 0.95;
+
+	/// Lower bound of the hedging delay
+	std::chrono::milliseconds min_delay = std::chrono::milliseconds{ 1 };
+
+	/// Upper bound of the hedging delay, and the delay until enough latencies have been observed
+	std::chrono::milliseconds max_delay = std::chrono::seconds{ 1 };
+
+	/// Interval at which the hedging delay is recomputed from the latencies observed during the interval
+	std::chrono::milliseconds window = std::chrono::seconds{ 10 };
+
+	/// Minimum number of latencies observed during a window to recompute the hedging delay
+	std::size_t min_samples = 100;
+
+	/// Maximum number of second attempts that run at the same time, and the number of threads that run them.
+	/// A read that is due for a hedge while all of these threads are busy is not hedged.
+	std::size_t max_hedges = 4;
+};
+
+/// Snapshot of the counters of a hedged_reader
+struct SQUID_EXPORT hedging_stats
+{
+	std::uint64_t            reads;         /// number of reads
+	std::uint64_t            hedges;        /// number of reads for which a second attempt was issued
+	std::uint64_t            hedge_wins;    /// number of reads that were answered by the second attempt
+	std::uint64_t            skipped;       /// number of reads that were due for a hedge, but no other replica had a connection
+	                                        /// or max_hedges second attempts were running
+	std::uint64_t            cancellations; /// number of losing attempts that were cancelled
+	std::chrono::nanoseconds delay;         /// current hedging delay
+	duration_histogram       latency;       /// latency of the attempts that completed without error
+};
+
+/// Format @a stats in the Prometheus text exposition format, like the statistics of a connection_pool
+SQUID_EXPORT std::string to_prometheus_text(const hedging_stats& stats,
+                                            std::string_view     pool_name = {},
+                                            std::string_view     prefix    = "squid_hedged_reads");
+
+/// Executes idempotent reads on the replicas of a routing_pool, hedging the slow ones.
+/// A read runs on a read-only connection on the calling thread. If it has not completed after the hedging delay,
+/// which tracks a quantile of the observed latencies, the same read is started on a connection to another replica
+/// on one of max_hedges hedging threads. The result of the attempt that completes first is returned, and the other attempt is
+/// cancelled (see ibackend_connection::cancel). Without cancellation support in the backend, the calling thread
+/// cannot return before its own attempt has completed.
+/// The reader must be destroyed before the routing pool; destruction waits for second attempts that are still running
+/// or queued.
+class SQUID_EXPORT hedged_reader final
+{
+	/// A type-erased read
+	class SQUID_EXPORT call
+	{
+	public:
+		virtual ~call() noexcept;
+
+		/// Run attempt @a attempt (0 or 1) of the read on @a connection
+		virtual void invoke(connection& connection, std::size_t attempt) = 0;
+	};
+
+	class impl;
+	std::unique_ptr<impl> pimpl_;
+
+	/// Runs @a read and returns the index of the attempt whose result is returned
+	std::size_t execute(const std::shared_ptr<call>& read);
+
+public:
+	explicit hedged_reader(routing_pool& pool, const hedging_options& options = {});
+	~hedged_reader() noexcept;
+
+	hedged_reader(const hedged_reader&)            = delete;
+	hedged_reader(hedged_reader&& src)             = default;
+	hedged_reader& operator=(const hedged_reader&) = delete;
+	hedged_reader& operator=(hedged_reader&&)      = default;
+
+	/// Execute @a read, a callable taking a connection& and returning the result of the read.
+	/// @a read must be idempotent, and it may be invoked twice at the same time, on different threads. The second
+	/// invocation can outlive this call, so @a read must not refer to objects of the caller by reference.
+	/// Throws the error of the first attempt if no attempt succeeds.
+	template<typename Read>
+	std::invoke_result_t<Read&, connection&> read(Read read)
+	{
+		using result_type = std::invoke_result_t<Read&, connection&>;
+		static_assert(!std::is_void_v<result_type>, "A hedged read must return its result");
+
+		class typed_call final : public call
+		{
+			Read read_;
+
+		public:
+			std::optional<result_type> results[2];
+
+			explicit typed_call(Read&& read)
+			    : read_{ std::move(read) }
+			    , results{}
+			{
+			}
+
+			void invoke(connection& connection, std::size_t attempt) override
+			{
+				this->results[attempt].emplace(this->read_(connection));
+			}
+		};
+
+		const auto typed  = std::make_shared<typed_call>(std::move(read));
+		const auto winner = this->execute(typed);
+		return std::move(*typed->results[winner]);
+	}
+
+	/// Current counters of the reader
+	hedging_stats stats() const;
+};
+
+} // namespace squid
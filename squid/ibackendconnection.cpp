@@ -6,11 +6,53 @@
 //
 
 #include "squid/ibackendconnection.h"
+#include "squid/statementobserver.h"
 
 namespace squid {
 
+ibackend_connection::ibackend_connection()
+    : observer_{}
+    , memory_{}
+{
+}
+
 ibackend_connection::~ibackend_connection() noexcept
 {
 }
 
+bool ibackend_connection::is_broken() const noexcept
+{
+	return false;
+}
+
+bool ibackend_connection::ping()
+{
+	return !this->is_broken();
+}
+
+bool ibackend_connection::cancel()
+{
+	return false;
+}
+
+statement_observer* ibackend_connection::observer() const noexcept
+{
+	return this->observer_.get();
+}
+
+void ibackend_connection::set_observer(std::shared_ptr<statement_observer> observer) noexcept
+{
+	this->observer_ = std::move(observer);
+}
+
+result_memory& ibackend_connection::memory() noexcept
+{
+	return this->memory_;
+}
+
+const result_memory& ibackend_connection::memory() const noexcept
+{
+	return this->memory_;
+}
+
 } // namespace squid
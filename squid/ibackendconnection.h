@@ -8,6 +8,7 @@
 #pragma once
 
 #include "squid/api.h"
+#include "squid/resultmemory.h"
 
 #include <memory>
 #include <string_view>
@@ -15,16 +16,46 @@
 namespace squid {
 
 class ibackend_statement;
+class statement_observer;
 
 /// Interface for a backend connection
 class SQUID_EXPORT ibackend_connection
 {
+	std::shared_ptr<statement_observer> observer_;
+	result_memory                       memory_;
+
 public:
+	ibackend_connection();
 	virtual ~ibackend_connection() noexcept;
 
 	virtual std::unique_ptr<ibackend_statement> create_statement(std::string_view query)          = 0;
 	virtual std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) = 0;
 	virtual void                                execute(const std::string& query)                 = 0;
+
+	/// Whether the connection is known to be unusable, e.g. because the server closed it.
+	/// Must be cheap and must not communicate with the server. The default implementation returns false.
+	virtual bool is_broken() const noexcept;
+
+	/// Verify that the connection is usable by communicating with the server.
+	/// The default implementation returns !is_broken().
+	virtual bool ping();
+
+	/// Request the server to cancel the statement that is being executed on the connection.
+	/// May be called from another thread than the one using the connection. The statement fails with an error if
+	/// the request arrives in time; if it arrives late, it has no effect.
+	/// Returns whether the request was sent. The default implementation does not support cancellation and returns false.
+	virtual bool cancel();
+
+	/// Observer of the statements executed on the connection, nullptr if there is none.
+	statement_observer* observer() const noexcept;
+
+	/// Set the observer of the statements executed on the connection, or remove it if @a observer is nullptr.
+	/// Must not be called while a statement is being executed on the connection.
+	void set_observer(std::shared_ptr<statement_observer> observer) noexcept;
+
+	/// Accounting and limits of the bytes buffered for the results of the statements executed on the connection
+	result_memory&       memory() noexcept;
+	const result_memory& memory() const noexcept;
 };
 
 } // namespace squid
@@ -2,8 +2,48 @@
 
 namespace squid {
 
+ibackend_statement::ibackend_statement()
+    : observer_{}
+    , result_account_{}
+{
+}
+
 ibackend_statement::~ibackend_statement() noexcept
 {
 }
 
+statement_observer* ibackend_statement::observer() const noexcept
+{
+	return this->observer_;
+}
+
+void ibackend_statement::observe(statement_observer* observer) noexcept
+{
+	this->observer_ = observer;
+}
+
+void ibackend_statement::account(result_memory* memory) noexcept
+{
+	this->result_account_.attach(memory);
+}
+
+result_account& ibackend_statement::results_account() noexcept
+{
+	return this->result_account_;
+}
+
+std::uint64_t ibackend_statement::result_bytes() const noexcept
+{
+	return this->result_account_.bytes();
+}
+
+void ibackend_statement::prepare()
+{
+}
+
+std::string_view ibackend_statement::query() const noexcept
+{
+	return {};
+}
+
 } // namespace squid
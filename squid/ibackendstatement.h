@@ -10,19 +10,57 @@
 #include "squid/api.h"
 #include "squid/parameter.h"
 #include "squid/result.h"
+#include "squid/resultmemory.h"
 
 #include <map>
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace squid {
 
+class statement_observer;
+
 /// Interface for a backend statement
 class SQUID_EXPORT ibackend_statement
 {
+	statement_observer* observer_;
+	result_account      result_account_;
+
+protected:
+	/// Observer of the next execution, and the fetches that follow it, nullptr if there is none
+	statement_observer* observer() const noexcept;
+
+	/// Account of the bytes buffered for the result of the current execution.
+	/// Backends release it when they execute again, and add to it while they receive a result.
+	result_account& results_account() noexcept;
+
 public:
+	ibackend_statement();
 	virtual ~ibackend_statement() noexcept;
 
+	ibackend_statement(const ibackend_statement&)            = delete;
+	ibackend_statement(ibackend_statement&& src)             = default;
+	ibackend_statement& operator=(const ibackend_statement&) = delete;
+	ibackend_statement& operator=(ibackend_statement&&)      = default;
+
+	/// Report the phases of the next execution, and the fetches that follow it, to @a observer.
+	/// The observer must outlive the statement, or be replaced before the statement is used again.
+	/// A statement that wraps another one forwards this to it.
+	virtual void observe(statement_observer* observer) noexcept;
+
+	/// Account the bytes buffered for the results of the next executions on @a memory, and check them against its
+	/// limits. The memory must outlive the statement, or be replaced before the statement is used again.
+	/// A statement that wraps another one forwards this to it.
+	virtual void account(result_memory* memory) noexcept;
+
+	/// Bytes buffered for the result of the current execution
+	virtual std::uint64_t result_bytes() const noexcept;
+
+	/// Prepare the statement now, e.g. on the server, instead of on its first execution. Throws if that fails.
+	/// Does nothing for a statement that is not reused, or that is prepared already.
+	virtual void prepare();
+
 	virtual void execute(const std::map<std::string, parameter>& parameters, const std::vector<result>& results)           = 0;
 	virtual void execute(const std::map<std::string, parameter>& parameters, const std::map<std::string, result>& results) = 0;
 	virtual bool fetch()                                                                                                   = 0;
@@ -31,6 +69,9 @@ public:
 	virtual std::string field_name(std::size_t index) = 0;
 
 	virtual std::uint64_t affected_rows() = 0;
+
+	/// Query text as passed to the backend, empty if it is not known
+	virtual std::string_view query() const noexcept;
 };
 
 } // namespace squid
@@ -309,8 +309,29 @@ void backend_connection::execute(const std::string& query)
 	statement::execute(*this->connection_, query);
 }
 
+bool backend_connection::ping()
+{
+	return mysql_ping(this->connection_.get()) == 0;
+}
+
+bool backend_connection::cancel()
+{
+	// The server cancels a statement with KILL QUERY, which has to be sent on another connection
+	try
+	{
+		const auto killer = connect_database(this->connection_info_);
+		const auto query  = "KILL QUERY " + std::to_string(mysql_thread_id(this->connection_.get()));
+		return mysql_query(killer.get(), query.c_str()) == 0;
+	}
+	catch (const error&)
+	{
+		return false;
+	}
+}
+
 backend_connection::backend_connection(const std::string& connection_info)
-    : connection_{ connect_database(connection_info) }
+    : connection_info_{ connection_info }
+    , connection_{ connect_database(connection_info) }
 {
 }
 
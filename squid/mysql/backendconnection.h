@@ -16,11 +16,14 @@ namespace mysql {
 
 class SQUID_EXPORT backend_connection final : public ibackend_connection
 {
+	std::string            connection_info_;
 	std::shared_ptr<MYSQL> connection_;
 
 	std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override;
 	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override;
 	void                                execute(const std::string& query) override;
+	bool                                ping() override;
+	bool                                cancel() override;
 
 public:
 	/// @a connection_info must contain a path to a file
@@ -379,6 +379,7 @@ query_results::query_results(std::shared_ptr<MYSQL_STMT> statement)
 		{
 			std::memset(&bind, 0, sizeof(bind));
 			bind.buffer_type = MYSQL_TYPE_NULL;
+			bind.length      = &bind.length_value; // also for the columns that are not bound, for row_bytes()
 		}
 	}
 }
@@ -510,5 +511,15 @@ bool query_results::fetch()
 	return true;
 }
 
+std::uint64_t query_results::row_bytes() const noexcept
+{
+	std::uint64_t bytes{};
+	for (const auto& bind : this->binds_)
+	{
+		bytes += bind.length_value;
+	}
+	return bytes;
+}
+
 } // namespace mysql
 } // namespace squid
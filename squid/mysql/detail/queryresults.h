@@ -10,6 +10,7 @@
 #include "squid/result.h"
 #include "squid/mysql/detail/mysqlfwd.h"
 
+#include <cstdint>
 #include <vector>
 #include <map>
 #include <memory>
@@ -40,6 +41,9 @@ public:
 	std::string_view field_name(std::size_t index) const;
 
 	bool fetch();
+
+	/// Number of bytes of the values of the last fetched row
+	std::uint64_t row_bytes() const noexcept;
 };
 
 } // namespace mysql
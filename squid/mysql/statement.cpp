@@ -12,6 +12,9 @@
 #include "squid/mysql/detail/queryparameters.h"
 #include "squid/mysql/detail/queryresults.h"
 
+#include "squid/detail/phasetimer.h"
+#include "squid/detail/probes.h"
+
 #include <sstream>
 #include <iomanip>
 #include <cassert>
@@ -35,6 +38,7 @@ std::shared_ptr<MYSQL_STMT> prepare_statement(MYSQL& connection, const std::stri
 	std::cout << "preparing: " << query << "\n";
 #endif
 
+	const auto                  start = probe_start(SQUID_PROBE_ENABLED(backend__prepare));
 	std::shared_ptr<MYSQL_STMT> stmt{ mysql_stmt_init(&connection), mysql_stmt_close };
 
 	if (!stmt)
@@ -47,6 +51,7 @@ std::shared_ptr<MYSQL_STMT> prepare_statement(MYSQL& connection, const std::stri
 		throw error{ "mysql_stmt_prepare failed", connection };
 	}
 
+	SQUID_PROBE(backend__prepare, "mysql", query.c_str(), probe_nanoseconds(start));
 	return stmt;
 }
 
@@ -60,6 +65,26 @@ class statement::impl
 	std::unique_ptr<query_parameters> parameters_;
 	std::unique_ptr<query_results>    query_results_;
 	std::shared_ptr<MYSQL_STMT>       statement_;
+	statement_observer*               observer_;
+	phase_accumulator                 decode_;
+
+	/// Account the bytes of the row that was just fetched. The client library does not tell the size of a stored result,
+	/// so also stored rows are accounted as they are fetched. When that exceeds a limit, the rows are streamed, and the
+	/// rest of the result is discarded before the error is thrown.
+	void account_row(result_account& account)
+	{
+		try
+		{
+			account.add(this->query_results_->row_bytes());
+		}
+		catch (...)
+		{
+			this->query_results_.reset();
+			mysql_stmt_reset(this->statement_.get());
+			account.release();
+			throw;
+		}
+	}
 
 public:
 	impl(std::shared_ptr<MYSQL> connection, std::string_view query, bool reuse_statement)
@@ -69,16 +94,37 @@ public:
 	    , parameters_{}
 	    , query_results_{}
 	    , statement_{}
+	    , observer_{}
+	    , decode_{}
 	{
 		assert(this->connection_);
 	}
 
+	void prepare()
+	{
+		assert(this->connection_);
+
+		if (this->reuse_statement_ && !this->statement_)
+		{
+			this->statement_ = prepare_statement(*this->connection_, this->query_->query());
+		}
+	}
+
 	template<typename ResultsContainer>
-	void execute(const std::map<std::string, parameter>& parameters, const ResultsContainer& results)
+	void execute(const std::map<std::string, parameter>& parameters,
+	             const ResultsContainer&                 results,
+	             statement_observer*                     observer,
+	             result_account&                         account)
 	{
 		assert(this->connection_);
 
+		this->decode_.report(this->observer_, statement_phase::decode, this->query_->query());
+		this->observer_ = observer;
+
 		this->query_results_.reset();
+		account.release();
+
+		phase_timer timer{ observer, this->query_->query(), &parameters };
 
 		if (this->statement_ && !this->reuse_statement_)
 		{
@@ -88,19 +134,30 @@ public:
 		if (!this->statement_)
 		{
 			this->statement_ = prepare_statement(*this->connection_, this->query_->query());
+			timer.lap(statement_phase::prepare);
 		}
 
 		this->parameters_ = std::make_unique<query_parameters>(*this->query_, parameters);
 
 		this->parameters_->bind(*this->statement_);
+		timer.lap(statement_phase::bind);
 
 		if (0 != mysql_stmt_execute(this->statement_.get()))
 		{
 			throw error{ "mysql_stmt_execute failed", *this->statement_ };
 		}
+		timer.lap(statement_phase::execute);
 
 		this->query_results_ = std::make_unique<query_results>(this->statement_, results);
 
+		// With a result limit, the rows are not stored but read one by one in fetch, so that a result that exceeds the
+		// limit is abandoned before the rest of it is received. While such a statement has rows that were not fetched
+		// yet, no other statement can be executed on the connection.
+		if (account.limited())
+		{
+			return;
+		}
+
 		// This call fetches the complete result on the client side, which can be suboptimal.
 		// This should not be necessary, but without this it is not possible
 		// to execute this statement again while another statement exists that has a
@@ -112,13 +169,35 @@ public:
 		{
 			throw error{ "mysql_stmt_store_result failed", *this->statement_ };
 		}
+		if (timer)
+		{
+			timer.lap(statement_phase::transfer, mysql_stmt_num_rows(this->statement_.get()));
+		}
 	}
 
-	bool fetch()
+	bool fetch(result_account& account)
 	{
 		if (this->query_results_)
 		{
-			return this->query_results_->fetch();
+			if (!this->observer_)
+			{
+				if (!this->query_results_->fetch())
+				{
+					return false;
+				}
+				this->account_row(account);
+				return true;
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			if (this->query_results_->fetch())
+			{
+				this->decode_.add(start);
+				this->account_row(account);
+				return true;
+			}
+			this->decode_.report(this->observer_, statement_phase::decode, this->query_->query());
+			return false;
 		}
 		else
 		{
@@ -155,6 +234,11 @@ public:
 		return mysql_affected_rows(this->connection_.get());
 	}
 
+	std::string_view query() const noexcept
+	{
+		return this->query_->query();
+	}
+
 	MYSQL_STMT& handle() const
 	{
 		if (!this->statement_)
@@ -178,19 +262,24 @@ statement::~statement() noexcept
 {
 }
 
+void statement::prepare()
+{
+	this->pimpl_->prepare();
+}
+
 void statement::execute(const std::map<std::string, parameter>& parameters, const std::vector<result>& results)
 {
-	this->pimpl_->execute(parameters, results);
+	this->pimpl_->execute(parameters, results, this->observer(), this->results_account());
 }
 
 void statement::execute(const std::map<std::string, parameter>& parameters, const std::map<std::string, result>& results)
 {
-	this->pimpl_->execute(parameters, results);
+	this->pimpl_->execute(parameters, results, this->observer(), this->results_account());
 }
 
 bool statement::fetch()
 {
-	return this->pimpl_->fetch();
+	return this->pimpl_->fetch(this->results_account());
 }
 
 std::size_t statement::field_count()
@@ -208,6 +297,11 @@ std::uint64_t statement::affected_rows()
 	return this->pimpl_->affected_rows();
 }
 
+std::string_view statement::query() const noexcept
+{
+	return this->pimpl_->query();
+}
+
 /*static*/ void statement::execute(MYSQL& connection, const std::string& query)
 {
 	if (0 != mysql_real_query(&connection, query.c_str(), query.length()))
@@ -32,6 +32,8 @@ public:
 	statement& operator=(const statement&) = delete;
 	statement& operator=(statement&&)      = default;
 
+	void prepare() override;
+
 	void execute(const std::map<std::string, parameter>& parameters, const std::vector<result>& results) override;
 	void execute(const std::map<std::string, parameter>& parameters, const std::map<std::string, result>& results) override;
 	bool fetch() override;
@@ -41,6 +43,8 @@ public:
 
 	std::uint64_t affected_rows() override;
 
+	std::string_view query() const noexcept override;
+
 	static void execute(MYSQL& connection, const std::string& query);
 
 	MYSQL_STMT& handle() const;
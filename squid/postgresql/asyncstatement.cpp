@@ -0,0 +1,415 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/postgresql/asyncstatement.h"
+#include "squid/postgresql/backendconnection.h"
+#include "squid/postgresql/error.h"
+
+#include "squid/postgresql/detail/query.h"
+#include "squid/postgresql/detail/queryparameters.h"
+#include "squid/postgresql/detail/queryresults.h"
+
+#include "squid/connection.h"
+#include "squid/detail/conversions.h"
+
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <optional>
+
+#include <libpq-fe.h>
+
+namespace squid {
+namespace postgresql {
+
+namespace {
+
+std::string next_statement_name()
+{
+	static std::atomic<uint64_t> statement_number = 0;
+	return std::string{ "a_" } + std::to_string(++statement_number);
+}
+
+} // namespace
+
+class async_statement::impl
+{
+	using stream_descriptor = boost::asio::posix::stream_descriptor;
+
+	std::shared_ptr<ibackend_connection> backend_; // keeps the connection alive
+	PGconn&                              connection_;
+	stream_descriptor                    stream_;  // the socket of the connection while the statement executes
+	postgresql_query                     query_;
+	std::string                          stmt_name_;
+	bool                                 prepared_;
+	bool                                 executed_;
+	const std::vector<result>*           results_;       // result bindings of the execution, sequential
+	const std::map<std::string, result>* named_results_; // or by name
+	std::shared_ptr<PGresult>            row_;           // row that arrived and was not fetched yet
+	std::shared_ptr<PGresult>            last_result_;   // last result of the execution, for the field and command info
+
+	static PGconn& handle(const std::shared_ptr<ibackend_connection>& backend)
+	{
+		const auto postgresql_backend = dynamic_cast<backend_connection*>(backend.get());
+		if (!postgresql_backend)
+		{
+			throw error{ "An async_statement requires a PostgreSQL connection" };
+		}
+		return postgresql_backend->handle();
+	}
+
+	/// Whether results of the execution have not all been received
+	bool busy() const
+	{
+		return this->stream_.is_open();
+	}
+
+	/// Starts watching the socket of the connection, in non-blocking mode
+	void begin()
+	{
+		if (PQsetnonblocking(&this->connection_, 1) != 0)
+		{
+			throw error{ "PQsetnonblocking failed", this->connection_ };
+		}
+		const auto socket = PQsocket(&this->connection_);
+		if (socket < 0)
+		{
+			throw error{ "PQsocket failed", this->connection_ };
+		}
+		this->stream_.assign(socket);
+	}
+
+	/// Stops watching the socket of the connection, which remains owned by libpq, and restores blocking mode
+	void end() noexcept
+	{
+		if (this->stream_.is_open())
+		{
+			this->stream_.release();
+		}
+		PQsetnonblocking(&this->connection_, 0);
+	}
+
+	/// Sends the query that was queued by a PQsend* function
+	boost::asio::awaitable<void> flush(const char* function)
+	{
+		for (;;)
+		{
+			const auto result = PQflush(&this->connection_);
+			if (result == 0)
+			{
+				co_return;
+			}
+			else if (result < 0)
+			{
+				throw error{ std::string{ function } + " failed", this->connection_ };
+			}
+			co_await this->stream_.async_wait(stream_descriptor::wait_write, boost::asio::use_awaitable);
+			// The server may not accept more input until it could send its output
+			if (!PQconsumeInput(&this->connection_))
+			{
+				throw error{ std::string{ function } + " failed", this->connection_ };
+			}
+		}
+	}
+
+	/// Waits for the next result, which is null when all results of the query have been received
+	boost::asio::awaitable<std::shared_ptr<PGresult>> next_result(const char* function)
+	{
+		while (PQisBusy(&this->connection_))
+		{
+			co_await this->stream_.async_wait(stream_descriptor::wait_read, boost::asio::use_awaitable);
+			if (!PQconsumeInput(&this->connection_))
+			{
+				throw error{ std::string{ function } + " failed", this->connection_ };
+			}
+		}
+		co_return std::shared_ptr<PGresult>{ PQgetResult(&this->connection_), PQclear };
+	}
+
+	/// Discards the remaining results of the query
+	boost::asio::awaitable<void> finish()
+	{
+		while (this->busy())
+		{
+			// Not awaited in the condition of the if: GCC 12 then resumes this coroutine with a corrupt this pointer
+			const auto result = co_await this->next_result("PQgetResult");
+			if (!result)
+			{
+				this->end();
+			}
+		}
+	}
+
+	/// Waits for the last result of a command, and throws if it failed
+	boost::asio::awaitable<std::shared_ptr<PGresult>> command_result(const char* function)
+	{
+		auto result = co_await this->next_result(function);
+		if (!result)
+		{
+			throw error{ std::string{ function } + " failed", this->connection_ };
+		}
+		co_await this->finish();
+		if (PGRES_COMMAND_OK != PQresultStatus(result.get()))
+		{
+			throw error{ std::string{ function } + " failed", this->connection_, *result };
+		}
+		co_return result;
+	}
+
+	/// Handles the next result of the query: a row, or the end of the rows or of the command
+	boost::asio::awaitable<void> receive(const char* function)
+	{
+		auto result = co_await this->next_result(function);
+		if (!result)
+		{
+			this->end();
+			throw error{ std::string{ function } + " failed", this->connection_ };
+		}
+
+		const auto status = PQresultStatus(result.get());
+		if (PGRES_SINGLE_TUPLE == status)
+		{
+			this->row_ = result;
+		}
+		else
+		{
+			co_await this->finish();
+			if (PGRES_TUPLES_OK != status && PGRES_COMMAND_OK != status)
+			{
+				throw error{ std::string{ function } + " failed", this->connection_, *result };
+			}
+		}
+		this->last_result_ = std::move(result);
+	}
+
+	std::unique_ptr<query_results> make_query_results(std::shared_ptr<PGresult> pgresult) const
+	{
+		if (this->named_results_)
+		{
+			return std::make_unique<query_results>(std::move(pgresult), *this->named_results_);
+		}
+		else
+		{
+			return std::make_unique<query_results>(std::move(pgresult), *this->results_);
+		}
+	}
+
+	const PGresult& executed_result(const char* what) const
+	{
+		if (!this->executed_ || !this->last_result_)
+		{
+			throw error{ std::string{ "Cannot get " } + what + " from a statement that has not been executed" };
+		}
+		return *this->last_result_;
+	}
+
+public:
+	explicit impl(boost::asio::io_context& ioc, std::shared_ptr<ibackend_connection> backend, std::string_view query)
+	    : backend_{ std::move(backend) }
+	    , connection_{ handle(this->backend_) }
+	    , stream_{ ioc }
+	    , query_{ query }
+	    , stmt_name_{ next_statement_name() }
+	    , prepared_{}
+	    , executed_{}
+	    , results_{}
+	    , named_results_{}
+	    , row_{}
+	    , last_result_{}
+	{
+	}
+
+	~impl() noexcept
+	{
+		try
+		{
+			if (this->busy())
+			{
+				// Abandoned while executing: have the server stop, and wait until it did
+				this->end();
+				this->backend_->cancel();
+				while (std::shared_ptr<PGresult>{ PQgetResult(&this->connection_), PQclear })
+				{
+				}
+			}
+			if (this->prepared_)
+			{
+				std::shared_ptr<PGresult>{ PQexec(&this->connection_, ("DEALLOCATE " + this->stmt_name_).c_str()), PQclear };
+			}
+		}
+		catch (...)
+		{
+			;
+		}
+	}
+
+	template<typename ResultsContainer>
+	boost::asio::awaitable<void> execute(const std::map<std::string, parameter>& parameters, const ResultsContainer& results)
+	{
+		co_await this->finish();
+
+		this->executed_ = false;
+		this->row_.reset();
+		this->last_result_.reset();
+		if constexpr (std::is_same_v<ResultsContainer, std::vector<result>>)
+		{
+			this->results_       = &results;
+			this->named_results_ = nullptr;
+		}
+		else
+		{
+			this->results_       = nullptr;
+			this->named_results_ = &results;
+		}
+
+		query_parameters query_params{ this->query_, parameters };
+		assert(query_params.parameter_count() == this->query_.parameter_count());
+
+		this->begin();
+		try
+		{
+			if (!this->prepared_)
+			{
+				if (!PQsendPrepare(&this->connection_,
+				                   this->stmt_name_.c_str(),
+				                   this->query_.query().c_str(),
+				                   this->query_.parameter_count(),
+				                   nullptr))
+				{
+					throw error{ "PQsendPrepare failed", this->connection_ };
+				}
+				co_await this->flush("PQsendPrepare");
+				co_await this->command_result("PQsendPrepare");
+				this->prepared_ = true;
+				this->begin();
+			}
+
+			if (!PQsendQueryPrepared(&this->connection_,
+			                         this->stmt_name_.c_str(),
+			                         query_params.parameter_count(),
+			                         query_params.parameter_values(),
+			                         nullptr,
+			                         nullptr,
+			                         0))
+			{
+				throw error{ "PQsendQueryPrepared failed", this->connection_ };
+			}
+			PQsetSingleRowMode(&this->connection_);
+			co_await this->flush("PQsendQueryPrepared");
+			co_await this->receive("PQsendQueryPrepared");
+		}
+		catch (...)
+		{
+			// Leave the connection usable, unless it is broken
+			if (this->busy() && PQstatus(&this->connection_) != CONNECTION_OK)
+			{
+				this->end();
+			}
+			throw;
+		}
+		this->executed_ = true;
+	}
+
+	boost::asio::awaitable<bool> fetch()
+	{
+		if (!this->executed_)
+		{
+			throw error{ "Cannot fetch tuple from a statement that has not been executed" };
+		}
+		if (!this->row_ && this->busy())
+		{
+			co_await this->receive("PQgetResult");
+		}
+		if (!this->row_)
+		{
+			co_return false;
+		}
+		this->make_query_results(std::move(this->row_))->fetch(0);
+		co_return true;
+	}
+
+	std::size_t field_count()
+	{
+		return static_cast<std::size_t>(PQnfields(&this->executed_result("field count")));
+	}
+
+	std::string field_name(std::size_t index)
+	{
+		const auto name = PQfname(&this->executed_result("field name"), static_cast<int>(index));
+		if (!name)
+		{
+			throw error{ "Field index " + std::to_string(index) + " is out of range" };
+		}
+		return name;
+	}
+
+	std::uint64_t affected_rows()
+	{
+		const auto num = PQcmdTuples(const_cast<PGresult*>(&this->executed_result("the number of affected rows")));
+		if (!num || !(*num))
+		{
+			return 0ull;
+		}
+		return string_to_number<std::uint64_t>(num);
+	}
+};
+
+std::unique_ptr<ibackend_statement> async_statement::create_statement(std::shared_ptr<ibackend_connection>, std::string_view)
+{
+	throw error{ "An async_statement is executed with async_execute" };
+}
+
+async_statement::async_statement(boost::asio::io_context& ioc, squid::connection& connection, std::string_view query)
+    : basic_statement{ connection.backend() }
+    , pimpl_{ std::make_unique<impl>(ioc, connection.backend(), query) }
+{
+}
+
+async_statement::~async_statement() noexcept
+{
+}
+
+boost::asio::awaitable<void> async_statement::async_execute()
+{
+	if (!this->bound_results().empty() && !this->bound_named_results().empty())
+	{
+		throw error{ "Named result binding cannot be combined with sequential result binding" };
+	}
+	if (!this->bound_named_results().empty())
+	{
+		co_await this->pimpl_->execute(this->bound_parameters(), this->bound_named_results());
+	}
+	else
+	{
+		co_await this->pimpl_->execute(this->bound_parameters(), this->bound_results());
+	}
+}
+
+boost::asio::awaitable<bool> async_statement::async_fetch()
+{
+	co_return co_await this->pimpl_->fetch();
+}
+
+std::size_t async_statement::field_count()
+{
+	return this->pimpl_->field_count();
+}
+
+std::string async_statement::field_name(std::size_t index)
+{
+	return this->pimpl_->field_name(index);
+}
+
+std::uint64_t async_statement::affected_rows()
+{
+	return this->pimpl_->affected_rows();
+}
+
+} // namespace postgresql
+} // namespace squid
@@ -0,0 +1,94 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/api.h"
+#include "squid/basicstatement.h"
+
+#include <utility> // must precede the asio headers for coroutine support
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace squid {
+
+class connection;
+
+namespace postgresql {
+
+/// A prepared statement that is executed in a coroutine on a Boost.Asio io_context, without blocking the thread.
+/// While the statement executes, the connection is in non-blocking mode and the coroutine waits for its socket, so a
+/// single thread running the io_context can drive many statements at once, each on a connection of its own (e.g.
+/// acquired from a connection_pool).
+/// Parameters and results are bound like with any other statement. Rows are received one at a time (single row mode),
+/// so that async_fetch only waits when the next row has not arrived yet.
+/// Only one statement can execute on a connection at any time, and the connection must not be used otherwise until
+/// all rows have been fetched. The statement must outlive the coroutines awaiting it.
+class SQUID_EXPORT async_statement final : private basic_statement
+{
+	class impl;
+	std::unique_ptr<impl> pimpl_;
+
+	std::unique_ptr<ibackend_statement> create_statement(std::shared_ptr<ibackend_connection> connection,
+	                                                     std::string_view                     query) override;
+
+public:
+	/// @a connection must be a PostgreSQL connection.
+	explicit async_statement(boost::asio::io_context& ioc, squid::connection& connection, std::string_view query);
+
+	/// Destroying a statement while it executes cancels it, and waits until the server has stopped.
+	/// The statement is deallocated on the server, which blocks for one round trip if it was executed.
+	~async_statement() noexcept override;
+
+	async_statement(const async_statement&)            = delete;
+	async_statement(async_statement&& src)             = default;
+	async_statement& operator=(const async_statement&) = delete;
+	async_statement& operator=(async_statement&&)      = default;
+
+	///
+	/// binding methods, see basic_statement
+
+	using basic_statement::bind;
+	using basic_statement::bind_ref;
+	using basic_statement::bind_result;
+	using basic_statement::bind_results;
+
+	///
+	/// statement execution methods
+
+	/// Execute the statement, preparing it on the server the first time.
+	/// Completes when the first row has arrived, or when the statement has completed if it returns no rows.
+	/// Rows that were not fetched from a previous execution are discarded.
+	boost::asio::awaitable<void> async_execute();
+
+	/// Fetch the next row, waiting for it if it has not arrived yet.
+	/// Returns false when the last row was already fetched or when the statement did not return any rows.
+	/// Throws if the statement has not been executed.
+	boost::asio::awaitable<bool> async_fetch();
+
+	/// Get the number of fields in the result set.
+	/// Throws if the statement has not been executed.
+	std::size_t field_count();
+
+	/// Get the name of index'th field in the result set.
+	/// The first field has index 0.
+	/// Throws if the statement has not been executed.
+	std::string field_name(std::size_t index);
+
+	/// Get the number of affected rows by the statement.
+	/// For statements that return rows, this is known after the last row has been fetched.
+	/// Throws if the statement has not been executed.
+	std::uint64_t affected_rows();
+};
+
+} // namespace postgresql
+} // namespace squid
@@ -13,6 +13,8 @@
 
 #include <libpq-fe.h>
 
+#include <memory>
+
 namespace squid {
 namespace postgresql {
 
@@ -31,6 +33,35 @@ std::unique_ptr<ibackend_statement> backend_connection::create_prepared_statemen
 	statement::execute(*connection_checker::check(this->connection_), query);
 }
 
+bool backend_connection::is_broken() const noexcept
+{
+	return CONNECTION_OK != PQstatus(this->connection_.get());
+}
+
+bool backend_connection::ping()
+{
+	// An empty query is a round trip to the server without any work on its side.
+	// Unlike connection_checker, this does not try to reset a broken connection.
+	if (this->is_broken())
+	{
+		return false;
+	}
+	std::shared_ptr<PGresult> result{ PQexec(this->connection_.get(), ""), PQclear };
+	return result && PGRES_EMPTY_QUERY == PQresultStatus(result.get()) && !this->is_broken();
+}
+
+bool backend_connection::cancel()
+{
+	// PQcancel opens a separate connection to the server, so it does not interfere with the thread using this one
+	std::unique_ptr<PGcancel, decltype(&PQfreeCancel)> handle{ PQgetCancel(this->connection_.get()), PQfreeCancel };
+	if (!handle)
+	{
+		return false;
+	}
+	char message[256];
+	return PQcancel(handle.get(), message, sizeof(message)) == 1;
+}
+
 backend_connection::backend_connection(const std::string& connection_info)
     : connection_{ PQconnectdb(connection_info.c_str()), PQfinish }
 {
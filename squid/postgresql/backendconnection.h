@@ -21,6 +21,9 @@ class SQUID_EXPORT backend_connection final : public ibackend_connection
 	std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override;
 	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override;
 	void                                execute(const std::string& query) override;
+	bool                                is_broken() const noexcept override;
+	bool                                ping() override;
+	bool                                cancel() override;
 
 public:
 	/// @a connection_info must contain a valid PostgreSQL connection string
@@ -6,34 +6,11 @@
 //
 
 #include "squid/postgresql/detail/conversions.h"
+#include "squid/postgresql/detail/hexcodec.h"
 
 namespace squid {
 namespace postgresql {
 
-namespace {
-
-byte_string::value_type hex_char_to_nibble(char c)
-{
-	if (c >= '0' && c <= '9')
-	{
-		return c - '0';
-	}
-	else if (c >= 'a' && c <= 'f')
-	{
-		return 0xa + c - 'a';
-	}
-	else if (c >= 'A' && c <= 'F')
-	{
-		return 0xa + c - 'A';
-	}
-	else
-	{
-		throw std::runtime_error{ "illegal hex character" };
-	}
-}
-
-} // namespace
-
 void hex_string_to_binary(std::string_view in, byte_string& out)
 {
 	if (!in.starts_with("\\x"))
@@ -47,12 +24,10 @@ void hex_string_to_binary(std::string_view in, byte_string& out)
 	}
 
 	out.resize((in.length() - 2) / 2);
-	auto p = out.data();
 
-	for (auto it = in.begin() + 2, end = in.end(); it != end;)
+	if (!hex_decode(in.data() + 2, out.length(), out.data()))
 	{
-		*p = (hex_char_to_nibble(*it++) << 4);
-		*p++ |= hex_char_to_nibble(*it++);
+		throw std::runtime_error{ "illegal hex character" };
 	}
 }
 
@@ -65,17 +40,12 @@ byte_string hex_string_to_binary(std::string_view in)
 
 void binary_to_hex_string(const unsigned char* begin, const unsigned char* end, std::string& out)
 {
-	constexpr auto hex = "0123456789ABCDEF";
+	const auto size = static_cast<std::size_t>(std::distance(begin, end));
 
-	out.resize(2 + 2 * std::distance(begin, end));
-	auto p = out.data();
-	*p++   = '\\';
-	*p++   = 'x';
-	for (auto it = begin; it < end; ++it)
-	{
-		*p++ = hex[*it >> 4];
-		*p++ = hex[*it & 15];
-	}
+	out.resize(2 + 2 * size);
+	out[0] = '\\';
+	out[1] = 'x';
+	hex_encode(begin, size, out.data() + 2);
 }
 
 std::string binary_to_hex_string(const unsigned char* begin, const unsigned char* end)
@@ -8,17 +8,20 @@
 #pragma once
 
 #include "squid/postgresql/detail/libpqfwd.h"
+#include "squid/postgresql/detail/receivedrows.h"
 
 #include <memory>
+#include <optional>
 
 namespace squid {
 namespace postgresql {
 
 struct exec_result
 {
-	std::shared_ptr<PGresult> pgresult;
-	int                       rows;
-	int                       current_row;
+	std::shared_ptr<PGresult>    pgresult;    // result of the command, holds the rows unless they were received one by one
+	int                          rows;        // number of rows
+	int                          current_row; // index of the next row to fetch
+	std::optional<received_rows> received;    // rows received in single-row mode
 };
 
 } // namespace postgresql
@@ -0,0 +1,248 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/postgresql/detail/hexcodec.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+// The SIMD kernels rely on the target attribute and __builtin_cpu_supports of GCC and Clang.
+// Other compilers and architectures use the scalar kernel.
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define SQUID_HEX_X86_64 1
+#include <immintrin.h>
+#endif
+
+namespace squid {
+namespace postgresql {
+
+namespace {
+
+constexpr std::uint8_t invalid_nibble = 0xff;
+
+constexpr std::array<std::uint8_t, 256> make_nibble_table()
+{
+	std::array<std::uint8_t, 256> table{};
+	for (auto& nibble : table)
+	{
+		nibble = invalid_nibble;
+	}
+	for (int c = '0'; c <= '9'; ++c)
+	{
+		table[c] = static_cast<std::uint8_t>(c - '0');
+	}
+	for (int c = 'a'; c <= 'f'; ++c)
+	{
+		table[c] = static_cast<std::uint8_t>(0xa + c - 'a');
+	}
+	for (int c = 'A'; c <= 'F'; ++c)
+	{
+		table[c] = static_cast<std::uint8_t>(0xa + c - 'A');
+	}
+	return table;
+}
+
+constexpr auto nibble_table = make_nibble_table();
+constexpr auto hex_digits   = "0123456789ABCDEF";
+
+void scalar_encode(const unsigned char* in, std::size_t size, char* out)
+{
+	for (const auto end = in + size; in != end; ++in)
+	{
+		*out++ = hex_digits[*in >> 4];
+		*out++ = hex_digits[*in & 15];
+	}
+}
+
+bool scalar_decode(const char* in, std::size_t size, unsigned char* out)
+{
+	// Invalid characters are accumulated instead of tested per byte, to keep the loop free of branches.
+	std::uint8_t invalid{};
+	for (const auto end = out + size; out != end; ++out)
+	{
+		const auto hi = nibble_table[static_cast<unsigned char>(*in++)];
+		const auto lo = nibble_table[static_cast<unsigned char>(*in++)];
+		invalid |= (hi | lo) & 0xf0;
+		*out = static_cast<unsigned char>((hi << 4) | (lo & 0x0f));
+	}
+	return invalid == 0;
+}
+
+#ifdef SQUID_HEX_X86_64
+
+// Converts 16 nibbles to upper case hex characters: n + '0' + (n > 9 ? 'A' - '0' - 10 : 0)
+inline __m128i sse2_nibbles_to_hex(__m128i nibbles)
+{
+	const auto letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+	return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+// Converts 16 hex characters to nibbles. Sets the bits in @a invalid of lanes that do not hold a hex character.
+inline __m128i sse2_hex_to_nibbles(__m128i chars, __m128i& invalid)
+{
+	// Characters >= 0x80 are negative in the signed comparisons below, so they are rejected as well.
+	const auto lower    = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+	const auto is_digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+	const auto is_alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+	invalid             = _mm_or_si128(invalid, _mm_andnot_si128(_mm_or_si128(is_digit, is_alpha), _mm_set1_epi8(-1)));
+	return _mm_or_si128(_mm_and_si128(is_digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+	                    _mm_and_si128(is_alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+
+// Combines the pairs of nibbles in the 16-bit lanes of @a nibbles to a byte in the low half of each lane.
+// The first character of a pair is in the low byte of the lane, and is the high nibble.
+inline __m128i sse2_combine_nibbles(__m128i nibbles)
+{
+	return _mm_or_si128(_mm_and_si128(_mm_slli_epi16(nibbles, 4), _mm_set1_epi16(0x00f0)), _mm_srli_epi16(nibbles, 8));
+}
+
+void sse2_encode(const unsigned char* in, std::size_t size, char* out)
+{
+	const auto mask = _mm_set1_epi8(0x0f);
+	for (; size >= 16; size -= 16, in += 16, out += 32)
+	{
+		const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		const auto hi    = sse2_nibbles_to_hex(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+		const auto lo    = sse2_nibbles_to_hex(_mm_and_si128(bytes, mask));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	scalar_encode(in, size, out);
+}
+
+bool sse2_decode(const char* in, std::size_t size, unsigned char* out)
+{
+	auto invalid = _mm_setzero_si128();
+	for (; size >= 16; size -= 16, in += 32, out += 16)
+	{
+		const auto first  = sse2_hex_to_nibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), invalid);
+		const auto second = sse2_hex_to_nibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16)), invalid);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(sse2_combine_nibbles(first), sse2_combine_nibbles(second)));
+	}
+	return _mm_movemask_epi8(invalid) == 0 && scalar_decode(in, size, out);
+}
+
+__attribute__((target("avx2"))) inline __m256i avx2_nibbles_to_hex(__m256i nibbles)
+{
+	const auto letters = _mm256_and_si256(_mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9)), _mm256_set1_epi8('A' - '0' - 10));
+	return _mm256_add_epi8(_mm256_add_epi8(nibbles, _mm256_set1_epi8('0')), letters);
+}
+
+__attribute__((target("avx2"))) inline __m256i avx2_hex_to_nibbles(__m256i chars, __m256i& invalid)
+{
+	const auto lower    = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+	const auto is_digit =
+	    _mm256_andnot_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('9')), _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)));
+	const auto is_alpha =
+	    _mm256_andnot_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('f')), _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)));
+	invalid             = _mm256_or_si256(invalid, _mm256_xor_si256(_mm256_or_si256(is_digit, is_alpha), _mm256_set1_epi8(-1)));
+	return _mm256_or_si256(_mm256_and_si256(is_digit, _mm256_sub_epi8(chars, _mm256_set1_epi8('0'))),
+	                       _mm256_and_si256(is_alpha, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+}
+
+__attribute__((target("avx2"))) inline __m256i avx2_combine_nibbles(__m256i nibbles)
+{
+	return _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(nibbles, 4), _mm256_set1_epi16(0x00f0)), _mm256_srli_epi16(nibbles, 8));
+}
+
+__attribute__((target("avx2"))) void avx2_encode(const unsigned char* in, std::size_t size, char* out)
+{
+	const auto mask = _mm256_set1_epi8(0x0f);
+	for (; size >= 32; size -= 32, in += 32, out += 64)
+	{
+		const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+		const auto hi    = avx2_nibbles_to_hex(_mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask));
+		const auto lo    = avx2_nibbles_to_hex(_mm256_and_si256(bytes, mask));
+		// The unpack instructions work per 128-bit lane: low holds bytes 0-7 and 16-23, high holds bytes 8-15 and 24-31.
+		const auto low  = _mm256_unpacklo_epi8(hi, lo);
+		const auto high = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute2x128_si256(low, high, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_permute2x128_si256(low, high, 0x31));
+	}
+	sse2_encode(in, size, out);
+}
+
+__attribute__((target("avx2"))) bool avx2_decode(const char* in, std::size_t size, unsigned char* out)
+{
+	auto invalid = _mm256_setzero_si256();
+	for (; size >= 32; size -= 32, in += 64, out += 32)
+	{
+		const auto first  = avx2_hex_to_nibbles(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in)), invalid);
+		const auto second = avx2_hex_to_nibbles(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32)), invalid);
+		// The pack instruction works per 128-bit lane, so the 64-bit quarters of the result must be reordered.
+		const auto packed = _mm256_packus_epi16(avx2_combine_nibbles(first), avx2_combine_nibbles(second));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute4x64_epi64(packed, 0xd8));
+	}
+	return _mm256_movemask_epi8(invalid) == 0 && sse2_decode(in, size, out);
+}
+
+#endif
+
+} // namespace
+
+bool hex_kernel_supported(hex_kernel kernel)
+{
+	switch (kernel)
+	{
+	case hex_kernel::scalar:
+		return true;
+#ifdef SQUID_HEX_X86_64
+	case hex_kernel::sse2:
+		return true;
+	case hex_kernel::avx2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+hex_kernel best_hex_kernel()
+{
+	static const auto kernel = hex_kernel_supported(hex_kernel::avx2)   ? hex_kernel::avx2
+	                           : hex_kernel_supported(hex_kernel::sse2) ? hex_kernel::sse2
+	                                                                    : hex_kernel::scalar;
+	return kernel;
+}
+
+void hex_encode(const unsigned char* in, std::size_t size, char* out, hex_kernel kernel)
+{
+	assert(hex_kernel_supported(kernel));
+
+	switch (kernel)
+	{
+#ifdef SQUID_HEX_X86_64
+	case hex_kernel::avx2:
+		return avx2_encode(in, size, out);
+	case hex_kernel::sse2:
+		return sse2_encode(in, size, out);
+#endif
+	default:
+		return scalar_encode(in, size, out);
+	}
+}
+
+bool hex_decode(const char* in, std::size_t size, unsigned char* out, hex_kernel kernel)
+{
+	assert(hex_kernel_supported(kernel));
+
+	switch (kernel)
+	{
+#ifdef SQUID_HEX_X86_64
+	case hex_kernel::avx2:
+		return avx2_decode(in, size, out);
+	case hex_kernel::sse2:
+		return sse2_decode(in, size, out);
+#endif
+	default:
+		return scalar_decode(in, size, out);
+	}
+}
+
+} // namespace postgresql
+} // namespace squid
@@ -0,0 +1,38 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace squid {
+namespace postgresql {
+
+/// Implementations of the hex encoding and decoding kernels
+enum class hex_kernel
+{
+	scalar, /// table driven, portable
+	sse2,   /// 16 bytes per iteration, x86-64 only
+	avx2,   /// 32 bytes per iteration, x86-64 only
+};
+
+/// Returns whether the @a kernel can be used on this machine.
+bool hex_kernel_supported(hex_kernel kernel);
+
+/// Returns the fastest kernel that can be used on this machine.
+/// It is determined once, at the first call.
+hex_kernel best_hex_kernel();
+
+/// Encodes @a size bytes at @a in as 2 * @a size upper case hex characters at @a out.
+void hex_encode(const unsigned char* in, std::size_t size, char* out, hex_kernel kernel = best_hex_kernel());
+
+/// Decodes 2 * @a size hex characters at @a in to @a size bytes at @a out.
+/// Returns false if an illegal hex character was encountered. The contents of @a out are unspecified in that case.
+bool hex_decode(const char* in, std::size_t size, unsigned char* out, hex_kernel kernel = best_hex_kernel());
+
+} // namespace postgresql
+} // namespace squid
@@ -14,8 +14,7 @@
 #include "squid/detail/conversions.h"
 
 #include <cassert>
-#include <sstream>
-#include <iomanip>
+#include <charconv>
 #include <type_traits>
 
 namespace squid {
@@ -23,7 +22,49 @@ namespace postgresql {
 
 namespace {
 
-const char* get_parameter_value(const parameter& parameter, std::string& value)
+// Formats @a value into @a buffer and terminates it with a null character.
+template<typename T, std::size_t N>
+const char* format_into(std::array<char, N>& buffer, const T& value)
+{
+	char* end{};
+	if constexpr (std::is_arithmetic_v<T>)
+	{
+		end = number_to_chars(buffer.data(), buffer.data() + N - 1, value);
+	}
+	else
+	{
+		std::to_chars_result res{};
+		if constexpr (std::is_same_v<T, time_point>)
+		{
+			res = time_point_to_chars(buffer.data(), buffer.data() + N - 1, value);
+		}
+		else if constexpr (std::is_same_v<T, date>)
+		{
+			res = date_to_chars(buffer.data(), buffer.data() + N - 1, value);
+		}
+		else
+		{
+			static_assert(std::is_same_v<T, time_of_day>);
+			res = time_of_day_to_chars(buffer.data(), buffer.data() + N - 1, value);
+		}
+		assert(res.ec == std::errc{});
+		end = res.ptr;
+	}
+	*end = '\0';
+	return buffer.data();
+}
+
+// Parameter types that are formatted into the inline buffer of a parameter value
+template<typename T>
+constexpr bool is_formatted_v =
+    std::is_same_v<T, const signed char*> || std::is_same_v<T, const unsigned char*> || std::is_same_v<T, const std::int16_t*> ||
+    std::is_same_v<T, const std::uint16_t*> || std::is_same_v<T, const std::int32_t*> || std::is_same_v<T, const std::uint32_t*> ||
+    std::is_same_v<T, const std::int64_t*> || std::is_same_v<T, const std::uint64_t*> || std::is_same_v<T, const float*> ||
+    std::is_same_v<T, const double*> || std::is_same_v<T, const long double*> || std::is_same_v<T, const time_point*> ||
+    std::is_same_v<T, const date*> || std::is_same_v<T, const time_of_day*>;
+
+template<std::size_t N>
+const char* get_parameter_value(const parameter& parameter, std::array<char, N>& buffer, std::string& value)
 {
 	const auto pointer = parameter.pointer();
 
@@ -32,89 +73,70 @@ const char* get_parameter_value(const parameter& parameter, std::string& value)
 		return nullptr;
 	}
 
-	std::visit(
-	    [&value](auto&& arg) {
+	return std::visit(
+	    [&buffer, &value](auto&& arg) -> const char* {
 		    using T = std::decay_t<decltype(arg)>;
 		    if constexpr (std::is_same_v<T, const std::nullopt_t*>)
 		    {
 			    assert(false && "should not happen, this alternative was already tested");
+			    return nullptr;
 		    }
 		    else if constexpr (std::is_same_v<T, const bool*>)
 		    {
 			    assert(arg != nullptr);
-			    value = *arg ? "t" : "f";
+			    return *arg ? "t" : "f";
 		    }
 		    else if constexpr (std::is_same_v<T, const char*>)
 		    {
 			    assert(arg != nullptr);
-			    value = std::string{ arg, 1 };
+			    buffer[0] = *arg;
+			    buffer[1] = '\0';
+			    return buffer.data();
 		    }
-		    else if constexpr (std::is_same_v<T, const signed char*> || std::is_same_v<T, const unsigned char*> ||
-		                       std::is_same_v<T, const std::int16_t*> || std::is_same_v<T, const std::uint16_t*> ||
-		                       std::is_same_v<T, const std::int32_t*> || std::is_same_v<T, const std::uint32_t*> ||
-		                       std::is_same_v<T, const std::int64_t*> || std::is_same_v<T, const std::uint64_t*>)
+		    else if constexpr (is_formatted_v<T>)
 		    {
 			    assert(arg != nullptr);
-			    value = std::to_string(*arg);
-		    }
-		    else if constexpr (std::is_same_v<T, const float*> || std::is_same_v<T, const double*> || std::is_same_v<T, const long double*>)
-		    {
-			    assert(arg != nullptr);
-			    std::ostringstream ss;
-			    constexpr auto     precision = std::numeric_limits<std::remove_cvref_t<decltype(*arg)>>::digits10;
-			    ss << std::setprecision(precision) << *arg;
-			    value = ss.str();
+			    return format_into(buffer, *arg);
 		    }
 		    else if constexpr (std::is_same_v<T, const std::string*> || std::is_same_v<T, const std::string_view*>)
 		    {
 			    assert(arg != nullptr);
 			    value = *arg;
+			    return value.c_str();
 		    }
 		    else if constexpr (std::is_same_v<T, const byte_string*> || std::is_same_v<T, const byte_string_view*>)
 		    {
 			    assert(arg != nullptr);
 			    binary_to_hex_string(*arg, value);
-		    }
-		    else if constexpr (std::is_same_v<T, const time_point*>)
-		    {
-			    assert(arg != nullptr);
-			    time_point_to_string(*arg, value);
-		    }
-		    else if constexpr (std::is_same_v<T, const date*>)
-		    {
-			    assert(arg != nullptr);
-			    date_to_string(*arg, value);
-		    }
-		    else if constexpr (std::is_same_v<T, const time_of_day*>)
-		    {
-			    assert(arg != nullptr);
-			    time_of_day_to_string(*arg, value);
+			    return value.c_str();
 		    }
 #ifdef SQUID_HAVE_BOOST_DATE_TIME
 		    else if constexpr (std::is_same_v<T, const boost::posix_time::ptime*>)
 		    {
 			    assert(arg != nullptr);
 			    boost_ptime_to_string(*arg, value);
+			    return value.c_str();
 		    }
 		    else if constexpr (std::is_same_v<T, const boost::gregorian::date*>)
 		    {
 			    assert(arg != nullptr);
 			    boost_date_to_string(*arg, value);
+			    return value.c_str();
 		    }
 		    else if constexpr (std::is_same_v<T, const boost::posix_time::time_duration*>)
 		    {
 			    assert(arg != nullptr);
 			    boost_time_duration_to_string(*arg, value);
+			    return value.c_str();
 		    }
 #endif
 		    else
 		    {
 			    static_assert(always_false_v<T>, "non-exhaustive visitor!");
+			    return nullptr;
 		    }
 	    },
 	    pointer);
-
-	return value.c_str();
 }
 
 } // namespace
@@ -136,7 +158,8 @@ query_parameters::query_parameters(const postgresql_query& query, const std::map
 		assert(position >= 1 && position <= static_cast<decltype(position)>(this->parameter_values_.size()));
 		const auto index = position - 1;
 
-		this->parameter_value_pointers_.at(index) = get_parameter_value(parameter, this->parameter_values_.at(index));
+		auto& value                               = this->parameter_values_.at(index);
+		this->parameter_value_pointers_.at(index) = get_parameter_value(parameter, value.buffer, value.text);
 	}
 }
 
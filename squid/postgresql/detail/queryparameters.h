@@ -9,6 +9,7 @@
 
 #include "squid/parameter.h"
 
+#include <array>
 #include <string>
 #include <vector>
 #include <map>
@@ -20,8 +21,16 @@ class postgresql_query;
 
 class query_parameters final
 {
-	std::vector<std::string> parameter_values_;
-	std::vector<const char*> parameter_value_pointers_;
+	/// Text of one parameter value.
+	/// Numbers and date/time values are formatted into the inline buffer, strings and byte strings into text.
+	struct parameter_value
+	{
+		std::array<char, 64> buffer;
+		std::string          text;
+	};
+
+	std::vector<parameter_value> parameter_values_;
+	std::vector<const char*>     parameter_value_pointers_;
 
 public:
 	query_parameters(const postgresql_query& query, const std::map<std::string, parameter>& parameters);
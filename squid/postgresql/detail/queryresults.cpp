@@ -118,15 +118,14 @@ void store_result(const result::non_nullable_type& result, std::string_view colu
 	    result);
 }
 
-void store_result(const result& result, const PGresult& pgresult, int row_index, std::string_view column_name, int column_index)
+/// Store @a value of column @a column_name, std::nullopt if it is NULL, in @a result
+void store_result(const result& result, std::optional<std::string_view> value, std::string_view column_name)
 {
-	assert(row_index < PQntuples(&pgresult));
-	assert(column_index < PQnfields(&pgresult));
 	assert(column_name.data());
 
 	const auto& destination = result.value();
 
-	if (PQgetisnull(&pgresult, row_index, column_index))
+	if (!value)
 	{
 		std::visit(
 		    [&](auto&& arg) {
@@ -155,15 +154,12 @@ void store_result(const result& result, const PGresult& pgresult, int row_index,
 	}
 	else
 	{
-		const auto value = PQgetvalue(&pgresult, row_index, column_index);
-		assert(value);
-
 		std::visit(
 		    [&](auto&& arg) {
 			    using T = std::decay_t<decltype(arg)>;
 			    if constexpr (std::is_same_v<T, result::non_nullable_type>)
 			    {
-				    store_result(arg, column_name, value);
+				    store_result(arg, column_name, *value);
 			    }
 			    else if constexpr (std::is_same_v<T, result::nullable_type>)
 			    {
@@ -172,7 +168,7 @@ void store_result(const result& result, const PGresult& pgresult, int row_index,
 					        // arg is a (std::optional<X>*)
 					        using T = typename std::decay_t<decltype(*arg)>::value_type;
 					        T tmp{};
-					        store_result(result::non_nullable_type{ &tmp }, column_name, value);
+					        store_result(result::non_nullable_type{ &tmp }, column_name, *value);
 					        *arg = tmp;
 				        },
 				        arg);
@@ -186,6 +182,24 @@ void store_result(const result& result, const PGresult& pgresult, int row_index,
 	}
 }
 
+void store_result(const result& result, const PGresult& pgresult, int row_index, std::string_view column_name, int column_index)
+{
+	assert(row_index < PQntuples(&pgresult));
+	assert(column_index < PQnfields(&pgresult));
+
+	if (PQgetisnull(&pgresult, row_index, column_index))
+	{
+		store_result(result, std::nullopt, column_name);
+	}
+	else
+	{
+		const auto value = PQgetvalue(&pgresult, row_index, column_index);
+		assert(value);
+		const auto length = static_cast<std::size_t>(PQgetlength(&pgresult, row_index, column_index));
+		store_result(result, std::string_view{ value, length }, column_name);
+	}
+}
+
 } // namespace
 
 struct query_results::column
@@ -300,10 +314,23 @@ std::string query_results::field_name(std::size_t index) const
 }
 
 void query_results::fetch(int row_index)
+{
+	this->fetch(*this->pgresult_, row_index);
+}
+
+void query_results::fetch(const PGresult& pgresult, int row_index)
+{
+	for (const auto& column : this->columns_)
+	{
+		store_result(column->res, pgresult, row_index, column->name, column->index);
+	}
+}
+
+void query_results::fetch(const received_rows& rows, int row_index)
 {
 	for (const auto& column : this->columns_)
 	{
-		store_result(column->res, *this->pgresult_, row_index, column->name, column->index);
+		store_result(column->res, rows.value(row_index, column->index), column->name);
 	}
 }
 
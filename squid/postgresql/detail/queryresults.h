@@ -9,6 +9,7 @@
 
 #include "squid/result.h"
 #include "squid/postgresql/detail/libpqfwd.h"
+#include "squid/postgresql/detail/receivedrows.h"
 
 #include <vector>
 #include <map>
@@ -37,6 +38,12 @@ public:
 	std::string field_name(std::size_t index) const;
 
 	void fetch(int row_index);
+
+	/// Fetch row @a row_index of @a pgresult, which must have the same columns as the result of the constructor
+	void fetch(const PGresult& pgresult, int row_index);
+
+	/// Fetch row @a row_index of @a rows, which must have the same columns as the result of the constructor
+	void fetch(const received_rows& rows, int row_index);
 };
 
 } // namespace postgresql
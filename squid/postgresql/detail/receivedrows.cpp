@@ -0,0 +1,80 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/postgresql/detail/receivedrows.h"
+
+#include <cassert>
+
+#include <libpq-fe.h>
+
+namespace squid {
+namespace postgresql {
+
+received_rows::received_rows() noexcept
+    : fields_{}
+    , rows_{}
+    , values_{}
+    , ends_{}
+    , nulls_{}
+{
+}
+
+void received_rows::append(const PGresult& pgresult)
+{
+	const auto rows   = PQntuples(&pgresult);
+	const auto fields = PQnfields(&pgresult);
+	assert(this->rows_ == 0 || fields == this->fields_);
+	this->fields_ = fields;
+
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int field = 0; field < fields; ++field)
+		{
+			const auto is_null = PQgetisnull(&pgresult, row, field) != 0;
+			if (!is_null)
+			{
+				const auto value = PQgetvalue(&pgresult, row, field);
+				this->values_.insert(this->values_.end(), value, value + PQgetlength(&pgresult, row, field));
+			}
+			this->ends_.push_back(this->values_.size());
+			this->nulls_.push_back(is_null);
+		}
+		++this->rows_;
+	}
+}
+
+int received_rows::rows() const noexcept
+{
+	return this->rows_;
+}
+
+std::optional<std::string_view> received_rows::value(int row, int field) const
+{
+	assert(row < this->rows_);
+	assert(field < this->fields_);
+
+	const auto index = static_cast<std::size_t>(row) * static_cast<std::size_t>(this->fields_) + static_cast<std::size_t>(field);
+	if (this->nulls_[index])
+	{
+		return std::nullopt;
+	}
+	const auto begin = index == 0 ? 0 : this->ends_[index - 1];
+	return std::string_view{ this->values_.data() + begin, this->ends_[index] - begin };
+}
+
+std::uint64_t received_rows::value_bytes() const noexcept
+{
+	return this->values_.size();
+}
+
+std::uint64_t received_rows::memory_size() const noexcept
+{
+	return this->values_.size() + this->ends_.size() * sizeof(std::size_t) + (this->nulls_.size() + 7) / 8;
+}
+
+} // namespace postgresql
+} // namespace squid
@@ -0,0 +1,52 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/postgresql/detail/libpqfwd.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace squid {
+namespace postgresql {
+
+/// The values of the rows of a result that was received in single-row mode.
+/// The values are copied out of the PGresult of each row, so that it can be cleared right away instead of being kept
+/// with the overhead of a PGresult per row.
+class received_rows final
+{
+	int                      fields_; // number of fields of every row
+	int                      rows_;   // number of rows
+	std::vector<char>        values_; // the values of all rows, one after the other
+	std::vector<std::size_t> ends_;   // end offset in values_ of the value of (row * fields_ + field)
+	std::vector<bool>        nulls_;  // whether the value of (row * fields_ + field) is NULL
+
+public:
+	received_rows() noexcept;
+
+	/// Append the rows of @a pgresult, which must have the same fields as the rows appended before
+	void append(const PGresult& pgresult);
+
+	/// Number of rows
+	int rows() const noexcept;
+
+	/// Value of @a field of row @a row, std::nullopt if it is NULL
+	std::optional<std::string_view> value(int row, int field) const;
+
+	/// Number of bytes of the values
+	std::uint64_t value_bytes() const noexcept;
+
+	/// Number of bytes kept for the values, excluding unused capacity
+	std::uint64_t memory_size() const noexcept;
+};
+
+} // namespace postgresql
+} // namespace squid
@@ -15,6 +15,8 @@
 #include "squid/postgresql/detail/execresult.h"
 
 #include "squid/detail/conversions.h"
+#include "squid/detail/phasetimer.h"
+#include "squid/detail/probes.h"
 
 #include <optional>
 #include <atomic>
@@ -37,6 +39,17 @@ std::string next_statement_name()
 	return std::string{ "s_" } + std::to_string(++statement_number);
 }
 
+/// Request the server to cancel the query that is being executed on @a connection
+void cancel(PGconn& connection) noexcept
+{
+	std::unique_ptr<PGcancel, decltype(&PQfreeCancel)> handle{ PQgetCancel(&connection), PQfreeCancel };
+	if (handle)
+	{
+		char message[256];
+		PQcancel(handle.get(), message, sizeof(message));
+	}
+}
+
 } // namespace
 
 class statement::impl
@@ -48,6 +61,111 @@ class statement::impl
 	std::optional<std::string>        stmt_name_;
 	std::optional<exec_result>        exec_result_;
 	std::unique_ptr<query_results>    query_results_;
+	statement_observer*               observer_;
+	phase_accumulator                 decode_;
+
+	/// Number of bytes of the values in @a pgresult
+	static std::uint64_t value_bytes(const PGresult& pgresult)
+	{
+		std::uint64_t bytes{};
+		const auto    rows   = PQntuples(&pgresult);
+		const auto    fields = PQnfields(&pgresult);
+		for (int row = 0; row < rows; ++row)
+		{
+			for (int field = 0; field < fields; ++field)
+			{
+				bytes += static_cast<std::uint64_t>(PQgetlength(&pgresult, row, field));
+			}
+		}
+		return bytes;
+	}
+
+	/// Store the values of the next row of @a exec_result in the bound results
+	void fetch_row(exec_result& exec_result)
+	{
+		const auto row = exec_result.current_row++;
+		if (exec_result.received)
+		{
+			this->query_results_->fetch(*exec_result.received, row);
+		}
+		else
+		{
+			this->query_results_->fetch(row);
+		}
+	}
+
+	/// Number of bytes of the values of the rows of the current execution
+	std::uint64_t received_bytes() const
+	{
+		if (this->exec_result_->received)
+		{
+			return this->exec_result_->received->value_bytes();
+		}
+		return value_bytes(*this->exec_result_->pgresult);
+	}
+
+	/// Receives the result of the query that was sent by @a function in single-row mode, accounting every row as it
+	/// arrives, so that a result that exceeds a limit is abandoned before the rest of it is buffered.
+	/// The values of each row are copied and its PGresult is cleared right away, only the copies are accounted.
+	template<typename ResultsContainer>
+	void receive_rows(bool sent, const char* function, const ResultsContainer& results, result_account& account)
+	{
+		auto& connection = *this->connection_;
+		if (!sent)
+		{
+			throw error{ std::string{ function } + " failed", connection };
+		}
+		PQsetSingleRowMode(&connection);
+
+		received_rows             rows{};
+		std::uint64_t             accounted{};
+		std::shared_ptr<PGresult> last{};
+		std::exception_ptr        failure{};
+		// Read up to the end of the results, also after a failure, to leave the connection usable
+		while (auto pgresult = std::shared_ptr<PGresult>{ PQgetResult(&connection), PQclear })
+		{
+			if (failure)
+			{
+				continue;
+			}
+			if (PGRES_SINGLE_TUPLE != PQresultStatus(pgresult.get()))
+			{
+				last = std::move(pgresult);
+				continue;
+			}
+			try
+			{
+				rows.append(*pgresult);
+				pgresult.reset();
+				const auto size = rows.memory_size();
+				account.add(size - accounted);
+				accounted = size;
+			}
+			catch (...)
+			{
+				failure = std::current_exception();
+				rows    = received_rows{};
+				account.release();
+				cancel(connection);
+			}
+		}
+		if (failure)
+		{
+			std::rethrow_exception(failure);
+		}
+
+		try
+		{
+			this->set_exec_result(std::move(last), function, results);
+		}
+		catch (...)
+		{
+			account.release();
+			throw;
+		}
+		this->exec_result_->rows     = rows.rows();
+		this->exec_result_->received = std::move(rows);
+	}
 
 public:
 	explicit impl(std::shared_ptr<PGconn> connection, std::string_view query, bool reuse_statement)
@@ -58,6 +176,8 @@ public:
 	    , stmt_name_{}
 	    , exec_result_{}
 	    , query_results_{}
+	    , observer_{}
+	    , decode_{}
 	{
 		assert(this->connection_);
 	}
@@ -88,11 +208,12 @@ public:
 			const auto status = PQresultStatus(pgresult.get());
 			if (PGRES_TUPLES_OK == status)
 			{
-				this->exec_result_ = exec_result{ .pgresult = pgresult, .rows = PQntuples(pgresult.get()), .current_row = 0 };
+				this->exec_result_ =
+				    exec_result{ .pgresult = pgresult, .rows = PQntuples(pgresult.get()), .current_row = 0, .received = std::nullopt };
 			}
 			else if (PGRES_COMMAND_OK == status)
 			{
-				this->exec_result_ = exec_result{ .pgresult = pgresult, .rows = 0, .current_row = 0 };
+				this->exec_result_ = exec_result{ .pgresult = pgresult, .rows = 0, .current_row = 0, .received = std::nullopt };
 			}
 			else
 			{
@@ -107,62 +228,116 @@ public:
 		}
 	}
 
+	/// Prepares the statement on the server if it is reused and not prepared yet, returns whether it did
+	bool prepare()
+	{
+		if (!this->reuse_statement_ || this->prepared_)
+		{
+			return false;
+		}
+
+		if (!this->stmt_name_)
+		{
+			this->stmt_name_ = next_statement_name();
+		}
+
+#ifdef SQUID_DEBUG_POSTGRESQL
+		std::cout << "preparing: " << this->query_->query() << "\n";
+#endif
+
+		const auto                start = probe_start(SQUID_PROBE_ENABLED(backend__prepare));
+		std::shared_ptr<PGresult> pgresult{ PQprepare(connection_checker::check(this->connection_),
+			                                          this->stmt_name_->c_str(),
+			                                          this->query_->query().c_str(),
+			                                          this->query_->parameter_count(),
+			                                          nullptr),
+			                                PQclear };
+		if (pgresult)
+		{
+			auto status = PQresultStatus(pgresult.get());
+			if (PGRES_COMMAND_OK != status)
+			{
+				throw error{ "PQprepare failed", *this->connection_, *pgresult };
+			}
+			this->prepared_ = true;
+			SQUID_PROBE(backend__prepare, "postgresql", this->query_->query().c_str(), probe_nanoseconds(start));
+		}
+		else
+		{
+			throw error{ "PQprepare failed", *this->connection_ };
+		}
+		return true;
+	}
+
 	template<typename ResultsContainer>
-	void execute(const std::map<std::string, parameter>& parameters, const ResultsContainer& results)
+	void execute(const std::map<std::string, parameter>& parameters,
+	             const ResultsContainer&                 results,
+	             statement_observer*                     observer,
+	             result_account&                         account)
 	{
+		this->decode_.report(this->observer_, statement_phase::decode, this->query_->query());
+		this->observer_ = observer;
+
 		this->exec_result_ = std::nullopt;
 		this->query_results_.reset();
+		account.release();
+
+		phase_timer timer{ observer, this->query_->query(), &parameters };
 
 		query_parameters query_params{ *this->query_, parameters };
+		timer.lap(statement_phase::bind);
 
 		assert(query_params.parameter_count() == this->query_->parameter_count());
 
 		if (this->reuse_statement_)
 		{
-			if (!this->prepared_)
+			if (this->prepare())
 			{
-				if (!this->stmt_name_)
-				{
-					this->stmt_name_ = next_statement_name();
-				}
-
-#ifdef SQUID_DEBUG_POSTGRESQL
-				std::cout << "preparing: " << this->query_->query() << "\n";
-#endif
-
-				std::shared_ptr<PGresult> pgresult{ PQprepare(connection_checker::check(this->connection_),
-					                                          this->stmt_name_->c_str(),
-					                                          this->query_->query().c_str(),
-					                                          this->query_->parameter_count(),
-					                                          nullptr),
-					                                PQclear };
-				if (pgresult)
-				{
-					auto status = PQresultStatus(pgresult.get());
-					if (PGRES_COMMAND_OK != status)
-					{
-						throw error{ "PQprepare failed", *this->connection_, *pgresult };
-					}
-					this->prepared_ = true;
-				}
-				else
-				{
-					throw error{ "PQprepare failed", *this->connection_ };
-				}
+				timer.lap(statement_phase::prepare);
 			}
 
 			assert(this->stmt_name_);
 
-			this->set_exec_result(std::shared_ptr<PGresult>{ PQexecPrepared(connection_checker::check(this->connection_),
-			                                                                this->stmt_name_->c_str(),
-			                                                                query_params.parameter_count(),
-			                                                                query_params.parameter_values(),
-			                                                                nullptr,
-			                                                                nullptr,
-			                                                                0),
-			                                                 PQclear },
-			                      "PQexecPrepared",
-			                      results);
+			if (account.limited())
+			{
+				this->receive_rows(PQsendQueryPrepared(connection_checker::check(this->connection_),
+				                                       this->stmt_name_->c_str(),
+				                                       query_params.parameter_count(),
+				                                       query_params.parameter_values(),
+				                                       nullptr,
+				                                       nullptr,
+				                                       0),
+				                   "PQsendQueryPrepared",
+				                   results,
+				                   account);
+			}
+			else
+			{
+				this->set_exec_result(std::shared_ptr<PGresult>{ PQexecPrepared(connection_checker::check(this->connection_),
+				                                                                this->stmt_name_->c_str(),
+				                                                                query_params.parameter_count(),
+				                                                                query_params.parameter_values(),
+				                                                                nullptr,
+				                                                                nullptr,
+				                                                                0),
+				                                                 PQclear },
+				                      "PQexecPrepared",
+				                      results);
+			}
+		}
+		else if (account.limited())
+		{
+			this->receive_rows(PQsendQueryParams(connection_checker::check(this->connection_),
+			                                     this->query_->query().c_str(),
+			                                     query_params.parameter_count(),
+			                                     nullptr,
+			                                     query_params.parameter_values(),
+			                                     nullptr,
+			                                     nullptr,
+			                                     0),
+			                   "PQsendQueryParams",
+			                   results,
+			                   account);
 		}
 		else
 		{
@@ -178,6 +353,17 @@ public:
 			                      "PQexecParams",
 			                      results);
 		}
+
+		if (!account.limited())
+		{
+			// Nothing to check, the complete result is there already
+			account.add(PQresultMemorySize(this->exec_result_->pgresult.get()));
+		}
+
+		if (timer)
+		{
+			timer.lap(statement_phase::execute, static_cast<std::uint64_t>(this->exec_result_->rows), this->received_bytes());
+		}
 	}
 
 	bool fetch()
@@ -191,10 +377,20 @@ public:
 
 		if (exec_result.current_row == exec_result.rows)
 		{
+			this->decode_.report(this->observer_, statement_phase::decode, this->query_->query());
 			return false;
 		}
 
-		this->query_results_->fetch(exec_result.current_row++);
+		if (this->observer_)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			this->fetch_row(exec_result);
+			this->decode_.add(start);
+		}
+		else
+		{
+			this->fetch_row(exec_result);
+		}
 
 		return true;
 	}
@@ -239,6 +435,11 @@ public:
 			throw error{ "Cannot get the number of affected rows from a statement that has not been executed" };
 		}
 	}
+
+	std::string_view query() const noexcept
+	{
+		return this->query_->query();
+	}
 };
 
 statement::statement(std::shared_ptr<PGconn> connection, std::string_view query, bool reuse_statement)
@@ -251,14 +452,19 @@ statement::~statement() noexcept
 {
 }
 
+void statement::prepare()
+{
+	this->pimpl_->prepare();
+}
+
 void statement::execute(const std::map<std::string, parameter>& parameters, const std::vector<result>& results)
 {
-	this->pimpl_->execute(parameters, results);
+	this->pimpl_->execute(parameters, results, this->observer(), this->results_account());
 }
 
 void statement::execute(const std::map<std::string, parameter>& parameters, const std::map<std::string, result>& results)
 {
-	this->pimpl_->execute(parameters, results);
+	this->pimpl_->execute(parameters, results, this->observer(), this->results_account());
 }
 
 bool statement::fetch()
@@ -281,6 +487,11 @@ std::uint64_t statement::affected_rows()
 	return this->pimpl_->affected_rows();
 }
 
+std::string_view statement::query() const noexcept
+{
+	return this->pimpl_->query();
+}
+
 /*static*/ void statement::execute(PGconn& connection, const std::string& query)
 {
 	std::shared_ptr<PGresult> result{ PQexec(&connection, query.c_str()), PQclear };
@@ -0,0 +1,98 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Throughput of the bytea hex encoding and decoding kernels, in GB/s of binary data.
+
+#include <squid/postgresql/detail/hexcodec.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace squid {
+namespace postgresql {
+
+namespace {
+
+constexpr std::size_t size        = 16 * 1024 * 1024;
+constexpr int         repetitions = 10;
+
+const char* kernel_name(hex_kernel kernel)
+{
+	switch (kernel)
+	{
+	case hex_kernel::scalar:
+		return "scalar";
+	case hex_kernel::sse2:
+		return "sse2";
+	case hex_kernel::avx2:
+		return "avx2";
+	}
+	return "?";
+}
+
+template<typename F>
+double gigabytes_per_second(F&& f)
+{
+	auto best = std::chrono::duration<double>::max();
+	for (int n = 0; n < repetitions; ++n)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		best = std::min(best, std::chrono::duration<double>{ std::chrono::steady_clock::now() - start });
+	}
+	return static_cast<double>(size) / best.count() / 1e9;
+}
+
+} // namespace
+
+} // namespace postgresql
+} // namespace squid
+
+int main()
+{
+	using namespace squid::postgresql;
+
+	std::vector<unsigned char> bytes(size);
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		bytes[i] = static_cast<unsigned char>(i * 2654435761u >> 13);
+	}
+
+	std::string                text(2 * size, '\0');
+	std::vector<unsigned char> decoded(size);
+
+	std::cout << "binary size: " << size / (1024 * 1024) << " MiB\n";
+	for (auto kernel : { hex_kernel::scalar, hex_kernel::sse2, hex_kernel::avx2 })
+	{
+		if (!hex_kernel_supported(kernel))
+		{
+			std::cout << kernel_name(kernel) << ": not supported\n";
+			continue;
+		}
+
+		const auto encode = gigabytes_per_second([&] { hex_encode(bytes.data(), size, text.data(), kernel); });
+		const auto decode = gigabytes_per_second([&] {
+			if (!hex_decode(text.data(), size, decoded.data(), kernel))
+			{
+				std::cerr << "decoding failed\n";
+				std::exit(EXIT_FAILURE);
+			}
+		});
+
+		if (decoded != bytes)
+		{
+			std::cerr << kernel_name(kernel) << ": round trip mismatch\n";
+			return EXIT_FAILURE;
+		}
+
+		std::cout << kernel_name(kernel) << ": encode " << encode << " GB/s, decode " << decode << " GB/s\n";
+	}
+}
@@ -0,0 +1,592 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/postgresql/test/support/fakeserver.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace squid {
+namespace postgresql {
+
+namespace {
+
+constexpr std::int32_t protocol_version = 196608; // 3.0
+constexpr std::int32_t cancel_code      = 80877102;
+constexpr std::int32_t ssl_code         = 80877103;
+constexpr std::int32_t gssenc_code      = 80877104;
+constexpr std::int32_t text_oid         = 25;
+
+/// Longest time that a query waits for a cancel request, so that a test that fails does not hang
+constexpr auto cancel_timeout = std::chrono::seconds{ 10 };
+
+bool read_exact(int socket, char* data, std::size_t size)
+{
+	while (size > 0)
+	{
+		const auto received = ::recv(socket, data, size, 0);
+		if (received <= 0)
+		{
+			return false;
+		}
+		data += received;
+		size -= static_cast<std::size_t>(received);
+	}
+	return true;
+}
+
+bool write_all(int socket, std::string_view data)
+{
+	while (!data.empty())
+	{
+		const auto sent = ::send(socket, data.data(), data.size(), MSG_NOSIGNAL);
+		if (sent <= 0)
+		{
+			return false;
+		}
+		data.remove_prefix(static_cast<std::size_t>(sent));
+	}
+	return true;
+}
+
+/// Reads the fields of the body of a frontend message
+class message_reader
+{
+	std::string_view body_;
+
+public:
+	explicit message_reader(std::string_view body)
+	    : body_{ body }
+	{
+	}
+
+	std::string_view bytes(std::size_t size)
+	{
+		if (size > this->body_.size())
+		{
+			throw std::runtime_error{ "message too short" };
+		}
+		const auto bytes = this->body_.substr(0, size);
+		this->body_.remove_prefix(size);
+		return bytes;
+	}
+
+	std::int32_t int32()
+	{
+		std::uint32_t value{};
+		std::memcpy(&value, this->bytes(sizeof(value)).data(), sizeof(value));
+		return static_cast<std::int32_t>(ntohl(value));
+	}
+
+	std::int16_t int16()
+	{
+		std::uint16_t value{};
+		std::memcpy(&value, this->bytes(sizeof(value)).data(), sizeof(value));
+		return static_cast<std::int16_t>(ntohs(value));
+	}
+
+	std::string string()
+	{
+		const auto end = this->body_.find('\0');
+		if (end == std::string_view::npos)
+		{
+			throw std::runtime_error{ "string not terminated" };
+		}
+		std::string value{ this->body_.substr(0, end) };
+		this->body_.remove_prefix(end + 1);
+		return value;
+	}
+};
+
+/// Builds a backend message
+class message_writer
+{
+	char        type_;
+	std::string body_;
+
+public:
+	explicit message_writer(char type)
+	    : type_{ type }
+	    , body_{}
+	{
+	}
+
+	message_writer& int32(std::int32_t value)
+	{
+		const auto network = htonl(static_cast<std::uint32_t>(value));
+		this->body_.append(reinterpret_cast<const char*>(&network), sizeof(network));
+		return *this;
+	}
+
+	message_writer& int16(std::int16_t value)
+	{
+		const auto network = htons(static_cast<std::uint16_t>(value));
+		this->body_.append(reinterpret_cast<const char*>(&network), sizeof(network));
+		return *this;
+	}
+
+	message_writer& bytes(std::string_view value)
+	{
+		this->body_.append(value);
+		return *this;
+	}
+
+	message_writer& string(std::string_view value)
+	{
+		this->body_.append(value);
+		this->body_.push_back('\0');
+		return *this;
+	}
+
+	/// Sends the message on @a socket
+	bool send(int socket) const
+	{
+		std::string message{};
+		message.push_back(this->type_);
+		const auto length = htonl(static_cast<std::uint32_t>(this->body_.size() + 4));
+		message.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		message.append(this->body_);
+		return write_all(socket, message);
+	}
+};
+
+bool send_row_description(int socket, const fake_result& result)
+{
+	if (result.columns.empty())
+	{
+		return message_writer{ 'n' }.send(socket);
+	}
+	message_writer message{ 'T' };
+	message.int16(static_cast<std::int16_t>(result.columns.size()));
+	for (const auto& column : result.columns)
+	{
+		message.string(column).int32(0).int16(0).int32(text_oid).int16(-1).int32(-1).int16(0);
+	}
+	return message.send(socket);
+}
+
+bool send_error(int socket, std::string_view code, std::string_view text)
+{
+	message_writer message{ 'E' };
+	message.bytes("S").string("ERROR").bytes("V").string("ERROR").bytes("C").string(code).bytes("M").string(text);
+	// The fields end with an empty one
+	return message.string("").send(socket);
+}
+
+bool send_ready(int socket)
+{
+	return message_writer{ 'Z' }.bytes("I").send(socket);
+}
+
+} // namespace
+
+struct fake_server::session
+{
+	int  socket;
+	int  process_id;
+	int  secret_key;
+	bool waiting;   // whether a query waits for a cancel request, guarded by the mutex of the server
+	bool cancelled; // whether that query was cancelled, idem
+};
+
+fake_server::fake_server(handler_type handler)
+    : handler_{ std::move(handler) }
+    , listener_{ ::socket(AF_INET, SOCK_STREAM, 0) }
+    , port_{}
+    , mutex_{}
+    , cancelled_{}
+    , sessions_{}
+    , queries_{}
+    , cancel_requests_{}
+    , next_process_id_{ 1000 }
+    , stopping_{}
+    , threads_{}
+    , acceptor_{}
+{
+	if (this->listener_ < 0)
+	{
+		throw std::system_error{ errno, std::generic_category(), "socket" };
+	}
+
+	sockaddr_in address{};
+	address.sin_family      = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port        = 0;
+	socklen_t length        = sizeof(address);
+	if (::bind(this->listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(this->listener_, 16) != 0 ||
+	    ::getsockname(this->listener_, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+	{
+		const auto error = errno;
+		::close(this->listener_);
+		throw std::system_error{ error, std::generic_category(), "bind" };
+	}
+	this->port_ = ntohs(address.sin_port);
+
+	this->acceptor_ = std::thread{ [this] { this->accept(); } };
+}
+
+fake_server::~fake_server() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		this->stopping_ = true;
+		for (const auto& [process_id, session] : this->sessions_)
+		{
+			::shutdown(session->socket, SHUT_RDWR);
+		}
+	}
+	this->cancelled_.notify_all();
+	// Unblocks accept()
+	::shutdown(this->listener_, SHUT_RDWR);
+	this->acceptor_.join();
+	::close(this->listener_);
+
+	for (auto& thread : this->threads_)
+	{
+		thread.join();
+	}
+}
+
+std::string fake_server::connection_info() const
+{
+	std::string info{ "host=127.0.0.1 user=test dbname=test sslmode=disable gssencmode=disable port=" };
+	info += std::to_string(this->port_);
+	return info;
+}
+
+std::vector<std::string> fake_server::queries() const
+{
+	std::lock_guard<std::mutex> lock{ this->mutex_ };
+	return this->queries_;
+}
+
+std::size_t fake_server::cancel_requests() const
+{
+	std::lock_guard<std::mutex> lock{ this->mutex_ };
+	return this->cancel_requests_;
+}
+
+void fake_server::accept()
+{
+	for (;;)
+	{
+		const auto socket = ::accept(this->listener_, nullptr, nullptr);
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		if (socket < 0 || this->stopping_)
+		{
+			if (socket >= 0)
+			{
+				::close(socket);
+			}
+			return;
+		}
+		// Messages are sent one by one, which must not wait for the acknowledgement of the previous one
+		const int no_delay = 1;
+		::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+		this->threads_.emplace_back([this, socket] {
+			this->serve(socket);
+			::close(socket);
+		});
+	}
+}
+
+void fake_server::serve(int socket)
+{
+	try
+	{
+		for (;;)
+		{
+			char length[4];
+			if (!read_exact(socket, length, sizeof(length)))
+			{
+				return;
+			}
+			std::string body(static_cast<std::size_t>(message_reader{ std::string_view{ length, sizeof(length) } }.int32() - 4), '\0');
+			if (!read_exact(socket, body.data(), body.size()))
+			{
+				return;
+			}
+
+			message_reader reader{ body };
+			const auto     code = reader.int32();
+			if (code == ssl_code || code == gssenc_code)
+			{
+				// Neither SSL nor GSSAPI encryption is supported
+				if (!write_all(socket, "N"))
+				{
+					return;
+				}
+			}
+			else if (code == cancel_code)
+			{
+				const auto process_id = reader.int32();
+				const auto secret_key = reader.int32();
+				this->cancel(process_id, secret_key);
+				return;
+			}
+			else if (code == protocol_version)
+			{
+				break;
+			}
+			else
+			{
+				return;
+			}
+		}
+
+		auto session = std::make_shared<fake_server::session>();
+		{
+			std::lock_guard<std::mutex> lock{ this->mutex_ };
+			if (this->stopping_)
+			{
+				return;
+			}
+			session->socket     = socket;
+			session->process_id = this->next_process_id_++;
+			session->secret_key = session->process_id * 7919;
+			session->waiting    = false;
+			session->cancelled  = false;
+			this->sessions_.emplace(session->process_id, session);
+		}
+
+		if (message_writer{ 'R' }.int32(0).send(socket) &&
+		    message_writer{ 'S' }.string("server_version").string("15.0").send(socket) &&
+		    message_writer{ 'S' }.string("server_encoding").string("UTF8").send(socket) &&
+		    message_writer{ 'S' }.string("client_encoding").string("UTF8").send(socket) &&
+		    message_writer{ 'S' }.string("DateStyle").string("ISO, MDY").send(socket) &&
+		    message_writer{ 'S' }.string("integer_datetimes").string("on").send(socket) &&
+		    message_writer{ 'S' }.string("standard_conforming_strings").string("on").send(socket) &&
+		    message_writer{ 'K' }.int32(session->process_id).int32(session->secret_key).send(socket) && send_ready(socket))
+		{
+			this->run_session(*session);
+		}
+
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		this->sessions_.erase(session->process_id);
+	}
+	catch (const std::exception&)
+	{
+		// A malformed message ends the session
+	}
+}
+
+void fake_server::run_session(session& session)
+{
+	const auto socket = session.socket;
+
+	std::map<std::string, std::string> statements{}; // queries of the prepared statements, by name
+	std::optional<fake_result>         portal{};     // answer to the query of the unnamed portal
+	bool                               failed{};     // skip messages until Sync after an error
+
+	/// Sends the rows of @a result, or an error if it is cancelled, and returns whether the session can go on
+	const auto send_rows = [&](const fake_result& result) {
+		if (result.until_cancelled)
+		{
+			if (!this->wait_for_cancel(session))
+			{
+				return false;
+			}
+			failed = true;
+			return send_error(socket, "57014", "canceling statement due to user request");
+		}
+		for (const auto& row : result.rows)
+		{
+			std::this_thread::sleep_for(result.row_interval);
+			message_writer message{ 'D' };
+			message.int16(static_cast<std::int16_t>(row.size()));
+			for (const auto& value : row)
+			{
+				if (value)
+				{
+					message.int32(static_cast<std::int32_t>(value->size())).bytes(*value);
+				}
+				else
+				{
+					message.int32(-1);
+				}
+			}
+			if (!message.send(socket))
+			{
+				return false;
+			}
+		}
+		return message_writer{ 'C' }.string(result.command_tag).send(socket);
+	};
+
+	for (;;)
+	{
+		char header[5];
+		if (!read_exact(socket, header, sizeof(header)))
+		{
+			return;
+		}
+		const auto  type = header[0];
+		std::string body(static_cast<std::size_t>(message_reader{ std::string_view{ header + 1, 4 } }.int32() - 4), '\0');
+		if (!read_exact(socket, body.data(), body.size()))
+		{
+			return;
+		}
+		message_reader reader{ body };
+
+		if (type == 'X')
+		{
+			return;
+		}
+		if (type == 'S')
+		{
+			failed = false;
+			if (!send_ready(socket))
+			{
+				return;
+			}
+			continue;
+		}
+		if (failed || type == 'H')
+		{
+			continue;
+		}
+
+		bool ok{};
+		switch (type)
+		{
+		case 'Q':
+		{
+			const auto query = reader.string();
+			if (query.empty())
+			{
+				ok = message_writer{ 'I' }.send(socket);
+			}
+			else
+			{
+				const auto result = this->answer(query, {});
+				ok                = send_row_description(socket, result) && send_rows(result);
+			}
+			failed = false;
+			ok     = ok && send_ready(socket);
+			break;
+		}
+		case 'P':
+		{
+			auto name        = reader.string();
+			statements[name] = reader.string();
+			ok               = message_writer{ '1' }.send(socket);
+			break;
+		}
+		case 'B':
+		{
+			reader.string(); // portal
+			const auto statement = statements.find(reader.string());
+			const auto formats   = reader.int16();
+			for (int n = 0; n < formats; ++n)
+			{
+				reader.int16();
+			}
+			std::vector<std::optional<std::string>> parameters{};
+			const auto                              count = reader.int16();
+			for (int n = 0; n < count; ++n)
+			{
+				const auto length = reader.int32();
+				if (length < 0)
+				{
+					parameters.push_back(std::nullopt);
+				}
+				else
+				{
+					parameters.push_back(std::string{ reader.bytes(static_cast<std::size_t>(length)) });
+				}
+			}
+			if (statement == statements.end())
+			{
+				failed = true;
+				ok     = send_error(socket, "26000", "prepared statement does not exist");
+			}
+			else
+			{
+				portal = this->answer(statement->second, parameters);
+				ok     = message_writer{ '2' }.send(socket);
+			}
+			break;
+		}
+		case 'D':
+			if (reader.bytes(1) == "S")
+			{
+				ok = message_writer{ 't' }.int16(0).send(socket) && message_writer{ 'n' }.send(socket);
+			}
+			else
+			{
+				ok = portal && send_row_description(socket, *portal);
+			}
+			break;
+		case 'E':
+			ok = portal && send_rows(*portal);
+			portal.reset();
+			break;
+		case 'C':
+			ok = message_writer{ '3' }.send(socket);
+			break;
+		default:
+			failed = true;
+			ok     = send_error(socket, "08P01", "unsupported message");
+			break;
+		}
+		if (!ok)
+		{
+			return;
+		}
+	}
+}
+
+void fake_server::cancel(int process_id, int secret_key)
+{
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		++this->cancel_requests_;
+		const auto session = this->sessions_.find(process_id);
+		// Like a real server, ignore the request if no query is running
+		if (session == this->sessions_.end() || session->second->secret_key != secret_key || !session->second->waiting)
+		{
+			return;
+		}
+		session->second->cancelled = true;
+	}
+	this->cancelled_.notify_all();
+}
+
+fake_result fake_server::answer(const std::string& query, const std::vector<std::optional<std::string>>& parameters)
+{
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		this->queries_.push_back(query);
+	}
+	if (query.starts_with("DEALLOCATE "))
+	{
+		return fake_result{ .command_tag = "DEALLOCATE" };
+	}
+	return this->handler_(query, parameters);
+}
+
+bool fake_server::wait_for_cancel(session& session)
+{
+	std::unique_lock<std::mutex> lock{ this->mutex_ };
+	session.waiting = true;
+	this->cancelled_.wait_for(lock, cancel_timeout, [this, &session] { return session.cancelled || this->stopping_; });
+	const auto cancelled = session.cancelled;
+	session.waiting      = false;
+	session.cancelled    = false;
+	return cancelled;
+}
+
+} // namespace postgresql
+} // namespace squid
@@ -0,0 +1,87 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace squid {
+namespace postgresql {
+
+/// The answer of a fake_server to a query
+struct fake_result
+{
+	std::vector<std::string>                             columns{};         // names of the text columns, empty for a command
+	std::vector<std::vector<std::optional<std::string>>> rows{};            // values of the rows, std::nullopt for NULL
+	std::string                                          command_tag{};     // e.g. "SELECT 2" or "INSERT 0 1"
+	std::chrono::milliseconds                            row_interval{};    // time before each row is sent
+	bool                                                 until_cancelled{}; // send no rows, wait for a cancel request
+};
+
+/// A PostgreSQL server on the loopback interface that speaks enough of the v3 frontend/backend protocol for libpq:
+/// startup without authentication, simple queries, the extended query protocol and cancel requests.
+/// Each query, with the text of its parameters, is answered by a handler. The handler runs on the thread of the
+/// session, so that it must be thread-safe if several connections are made.
+class fake_server final
+{
+public:
+	using handler_type = std::function<fake_result(const std::string& query, const std::vector<std::optional<std::string>>& parameters)>;
+
+private:
+	struct session;
+
+	handler_type                            handler_;
+	int                                     listener_;
+	std::uint16_t                           port_;
+	mutable std::mutex                      mutex_;
+	std::condition_variable                 cancelled_; // signalled when a session is cancelled, or the server stops
+	std::map<int, std::shared_ptr<session>> sessions_;  // by process id
+	std::vector<std::string>                queries_;
+	std::size_t                             cancel_requests_;
+	int                                     next_process_id_;
+	bool                                    stopping_;
+	std::vector<std::thread>                threads_; // of the sessions and the cancel requests
+	std::thread                             acceptor_;
+
+	void        accept();
+	void        serve(int socket);
+	void        run_session(session& session);
+	void        cancel(int process_id, int secret_key);
+	fake_result answer(const std::string& query, const std::vector<std::optional<std::string>>& parameters);
+	bool        wait_for_cancel(session& session);
+
+public:
+	explicit fake_server(handler_type handler);
+	~fake_server() noexcept;
+
+	fake_server(const fake_server&)            = delete;
+	fake_server(fake_server&& src)             = delete;
+	fake_server& operator=(const fake_server&) = delete;
+	fake_server& operator=(fake_server&&)      = delete;
+
+	/// Connection string of the server, for PQconnectdb
+	std::string connection_info() const;
+
+	/// Queries received so far, in the order in which they were received
+	std::vector<std::string> queries() const;
+
+	/// Number of cancel requests received so far
+	std::size_t cancel_requests() const;
+};
+
+} // namespace postgresql
+} // namespace squid
@@ -0,0 +1,239 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/postgresql/asyncstatement.h>
+#include <squid/postgresql/connection.h>
+#include <squid/postgresql/error.h>
+#include <squid/ibackendconnection.h>
+
+#include <squid/postgresql/test/support/fakeserver.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace squid {
+namespace postgresql {
+
+namespace {
+
+using row = std::pair<std::string, std::optional<std::string>>;
+
+constexpr auto items_query = "SELECT name, note FROM items WHERE id > :id";
+constexpr auto slow_query  = "SELECT name, note FROM slow_items";
+constexpr auto sleep_query = "SELECT pg_sleep(60)";
+
+/// Answers the queries of the tests: items_query returns the items with an id above the parameter, slow_query returns
+/// two rows 100 ms apart, and sleep_query runs until it is cancelled
+fake_result answer(const std::string& query, const std::vector<std::optional<std::string>>& parameters)
+{
+	if (query == "SELECT name, note FROM items WHERE id > $1")
+	{
+		const std::vector<row> items{ { "first", std::nullopt }, { "second", "two" }, { "third", "three" } };
+		const auto             after = static_cast<std::size_t>(std::stoi(parameters.at(0).value()));
+
+		fake_result result{ .columns = { "name", "note" } };
+		for (std::size_t n = after; n < items.size(); ++n)
+		{
+			result.rows.push_back({ items[n].first, items[n].second });
+		}
+		result.command_tag = "SELECT " + std::to_string(result.rows.size());
+		return result;
+	}
+	if (query == slow_query)
+	{
+		return fake_result{ .columns      = { "name", "note" },
+			                .rows         = { { "first", "one" }, { "second", "two" } },
+			                .command_tag  = "SELECT 2",
+			                .row_interval = std::chrono::milliseconds{ 100 } };
+	}
+	if (query == sleep_query)
+	{
+		return fake_result{ .columns = { "pg_sleep" }, .until_cancelled = true };
+	}
+	return fake_result{ .command_tag = "SELECT 0" };
+}
+
+/// Runs @a function on @a ioc until it completes, and rethrows its error
+template<typename Function>
+void run(boost::asio::io_context& ioc, Function&& function)
+{
+	std::exception_ptr error{};
+	boost::asio::co_spawn(ioc, std::forward<Function>(function), [&error](std::exception_ptr e) { error = e; });
+	ioc.run();
+	ioc.restart();
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+/// Executes @a statement and fetches all of its rows
+boost::asio::awaitable<std::vector<row>> fetch_all(async_statement&                  statement,
+                                                   const std::string&                name,
+                                                   const std::optional<std::string>& note)
+{
+	std::vector<row> rows{};
+	co_await statement.async_execute();
+	while (co_await statement.async_fetch())
+	{
+		rows.emplace_back(name, note);
+	}
+	co_return rows;
+}
+
+} // namespace
+
+TEST(PostgresqlAsyncStatementTest, ExecuteAndFetch)
+{
+	fake_server             server{ answer };
+	connection              connection{ server.connection_info() };
+	boost::asio::io_context ioc{};
+
+	std::string                name{};
+	std::optional<std::string> note{};
+	async_statement            statement{ ioc, connection, items_query };
+	statement.bind("id", 0).bind_result(name).bind_result(note);
+
+	std::vector<row> rows{};
+	run(ioc, [&]() -> boost::asio::awaitable<void> { rows = co_await fetch_all(statement, name, note); });
+
+	EXPECT_EQ(rows, (std::vector<row>{ { "first", std::nullopt }, { "second", "two" }, { "third", "three" } }));
+	EXPECT_EQ(statement.field_count(), 2u);
+	EXPECT_EQ(statement.field_name(1), "note");
+	EXPECT_EQ(statement.affected_rows(), 3u);
+}
+
+TEST(PostgresqlAsyncStatementTest, RowsThatWereNotFetchedAreDiscarded)
+{
+	fake_server             server{ answer };
+	connection              connection{ server.connection_info() };
+	boost::asio::io_context ioc{};
+
+	std::string                name{};
+	std::optional<std::string> note{};
+	async_statement            statement{ ioc, connection, items_query };
+	statement.bind("id", 1).bind_result(name).bind_result(note);
+
+	std::vector<row> rows{};
+	run(ioc, [&]() -> boost::asio::awaitable<void> {
+		co_await statement.async_execute();
+		EXPECT_TRUE(co_await statement.async_fetch());
+		EXPECT_EQ(name, "second");
+		rows = co_await fetch_all(statement, name, note);
+	});
+
+	EXPECT_EQ(rows, (std::vector<row>{ { "second", "two" }, { "third", "three" } }));
+}
+
+TEST(PostgresqlAsyncStatementTest, StatementsOnOneThreadWaitForTheirRowsTogether)
+{
+	fake_server             server{ answer };
+	connection              first_connection{ server.connection_info() };
+	connection              second_connection{ server.connection_info() };
+	boost::asio::io_context ioc{};
+
+	std::string                first_name{}, second_name{};
+	std::optional<std::string> first_note{}, second_note{};
+	async_statement            first{ ioc, first_connection, slow_query };
+	async_statement            second{ ioc, second_connection, slow_query };
+	first.bind_result(first_name).bind_result(first_note);
+	second.bind_result(second_name).bind_result(second_note);
+
+	std::vector<row> first_rows{}, second_rows{};
+	boost::asio::co_spawn(
+	    ioc,
+	    [&]() -> boost::asio::awaitable<void> { first_rows = co_await fetch_all(first, first_name, first_note); },
+	    boost::asio::detached);
+	boost::asio::co_spawn(
+	    ioc,
+	    [&]() -> boost::asio::awaitable<void> { second_rows = co_await fetch_all(second, second_name, second_note); },
+	    boost::asio::detached);
+
+	const auto start = std::chrono::steady_clock::now();
+	ioc.run();
+
+	// Each statement takes 200 ms, one after the other would take 400 ms
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{ 350 });
+	EXPECT_EQ(first_rows.size(), 2u);
+	EXPECT_EQ(second_rows, first_rows);
+}
+
+TEST(PostgresqlAsyncStatementTest, CancelledStatementFails)
+{
+	fake_server             server{ answer };
+	connection              connection{ server.connection_info() };
+	boost::asio::io_context ioc{};
+
+	async_statement statement{ ioc, connection, sleep_query };
+
+	boost::asio::co_spawn(
+	    ioc,
+	    [&]() -> boost::asio::awaitable<void> {
+		    boost::asio::steady_timer timer{ ioc, std::chrono::milliseconds{ 50 } };
+		    co_await timer.async_wait(boost::asio::use_awaitable);
+		    connection.squid::connection::backend()->cancel();
+	    },
+	    boost::asio::detached);
+	EXPECT_THROW(run(ioc, [&]() -> boost::asio::awaitable<void> { co_await statement.async_execute(); }), error);
+	EXPECT_EQ(server.cancel_requests(), 1u);
+
+	// The connection can be used again
+	std::string                name{};
+	std::optional<std::string> note{};
+	async_statement            next{ ioc, connection, items_query };
+	next.bind("id", 2).bind_result(name).bind_result(note);
+	std::vector<row> rows{};
+	run(ioc, [&]() -> boost::asio::awaitable<void> { rows = co_await fetch_all(next, name, note); });
+	EXPECT_EQ(rows, (std::vector<row>{ { "third", "three" } }));
+}
+
+TEST(PostgresqlAsyncStatementTest, DestroyingAnExecutingStatementCancelsIt)
+{
+	fake_server             server{ answer };
+	connection              connection{ server.connection_info() };
+	boost::asio::io_context ioc{};
+
+	auto statement = std::make_unique<async_statement>(ioc, connection, sleep_query);
+	boost::asio::co_spawn(
+	    ioc, [&]() -> boost::asio::awaitable<void> { co_await statement->async_execute(); }, boost::asio::detached);
+	// Runs the coroutine up to where it waits for the result
+	ioc.run_for(std::chrono::milliseconds{ 100 });
+	ASSERT_FALSE(ioc.stopped());
+
+	// The coroutine stays suspended, it is destroyed with the io_context without being resumed
+	const auto start = std::chrono::steady_clock::now();
+	statement.reset();
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{ 5 });
+	EXPECT_EQ(server.cancel_requests(), 1u);
+	const auto queries = server.queries();
+	ASSERT_FALSE(queries.empty());
+	EXPECT_EQ(queries.back().rfind("DEALLOCATE ", 0), 0u);
+
+	// The connection can be used again
+	boost::asio::io_context    next_ioc{};
+	std::string                name{};
+	std::optional<std::string> note{};
+	async_statement            next{ next_ioc, connection, items_query };
+	next.bind("id", 2).bind_result(name).bind_result(note);
+	std::vector<row> rows{};
+	run(next_ioc, [&]() -> boost::asio::awaitable<void> { rows = co_await fetch_all(next, name, note); });
+	EXPECT_EQ(rows, (std::vector<row>{ { "third", "three" } }));
+}
+
+} // namespace postgresql
+} // namespace squid
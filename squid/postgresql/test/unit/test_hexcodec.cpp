@@ -0,0 +1,114 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/postgresql/detail/hexcodec.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace squid {
+namespace postgresql {
+
+namespace {
+
+std::vector<hex_kernel> supported_kernels()
+{
+	std::vector<hex_kernel> kernels{};
+	for (auto kernel : { hex_kernel::scalar, hex_kernel::sse2, hex_kernel::avx2 })
+	{
+		if (hex_kernel_supported(kernel))
+		{
+			kernels.push_back(kernel);
+		}
+	}
+	return kernels;
+}
+
+std::vector<unsigned char> random_bytes(std::size_t size)
+{
+	std::mt19937                    generator{ static_cast<std::mt19937::result_type>(size) };
+	std::uniform_int_distribution<> distribution{ 0, 255 };
+	std::vector<unsigned char>      bytes(size);
+	for (auto& byte : bytes)
+	{
+		byte = static_cast<unsigned char>(distribution(generator));
+	}
+	return bytes;
+}
+
+} // namespace
+
+TEST(PostgresqlHexcodecTest, ScalarAndBestKernelAreSupported)
+{
+	EXPECT_TRUE(hex_kernel_supported(hex_kernel::scalar));
+	EXPECT_TRUE(hex_kernel_supported(best_hex_kernel()));
+}
+
+TEST(PostgresqlHexcodecTest, KernelsAgreeWithScalarKernel)
+{
+	// Sizes around the 16 and 32 byte blocks of the SIMD kernels, to cover their scalar tails
+	for (std::size_t size = 0; size < 200; ++size)
+	{
+		const auto bytes = random_bytes(size);
+
+		std::string expected(2 * size, '\0');
+		hex_encode(bytes.data(), size, expected.data(), hex_kernel::scalar);
+
+		for (auto kernel : supported_kernels())
+		{
+			std::string encoded(2 * size, '\0');
+			hex_encode(bytes.data(), size, encoded.data(), kernel);
+			EXPECT_EQ(encoded, expected) << "kernel " << static_cast<int>(kernel) << ", size " << size;
+
+			std::vector<unsigned char> decoded(size);
+			EXPECT_TRUE(hex_decode(encoded.data(), size, decoded.data(), kernel));
+			EXPECT_EQ(decoded, bytes) << "kernel " << static_cast<int>(kernel) << ", size " << size;
+		}
+	}
+}
+
+TEST(PostgresqlHexcodecTest, DecodeAcceptsLowerAndUpperCase)
+{
+	const std::string text = "0123456789abcdefABCDEF0123456789abcdefABCDEF0123456789abcdefABCDEF0123456789abcdef";
+	for (auto kernel : supported_kernels())
+	{
+		std::vector<unsigned char> decoded(text.length() / 2);
+		EXPECT_TRUE(hex_decode(text.data(), decoded.size(), decoded.data(), kernel));
+		EXPECT_EQ(decoded[0], 0x01u);
+		EXPECT_EQ(decoded[5], 0xabu);
+		EXPECT_EQ(decoded[8], 0xabu);
+		EXPECT_EQ(decoded[10], 0xefu);
+	}
+}
+
+TEST(PostgresqlHexcodecTest, DecodeRejectsIllegalCharacters)
+{
+	constexpr std::size_t size = 100;
+	const std::string     valid(2 * size, 'a');
+	// Neighbours of the valid ranges, and characters with the high bit set
+	const std::string illegal = std::string{ "/:@G`g x\x80\xff" } + '\0';
+
+	for (auto kernel : supported_kernels())
+	{
+		for (std::size_t pos = 0; pos < valid.length(); ++pos)
+		{
+			for (auto c : illegal)
+			{
+				auto text = valid;
+				text[pos] = c;
+				std::vector<unsigned char> decoded(size);
+				EXPECT_FALSE(hex_decode(text.data(), size, decoded.data(), kernel))
+				    << "kernel " << static_cast<int>(kernel) << ", position " << pos << ", character " << static_cast<int>(c);
+			}
+		}
+	}
+}
+
+} // namespace postgresql
+} // namespace squid
@@ -92,6 +92,8 @@ TEST(PostgresqlQueryparametersTest, FloatParameter)
 {
 	EXPECT_EQ(get_one_query_parameter(42.42f), "42.42");
 	EXPECT_EQ(get_one_query_parameter(42.42), "42.42");
+	EXPECT_EQ(get_one_query_parameter(0.1 + 0.2), "0.30000000000000004");
+	EXPECT_EQ(get_one_query_parameter(1e300), "1e+300");
 }
 
 TEST(PostgresqlQueryparametersTest, StringParameter)
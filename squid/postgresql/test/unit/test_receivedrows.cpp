@@ -0,0 +1,99 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/postgresql/detail/receivedrows.h>
+#include <squid/postgresql/detail/queryresults.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+
+namespace squid {
+namespace postgresql {
+
+namespace {
+
+/// A result with the text columns "name" and "note", like the result of a row received in single-row mode
+std::shared_ptr<PGresult> make_result(const std::vector<std::optional<std::string>>& values)
+{
+	std::shared_ptr<PGresult> pgresult{ PQmakeEmptyPGresult(nullptr, PGRES_SINGLE_TUPLE), PQclear };
+	char                      name[]       = "name";
+	char                      note[]       = "note";
+	PGresAttDesc              attributes[] = { { name, 0, 0, 0, 25, -1, -1 }, { note, 0, 0, 0, 25, -1, -1 } };
+	EXPECT_TRUE(PQsetResultAttrs(pgresult.get(), 2, attributes));
+	for (std::size_t index = 0; index < values.size(); ++index)
+	{
+		const auto& value = values[index];
+		EXPECT_TRUE(PQsetvalue(pgresult.get(),
+		                       static_cast<int>(index / 2),
+		                       static_cast<int>(index % 2),
+		                       value ? const_cast<char*>(value->c_str()) : nullptr,
+		                       value ? static_cast<int>(value->length()) : -1));
+	}
+	return pgresult;
+}
+
+} // namespace
+
+TEST(PostgresqlReceivedRowsTest, ValuesOfAppendedRows)
+{
+	received_rows rows{};
+	rows.append(*make_result({ "first", std::nullopt }));
+	rows.append(*make_result({ "", "second note" }));
+
+	EXPECT_EQ(rows.rows(), 2);
+	EXPECT_EQ(rows.value(0, 0), "first");
+	EXPECT_EQ(rows.value(0, 1), std::nullopt);
+	EXPECT_EQ(rows.value(1, 0), "");
+	EXPECT_EQ(rows.value(1, 1), "second note");
+	EXPECT_EQ(rows.value_bytes(), 16u);
+	EXPECT_GE(rows.memory_size(), rows.value_bytes());
+}
+
+TEST(PostgresqlReceivedRowsTest, MemorySizeExcludesTheOverheadOfEachResult)
+{
+	received_rows rows{};
+	std::size_t   result_bytes{};
+	for (int n = 0; n < 100; ++n)
+	{
+		const auto pgresult = make_result({ std::to_string(n), "note" });
+		result_bytes += PQresultMemorySize(pgresult.get());
+		rows.append(*pgresult);
+	}
+
+	EXPECT_EQ(rows.rows(), 100);
+	EXPECT_EQ(rows.value_bytes(), 590u);
+	EXPECT_LT(rows.memory_size(), rows.value_bytes() + 200 * sizeof(std::size_t) + 200);
+	EXPECT_LT(rows.memory_size() * 10, result_bytes);
+}
+
+TEST(PostgresqlReceivedRowsTest, FetchStoresTheValuesInTheResults)
+{
+	const auto                 columns = make_result({});
+	std::string                name{};
+	std::optional<std::string> note{ "not fetched" };
+	query_results              results{ columns, std::vector<result>{ result{ name }, result{ note } } };
+
+	received_rows rows{};
+	rows.append(*make_result({ "first", std::nullopt }));
+	rows.append(*make_result({ "second", "a note" }));
+
+	results.fetch(rows, 0);
+	EXPECT_EQ(name, "first");
+	EXPECT_EQ(note, std::nullopt);
+
+	results.fetch(rows, 1);
+	EXPECT_EQ(name, "second");
+	EXPECT_EQ(note, "a note");
+}
+
+} // namespace postgresql
+} // namespace squid
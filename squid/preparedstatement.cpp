@@ -9,9 +9,79 @@
 #include "squid/connection.h"
 #include "squid/ibackendconnection.h"
 #include "squid/ibackendstatement.h"
+#include "squid/connectionpool.h"
+#include "squid/routingpool.h"
+
+#include <string>
 
 namespace squid {
 
+namespace {
+
+/// A statement that is owned by a connection pool, see connection_pool_options::statements
+class registered_statement final : public ibackend_statement
+{
+	ibackend_statement& statement_;
+
+public:
+	explicit registered_statement(ibackend_statement& statement)
+	    : statement_{ statement }
+	{
+	}
+
+	void execute(const std::map<std::string, parameter>& parameters, const std::vector<result>& results) override
+	{
+		this->statement_.execute(parameters, results);
+	}
+
+	void execute(const std::map<std::string, parameter>& parameters, const std::map<std::string, result>& results) override
+	{
+		this->statement_.execute(parameters, results);
+	}
+
+	bool fetch() override
+	{
+		return this->statement_.fetch();
+	}
+
+	std::size_t field_count() override
+	{
+		return this->statement_.field_count();
+	}
+
+	std::string field_name(std::size_t index) override
+	{
+		return this->statement_.field_name(index);
+	}
+
+	std::uint64_t affected_rows() override
+	{
+		return this->statement_.affected_rows();
+	}
+
+	void observe(statement_observer* observer) noexcept override
+	{
+		this->statement_.observe(observer);
+	}
+
+	std::string_view query() const noexcept override
+	{
+		return this->statement_.query();
+	}
+
+	void account(result_memory* memory) noexcept override
+	{
+		this->statement_.account(memory);
+	}
+
+	std::uint64_t result_bytes() const noexcept override
+	{
+		return this->statement_.result_bytes();
+	}
+};
+
+} // namespace
+
 std::unique_ptr<ibackend_statement> prepared_statement::create_statement(std::shared_ptr<ibackend_connection> connection,
                                                                          std::string_view                     query)
 {
@@ -28,4 +98,19 @@ prepared_statement::prepared_statement(connection& connection)
 {
 }
 
+prepared_statement::prepared_statement(std::shared_ptr<ibackend_connection> connection, std::unique_ptr<ibackend_statement>&& statement)
+    : basic_statement{ connection, std::move(statement) }
+{
+}
+
+prepared_statement prepared_statement::registered(connection& connection, std::string_view name)
+{
+	auto statement = routing_pool::registered_statement(connection.backend(), name);
+	if (!statement)
+	{
+		throw error{ "No statement is registered as " + std::string{ name } };
+	}
+	return prepared_statement{ connection.backend(), std::make_unique<registered_statement>(*statement) };
+}
+
 } // namespace squid
@@ -22,6 +22,8 @@ class SQUID_EXPORT prepared_statement final : public basic_statement
 {
 	std::unique_ptr<ibackend_statement> create_statement(std::shared_ptr<ibackend_connection> connection, std::string_view query) override;
 
+	explicit prepared_statement(std::shared_ptr<ibackend_connection> connection, std::unique_ptr<ibackend_statement>&& statement);
+
 public:
 	/// Create a prepared statement defined by @a query on @a connection.
 	explicit prepared_statement(connection& connection, std::string_view query);
@@ -30,13 +32,23 @@ public:
 	/// The query must be provided later on with the methods query() or operator<<.
 	explicit prepared_statement(connection& connection);
 
+	/// Use the statement registered as @a name with the pool that @a connection was acquired from, which was
+	/// prepared when the pooled connection was opened (see connection_pool_options::statements).
+	/// Throws an error if @a connection is not pooled or if no statement is registered as @a name.
+	/// Like any statement on a pooled connection, the result must not be used after the connection is released.
+	static prepared_statement registered(connection& connection, std::string_view name);
+
 	using basic_statement::operator<<;
 	using basic_statement::bind;
 	using basic_statement::bind_ref;
 	using basic_statement::bind_result;
 	using basic_statement::bind_results;
+	using basic_statement::cancel;
 	using basic_statement::execute;
+	using basic_statement::execute_async;
 	using basic_statement::fetch;
+	using basic_statement::fetch_all;
+	using basic_statement::fetch_all_async;
 	using basic_statement::field_count;
 	using basic_statement::field_name;
 };
@@ -0,0 +1,283 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/querystats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <locale>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace squid {
+
+namespace {
+
+constexpr bool is_space(char c) noexcept
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+double milliseconds(std::chrono::nanoseconds duration)
+{
+	return std::chrono::duration<double, std::milli>{ duration }.count();
+}
+
+/// Sort key of @a stats for @a order
+double sort_key(const query_stats& stats, query_stats_order order)
+{
+	switch (order)
+	{
+	case query_stats_order::total_time:
+		return static_cast<double>(stats.total_time.count());
+	case query_stats_order::calls:
+		return static_cast<double>(stats.calls);
+	case query_stats_order::mean_latency:
+		return static_cast<double>(stats.latency.mean().count());
+	case query_stats_order::max_latency:
+		return static_cast<double>(stats.max_latency.count());
+	case query_stats_order::errors:
+		return static_cast<double>(stats.errors);
+	case query_stats_order::rows:
+		return static_cast<double>(stats.rows);
+	}
+	return 0.0;
+}
+
+} // namespace
+
+std::uint64_t query_fingerprint(std::string_view query) noexcept
+{
+	constexpr std::uint64_t offset_basis = 14695981039346656037ull;
+	constexpr std::uint64_t prime        = 1099511628211ull;
+
+	std::uint64_t hash  = offset_basis;
+	bool          space = false;
+	for (const auto c : query)
+	{
+		if (is_space(c))
+		{
+			space = true;
+			continue;
+		}
+		if (space && hash != offset_basis)
+		{
+			hash = (hash ^ static_cast<unsigned char>(' ')) * prime;
+		}
+		space = false;
+		hash  = (hash ^ static_cast<unsigned char>(c)) * prime;
+	}
+	return hash;
+}
+
+std::string to_text(const std::vector<query_stats>& stats)
+{
+	std::ostringstream out{};
+	out.imbue(std::locale::classic());
+	out << std::fixed << std::setprecision(3);
+
+	out << std::setw(10) << "calls" << std::setw(8) << "errors" << std::setw(12) << "rows" << std::setw(14) << "total ms"
+	    << std::setw(11) << "mean ms" << std::setw(11) << "p50 ms" << std::setw(11) << "p95 ms" << std::setw(11) << "p99 ms"
+	    << std::setw(11) << "max ms"
+	    << "  query\n";
+	for (const auto& query : stats)
+	{
+		out << std::setw(10) << query.calls << std::setw(8) << query.errors << std::setw(12) << query.rows << std::setw(14)
+		    << milliseconds(query.total_time) << std::setw(11) << milliseconds(query.latency.mean()) << std::setw(11)
+		    << milliseconds(query.latency.quantile(0.5)) << std::setw(11) << milliseconds(query.latency.quantile(0.95))
+		    << std::setw(11) << milliseconds(query.latency.quantile(0.99)) << std::setw(11)
+		    << milliseconds(query.calls ? query.max_latency : std::chrono::nanoseconds::zero()) << "  ";
+		for (const auto c : query.query)
+		{
+			out << (is_space(c) ? ' ' : c);
+		}
+		out << '\n';
+	}
+
+	return out.str();
+}
+
+class query_stats_observer::impl
+{
+	struct shard
+	{
+		mutable std::mutex                             mutex{};
+		std::unordered_map<std::uint64_t, query_stats> queries{};
+	};
+
+	std::vector<shard>         shards_;
+	std::size_t                max_queries_;
+	std::atomic<std::size_t>   size_;
+	std::atomic<std::uint64_t> dropped_;
+
+	shard& shard_of(std::uint64_t fingerprint) noexcept
+	{
+		return this->shards_[(fingerprint ^ (fingerprint >> 32)) % this->shards_.size()];
+	}
+
+	/// Calls @a apply with the statistics of @a query, added if they do not exist yet and there is room for them
+	template<typename Apply>
+	void update(std::string_view query, Apply&& apply) noexcept
+	{
+		const auto fingerprint = query_fingerprint(query);
+		auto&      shard       = this->shard_of(fingerprint);
+
+		std::lock_guard<std::mutex> lock{ shard.mutex };
+		auto                        it = shard.queries.find(fingerprint);
+		if (it == shard.queries.end())
+		{
+			if (this->size_.fetch_add(1, std::memory_order_relaxed) >= this->max_queries_)
+			{
+				this->size_.fetch_sub(1, std::memory_order_relaxed);
+				this->dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			try
+			{
+				it = shard.queries
+				         .emplace(fingerprint,
+				                  query_stats{ .fingerprint = fingerprint,
+				                               .query       = std::string{ query },
+				                               .calls       = 0,
+				                               .errors      = 0,
+				                               .rows        = 0,
+				                               .total_time  = std::chrono::nanoseconds::zero(),
+				                               .min_latency = std::chrono::nanoseconds::max(),
+				                               .max_latency = std::chrono::nanoseconds::zero(),
+				                               .latency     = {} })
+				         .first;
+			}
+			catch (...)
+			{
+				this->size_.fetch_sub(1, std::memory_order_relaxed);
+				this->dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+		apply(it->second);
+	}
+
+public:
+	explicit impl(const query_stats_options& options)
+	    : shards_(options.shards ? options.shards : std::max(1u, std::thread::hardware_concurrency()))
+	    , max_queries_{ options.max_queries }
+	    , size_{}
+	    , dropped_{}
+	{
+	}
+
+	void on_phase(const statement_event& event) noexcept
+	{
+		this->update(event.query, [&event](query_stats& stats) {
+			stats.total_time += event.duration;
+			if (event.phase == statement_phase::execute)
+			{
+				const auto nanoseconds = static_cast<std::uint64_t>(std::max(event.duration.count(), std::chrono::nanoseconds::rep{}));
+				++stats.calls;
+				++stats.latency.counts[duration_histogram::bucket_of(nanoseconds)];
+				stats.latency.total_nanoseconds += nanoseconds;
+				stats.min_latency = std::min(stats.min_latency, event.duration);
+				stats.max_latency = std::max(stats.max_latency, event.duration);
+			}
+			else if (event.phase == statement_phase::decode)
+			{
+				stats.rows += event.rows;
+			}
+		});
+	}
+
+	void on_error(std::string_view query) noexcept
+	{
+		this->update(query, [](query_stats& stats) { ++stats.errors; });
+	}
+
+	std::vector<query_stats> snapshot() const
+	{
+		std::vector<query_stats> result{};
+		result.reserve(this->size_.load(std::memory_order_relaxed));
+		for (const auto& shard : this->shards_)
+		{
+			std::lock_guard<std::mutex> lock{ shard.mutex };
+			for (const auto& [fingerprint, stats] : shard.queries)
+			{
+				result.push_back(stats);
+				if (!result.back().calls)
+				{
+					result.back().min_latency = std::chrono::nanoseconds::zero();
+				}
+			}
+		}
+		return result;
+	}
+
+	std::uint64_t dropped() const noexcept
+	{
+		return this->dropped_.load(std::memory_order_relaxed);
+	}
+
+	void reset()
+	{
+		for (auto& shard : this->shards_)
+		{
+			std::lock_guard<std::mutex> lock{ shard.mutex };
+			this->size_.fetch_sub(shard.queries.size(), std::memory_order_relaxed);
+			shard.queries.clear();
+		}
+		this->dropped_.store(0, std::memory_order_relaxed);
+	}
+};
+
+query_stats_observer::query_stats_observer(const query_stats_options& options)
+    : statement_observer{}
+    , pimpl_{ std::make_unique<impl>(options) }
+{
+}
+
+query_stats_observer::~query_stats_observer() noexcept
+{
+}
+
+void query_stats_observer::on_phase(const statement_event& event) noexcept
+{
+	this->pimpl_->on_phase(event);
+}
+
+void query_stats_observer::on_error(std::string_view query) noexcept
+{
+	this->pimpl_->on_error(query);
+}
+
+std::vector<query_stats> query_stats_observer::snapshot() const
+{
+	return this->pimpl_->snapshot();
+}
+
+std::vector<query_stats> query_stats_observer::top(std::size_t n, query_stats_order order) const
+{
+	auto stats = this->snapshot();
+	n          = std::min(n, stats.size());
+	std::partial_sort(stats.begin(), stats.begin() + static_cast<std::ptrdiff_t>(n), stats.end(), [order](const auto& a, const auto& b) {
+		return sort_key(a, order) > sort_key(b, order);
+	});
+	stats.erase(stats.begin() + static_cast<std::ptrdiff_t>(n), stats.end());
+	return stats;
+}
+
+std::uint64_t query_stats_observer::dropped() const noexcept
+{
+	return this->pimpl_->dropped();
+}
+
+void query_stats_observer::reset()
+{
+	this->pimpl_->reset();
+}
+
+} // namespace squid
@@ -0,0 +1,101 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/api.h"
+#include "squid/durationhistogram.h"
+#include "squid/statementobserver.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace squid {
+
+/// Fingerprint of @a query, the query text as passed to the backend.
+/// For PostgreSQL and MySQL that is the text with the named parameters replaced by placeholders, so all executions of
+/// a statement share a fingerprint whatever the values of their parameters. Runs of whitespace are treated as a single
+/// space, and leading and trailing whitespace is ignored. A 64-bit FNV-1a hash.
+SQUID_EXPORT std::uint64_t query_fingerprint(std::string_view query) noexcept;
+
+/// Options of a query_stats_observer
+struct SQUID_EXPORT query_stats_options
+{
+	/// Number of shards of the table of queries, each with its own lock. 0 means one per hardware thread.
+	std::size_t shards = 16;
+
+	/// Maximum number of distinct queries. Executions of other queries are only counted in query_stats_observer::dropped.
+	std::size_t max_queries = 5000;
+};
+
+/// Statistics of the executions of a query
+struct SQUID_EXPORT query_stats
+{
+	std::uint64_t            fingerprint; /// see query_fingerprint
+	std::string              query;       /// text of the first execution of the query
+	std::uint64_t            calls;       /// number of successful executions
+	std::uint64_t            errors;      /// number of failed executions
+	std::uint64_t            rows;        /// number of rows fetched
+	std::chrono::nanoseconds total_time;  /// time spent in all phases of the statement, see statement_phase
+	std::chrono::nanoseconds min_latency; /// shortest execute phase
+	std::chrono::nanoseconds max_latency; /// longest execute phase
+	duration_histogram       latency;     /// durations of the execute phase
+};
+
+/// Orders of query_stats_observer::top
+enum class query_stats_order
+{
+	total_time,
+	calls,
+	mean_latency,
+	max_latency,
+	errors,
+	rows
+};
+
+/// Format @a stats as a plain text table, one line per query, like query_stats_observer::top returns them
+SQUID_EXPORT std::string to_text(const std::vector<query_stats>& stats);
+
+/// A thread-safe statement_observer that aggregates the executions of statements per query_fingerprint,
+/// like the pg_stat_statements extension does on the server, for any backend.
+/// Recording an execution locks one shard of the table of queries.
+class SQUID_EXPORT query_stats_observer final : public statement_observer
+{
+	class impl;
+	std::unique_ptr<impl> pimpl_;
+
+public:
+	explicit query_stats_observer(const query_stats_options& options = {});
+	~query_stats_observer() noexcept override;
+
+	query_stats_observer(const query_stats_observer&)            = delete;
+	query_stats_observer(query_stats_observer&& src)             = delete;
+	query_stats_observer& operator=(const query_stats_observer&) = delete;
+	query_stats_observer& operator=(query_stats_observer&&)      = delete;
+
+	void on_phase(const statement_event& event) noexcept override;
+	void on_error(std::string_view query) noexcept override;
+
+	/// Statistics of all queries, in no particular order
+	std::vector<query_stats> snapshot() const;
+
+	/// The @a n queries that come first in @a order, highest first
+	std::vector<query_stats> top(std::size_t n, query_stats_order order = query_stats_order::total_time) const;
+
+	/// Number of executions that were not recorded because max_queries distinct queries were recorded already
+	std::uint64_t dropped() const noexcept;
+
+	/// Forget all queries and reset the number of dropped executions
+	void reset();
+};
+
+} // namespace squid
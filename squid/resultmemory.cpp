@@ -0,0 +1,140 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/resultmemory.h"
+#include "squid/error.h"
+
+#include <string>
+#include <utility>
+
+namespace squid {
+
+result_memory::result_memory() noexcept
+    : bytes_{}
+    , peak_{}
+    , limits_{}
+{
+}
+
+std::uint64_t result_memory::bytes() const noexcept
+{
+	return this->bytes_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t result_memory::peak() const noexcept
+{
+	return this->peak_.load(std::memory_order_relaxed);
+}
+
+void result_memory::reset_peak() noexcept
+{
+	this->peak_.store(this->bytes(), std::memory_order_relaxed);
+}
+
+const result_limits& result_memory::limits() const noexcept
+{
+	return this->limits_;
+}
+
+void result_memory::set_limits(const result_limits& limits) noexcept
+{
+	this->limits_ = limits;
+}
+
+void result_memory::acquire(std::uint64_t statement_bytes, std::uint64_t bytes)
+{
+	// Only the thread that uses the connection changes the bytes, so checking before adding is not racy
+	const auto total = this->bytes() + bytes;
+	if (this->limits_.statement_bytes && statement_bytes + bytes > this->limits_.statement_bytes)
+	{
+		throw result_limit_error{ "The result of the statement exceeds the limit of " + std::to_string(this->limits_.statement_bytes) +
+			                      " bytes" };
+	}
+	if (this->limits_.connection_bytes && total > this->limits_.connection_bytes)
+	{
+		throw result_limit_error{ "The results of the statements of the connection exceed the limit of " +
+			                      std::to_string(this->limits_.connection_bytes) + " bytes" };
+	}
+
+	this->bytes_.store(total, std::memory_order_relaxed);
+	if (total > this->peak())
+	{
+		this->peak_.store(total, std::memory_order_relaxed);
+	}
+}
+
+void result_memory::release(std::uint64_t bytes) noexcept
+{
+	this->bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+result_account::result_account() noexcept
+    : memory_{}
+    , bytes_{}
+{
+}
+
+result_account::~result_account() noexcept
+{
+	this->release();
+}
+
+result_account::result_account(result_account&& src) noexcept
+    : memory_{ std::exchange(src.memory_, nullptr) }
+    , bytes_{ std::exchange(src.bytes_, 0u) }
+{
+}
+
+result_account& result_account::operator=(result_account&& src) noexcept
+{
+	if (this != &src)
+	{
+		this->release();
+		this->memory_ = std::exchange(src.memory_, nullptr);
+		this->bytes_  = std::exchange(src.bytes_, 0u);
+	}
+	return *this;
+}
+
+void result_account::attach(result_memory* memory) noexcept
+{
+	if (memory != this->memory_)
+	{
+		this->release();
+		this->memory_ = memory;
+	}
+}
+
+bool result_account::limited() const noexcept
+{
+	return this->memory_ && (this->memory_->limits().statement_bytes || this->memory_->limits().connection_bytes);
+}
+
+void result_account::add(std::uint64_t bytes)
+{
+	if (this->memory_)
+	{
+		this->memory_->acquire(this->bytes_, bytes);
+	}
+	this->bytes_ += bytes;
+}
+
+void result_account::release() noexcept
+{
+	if (this->memory_)
+	{
+		this->memory_->release(this->bytes_);
+	}
+	this->bytes_ = 0;
+}
+
+std::uint64_t result_account::bytes() const noexcept
+{
+	return this->bytes_;
+}
+
+} // namespace squid
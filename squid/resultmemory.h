@@ -0,0 +1,95 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/api.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace squid {
+
+/// Limits of the bytes that the backend buffers for results, 0 for no limit.
+/// A statement whose result exceeds a limit fails with a result_limit_error. Backends that can, check the limits
+/// while the result is being received, so that the rest of the result is never buffered.
+/// SQLite steps through the result in fetch and buffers nothing, so the limits never apply to it.
+struct SQUID_EXPORT result_limits
+{
+	std::uint64_t statement_bytes  = 0; /// bytes of the result of one execution of a statement
+	std::uint64_t connection_bytes = 0; /// bytes of the results of all statements of a connection together
+};
+
+/// Accounting of the bytes that the backend buffers for the results of the statements of a connection.
+/// The counters may be read from any thread; the limits are set while no statement is being executed.
+class SQUID_EXPORT result_memory final
+{
+	std::atomic<std::uint64_t> bytes_;
+	std::atomic<std::uint64_t> peak_;
+	result_limits              limits_;
+
+public:
+	result_memory() noexcept;
+
+	result_memory(const result_memory&)            = delete;
+	result_memory(result_memory&& src)             = delete;
+	result_memory& operator=(const result_memory&) = delete;
+	result_memory& operator=(result_memory&&)      = delete;
+
+	/// Bytes buffered for the results of the statements of the connection
+	std::uint64_t bytes() const noexcept;
+
+	/// Most bytes that were buffered at once since the connection was opened, or since the last reset_peak()
+	std::uint64_t peak() const noexcept;
+
+	/// Start measuring the peak again, from the bytes that are buffered now
+	void reset_peak() noexcept;
+
+	const result_limits& limits() const noexcept;
+	void                 set_limits(const result_limits& limits) noexcept;
+
+	/// Account @a bytes more for a statement whose result already holds @a statement_bytes.
+	/// Throws result_limit_error, and accounts nothing, if that exceeds a limit.
+	void acquire(std::uint64_t statement_bytes, std::uint64_t bytes);
+
+	/// Account @a bytes less
+	void release(std::uint64_t bytes) noexcept;
+};
+
+/// The bytes buffered for the result of the current execution of one statement, accounted on the result_memory of
+/// its connection, if any. Released when the statement is executed again, or destroyed.
+class SQUID_EXPORT result_account final
+{
+	result_memory* memory_;
+	std::uint64_t  bytes_;
+
+public:
+	result_account() noexcept;
+	~result_account() noexcept;
+
+	result_account(const result_account&) = delete;
+	result_account(result_account&& src) noexcept;
+	result_account& operator=(const result_account&) = delete;
+	result_account& operator=(result_account&& src) noexcept;
+
+	/// Account on @a memory from now on, nullptr to only count the bytes of the statement
+	void attach(result_memory* memory) noexcept;
+
+	/// Whether a limit applies, so that the backend should check it while receiving a result
+	bool limited() const noexcept;
+
+	/// Account @a bytes more. Throws result_limit_error, and accounts nothing, if that exceeds a limit.
+	void add(std::uint64_t bytes);
+
+	/// Release all bytes, when the result is discarded
+	void release() noexcept;
+
+	/// Bytes buffered for the result of the current execution
+	std::uint64_t bytes() const noexcept;
+};
+
+} // namespace squid
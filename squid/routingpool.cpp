@@ -0,0 +1,412 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/routingpool.h"
+#include "squid/ibackendconnection.h"
+#include "squid/error.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+namespace squid {
+
+class routing_pool::impl
+{
+	using clock_type = std::chrono::steady_clock;
+
+	/// A replica and its routing state.
+	/// The state is read and updated with relaxed atomics; concurrent updates of the latency may overwrite each
+	/// other, which only loses a sample of a moving average.
+	struct replica
+	{
+		connection_pool              pool;
+		std::atomic<std::int64_t>    latency_nanoseconds;
+		std::atomic<int>             outstanding;
+		std::atomic<std::size_t>     consecutive_failures;
+		std::atomic<clock_type::rep> ejected_until;
+		std::atomic<std::uint64_t>   requests;
+		std::atomic<std::uint64_t>   failures;
+		std::atomic<std::uint64_t>   ejections;
+		std::atomic<std::uint64_t>   connect_failures; // failures of the pool to open a connection, as last seen
+
+		replica(const ibackend_connection_factory& factory,
+		        std::string_view                   connection_info,
+		        std::size_t                        count,
+		        const connection_pool_options&     options)
+		    : pool{ factory, connection_info, count, options }
+		    , latency_nanoseconds{}
+		    , outstanding{}
+		    , consecutive_failures{}
+		    , ejected_until{ std::numeric_limits<clock_type::rep>::min() }
+		    , requests{}
+		    , failures{}
+		    , ejections{}
+		    , connect_failures{}
+		{
+		}
+
+		bool healthy(clock_type::time_point now) const noexcept
+		{
+			return this->ejected_until.load(std::memory_order_relaxed) <= now.time_since_epoch().count();
+		}
+	};
+
+	/// Deleter of the connections handed out for read-only access.
+	/// Holds the connection acquired from the replica pool and returns it when the handed out connection is released,
+	/// after accounting for the latency or the failure of the replica.
+	struct lease
+	{
+		impl*                                pool;
+		replica*                             target;
+		std::shared_ptr<ibackend_connection> connection;
+		clock_type::time_point               acquired;
+
+		void operator()(ibackend_connection*) noexcept
+		{
+			if (this->connection->is_broken())
+			{
+				this->pool->fail(*this->target, clock_type::now());
+			}
+			else
+			{
+				this->pool->succeed(*this->target, clock_type::now() - this->acquired);
+			}
+			this->target->outstanding.fetch_sub(1, std::memory_order_relaxed);
+			this->connection.reset();
+		}
+	};
+
+	routing_pool_options                  options_;
+	connection_pool                       primary_;
+	std::vector<std::unique_ptr<replica>> replicas_;
+	std::atomic<std::size_t>              next_;
+	std::atomic<std::uint64_t>            primary_fallbacks_;
+
+	void succeed(replica& target, clock_type::duration latency) noexcept
+	{
+		const auto sample  = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+		const auto average = target.latency_nanoseconds.load(std::memory_order_relaxed);
+		const auto updated = average ? average + static_cast<std::int64_t>(this->options_.latency_smoothing * (sample - average)) : sample;
+		target.latency_nanoseconds.store(std::max<std::int64_t>(updated, 1), std::memory_order_relaxed);
+		target.consecutive_failures.store(0, std::memory_order_relaxed);
+	}
+
+	void fail(replica& target, clock_type::time_point now) noexcept
+	{
+		target.failures.fetch_add(1, std::memory_order_relaxed);
+		// After an ejection, the count stays at the threshold, so that the next failure ejects the replica again
+		if (target.consecutive_failures.fetch_add(1, std::memory_order_relaxed) + 1 >= this->options_.failure_threshold &&
+		    target.healthy(now))
+		{
+			target.ejected_until.store((now + this->options_.ejection_time).time_since_epoch().count(), std::memory_order_relaxed);
+			target.ejections.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	/// Whether the pool of @a target failed to open a connection since this was last called
+	static bool failed_to_connect(replica& target)
+	{
+		const auto failures = target.pool.stats().connect_failures;
+		return target.connect_failures.exchange(failures, std::memory_order_relaxed) < failures;
+	}
+
+	/// The healthy replica with the lowest load that is not in @a excluded, nullptr if there is none.
+	/// The scan starts at a rotating offset, so that replicas with the same load are selected in turn.
+	replica* select(clock_type::time_point now, std::span<const replica* const> excluded = {}) noexcept
+	{
+		const auto count = this->replicas_.size();
+		const auto start = count ? this->next_.fetch_add(1, std::memory_order_relaxed) % count : 0u;
+
+		replica* best{};
+		double   best_load{};
+		for (std::size_t n = 0; n < count; ++n)
+		{
+			auto& candidate = *this->replicas_[(start + n) % count];
+			if (!candidate.healthy(now) || std::find(excluded.begin(), excluded.end(), &candidate) != excluded.end())
+			{
+				continue;
+			}
+			// Replicas without latency sample yet count as the fastest, so that they get one soon
+			const auto latency = static_cast<double>(candidate.latency_nanoseconds.load(std::memory_order_relaxed));
+			const auto load    = (latency + 1.0) * (candidate.outstanding.load(std::memory_order_relaxed) + 1);
+			if (!best || load < best_load)
+			{
+				best      = &candidate;
+				best_load = load;
+			}
+		}
+		return best;
+	}
+
+	std::shared_ptr<ibackend_connection> make_lease(replica& target, std::shared_ptr<ibackend_connection>&& connection)
+	{
+		if (!connection)
+		{
+			return nullptr;
+		}
+		// If allocating the control block fails, the deleter is called, which returns the connection
+		auto* raw = connection.get();
+		return std::shared_ptr<ibackend_connection>{ raw, lease{ this, &target, std::move(connection), clock_type::now() } };
+	}
+
+	std::shared_ptr<ibackend_connection> try_acquire_replica(replica& target)
+	{
+		target.outstanding.fetch_add(1, std::memory_order_relaxed);
+		auto connection = target.pool.try_acquire();
+		if (!connection)
+		{
+			target.outstanding.fetch_sub(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		target.requests.fetch_add(1, std::memory_order_relaxed);
+		return this->make_lease(target, std::move(connection));
+	}
+
+	/// Acquires a read-only connection from the replicas, waiting until @a deadline if set.
+	/// Returns nullptr if no replica is healthy.
+	/// Sets @a timed_out if the deadline passed while waiting.
+	/// A replica that has no connection available within the replica acquire timeout is busy, and the next one is tried.
+	/// That only counts as a failure of the replica if its pool failed to open connections meanwhile. When all healthy
+	/// replicas are busy, they are tried again, so that reads stay on the replicas.
+	std::shared_ptr<ibackend_connection> acquire_replica(const std::optional<clock_type::time_point>& deadline, bool& timed_out)
+	{
+		timed_out = false;
+		std::vector<const replica*> busy{};
+		for (;;)
+		{
+			const auto now    = clock_type::now();
+			auto*      target = this->select(now, busy);
+			if (!target && !busy.empty())
+			{
+				busy.clear();
+				target = this->select(now);
+			}
+			if (!target)
+			{
+				return nullptr;
+			}
+
+			auto until = now + this->options_.replica_acquire_timeout;
+			if (deadline && *deadline < until)
+			{
+				until = *deadline;
+			}
+
+			target->outstanding.fetch_add(1, std::memory_order_relaxed);
+			auto connection = target->pool.acquire_until(until);
+			if (connection)
+			{
+				target->requests.fetch_add(1, std::memory_order_relaxed);
+				return this->make_lease(*target, std::move(connection));
+			}
+			target->outstanding.fetch_sub(1, std::memory_order_relaxed);
+
+			const auto later = clock_type::now();
+			if (failed_to_connect(*target))
+			{
+				this->fail(*target, later);
+			}
+			if (deadline && later >= *deadline)
+			{
+				timed_out = true;
+				return nullptr;
+			}
+			busy.push_back(target);
+		}
+	}
+
+	std::shared_ptr<ibackend_connection> acquire_read(const std::optional<clock_type::time_point>& deadline)
+	{
+		bool timed_out{};
+		auto connection = this->acquire_replica(deadline, timed_out);
+		if (connection || timed_out)
+		{
+			return connection;
+		}
+
+		if (!this->options_.fallback_to_primary)
+		{
+			if (deadline)
+			{
+				return nullptr;
+			}
+			throw error{ "No healthy replica is available" };
+		}
+		this->primary_fallbacks_.fetch_add(1, std::memory_order_relaxed);
+		return deadline ? this->primary_.acquire_until(*deadline) : this->primary_.acquire();
+	}
+
+public:
+	impl(const ibackend_connection_factory& factory,
+	     std::string_view                   primary_connection_info,
+	     const std::vector<std::string>&    replica_connection_infos,
+	     std::size_t                        count,
+	     const routing_pool_options&        options)
+	    : options_{ options }
+	    , primary_{ factory, primary_connection_info, count, options.primary }
+	    , replicas_{}
+	    , next_{}
+	    , primary_fallbacks_{}
+	{
+		if (!(this->options_.latency_smoothing > 0.0 && this->options_.latency_smoothing <= 1.0))
+		{
+			throw std::invalid_argument{ "latency_smoothing must be greater than zero and not greater than one" };
+		}
+		if (this->options_.failure_threshold == 0)
+		{
+			throw std::invalid_argument{ "failure_threshold must be greater than zero" };
+		}
+
+		this->replicas_.reserve(replica_connection_infos.size());
+		for (const auto& connection_info : replica_connection_infos)
+		{
+			this->replicas_.push_back(std::make_unique<replica>(factory, connection_info, count, options.replica));
+		}
+	}
+
+	std::shared_ptr<ibackend_connection> acquire(access_mode mode)
+	{
+		return mode == access_mode::read_only ? this->acquire_read(std::nullopt) : this->primary_.acquire();
+	}
+
+	std::shared_ptr<ibackend_connection> acquire(access_mode mode, const std::chrono::milliseconds& timeout)
+	{
+		const auto deadline = clock_type::now() + timeout;
+		return mode == access_mode::read_only ? this->acquire_read(deadline) : this->primary_.acquire_until(deadline);
+	}
+
+	std::shared_ptr<ibackend_connection> try_acquire(access_mode mode)
+	{
+		if (mode == access_mode::read_write)
+		{
+			return this->primary_.try_acquire();
+		}
+
+		auto* target = this->select(clock_type::now());
+		if (!target)
+		{
+			if (!this->options_.fallback_to_primary)
+			{
+				return nullptr;
+			}
+			this->primary_fallbacks_.fetch_add(1, std::memory_order_relaxed);
+			return this->primary_.try_acquire();
+		}
+
+		return this->try_acquire_replica(*target);
+	}
+
+	std::shared_ptr<ibackend_connection> try_acquire_other(const std::shared_ptr<ibackend_connection>& connection)
+	{
+		const auto* other = std::get_deleter<lease>(connection);
+		if (!other)
+		{
+			return nullptr;
+		}
+		const replica* excluded[] = { other->target };
+		auto*          target     = this->select(clock_type::now(), excluded);
+		return target ? this->try_acquire_replica(*target) : nullptr;
+	}
+
+	static ibackend_statement* registered_statement(const std::shared_ptr<ibackend_connection>& connection, std::string_view name) noexcept
+	{
+		const auto* replica = std::get_deleter<lease>(connection);
+		return connection_pool::registered_statement(replica ? replica->connection : connection, name);
+	}
+
+	connection_pool& primary()
+	{
+		return this->primary_;
+	}
+
+	std::size_t replica_count() const
+	{
+		return this->replicas_.size();
+	}
+
+	routing_pool_stats stats() const
+	{
+		routing_pool_stats stats{};
+		stats.primary           = this->primary_.stats();
+		stats.primary_fallbacks = this->primary_fallbacks_.load(std::memory_order_relaxed);
+
+		const auto now = clock_type::now();
+		stats.replicas.reserve(this->replicas_.size());
+		for (const auto& replica : this->replicas_)
+		{
+			stats.replicas.push_back(routing_pool_stats::replica_stats{
+			    .healthy     = replica->healthy(now),
+			    .latency     = std::chrono::nanoseconds{ replica->latency_nanoseconds.load(std::memory_order_relaxed) },
+			    .outstanding = static_cast<std::size_t>(std::max(replica->outstanding.load(std::memory_order_relaxed), 0)),
+			    .requests    = replica->requests.load(std::memory_order_relaxed),
+			    .failures    = replica->failures.load(std::memory_order_relaxed),
+			    .ejections   = replica->ejections.load(std::memory_order_relaxed),
+			    .pool        = replica->pool.stats(),
+			});
+		}
+		return stats;
+	}
+};
+
+routing_pool::routing_pool(const ibackend_connection_factory& factory,
+                           std::string_view                   primary_connection_info,
+                           const std::vector<std::string>&    replica_connection_infos,
+                           std::size_t                        count,
+                           const routing_pool_options&        options)
+    : pimpl_{ std::make_unique<impl>(factory, primary_connection_info, replica_connection_infos, count, options) }
+{
+}
+
+routing_pool::~routing_pool() noexcept = default;
+
+std::shared_ptr<ibackend_connection> routing_pool::acquire(access_mode mode)
+{
+	return this->pimpl_->acquire(mode);
+}
+
+std::shared_ptr<ibackend_connection> routing_pool::acquire(access_mode mode, const std::chrono::milliseconds& timeout)
+{
+	return this->pimpl_->acquire(mode, timeout);
+}
+
+std::shared_ptr<ibackend_connection> routing_pool::try_acquire(access_mode mode)
+{
+	return this->pimpl_->try_acquire(mode);
+}
+
+std::shared_ptr<ibackend_connection> routing_pool::try_acquire_other(const std::shared_ptr<ibackend_connection>& connection)
+{
+	return this->pimpl_->try_acquire_other(connection);
+}
+
+connection_pool& routing_pool::primary()
+{
+	return this->pimpl_->primary();
+}
+
+std::size_t routing_pool::replica_count() const
+{
+	return this->pimpl_->replica_count();
+}
+
+routing_pool_stats routing_pool::stats() const
+{
+	return this->pimpl_->stats();
+}
+
+ibackend_statement* routing_pool::registered_statement(const std::shared_ptr<ibackend_connection>& connection,
+                                                       std::string_view                            name) noexcept
+{
+	return impl::registered_statement(connection, name);
+}
+
+} // namespace squid
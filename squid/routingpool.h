@@ -0,0 +1,142 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/api.h"
+#include "squid/connectionpool.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace squid {
+
+class ibackend_connection;
+class ibackend_connection_factory;
+
+/// What a connection acquired from a routing_pool will be used for
+enum class access_mode
+{
+	read_write, /// writes, transactions and anything that must see its own writes, served by the primary
+	read_only   /// read-only statements, served by a replica
+};
+
+/// Options of a routing_pool
+struct SQUID_EXPORT routing_pool_options
+{
+	/// Options of the pool of connections to the primary
+	connection_pool_options primary = {};
+
+	/// Options of the pools of connections to the replicas
+	connection_pool_options replica = {};
+
+	/// Weight of a new latency sample in the exponentially weighted moving average of the latency of a replica, in (0, 1].
+	double latency_smoothing = 0.2;
+
+	/// Number of consecutive failures after which a replica is excluded from routing.
+	/// A failure is a broken connection on release, or an acquisition that timed out after @a replica_acquire_timeout
+	/// while the pool of the replica failed to open connections. A replica that is merely busy does not fail.
+	std::size_t failure_threshold = 3;
+
+	/// Time that an excluded replica is not routed to.
+	/// After that, it is routed to again, and excluded again on its next failure.
+	std::chrono::milliseconds ejection_time = std::chrono::seconds{ 5 };
+
+	/// Time that a read-only acquisition waits for a connection of the selected replica before another replica is
+	/// selected. When all healthy replicas are busy, the acquisition keeps waiting on them in turn.
+	std::chrono::milliseconds replica_acquire_timeout = std::chrono::seconds{ 1 };
+
+	/// Whether read-only acquisitions are served by the primary when no replica is healthy.
+	bool fallback_to_primary = true;
+};
+
+/// Snapshot of the state and the counters of a routing_pool
+struct SQUID_EXPORT routing_pool_stats
+{
+	struct replica_stats
+	{
+		bool                     healthy;     /// whether the replica is routed to
+		std::chrono::nanoseconds latency;     /// moving average of the time that its connections were held
+		std::size_t              outstanding; /// number of its connections that are acquired
+		std::uint64_t            requests;    /// number of read-only acquisitions routed to it
+		std::uint64_t            failures;    /// number of failures
+		std::uint64_t            ejections;   /// number of times it was excluded from routing
+		connection_pool_stats    pool;        /// statistics of its connection pool
+	};
+
+	connection_pool_stats      primary;           /// statistics of the pool of connections to the primary
+	std::vector<replica_stats> replicas;          /// statistics per replica, in the order passed to the routing_pool
+	std::uint64_t              primary_fallbacks; /// number of read-only acquisitions served by the primary
+};
+
+/// A pool of connections to a primary server and its read replicas.
+/// Connections for access_mode::read_write are acquired from the primary. Connections for access_mode::read_only are
+/// acquired from the healthy replica with the lowest load, where the load is the moving average of the latency of the
+/// replica times one plus the number of its connections that are acquired. The latency is measured as the time from
+/// acquisition until release of a read-only connection, so a connection should be released as soon as its result
+/// has been read. Replicas that keep failing are excluded from routing for a while (see routing_pool_options).
+/// The pool must outlive the connections acquired from it.
+class SQUID_EXPORT routing_pool final
+{
+	class impl;
+	std::unique_ptr<impl> pimpl_;
+
+public:
+	/// Create a routing pool of at most @a count connections per server using the connection factory @a factory,
+	/// a connection string @a primary_connection_info for the primary and @a replica_connection_infos for the replicas.
+	/// Opens the initial connections of all servers before returning.
+	routing_pool(const ibackend_connection_factory& factory,
+	             std::string_view                   primary_connection_info,
+	             const std::vector<std::string>&    replica_connection_infos,
+	             std::size_t                        count,
+	             const routing_pool_options&        options = {});
+	~routing_pool() noexcept;
+
+	routing_pool(const routing_pool&)            = delete;
+	routing_pool(routing_pool&& src)             = default;
+	routing_pool& operator=(const routing_pool&) = delete;
+	routing_pool& operator=(routing_pool&&)      = default;
+
+	/// Acquire a backend connection for @a mode
+	/// Waits indefinitely until a connection is available.
+	/// Throws an error if @a mode is access_mode::read_only, no replica is healthy and options.fallback_to_primary is false.
+	std::shared_ptr<ibackend_connection> acquire(access_mode mode);
+
+	/// Acquire a backend connection for @a mode with timeout
+	/// Returns nullptr if no connection is available within the specified timeout.
+	std::shared_ptr<ibackend_connection> acquire(access_mode mode, const std::chrono::milliseconds& timeout);
+
+	/// Acquire a backend connection for @a mode
+	/// Immediately returns nullptr if no connection is available.
+	std::shared_ptr<ibackend_connection> try_acquire(access_mode mode);
+
+	/// Acquire a backend connection for read-only access from another replica than the one of @a connection, which
+	/// must have been acquired from this pool for read-only access.
+	/// Immediately returns nullptr if @a connection is not connected to a replica, or if the healthy replica with the
+	/// lowest load among the others has no connection available.
+	std::shared_ptr<ibackend_connection> try_acquire_other(const std::shared_ptr<ibackend_connection>& connection);
+
+	/// The pool of connections to the primary
+	connection_pool& primary();
+
+	/// Number of replicas
+	std::size_t replica_count() const;
+
+	/// Current state and counters of the pool
+	routing_pool_stats stats() const;
+
+	/// The statement registered as @a name with the connection pool of the primary or the replica that @a connection
+	/// was acquired from, like connection_pool::registered_statement.
+	static ibackend_statement* registered_statement(const std::shared_ptr<ibackend_connection>& connection,
+	                                                std::string_view                            name) noexcept;
+};
+
+} // namespace squid
@@ -0,0 +1,344 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/slowquerylog.h"
+#include "squid/connection.h"
+#include "squid/connectionpool.h"
+#include "squid/statement.h"
+
+#include "squid/detail/always_false.h"
+#include "squid/detail/conversions.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace squid {
+
+namespace {
+
+/// @a value between single quotes
+std::string single_quoted(std::string_view value)
+{
+	std::string result{};
+	result.reserve(value.length() + 2u);
+	result += '\'';
+	result += value;
+	result += '\'';
+	return result;
+}
+
+/// Format the value of @a parameter as text, quoted if it is a string, a date or a time
+std::string format_value(const parameter& parameter)
+{
+	return std::visit(
+	    [](auto&& arg) -> std::string {
+		    using T = std::decay_t<decltype(arg)>;
+		    if constexpr (std::is_same_v<T, const std::nullopt_t*>)
+		    {
+			    return "NULL";
+		    }
+		    else if constexpr (std::is_same_v<T, const bool*>)
+		    {
+			    return *arg ? "true" : "false";
+		    }
+		    else if constexpr (std::is_same_v<T, const char*>)
+		    {
+			    return std::string{ '\'', *arg, '\'' };
+		    }
+		    else if constexpr (std::is_arithmetic_v<std::remove_pointer_t<T>>)
+		    {
+			    std::array<char, 64> buffer{};
+			    return std::string{ buffer.data(), number_to_chars(buffer.data(), buffer.data() + buffer.size(), *arg) };
+		    }
+		    else if constexpr (std::is_same_v<T, const std::string*> || std::is_same_v<T, const std::string_view*>)
+		    {
+			    std::string value{};
+			    for (const auto c : *arg)
+			    {
+				    value += c;
+				    if (c == '\'')
+				    {
+					    value += c;
+				    }
+			    }
+			    return single_quoted(value);
+		    }
+		    else if constexpr (std::is_same_v<T, const byte_string*> || std::is_same_v<T, const byte_string_view*>)
+		    {
+			    auto value = std::to_string(arg->size());
+			    value.insert(value.begin(), '<');
+			    value += " bytes>";
+			    return value;
+		    }
+		    else if constexpr (std::is_same_v<T, const time_point*>)
+		    {
+			    return single_quoted(time_point_to_string(*arg));
+		    }
+		    else if constexpr (std::is_same_v<T, const date*>)
+		    {
+			    return single_quoted(date_to_string(*arg));
+		    }
+		    else if constexpr (std::is_same_v<T, const time_of_day*>)
+		    {
+			    return single_quoted(time_of_day_to_string(*arg));
+		    }
+#ifdef SQUID_HAVE_BOOST_DATE_TIME
+		    else if constexpr (std::is_same_v<T, const boost::posix_time::ptime*>)
+		    {
+			    return single_quoted(boost_ptime_to_string(*arg));
+		    }
+		    else if constexpr (std::is_same_v<T, const boost::gregorian::date*>)
+		    {
+			    return single_quoted(boost_date_to_string(*arg));
+		    }
+		    else if constexpr (std::is_same_v<T, const boost::posix_time::time_duration*>)
+		    {
+			    return single_quoted(boost_time_duration_to_string(*arg));
+		    }
+#endif
+		    else
+		    {
+			    static_assert(always_false_v<T>, "non-exhaustive visitor!");
+			    return {};
+		    }
+	    },
+	    parameter.pointer());
+}
+
+} // namespace
+
+class slow_query_log::impl
+{
+	slow_query_log_options       options_;
+	std::atomic<std::uint64_t>   dropped_;
+	mutable std::mutex           mutex_;
+	std::condition_variable      cv_;
+	std::condition_variable      idle_cv_;
+	std::deque<slow_query>       queue_;
+	std::deque<slow_query>       recent_;
+	bool                         busy_;
+	bool                         stop_;
+	std::thread                  thread_;
+	std::atomic<std::thread::id> thread_id_;
+
+	slow_query make_record(const statement_event& event) const
+	{
+		slow_query record{ .query      = std::string{ event.query },
+			               .parameters = {},
+			               .time       = std::chrono::system_clock::now(),
+			               .duration   = event.duration,
+			               .rows       = event.rows,
+			               .plan       = {} };
+		if (event.parameters)
+		{
+			record.parameters.reserve(event.parameters->size());
+			for (const auto& [name, parameter] : *event.parameters)
+			{
+				if (this->options_.redact && this->options_.redact(name))
+				{
+					record.parameters.emplace_back(name, "<redacted>");
+					continue;
+				}
+				auto value = format_value(parameter);
+				if (value.length() > this->options_.max_parameter_length)
+				{
+					value.resize(this->options_.max_parameter_length);
+					value += "...";
+				}
+				record.parameters.emplace_back(name, std::move(value));
+			}
+		}
+		return record;
+	}
+
+	/// Captures the plan of @a record on an idle connection of the explain pool, if any
+	void explain(slow_query& record)
+	{
+		auto backend = this->options_.explain_pool->try_acquire(connection_priority::low);
+		if (!backend)
+		{
+			return;
+		}
+
+		try
+		{
+			connection  connection{ std::move(backend) };
+			std::string line{};
+			statement   statement{ connection, this->options_.explain_prefix + record.query };
+			statement.bind_result(this->options_.explain_column, line);
+			statement.execute();
+			while (statement.fetch())
+			{
+				record.plan += line;
+				record.plan += '\n';
+			}
+		}
+		catch (const std::exception& e)
+		{
+			record.plan = std::string{ "EXPLAIN failed: " } + e.what();
+		}
+	}
+
+	void run()
+	{
+		this->thread_id_ = std::this_thread::get_id();
+
+		std::unique_lock<std::mutex> lock{ this->mutex_ };
+		for (;;)
+		{
+			this->cv_.wait(lock, [this] { return this->stop_ || !this->queue_.empty(); });
+			if (this->queue_.empty())
+			{
+				break;
+			}
+
+			auto record = std::move(this->queue_.front());
+			this->queue_.pop_front();
+			this->busy_ = true;
+			lock.unlock();
+
+			if (this->options_.explain_pool)
+			{
+				this->explain(record);
+			}
+			if (this->options_.sink)
+			{
+				this->options_.sink(record);
+			}
+
+			lock.lock();
+			this->recent_.push_back(std::move(record));
+			if (this->recent_.size() > this->options_.capacity)
+			{
+				this->recent_.pop_front();
+			}
+			this->busy_ = false;
+			if (this->queue_.empty())
+			{
+				this->idle_cv_.notify_all();
+			}
+		}
+	}
+
+public:
+	explicit impl(const slow_query_log_options& options)
+	    : options_{ options }
+	    , dropped_{}
+	    , mutex_{}
+	    , cv_{}
+	    , idle_cv_{}
+	    , queue_{}
+	    , recent_{}
+	    , busy_{}
+	    , stop_{}
+	    , thread_{}
+	    , thread_id_{}
+	{
+		if (!this->options_.capacity)
+		{
+			throw error{ "The capacity of a slow query log must not be 0" };
+		}
+		this->thread_ = std::thread{ [this] { this->run(); } };
+	}
+
+	~impl() noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock{ this->mutex_ };
+			this->stop_ = true;
+		}
+		this->cv_.notify_one();
+		this->thread_.join();
+	}
+
+	impl(const impl&)            = delete;
+	impl(impl&& src)             = delete;
+	impl& operator=(const impl&) = delete;
+	impl& operator=(impl&&)      = delete;
+
+	void on_phase(const statement_event& event) noexcept
+	{
+		if (event.phase != statement_phase::execute || event.duration < this->options_.threshold ||
+		    std::this_thread::get_id() == this->thread_id_.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		try
+		{
+			auto record = this->make_record(event);
+			{
+				std::lock_guard<std::mutex> lock{ this->mutex_ };
+				if (this->queue_.size() == this->options_.capacity)
+				{
+					this->queue_.pop_front();
+					this->dropped_.fetch_add(1, std::memory_order_relaxed);
+				}
+				this->queue_.push_back(std::move(record));
+			}
+			this->cv_.notify_one();
+		}
+		catch (...)
+		{
+			this->dropped_.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void flush()
+	{
+		std::unique_lock<std::mutex> lock{ this->mutex_ };
+		this->idle_cv_.wait(lock, [this] { return this->queue_.empty() && !this->busy_; });
+	}
+
+	std::vector<slow_query> recent() const
+	{
+		std::lock_guard<std::mutex> lock{ this->mutex_ };
+		return std::vector<slow_query>{ this->recent_.begin(), this->recent_.end() };
+	}
+
+	std::uint64_t dropped() const noexcept
+	{
+		return this->dropped_.load(std::memory_order_relaxed);
+	}
+};
+
+slow_query_log::slow_query_log(const slow_query_log_options& options)
+    : statement_observer{}
+    , pimpl_{ std::make_unique<impl>(options) }
+{
+}
+
+slow_query_log::~slow_query_log() noexcept
+{
+}
+
+void slow_query_log::on_phase(const statement_event& event) noexcept
+{
+	this->pimpl_->on_phase(event);
+}
+
+void slow_query_log::flush()
+{
+	this->pimpl_->flush();
+}
+
+std::vector<slow_query> slow_query_log::recent() const
+{
+	return this->pimpl_->recent();
+}
+
+std::uint64_t slow_query_log::dropped() const noexcept
+{
+	return this->pimpl_->dropped();
+}
+
+} // namespace squid
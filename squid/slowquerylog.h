@@ -0,0 +1,105 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/api.h"
+#include "squid/statementobserver.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace squid {
+
+class connection_pool;
+
+/// A statement that was slower than the threshold of a slow_query_log
+struct SQUID_EXPORT slow_query
+{
+	std::string                                      query;      /// query text as passed to the backend
+	std::vector<std::pair<std::string, std::string>> parameters; /// bound parameters, by name, formatted as text
+	std::chrono::system_clock::time_point            time;       /// when the execute phase ended
+	std::chrono::nanoseconds                         duration;   /// duration of the execute phase
+	std::uint64_t                                    rows;       /// number of rows received by the execute phase
+	std::string                                      plan;       /// captured query plan, one line per row, empty if none
+};
+
+/// Options of a slow_query_log
+struct SQUID_EXPORT slow_query_log_options
+{
+	/// Statements whose execute phase takes at least this long are recorded
+	std::chrono::milliseconds threshold = std::chrono::milliseconds{ 100 };
+
+	/// Number of records that can wait for the background thread, and number of processed records kept for recent().
+	/// When the queue is full, the oldest waiting record is dropped.
+	std::size_t capacity = 256;
+
+	/// Whether the value of the parameter named @a name is replaced by "<redacted>", nullptr to log all values
+	std::function<bool(std::string_view name)> redact = nullptr;
+
+	/// Values of parameters longer than this are truncated
+	std::size_t max_parameter_length = 256;
+
+	/// Pool of the side connections on which the plans of slow queries are captured, nullptr to not capture plans.
+	/// A connection is only taken when one is idle, with a low priority, so capturing a plan never makes the
+	/// application wait for a connection. Must outlive the log.
+	connection_pool* explain_pool = nullptr;
+
+	/// Prefix of the query text that makes the backend return its plan, e.g. "EXPLAIN (ANALYZE false) " for
+	/// PostgreSQL, "EXPLAIN FORMAT=TREE " for MySQL or "EXPLAIN QUERY PLAN " for SQLite.
+	/// The plan is captured without the values of the parameters. PostgreSQL only accepts that for a query with
+	/// parameters with "EXPLAIN (GENERIC_PLAN) ", from version 16 on; SQLite plans with NULL values.
+	std::string explain_prefix = "EXPLAIN (ANALYZE false) ";
+
+	/// Name of the result column that holds the plan, e.g. "QUERY PLAN" for PostgreSQL, "EXPLAIN" for MySQL or
+	/// "detail" for SQLite
+	std::string explain_column = "QUERY PLAN";
+
+	/// Called for every record on the background thread, after its plan was captured. Must not throw.
+	std::function<void(const slow_query& query)> sink = nullptr;
+};
+
+/// A statement_observer that records slow statements.
+/// Recording a slow statement formats its parameters and queues the record; the plan is captured and the sink is
+/// called on a background thread, so the thread that executed the statement never waits for I/O.
+/// The statements that the background thread executes to capture plans are not recorded.
+class SQUID_EXPORT slow_query_log final : public statement_observer
+{
+	class impl;
+	std::unique_ptr<impl> pimpl_;
+
+public:
+	explicit slow_query_log(const slow_query_log_options& options = {});
+
+	/// Processes the records that are still queued, and stops the background thread
+	~slow_query_log() noexcept override;
+
+	slow_query_log(const slow_query_log&)            = delete;
+	slow_query_log(slow_query_log&& src)             = delete;
+	slow_query_log& operator=(const slow_query_log&) = delete;
+	slow_query_log& operator=(slow_query_log&&)      = delete;
+
+	void on_phase(const statement_event& event) noexcept override;
+
+	/// Wait until all queued records have been processed
+	void flush();
+
+	/// The last processed records, oldest first
+	std::vector<slow_query> recent() const;
+
+	/// Number of records dropped because the queue was full
+	std::uint64_t dropped() const noexcept;
+};
+
+} // namespace squid
@@ -10,6 +10,7 @@
 #include "squid/sqlite3/error.h"
 
 #include "squid/sqlite3/detail/isqliteapi.h"
+#include "squid/sqlite3/detail/statementcache.h"
 
 #include <sqlite3.h>
 
@@ -48,7 +49,7 @@ std::unique_ptr<ibackend_statement> backend_connection::create_statement(std::st
 
 std::unique_ptr<ibackend_statement> backend_connection::create_prepared_statement(std::string_view query)
 {
-	return std::make_unique<statement>(*this->api_, this->connection_, query, true);
+	return std::make_unique<statement>(*this->api_, this->connection_, query, true, this->statement_cache_);
 }
 
 void backend_connection::execute(const std::string& query)
@@ -59,13 +60,31 @@ void backend_connection::execute(const std::string& query)
 backend_connection::backend_connection(isqlite_api& api, const std::string& connection_info)
     : api_{ &api }
     , connection_{ connect_database(api, connection_info), [&api](sqlite3* db) { api.close(db); } }
+    , statement_cache_{ std::make_shared<statement_cache>(api, *this->connection_) }
 {
 }
 
+bool backend_connection::cancel()
+{
+	// sqlite3_interrupt may be called from any thread; it makes the running statement fail with SQLITE_INTERRUPT
+	this->api_->interrupt(this->connection_.get());
+	return true;
+}
+
 sqlite3& backend_connection::handle() const
 {
 	return *this->connection_;
 }
 
+statement_cache_stats backend_connection::prepared_statement_cache_stats() const
+{
+	return this->statement_cache_->stats();
+}
+
+void backend_connection::set_prepared_statement_cache_capacity(std::size_t capacity)
+{
+	this->statement_cache_->set_capacity(capacity);
+}
+
 } // namespace sqlite
 } // namespace squid
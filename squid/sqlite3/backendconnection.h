@@ -9,17 +9,20 @@
 
 #include "squid/api.h"
 #include "squid/ibackendconnection.h"
+#include "squid/sqlite3/statementcachestats.h"
 #include "squid/sqlite3/detail/sqlite3fwd.h"
 
 namespace squid {
 namespace sqlite {
 
 class isqlite_api;
+class statement_cache;
 
 class SQUID_EXPORT backend_connection final : public ibackend_connection
 {
-	isqlite_api*             api_;
-	std::shared_ptr<sqlite3> connection_;
+	isqlite_api*                     api_;
+	std::shared_ptr<sqlite3>         connection_;
+	std::shared_ptr<statement_cache> statement_cache_; // must be destroyed before connection_
 
 public:
 	/// @a connection_info must contain a path to a file
@@ -35,8 +38,16 @@ public:
 	std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override;
 	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override;
 	void                                execute(const std::string& query) override;
+	bool                                cancel() override;
 
 	sqlite3& handle() const;
+
+	/// Get the counters of the cache of compiled statements used by prepared statements on this connection.
+	statement_cache_stats prepared_statement_cache_stats() const;
+
+	/// Set the maximum number of idle compiled statements that are kept for prepared statements on this connection,
+	/// finalizing the least recently used ones if needed. A capacity of 0 disables caching.
+	void set_prepared_statement_cache_capacity(std::size_t capacity);
 };
 
 } // namespace sqlite
@@ -29,12 +29,16 @@ public:
 	virtual int open(const char* filename, sqlite3** ppDb) = 0;
 	virtual int close(sqlite3* db)                         = 0;
 
+	virtual void interrupt(sqlite3* db) = 0;
+
 	virtual int64_t changes64(sqlite3* db) = 0;
 
-	virtual int prepare_v2(sqlite3* db, const char* zSql, int nByte, sqlite3_stmt** ppStmt, const char** pzTail) = 0;
-	virtual int finalize(sqlite3_stmt* pStmt)                                                                    = 0;
-	virtual int step(sqlite3_stmt* pStmt)                                                                        = 0;
-	virtual int reset(sqlite3_stmt* pStmt)                                                                       = 0;
+	virtual int prepare_v2(sqlite3* db, const char* zSql, int nByte, sqlite3_stmt** ppStmt, const char** pzTail)                     = 0;
+	virtual int prepare_v3(sqlite3* db, const char* zSql, int nByte, unsigned prepFlags, sqlite3_stmt** ppStmt, const char** pzTail) = 0;
+	virtual int finalize(sqlite3_stmt* pStmt)                                                                                        = 0;
+	virtual int step(sqlite3_stmt* pStmt)                                                                                            = 0;
+	virtual int reset(sqlite3_stmt* pStmt)                                                                                           = 0;
+	virtual int clear_bindings(sqlite3_stmt* pStmt)                                                                                  = 0;
 
 	virtual int bind_parameter_index(sqlite3_stmt* pStmt, const char* zName)                                        = 0;
 	virtual int bind_null(sqlite3_stmt* pStmt, int index)                                                           = 0;
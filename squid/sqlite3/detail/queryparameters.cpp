@@ -9,6 +9,7 @@
 
 #include "squid/sqlite3/error.h"
 #include "squid/sqlite3/detail/isqliteapi.h"
+#include "squid/sqlite3/detail/sqliteapi.h"
 
 #include "squid/detail/conversions.h"
 #include "squid/detail/always_false.h"
@@ -16,6 +17,7 @@
 #include <sqlite3.h>
 
 #include <iomanip>
+#include <iterator>
 #include <cassert>
 
 #ifdef SQUID_DEBUG_SQLITE
@@ -29,7 +31,8 @@ namespace sqlite {
 
 namespace {
 
-void bind_parameter(isqlite_api& api, sqlite3& connection, sqlite3_stmt& statement, const std::string& name, const parameter& parameter)
+template<class Api>
+void bind_parameter(Api& api, sqlite3& connection, sqlite3_stmt& statement, const std::string& name, const parameter& parameter)
 {
 	auto tmp_name        = ":" + name;
 	auto parameter_index = api.bind_parameter_index(&statement, tmp_name.c_str());
@@ -111,18 +114,24 @@ void bind_parameter(isqlite_api& api, sqlite3& connection, sqlite3_stmt& stateme
 		    }
 		    else if constexpr (std::is_same_v<T, const time_point*>)
 		    {
-			    auto tmp = time_point_to_string(*arg);
-			    BIND(api.bind_text, tmp.data(), static_cast<int>(tmp.length()), SQLITE_TRANSIENT);
+			    char       tmp[max_date_time_chars];
+			    const auto res = time_point_to_chars(std::begin(tmp), std::end(tmp), *arg);
+			    assert(res.ec == std::errc{});
+			    BIND(api.bind_text, tmp, static_cast<int>(res.ptr - tmp), SQLITE_TRANSIENT);
 		    }
 		    else if constexpr (std::is_same_v<T, const date*>)
 		    {
-			    auto tmp = date_to_string(*arg);
-			    BIND(api.bind_text, tmp.data(), static_cast<int>(tmp.length()), SQLITE_TRANSIENT);
+			    char       tmp[max_date_time_chars];
+			    const auto res = date_to_chars(std::begin(tmp), std::end(tmp), *arg);
+			    assert(res.ec == std::errc{});
+			    BIND(api.bind_text, tmp, static_cast<int>(res.ptr - tmp), SQLITE_TRANSIENT);
 		    }
 		    else if constexpr (std::is_same_v<T, const time_of_day*>)
 		    {
-			    auto tmp = time_of_day_to_string(*arg);
-			    BIND(api.bind_text, tmp.data(), static_cast<int>(tmp.length()), SQLITE_TRANSIENT);
+			    char       tmp[max_date_time_chars];
+			    const auto res = time_of_day_to_chars(std::begin(tmp), std::end(tmp), *arg);
+			    assert(res.ec == std::errc{});
+			    BIND(api.bind_text, tmp, static_cast<int>(res.ptr - tmp), SQLITE_TRANSIENT);
 		    }
 #ifdef SQUID_HAVE_BOOST_DATE_TIME
 		    else if constexpr (std::is_same_v<T, const boost::posix_time::ptime*>)
@@ -151,8 +160,11 @@ void bind_parameter(isqlite_api& api, sqlite3& connection, sqlite3_stmt& stateme
 
 } // namespace
 
-/*static*/ void
-query_parameters::bind(isqlite_api& api, sqlite3& connection, sqlite3_stmt& statement, const std::map<std::string, parameter>& parameters)
+template<class Api>
+/*static*/ void basic_query_parameters<Api>::bind(Api&                                    api,
+                                                 sqlite3&                                connection,
+                                                 sqlite3_stmt&                           statement,
+                                                 const std::map<std::string, parameter>& parameters)
 {
 	for (const auto& pair : parameters)
 	{
@@ -160,5 +172,8 @@ query_parameters::bind(isqlite_api& api, sqlite3& connection, sqlite3_stmt& stat
 	}
 }
 
+template class basic_query_parameters<isqlite_api>;
+template class basic_query_parameters<sqlite_api>;
+
 } // namespace sqlite
 } // namespace squid
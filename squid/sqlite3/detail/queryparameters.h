@@ -17,14 +17,23 @@ namespace squid {
 namespace sqlite {
 
 class isqlite_api;
+class sqlite_api;
 
-class query_parameters final
+/// @a Api is either isqlite_api (calls go through the vtable, e.g. to a mock)
+/// or the final sqlite_api (calls to sqlite3_* are resolved at compile time).
+template<class Api>
+class basic_query_parameters final
 {
 public:
-	query_parameters() = delete;
+	basic_query_parameters() = delete;
 
-	static void bind(isqlite_api& api, sqlite3& connection, sqlite3_stmt& statement, const std::map<std::string, parameter>& parameters);
+	static void bind(Api& api, sqlite3& connection, sqlite3_stmt& statement, const std::map<std::string, parameter>& parameters);
 };
 
+extern template class basic_query_parameters<isqlite_api>;
+extern template class basic_query_parameters<sqlite_api>;
+
+using query_parameters = basic_query_parameters<isqlite_api>;
+
 } // namespace sqlite
 } // namespace squid
@@ -9,6 +9,7 @@
 
 #include "squid/sqlite3/error.h"
 #include "squid/sqlite3/detail/isqliteapi.h"
+#include "squid/sqlite3/detail/sqliteapi.h"
 
 #include "squid/detail/always_false.h"
 #include "squid/detail/conversions.h"
@@ -28,7 +29,8 @@ namespace sqlite {
 
 namespace {
 
-void store_string(isqlite_api&     api,
+template<class Api>
+void store_string(Api&             api,
                   sqlite3&         connection,
                   sqlite3_stmt&    statement,
                   int              column,
@@ -52,7 +54,8 @@ void store_string(isqlite_api&     api,
 	out.assign(reinterpret_cast<const char*>(ptr), len);
 }
 
-void store_result(isqlite_api&                     api,
+template<class Api>
+void store_result(Api&                             api,
                   sqlite3&                         connection,
                   sqlite3_stmt&                    statement,
                   const result::non_nullable_type& result,
@@ -173,7 +176,8 @@ void store_result(isqlite_api&                     api,
 	    result);
 }
 
-void store_result(isqlite_api&     api,
+template<class Api>
+void store_result(Api&             api,
                   sqlite3&         connection,
                   sqlite3_stmt&    statement,
                   const result&    result,
@@ -243,7 +247,8 @@ void store_result(isqlite_api&     api,
 
 } // namespace
 
-struct query_results::column
+template<class Api>
+struct basic_query_results<Api>::column
 {
 	result           res;
 	std::string_view name;
@@ -259,7 +264,8 @@ struct query_results::column
 	}
 };
 
-query_results::query_results(isqlite_api& api, std::shared_ptr<sqlite3> connection, std::shared_ptr<sqlite3_stmt> statement)
+template<class Api>
+basic_query_results<Api>::basic_query_results(Api& api, std::shared_ptr<sqlite3> connection, std::shared_ptr<sqlite3_stmt> statement)
     : api_{ &api }
     , connection_{ std::move(connection) }
     , statement_{ std::move(statement) }
@@ -279,11 +285,12 @@ query_results::query_results(isqlite_api& api, std::shared_ptr<sqlite3> connecti
 	this->field_count_ = static_cast<size_t>(column_count);
 }
 
-query_results::query_results(isqlite_api&                  api,
-                             std::shared_ptr<sqlite3>      connection,
-                             std::shared_ptr<sqlite3_stmt> statement,
-                             const std::vector<result>&    results)
-    : query_results{ api, connection, statement }
+template<class Api>
+basic_query_results<Api>::basic_query_results(Api&                          api,
+                                              std::shared_ptr<sqlite3>      connection,
+                                              std::shared_ptr<sqlite3_stmt> statement,
+                                              const std::vector<result>&    results)
+    : basic_query_results{ api, connection, statement }
 {
 	if (results.size() > this->field_count_)
 	{
@@ -307,11 +314,12 @@ query_results::query_results(isqlite_api&                  api,
 	}
 }
 
-query_results::query_results(isqlite_api&                         api,
-                             std::shared_ptr<sqlite3>             connection,
-                             std::shared_ptr<sqlite3_stmt>        statement,
-                             const std::map<std::string, result>& results)
-    : query_results{ api, connection, statement }
+template<class Api>
+basic_query_results<Api>::basic_query_results(Api&                                 api,
+                                              std::shared_ptr<sqlite3>             connection,
+                                              std::shared_ptr<sqlite3_stmt>        statement,
+                                              const std::map<std::string, result>& results)
+    : basic_query_results{ api, connection, statement }
 {
 	if (results.size() > this->field_count_)
 	{
@@ -346,16 +354,19 @@ query_results::query_results(isqlite_api&                         api,
 	}
 }
 
-query_results::~query_results() noexcept
+template<class Api>
+basic_query_results<Api>::~basic_query_results() noexcept
 {
 }
 
-size_t query_results::field_count() const
+template<class Api>
+size_t basic_query_results<Api>::field_count() const
 {
 	return this->field_count_;
 }
 
-std::string query_results::field_name(std::size_t index) const
+template<class Api>
+std::string basic_query_results<Api>::field_name(std::size_t index) const
 {
 	assert(this->api_);
 	assert(this->statement_);
@@ -370,7 +381,8 @@ std::string query_results::field_name(std::size_t index) const
 	return name;
 }
 
-void query_results::fetch()
+template<class Api>
+void basic_query_results<Api>::fetch()
 {
 	assert(this->api_);
 	assert(this->connection_);
@@ -382,5 +394,8 @@ void query_results::fetch()
 	}
 }
 
+template class basic_query_results<isqlite_api>;
+template class basic_query_results<sqlite_api>;
+
 } // namespace sqlite
 } // namespace squid
@@ -18,31 +18,35 @@ namespace squid {
 namespace sqlite {
 
 class isqlite_api;
+class sqlite_api;
 
-class query_results
+/// @a Api is either isqlite_api (calls go through the vtable, e.g. to a mock)
+/// or the final sqlite_api (calls to sqlite3_* are resolved at compile time).
+template<class Api>
+class basic_query_results
 {
 	struct column;
 
-	isqlite_api*                         api_;
+	Api*                                 api_;
 	std::shared_ptr<sqlite3>             connection_;
 	std::shared_ptr<sqlite3_stmt>        statement_;
 	std::vector<std::unique_ptr<column>> columns_;
 	size_t                               field_count_; // number of fields in the statement, may differ from columns_.size()
 
-	explicit query_results(isqlite_api& api, std::shared_ptr<sqlite3> connection, std::shared_ptr<sqlite3_stmt> statement);
+	explicit basic_query_results(Api& api, std::shared_ptr<sqlite3> connection, std::shared_ptr<sqlite3_stmt> statement);
 
 public:
-	explicit query_results(isqlite_api&                  api,
-	                       std::shared_ptr<sqlite3>      connection,
-	                       std::shared_ptr<sqlite3_stmt> statement,
-	                       const std::vector<result>&    results);
+	explicit basic_query_results(Api&                          api,
+	                             std::shared_ptr<sqlite3>      connection,
+	                             std::shared_ptr<sqlite3_stmt> statement,
+	                             const std::vector<result>&    results);
 
-	explicit query_results(isqlite_api&                         api,
-	                       std::shared_ptr<sqlite3>             connection,
-	                       std::shared_ptr<sqlite3_stmt>        statement,
-	                       const std::map<std::string, result>& results);
+	explicit basic_query_results(Api&                                 api,
+	                             std::shared_ptr<sqlite3>             connection,
+	                             std::shared_ptr<sqlite3_stmt>        statement,
+	                             const std::map<std::string, result>& results);
 
-	~query_results() noexcept;
+	~basic_query_results() noexcept;
 
 	size_t      field_count() const;
 	std::string field_name(std::size_t index) const;
@@ -50,5 +54,10 @@ public:
 	void fetch();
 };
 
+extern template class basic_query_results<isqlite_api>;
+extern template class basic_query_results<sqlite_api>;
+
+using query_results = basic_query_results<isqlite_api>;
+
 } // namespace sqlite
 } // namespace squid
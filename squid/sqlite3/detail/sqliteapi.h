@@ -9,10 +9,15 @@
 
 #include "isqliteapi.h"
 
+#include <sqlite3.h>
+
 namespace squid {
 namespace sqlite {
 
-class sqlite_api : public isqlite_api
+/// Production implementation of isqlite_api.
+/// The class is final and its methods are defined inline, so code that is instantiated with
+/// sqlite_api as API type calls the sqlite3_* functions directly instead of through the vtable.
+class sqlite_api final : public isqlite_api
 {
 public:
 	sqlite_api();
@@ -24,38 +29,150 @@ public:
 	sqlite_api& operator=(sqlite_api&&)      = delete;
 	sqlite_api& operator=(const sqlite_api&) = delete;
 
-	int open(const char* filename, sqlite3** ppDb) override;
-	int close(sqlite3* db) override;
-
-	int64_t changes64(sqlite3* db) override;
-
-	int prepare_v2(sqlite3* db, const char* zSql, int nByte, sqlite3_stmt** ppStmt, const char** pzTail) override;
-	int finalize(sqlite3_stmt* pStmt) override;
-	int step(sqlite3_stmt* pStmt) override;
-	int reset(sqlite3_stmt* pStmt) override;
-
-	int bind_parameter_index(sqlite3_stmt* pStmt, const char* zName) override;
-	int bind_null(sqlite3_stmt* pStmt, int index) override;
-	int bind_int(sqlite3_stmt* pStmt, int index, int value) override;
-	int bind_int64(sqlite3_stmt* pStmt, int index, int64_t value) override;
-	int bind_double(sqlite3_stmt* pStmt, int index, double value) override;
-	int bind_text(sqlite3_stmt* pStmt, int index, const char* value, int length, void (*destructor)(void*)) override;
-	int bind_blob(sqlite3_stmt* pStmt, int index, const void* value, int length, void (*destructor)(void*)) override;
-
-	int                  column_int(sqlite3_stmt* pStmt, int index) override;
-	int64_t              column_int64(sqlite3_stmt* pStmt, int index) override;
-	double               column_double(sqlite3_stmt* pStmt, int index) override;
-	const unsigned char* column_text(sqlite3_stmt* pStmt, int index) override;
-	const void*          column_blob(sqlite3_stmt* pStmt, int index) override;
-	int                  column_bytes(sqlite3_stmt* pStmt, int index) override;
-
-	int         column_count(sqlite3_stmt* pStmt) override;
-	const char* column_name(sqlite3_stmt* pStmt, int index) override;
-	int         column_type(sqlite3_stmt* pStmt, int index) override;
-
-	int         errcode(sqlite3* db) override;
-	const char* errstr(int ec) override;
-	const char* errmsg(sqlite3* db) override;
+	int open(const char* filename, sqlite3** ppDb) override
+	{
+		return sqlite3_open(filename, ppDb);
+	}
+
+	int close(sqlite3* db) override
+	{
+		return sqlite3_close(db);
+	}
+
+	void interrupt(sqlite3* db) override
+	{
+		sqlite3_interrupt(db);
+	}
+
+	int64_t changes64(sqlite3* db) override
+	{
+		return static_cast<int64_t>(sqlite3_changes64(db));
+	}
+
+	int prepare_v2(sqlite3* db, const char* zSql, int nByte, sqlite3_stmt** ppStmt, const char** pzTail) override
+	{
+		return sqlite3_prepare_v2(db, zSql, nByte, ppStmt, pzTail);
+	}
+
+	int prepare_v3(sqlite3* db, const char* zSql, int nByte, unsigned prepFlags, sqlite3_stmt** ppStmt, const char** pzTail) override
+	{
+		return sqlite3_prepare_v3(db, zSql, nByte, prepFlags, ppStmt, pzTail);
+	}
+
+	int finalize(sqlite3_stmt* pStmt) override
+	{
+		return sqlite3_finalize(pStmt);
+	}
+
+	int step(sqlite3_stmt* pStmt) override
+	{
+		return sqlite3_step(pStmt);
+	}
+
+	int reset(sqlite3_stmt* pStmt) override
+	{
+		return sqlite3_reset(pStmt);
+	}
+
+	int clear_bindings(sqlite3_stmt* pStmt) override
+	{
+		return sqlite3_clear_bindings(pStmt);
+	}
+
+	int bind_parameter_index(sqlite3_stmt* pStmt, const char* zName) override
+	{
+		return sqlite3_bind_parameter_index(pStmt, zName);
+	}
+
+	int bind_null(sqlite3_stmt* pStmt, int index) override
+	{
+		return sqlite3_bind_null(pStmt, index);
+	}
+
+	int bind_int(sqlite3_stmt* pStmt, int index, int value) override
+	{
+		return sqlite3_bind_int(pStmt, index, value);
+	}
+
+	int bind_int64(sqlite3_stmt* pStmt, int index, int64_t value) override
+	{
+		return sqlite3_bind_int64(pStmt, index, static_cast<sqlite3_int64>(value));
+	}
+
+	int bind_double(sqlite3_stmt* pStmt, int index, double value) override
+	{
+		return sqlite3_bind_double(pStmt, index, value);
+	}
+
+	int bind_text(sqlite3_stmt* pStmt, int index, const char* value, int length, void (*destructor)(void*)) override
+	{
+		return sqlite3_bind_text(pStmt, index, value, length, destructor);
+	}
+
+	int bind_blob(sqlite3_stmt* pStmt, int index, const void* value, int length, void (*destructor)(void*)) override
+	{
+		return sqlite3_bind_blob(pStmt, index, value, length, destructor);
+	}
+
+	int column_int(sqlite3_stmt* pStmt, int index) override
+	{
+		return sqlite3_column_int(pStmt, index);
+	}
+
+	int64_t column_int64(sqlite3_stmt* pStmt, int index) override
+	{
+		return static_cast<int64_t>(sqlite3_column_int64(pStmt, index));
+	}
+
+	double column_double(sqlite3_stmt* pStmt, int index) override
+	{
+		return sqlite3_column_double(pStmt, index);
+	}
+
+	const unsigned char* column_text(sqlite3_stmt* pStmt, int index) override
+	{
+		return sqlite3_column_text(pStmt, index);
+	}
+
+	const void* column_blob(sqlite3_stmt* pStmt, int index) override
+	{
+		return sqlite3_column_blob(pStmt, index);
+	}
+
+	int column_bytes(sqlite3_stmt* pStmt, int index) override
+	{
+		return sqlite3_column_bytes(pStmt, index);
+	}
+
+	int column_count(sqlite3_stmt* pStmt) override
+	{
+		return sqlite3_column_count(pStmt);
+	}
+
+	const char* column_name(sqlite3_stmt* pStmt, int index) override
+	{
+		return sqlite3_column_name(pStmt, index);
+	}
+
+	int column_type(sqlite3_stmt* pStmt, int index) override
+	{
+		return sqlite3_column_type(pStmt, index);
+	}
+
+	int errcode(sqlite3* db) override
+	{
+		return sqlite3_errcode(db);
+	}
+
+	const char* errstr(int ec) override
+	{
+		return sqlite3_errstr(ec);
+	}
+
+	const char* errmsg(sqlite3* db) override
+	{
+		return sqlite3_errmsg(db);
+	}
 };
 
 } // namespace sqlite
@@ -45,12 +45,19 @@ public:
 
 	MOCK_METHOD(int, close, (sqlite3 * db), (override));
 
+	MOCK_METHOD(void, interrupt, (sqlite3 * db), (override));
+
 	MOCK_METHOD(int64_t, changes64, (sqlite3 * db), (override));
 
 	MOCK_METHOD(int, prepare_v2, (sqlite3 * db, const char* zSql, int nByte, sqlite3_stmt** ppStmt, const char** pzTail), (override));
+	MOCK_METHOD(int,
+	            prepare_v3,
+	            (sqlite3 * db, const char* zSql, int nByte, unsigned prepFlags, sqlite3_stmt** ppStmt, const char** pzTail),
+	            (override));
 	MOCK_METHOD(int, finalize, (sqlite3_stmt * pStmt), (override));
 	MOCK_METHOD(int, step, (sqlite3_stmt * pStmt), (override));
 	MOCK_METHOD(int, reset, (sqlite3_stmt * pStmt), (override));
+	MOCK_METHOD(int, clear_bindings, (sqlite3_stmt * pStmt), (override));
 
 	MOCK_METHOD(int, bind_parameter_index, (sqlite3_stmt * pStmt, const char* zName), (override));
 	MOCK_METHOD(int, bind_null, (sqlite3_stmt * pStmt, int index), (override));
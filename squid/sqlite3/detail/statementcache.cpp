@@ -0,0 +1,166 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "statementcache.h"
+
+#include "squid/sqlite3/error.h"
+#include "squid/sqlite3/detail/isqliteapi.h"
+
+#include "squid/detail/probes.h"
+
+#include <cassert>
+
+#ifdef SQUID_DEBUG_SQLITE
+#include <iostream>
+#endif
+
+#include <sqlite3.h>
+
+namespace squid {
+namespace sqlite {
+
+namespace {
+
+sqlite3_stmt* prepare_persistent_statement(isqlite_api& api, sqlite3& connection, const std::string& query)
+{
+#ifdef SQUID_DEBUG_SQLITE
+	std::cout << "preparing persistent: " << query << "\n";
+#endif
+
+	const auto    start = probe_start(SQUID_PROBE_ENABLED(backend__prepare));
+	sqlite3_stmt* stmt{ nullptr };
+	auto          rc = api.prepare_v3(&connection, query.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+
+	if (SQLITE_OK != rc)
+	{
+		throw error{ api, "sqlite3_prepare_v3 failed", connection };
+	}
+	else if (!stmt)
+	{
+		throw error{ api, "sqlite3_prepare_v3 did not set the statement handle", connection };
+	}
+	else
+	{
+		SQUID_PROBE(backend__prepare, "sqlite", query.c_str(), probe_nanoseconds(start));
+		return stmt;
+	}
+}
+
+} // namespace
+
+statement_cache::statement_cache(isqlite_api& api, sqlite3& connection, std::size_t capacity)
+    : api_{ &api }
+    , connection_{ &connection }
+    , capacity_{ capacity }
+    , lru_{}
+    , index_{}
+    , hits_{}
+    , misses_{}
+{
+}
+
+statement_cache::~statement_cache() noexcept
+{
+	this->evict(0);
+}
+
+std::shared_ptr<sqlite3_stmt> statement_cache::acquire(const std::string& query)
+{
+	// Returns the statement to the cache, or finalizes it if the cache no longer exists.
+	auto deleter = [cache = this->weak_from_this(), api = this->api_, query = std::string{ query }](sqlite3_stmt* statement) mutable {
+		if (auto self = cache.lock())
+		{
+			self->release(std::move(query), statement);
+		}
+		else
+		{
+			api->finalize(statement);
+		}
+	};
+
+	sqlite3_stmt* statement{ nullptr };
+
+	auto it = this->index_.find(query);
+	if (it != this->index_.end())
+	{
+		// Take the statement out of the cache, so that it cannot be handed out twice.
+		// It was already reset when it was released.
+		const auto lru_entry = it->second;
+		statement            = lru_entry->statement;
+		this->index_.erase(it);
+		this->lru_.erase(lru_entry);
+		++this->hits_;
+	}
+	else
+	{
+		++this->misses_;
+		statement = prepare_persistent_statement(*this->api_, *this->connection_, query);
+	}
+
+	return std::shared_ptr<sqlite3_stmt>{ statement, std::move(deleter) };
+}
+
+void statement_cache::release(std::string&& query, sqlite3_stmt* statement) noexcept
+{
+	assert(statement);
+
+	// The return value of sqlite3_reset only repeats the error of the last step, if any.
+	this->api_->reset(statement);
+	this->api_->clear_bindings(statement);
+
+	if (this->capacity_ == 0 || this->index_.contains(query))
+	{
+		this->api_->finalize(statement);
+		return;
+	}
+
+	try
+	{
+		this->lru_.push_front(entry{ std::move(query), statement });
+		try
+		{
+			this->index_.emplace(this->lru_.front().query, this->lru_.begin());
+		}
+		catch (...)
+		{
+			this->lru_.pop_front();
+			throw;
+		}
+	}
+	catch (...)
+	{
+		this->api_->finalize(statement);
+		return;
+	}
+
+	this->evict(this->capacity_);
+}
+
+void statement_cache::evict(std::size_t capacity) noexcept
+{
+	while (this->lru_.size() > capacity)
+	{
+		auto& lru = this->lru_.back();
+		this->index_.erase(lru.query);
+		this->api_->finalize(lru.statement);
+		this->lru_.pop_back();
+	}
+}
+
+void statement_cache::set_capacity(std::size_t capacity)
+{
+	this->capacity_ = capacity;
+	this->evict(capacity);
+}
+
+statement_cache_stats statement_cache::stats() const
+{
+	return statement_cache_stats{ .hits = this->hits_, .misses = this->misses_, .size = this->lru_.size(), .capacity = this->capacity_ };
+}
+
+} // namespace sqlite
+} // namespace squid
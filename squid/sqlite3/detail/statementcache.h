@@ -0,0 +1,77 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/sqlite3/statementcachestats.h"
+#include "squid/sqlite3/detail/sqlite3fwd.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace squid {
+namespace sqlite {
+
+class isqlite_api;
+
+/// LRU cache of compiled statements of one SQLite connection, keyed by SQL text.
+/// Statements are compiled with sqlite3_prepare_v3 and SQLITE_PREPARE_PERSISTENT.
+/// A statement acquired from the cache is returned to it when the last shared pointer to it
+/// is released; it is then reset and its bindings are cleared. When the cache is full, the
+/// least recently used statement is finalized.
+/// Like the connection itself, the cache must not be used by multiple threads simultaneously.
+class statement_cache final : public std::enable_shared_from_this<statement_cache>
+{
+	struct entry
+	{
+		std::string   query;
+		sqlite3_stmt* statement;
+	};
+
+	using entry_list = std::list<entry>;
+
+	isqlite_api*                                               api_;
+	sqlite3*                                                   connection_;
+	std::size_t                                                capacity_;
+	entry_list                                                 lru_;   // most recently used first
+	std::unordered_map<std::string_view, entry_list::iterator> index_; // keys refer to entry::query
+	std::uint64_t                                              hits_;
+	std::uint64_t                                              misses_;
+
+	void release(std::string&& query, sqlite3_stmt* statement) noexcept;
+	void evict(std::size_t capacity) noexcept;
+
+public:
+	static constexpr std::size_t default_capacity = 32;
+
+	explicit statement_cache(isqlite_api& api, sqlite3& connection, std::size_t capacity = default_capacity);
+
+	/// Finalizes all idle statements.
+	/// Statements that are still in use are finalized when they are released.
+	~statement_cache() noexcept;
+
+	statement_cache(const statement_cache&)            = delete;
+	statement_cache(statement_cache&& src)             = delete;
+	statement_cache& operator=(const statement_cache&) = delete;
+	statement_cache& operator=(statement_cache&&)      = delete;
+
+	/// Get a compiled statement for @a query, either from the cache or freshly compiled.
+	std::shared_ptr<sqlite3_stmt> acquire(const std::string& query);
+
+	/// Set the maximum number of idle statements, finalizing the least recently used ones if needed.
+	/// A capacity of 0 disables caching.
+	void set_capacity(std::size_t capacity);
+
+	statement_cache_stats stats() const;
+};
+
+} // namespace sqlite
+} // namespace squid
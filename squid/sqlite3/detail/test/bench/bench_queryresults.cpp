@@ -0,0 +1,140 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Row decoding throughput of basic_query_results, instantiated with the final sqlite_api
+// (direct sqlite3_* calls) versus the isqlite_api interface (one virtual call per column access).
+
+#include <squid/sqlite3/detail/queryresults.h>
+#include <squid/sqlite3/detail/sqliteapi.h>
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace squid {
+namespace sqlite {
+
+namespace {
+
+constexpr int row_count   = 200000;
+constexpr int repetitions = 5;
+
+void exec(sqlite3* db, const char* sql)
+{
+	if (SQLITE_OK != sqlite3_exec(db, sql, nullptr, nullptr, nullptr))
+	{
+		throw std::runtime_error{ sqlite3_errmsg(db) };
+	}
+}
+
+std::shared_ptr<sqlite3> create_database()
+{
+	sqlite3* handle{};
+	if (SQLITE_OK != sqlite3_open(":memory:", &handle))
+	{
+		throw std::runtime_error{ "sqlite3_open failed" };
+	}
+	std::shared_ptr<sqlite3> db{ handle, sqlite3_close };
+
+	exec(db.get(), "CREATE TABLE t(i INTEGER, l INTEGER, d REAL, s TEXT)");
+	exec(db.get(), "BEGIN");
+	exec(db.get(),
+	     ("WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < " + std::to_string(row_count) +
+	      ") INSERT INTO t SELECT x, x * 1000003, x / 7.0, 'row number ' || x FROM c")
+	         .c_str());
+	exec(db.get(), "COMMIT");
+
+	return db;
+}
+
+template<class Api>
+double decode_all_rows(Api& api, std::shared_ptr<sqlite3> db)
+{
+	sqlite3_stmt* handle{};
+	if (SQLITE_OK != sqlite3_prepare_v2(db.get(), "SELECT i, l, d, s FROM t", -1, &handle, nullptr))
+	{
+		throw std::runtime_error{ sqlite3_errmsg(db.get()) };
+	}
+	std::shared_ptr<sqlite3_stmt> statement{ handle, sqlite3_finalize };
+
+	int          i{};
+	std::int64_t l{};
+	double       d{};
+	std::string  s{};
+
+	const auto results = std::vector<result>{ result{ i }, result{ l }, result{ d }, result{ s } };
+
+	const auto start = std::chrono::steady_clock::now();
+
+	// As in statement::execute, the first step precedes the construction of the query results
+	auto                     rc = sqlite3_step(statement.get());
+	basic_query_results<Api> query_results{ api, db, statement, results };
+	int                      rows = 0;
+	while (SQLITE_ROW == rc)
+	{
+		query_results.fetch();
+		++rows;
+		rc = sqlite3_step(statement.get());
+	}
+
+	const auto elapsed = std::chrono::duration<double, std::nano>{ std::chrono::steady_clock::now() - start };
+
+	if (rows != row_count)
+	{
+		throw std::runtime_error{ "unexpected row count" };
+	}
+
+	return elapsed.count() / rows;
+}
+
+template<class Api>
+double best_of(Api& api, std::shared_ptr<sqlite3> db)
+{
+	auto best = decode_all_rows(api, db);
+	for (int n = 1; n < repetitions; ++n)
+	{
+		best = std::min(best, decode_all_rows(api, db));
+	}
+	return best;
+}
+
+} // namespace
+
+} // namespace sqlite
+} // namespace squid
+
+int main()
+{
+	using namespace squid::sqlite;
+
+	try
+	{
+		const auto db = create_database();
+
+		sqlite_api   api{};
+		isqlite_api& interface = api;
+
+		const auto direct   = best_of(api, db);
+		const auto indirect = best_of(interface, db);
+
+		std::cout << "rows per run:            " << row_count << "\n";
+		std::cout << "sqlite_api (direct):     " << direct << " ns/row\n";
+		std::cout << "isqlite_api (virtual):   " << indirect << " ns/row\n";
+		std::cout << "speedup:                 " << indirect / direct << "x\n";
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,156 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/sqlite3/detail/statementcache.h>
+#include <squid/sqlite3/detail/sqliteapimock.h>
+#include <sqlite3.h>
+
+namespace squid {
+namespace sqlite {
+
+namespace {
+
+static constexpr auto g_query       = "select foo from bar";
+static constexpr auto g_other_query = "select bar from foo";
+
+sqlite3_stmt g_other_statement;
+
+void set_statement_handle(sqlite3*, const char*, int, unsigned, sqlite3_stmt** ppStmt, const char**)
+{
+	*ppStmt = sqlite_api_mock::test_statement;
+}
+
+void set_other_statement_handle(sqlite3*, const char*, int, unsigned, sqlite3_stmt** ppStmt, const char**)
+{
+	*ppStmt = &g_other_statement;
+}
+
+} // namespace
+
+TEST(StatementCacheTests, TestMissThenHit)
+{
+	auto api = sqlite_api_mock_nice{};
+
+	EXPECT_CALL(api,
+	            prepare_v3(sqlite_api_mock::test_connection,
+	                       testing::StrEq(g_query),
+	                       -1,
+	                       static_cast<unsigned>(SQLITE_PREPARE_PERSISTENT),
+	                       testing::NotNull(),
+	                       nullptr))
+	    .WillOnce(testing::DoAll(&set_statement_handle, testing::Return(SQLITE_OK)));
+	EXPECT_CALL(api, reset(sqlite_api_mock::test_statement)).Times(2);
+	EXPECT_CALL(api, clear_bindings(sqlite_api_mock::test_statement)).Times(2);
+	EXPECT_CALL(api, finalize(sqlite_api_mock::test_statement)).Times(1); // by the cache destructor
+
+	auto cache = std::make_shared<statement_cache>(api, *sqlite_api_mock::test_connection);
+
+	EXPECT_EQ(cache->acquire(g_query).get(), sqlite_api_mock::test_statement);
+	EXPECT_EQ(cache->acquire(g_query).get(), sqlite_api_mock::test_statement);
+
+	const auto stats = cache->stats();
+	EXPECT_EQ(stats.misses, 1u);
+	EXPECT_EQ(stats.hits, 1u);
+	EXPECT_EQ(stats.size, 1u);
+}
+
+TEST(StatementCacheTests, TestStatementInUseIsNotHandedOutTwice)
+{
+	auto api = sqlite_api_mock_nice{};
+
+	EXPECT_CALL(api, prepare_v3(sqlite_api_mock::test_connection, testing::StrEq(g_query), -1, testing::_, testing::NotNull(), nullptr))
+	    .WillOnce(testing::DoAll(&set_statement_handle, testing::Return(SQLITE_OK)))
+	    .WillOnce(testing::DoAll(&set_other_statement_handle, testing::Return(SQLITE_OK)));
+
+	// Only one idle statement per query is kept.
+	// The second statement is released first, so the first one is finalized when it is released.
+	EXPECT_CALL(api, finalize(sqlite_api_mock::test_statement)).Times(1);
+
+	auto cache = std::make_shared<statement_cache>(api, *sqlite_api_mock::test_connection);
+	{
+		auto first  = cache->acquire(g_query);
+		auto second = cache->acquire(g_query);
+		EXPECT_NE(first.get(), second.get());
+	}
+
+	EXPECT_EQ(cache->stats().misses, 2u);
+	EXPECT_EQ(cache->stats().size, 1u);
+
+	testing::Mock::VerifyAndClearExpectations(&api);
+}
+
+TEST(StatementCacheTests, TestLeastRecentlyUsedIsEvicted)
+{
+	auto api = sqlite_api_mock_nice{};
+
+	EXPECT_CALL(api, prepare_v3(sqlite_api_mock::test_connection, testing::StrEq(g_query), -1, testing::_, testing::NotNull(), nullptr))
+	    .WillOnce(testing::DoAll(&set_statement_handle, testing::Return(SQLITE_OK)));
+	EXPECT_CALL(api,
+	            prepare_v3(sqlite_api_mock::test_connection, testing::StrEq(g_other_query), -1, testing::_, testing::NotNull(), nullptr))
+	    .WillOnce(testing::DoAll(&set_other_statement_handle, testing::Return(SQLITE_OK)));
+
+	auto cache = std::make_shared<statement_cache>(api, *sqlite_api_mock::test_connection, 1u);
+
+	EXPECT_CALL(api, finalize(sqlite_api_mock::test_statement)).Times(1);
+	cache->acquire(g_query);
+	cache->acquire(g_other_query);
+	testing::Mock::VerifyAndClearExpectations(&api);
+
+	EXPECT_EQ(cache->stats().size, 1u);
+
+	EXPECT_CALL(api, finalize(&g_other_statement)).Times(1);
+	cache.reset();
+}
+
+TEST(StatementCacheTests, TestZeroCapacityDisablesCaching)
+{
+	auto api = sqlite_api_mock_nice{};
+
+	EXPECT_CALL(api, prepare_v3(sqlite_api_mock::test_connection, testing::StrEq(g_query), -1, testing::_, testing::NotNull(), nullptr))
+	    .Times(2)
+	    .WillRepeatedly(testing::DoAll(&set_statement_handle, testing::Return(SQLITE_OK)));
+	EXPECT_CALL(api, finalize(sqlite_api_mock::test_statement)).Times(2);
+
+	auto cache = std::make_shared<statement_cache>(api, *sqlite_api_mock::test_connection, 0u);
+	cache->acquire(g_query);
+	cache->acquire(g_query);
+
+	EXPECT_EQ(cache->stats().hits, 0u);
+	EXPECT_EQ(cache->stats().misses, 2u);
+}
+
+TEST(StatementCacheTests, TestStatementOutlivesCache)
+{
+	auto api = sqlite_api_mock_nice{};
+
+	EXPECT_CALL(api, prepare_v3(sqlite_api_mock::test_connection, testing::StrEq(g_query), -1, testing::_, testing::NotNull(), nullptr))
+	    .WillOnce(testing::DoAll(&set_statement_handle, testing::Return(SQLITE_OK)));
+
+	auto cache     = std::make_shared<statement_cache>(api, *sqlite_api_mock::test_connection);
+	auto statement = cache->acquire(g_query);
+	cache.reset();
+
+	EXPECT_CALL(api, reset(testing::_)).Times(0);
+	EXPECT_CALL(api, finalize(sqlite_api_mock::test_statement)).Times(1);
+	statement.reset();
+}
+
+TEST(StatementCacheTests, TestPrepareFails)
+{
+	auto api = sqlite_api_mock_nice{};
+
+	EXPECT_CALL(api, prepare_v3(sqlite_api_mock::test_connection, testing::StrEq(g_query), -1, testing::_, testing::NotNull(), nullptr))
+	    .WillOnce(testing::Return(SQLITE_ERROR));
+
+	auto cache = std::make_shared<statement_cache>(api, *sqlite_api_mock::test_connection);
+	EXPECT_ANY_THROW(cache->acquire(g_query));
+	EXPECT_EQ(cache->stats().misses, 1u);
+}
+
+} // namespace sqlite
+} // namespace squid
@@ -9,9 +9,14 @@
 #include "squid/sqlite3/error.h"
 
 #include "squid/sqlite3/detail/isqliteapi.h"
+#include "squid/sqlite3/detail/sqliteapi.h"
+#include "squid/sqlite3/detail/statementcache.h"
 #include "squid/sqlite3/detail/queryparameters.h"
 #include "squid/sqlite3/detail/queryresults.h"
 
+#include "squid/detail/phasetimer.h"
+#include "squid/detail/probes.h"
+
 #include <sstream>
 #include <cassert>
 
@@ -32,6 +37,7 @@ sqlite3_stmt* prepare_statement(isqlite_api& api, sqlite3& connection, const std
 	std::cout << "preparing: " << query << "\n";
 #endif
 
+	const auto    start = probe_start(SQUID_PROBE_ENABLED(backend__prepare));
 	sqlite3_stmt* stmt{ nullptr };
 	auto          rc = api.prepare_v2(&connection, query.c_str(), -1, &stmt, nullptr);
 
@@ -45,6 +51,7 @@ sqlite3_stmt* prepare_statement(isqlite_api& api, sqlite3& connection, const std
 	}
 	else
 	{
+		SQUID_PROBE(backend__prepare, "sqlite", query.c_str(), probe_nanoseconds(start));
 		return stmt;
 	}
 }
@@ -53,13 +60,40 @@ sqlite3_stmt* prepare_statement(isqlite_api& api, sqlite3& connection, const std
 
 class statement::impl
 {
-	isqlite_api*                   api_;
-	std::shared_ptr<sqlite3>       connection_;
-	std::string                    query_;
-	bool                           reuse_statement_;
-	std::shared_ptr<sqlite3_stmt>  statement_;
-	int                            step_result_;
-	std::unique_ptr<query_results> query_results_;
+public:
+	virtual ~impl() noexcept
+	{
+	}
+
+	virtual void execute(const std::map<std::string, parameter>& parameters,
+	                     const std::vector<result>&              results,
+	                     statement_observer*                     observer) = 0;
+	virtual void execute(const std::map<std::string, parameter>& parameters,
+	                     const std::map<std::string, result>&    results,
+	                     statement_observer*                     observer) = 0;
+
+	virtual void             prepare()                     = 0;
+	virtual bool             fetch()                       = 0;
+	virtual std::size_t      field_count()                 = 0;
+	virtual std::string      field_name(std::size_t index) = 0;
+	virtual std::uint64_t    affected_rows()               = 0;
+	virtual std::string_view query() const noexcept        = 0;
+};
+
+template<class Api>
+class statement::basic_impl final : public statement::impl
+{
+	Api*                                      api_;
+	std::shared_ptr<sqlite3>                  connection_;
+	std::string                               query_;
+	bool                                      reuse_statement_;
+	std::shared_ptr<statement_cache>          cache_;
+	std::shared_ptr<sqlite3_stmt>             statement_;
+	int                                       step_result_;
+	std::unique_ptr<basic_query_results<Api>> query_results_;
+	statement_observer*                       observer_;
+	phase_accumulator                         transfer_;
+	phase_accumulator                         decode_;
 
 	void step()
 	{
@@ -74,27 +108,42 @@ class statement::impl
 		}
 	}
 
-public:
-	impl(isqlite_api& api, std::shared_ptr<sqlite3> connection, std::string_view query, bool reuse_statement)
-	    : api_{ &api }
-	    , connection_{ connection }
-	    , query_{ query }
-	    , reuse_statement_{ reuse_statement }
-	    , statement_{}
-	    , step_result_{ -1 }
-	    , query_results_{}
+	/// Takes the prepared statement from the cache, or prepares it
+	void acquire_statement()
 	{
-		assert(this->connection_);
+		if (this->reuse_statement_ && this->cache_)
+		{
+			this->statement_ = this->cache_->acquire(this->query_);
+		}
+		else
+		{
+			this->statement_.reset(prepare_statement(*this->api_, *this->connection_, this->query_),
+			                       [this](sqlite3_stmt* pStmt) { this->api_->finalize(pStmt); });
+		}
+	}
+
+	/// Reports the rows fetched since the last execution
+	void report_fetched() noexcept
+	{
+		this->transfer_.report(this->observer_, statement_phase::transfer, this->query_);
+		this->decode_.report(this->observer_, statement_phase::decode, this->query_);
 	}
 
 	template<typename ResultsContainer>
-	void execute(const std::map<std::string, parameter>& parameters, const ResultsContainer& results)
+	void execute_with_results(const std::map<std::string, parameter>& parameters,
+	                          const ResultsContainer&                 results,
+	                          statement_observer*                     observer)
 	{
 		assert(this->connection_);
 		assert(this->api_);
 
+		this->report_fetched();
+		this->observer_ = observer;
+
 		this->query_results_.reset();
 
+		phase_timer timer{ observer, this->query_, &parameters };
+
 		if (this->statement_)
 		{
 			if (this->reuse_statement_)
@@ -112,18 +161,66 @@ public:
 
 		if (!this->statement_)
 		{
-			this->statement_.reset(prepare_statement(*this->api_, *this->connection_, this->query_),
-			                       [this](sqlite3_stmt* pStmt) { this->api_->finalize(pStmt); });
+			this->acquire_statement();
+			timer.lap(statement_phase::prepare);
 		}
 
-		query_parameters::bind(*this->api_, *this->connection_, *this->statement_, parameters);
+		basic_query_parameters<Api>::bind(*this->api_, *this->connection_, *this->statement_, parameters);
+		timer.lap(statement_phase::bind);
 
 		this->step();
+		timer.lap(statement_phase::execute, SQLITE_ROW == this->step_result_ ? 1 : 0);
+
+		this->query_results_ = std::make_unique<basic_query_results<Api>>(*this->api_, this->connection_, this->statement_, results);
+	}
+
+public:
+	basic_impl(Api&                             api,
+	           std::shared_ptr<sqlite3>         connection,
+	           std::string_view                 query,
+	           bool                             reuse_statement,
+	           std::shared_ptr<statement_cache> cache)
+	    : api_{ &api }
+	    , connection_{ connection }
+	    , query_{ query }
+	    , reuse_statement_{ reuse_statement }
+	    , cache_{ std::move(cache) }
+	    , statement_{}
+	    , step_result_{ -1 }
+	    , query_results_{}
+	    , observer_{}
+	    , transfer_{}
+	    , decode_{}
+	{
+		assert(this->connection_);
+	}
 
-		this->query_results_ = std::make_unique<query_results>(*this->api_, this->connection_, this->statement_, results);
+	void execute(const std::map<std::string, parameter>& parameters,
+	             const std::vector<result>&              results,
+	             statement_observer*                     observer) override
+	{
+		this->execute_with_results(parameters, results, observer);
 	}
 
-	bool fetch()
+	void execute(const std::map<std::string, parameter>& parameters,
+	             const std::map<std::string, result>&    results,
+	             statement_observer*                     observer) override
+	{
+		this->execute_with_results(parameters, results, observer);
+	}
+
+	void prepare() override
+	{
+		assert(this->connection_);
+		assert(this->api_);
+
+		if (this->reuse_statement_ && !this->statement_)
+		{
+			this->acquire_statement();
+		}
+	}
+
+	bool fetch() override
 	{
 		if (!this->statement_ || !this->query_results_)
 		{
@@ -132,18 +229,30 @@ public:
 
 		if (SQLITE_DONE == this->step_result_)
 		{
+			this->report_fetched();
 			return false;
 		}
 		assert(SQLITE_ROW == this->step_result_);
 
+		if (!this->observer_)
+		{
+			this->query_results_->fetch();
+			this->step();
+			return true;
+		}
+
+		const auto decode_start = std::chrono::steady_clock::now();
 		this->query_results_->fetch();
+		this->decode_.add(decode_start);
 
+		const auto transfer_start = std::chrono::steady_clock::now();
 		this->step();
+		this->transfer_.add(transfer_start, SQLITE_ROW == this->step_result_ ? 1 : 0);
 
 		return true;
 	}
 
-	std::size_t field_count()
+	std::size_t field_count() override
 	{
 		if (this->query_results_)
 		{
@@ -155,7 +264,7 @@ public:
 		}
 	}
 
-	std::string field_name(std::size_t index)
+	std::string field_name(std::size_t index) override
 	{
 		if (this->query_results_)
 		{
@@ -167,7 +276,7 @@ public:
 		}
 	}
 
-	std::uint64_t affected_rows()
+	std::uint64_t affected_rows() override
 	{
 		if (this->statement_)
 		{
@@ -179,26 +288,50 @@ public:
 			throw error{ "Cannot get the number of affected rows from a statement that has not been executed" };
 		}
 	}
+
+	std::string_view query() const noexcept override
+	{
+		return this->query_;
+	}
 };
 
 statement::~statement() noexcept
 {
 }
 
-statement::statement(isqlite_api& api, std::shared_ptr<sqlite3> connection, std::string_view query, bool reuse_statement)
+statement::statement(isqlite_api&                     api,
+                     std::shared_ptr<sqlite3>         connection,
+                     std::string_view                 query,
+                     bool                             reuse_statement,
+                     std::shared_ptr<statement_cache> cache)
     : ibackend_statement{}
-    , pimpl_{ std::make_unique<impl>(api, connection, query, reuse_statement) }
+    , pimpl_{}
+{
+	// Resolve the API type once per statement, so that binding, stepping and fetching
+	// do not need a virtual call per column when running against the real SQLite library.
+	if (auto production_api = dynamic_cast<sqlite_api*>(&api))
+	{
+		this->pimpl_ = std::make_unique<basic_impl<sqlite_api>>(*production_api, connection, query, reuse_statement, std::move(cache));
+	}
+	else
+	{
+		this->pimpl_ = std::make_unique<basic_impl<isqlite_api>>(api, connection, query, reuse_statement, std::move(cache));
+	}
+}
+
+void statement::prepare()
 {
+	this->pimpl_->prepare();
 }
 
 void statement::execute(const std::map<std::string, parameter>& parameters, const std::vector<result>& results)
 {
-	this->pimpl_->execute(parameters, results);
+	this->pimpl_->execute(parameters, results, this->observer());
 }
 
 void statement::execute(const std::map<std::string, parameter>& parameters, const std::map<std::string, result>& results)
 {
-	this->pimpl_->execute(parameters, results);
+	this->pimpl_->execute(parameters, results, this->observer());
 }
 
 bool statement::fetch()
@@ -221,6 +354,11 @@ std::uint64_t statement::affected_rows()
 	return this->pimpl_->affected_rows();
 }
 
+std::string_view statement::query() const noexcept
+{
+	return this->pimpl_->query();
+}
+
 void statement::execute(isqlite_api& api, sqlite3& connection, const std::string& query)
 {
 	std::shared_ptr<sqlite3_stmt> statement{ prepare_statement(api, connection, query),
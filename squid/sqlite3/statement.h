@@ -17,22 +17,33 @@ namespace squid {
 namespace sqlite {
 
 class isqlite_api;
+class statement_cache;
 
 class statement final : public ibackend_statement
 {
 	class impl;
+	template<class Api>
+	class basic_impl;
 	std::unique_ptr<impl> pimpl_;
 
 public:
 	~statement() noexcept;
 
-	statement(isqlite_api& api, std::shared_ptr<sqlite3> connection, std::string_view query, bool reuse_statement);
+	/// When @a reuse_statement is true and a @a cache is given, the compiled statement is taken from
+	/// and returned to that cache, so that it survives this statement object.
+	statement(isqlite_api&                     api,
+	          std::shared_ptr<sqlite3>         connection,
+	          std::string_view                 query,
+	          bool                             reuse_statement,
+	          std::shared_ptr<statement_cache> cache = nullptr);
 
 	statement(const statement&)            = delete;
 	statement(statement&& src)             = default;
 	statement& operator=(const statement&) = delete;
 	statement& operator=(statement&&)      = default;
 
+	void prepare() override;
+
 	void execute(const std::map<std::string, parameter>& parameters, const std::vector<result>& results) override;
 	void execute(const std::map<std::string, parameter>& parameters, const std::map<std::string, result>& results) override;
 	bool fetch() override;
@@ -42,6 +53,8 @@ public:
 
 	std::uint64_t affected_rows() override;
 
+	std::string_view query() const noexcept override;
+
 	static void execute(isqlite_api& api, sqlite3& connection, const std::string& query);
 };
 
@@ -0,0 +1,26 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace squid {
+namespace sqlite {
+
+/// Counters of the cache of compiled statements of a connection
+struct statement_cache_stats
+{
+	std::uint64_t hits;     /// number of statements served from the cache
+	std::uint64_t misses;   /// number of statements that had to be compiled
+	std::size_t   size;     /// number of idle statements held by the cache
+	std::size_t   capacity; /// maximum number of idle statements held by the cache
+};
+
+} // namespace sqlite
+} // namespace squid
@@ -0,0 +1,393 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/test/support/allocationcounter.h>
+#include <squid/sqlite3/connection.h>
+#include <squid/sqlite3/detail/sqliteapimock.h>
+#include <squid/preparedstatement.h>
+#include <squid/statement.h>
+#include <sqlite3.h>
+
+#include <cstring>
+#include <string>
+
+//
+// Allocation budgets of the hot paths of a prepared statement, so that hidden allocations show up as test failures.
+// Only allocations with the global operator new are counted, not those of the SQLite library itself.
+//
+
+namespace squid {
+namespace sqlite {
+
+namespace {
+
+/// Allocations of an execution of a prepared statement: the results object, its vector of columns and one column per
+/// bound result. Binding and stepping allocate nothing.
+constexpr std::uint64_t execute_budget(std::uint64_t bound_results)
+{
+	return 2u + bound_results;
+}
+
+/// Longer than the small string buffer of std::string, so that storing it in a string without capacity allocates
+constexpr auto g_long_name = "a name that does not fit in the small string buffer";
+
+/// Forwards to another api, without counting the allocations that it makes, e.g. those of a mock
+class uncounted_api final : public isqlite_api
+{
+	isqlite_api& api_;
+
+public:
+	explicit uncounted_api(isqlite_api& api)
+	    : isqlite_api{}
+	    , api_{ api }
+	{
+	}
+
+	int open(const char* filename, sqlite3** ppDb) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.open(filename, ppDb);
+	}
+
+	int close(sqlite3* db) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.close(db);
+	}
+
+	void interrupt(sqlite3* db) override
+	{
+		uncounted_allocations uncounted{};
+		this->api_.interrupt(db);
+	}
+
+	int64_t changes64(sqlite3* db) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.changes64(db);
+	}
+
+	int prepare_v2(sqlite3* db, const char* zSql, int nByte, sqlite3_stmt** ppStmt, const char** pzTail) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.prepare_v2(db, zSql, nByte, ppStmt, pzTail);
+	}
+
+	int prepare_v3(sqlite3* db, const char* zSql, int nByte, unsigned prepFlags, sqlite3_stmt** ppStmt, const char** pzTail) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.prepare_v3(db, zSql, nByte, prepFlags, ppStmt, pzTail);
+	}
+
+	int finalize(sqlite3_stmt* pStmt) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.finalize(pStmt);
+	}
+
+	int step(sqlite3_stmt* pStmt) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.step(pStmt);
+	}
+
+	int reset(sqlite3_stmt* pStmt) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.reset(pStmt);
+	}
+
+	int clear_bindings(sqlite3_stmt* pStmt) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.clear_bindings(pStmt);
+	}
+
+	int bind_parameter_index(sqlite3_stmt* pStmt, const char* zName) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.bind_parameter_index(pStmt, zName);
+	}
+
+	int bind_null(sqlite3_stmt* pStmt, int index) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.bind_null(pStmt, index);
+	}
+
+	int bind_int(sqlite3_stmt* pStmt, int index, int value) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.bind_int(pStmt, index, value);
+	}
+
+	int bind_int64(sqlite3_stmt* pStmt, int index, int64_t value) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.bind_int64(pStmt, index, value);
+	}
+
+	int bind_double(sqlite3_stmt* pStmt, int index, double value) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.bind_double(pStmt, index, value);
+	}
+
+	int bind_text(sqlite3_stmt* pStmt, int index, const char* value, int length, void (*destructor)(void*)) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.bind_text(pStmt, index, value, length, destructor);
+	}
+
+	int bind_blob(sqlite3_stmt* pStmt, int index, const void* value, int length, void (*destructor)(void*)) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.bind_blob(pStmt, index, value, length, destructor);
+	}
+
+	int column_int(sqlite3_stmt* pStmt, int index) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.column_int(pStmt, index);
+	}
+
+	int64_t column_int64(sqlite3_stmt* pStmt, int index) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.column_int64(pStmt, index);
+	}
+
+	double column_double(sqlite3_stmt* pStmt, int index) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.column_double(pStmt, index);
+	}
+
+	const unsigned char* column_text(sqlite3_stmt* pStmt, int index) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.column_text(pStmt, index);
+	}
+
+	const void* column_blob(sqlite3_stmt* pStmt, int index) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.column_blob(pStmt, index);
+	}
+
+	int column_bytes(sqlite3_stmt* pStmt, int index) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.column_bytes(pStmt, index);
+	}
+
+	int column_count(sqlite3_stmt* pStmt) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.column_count(pStmt);
+	}
+
+	const char* column_name(sqlite3_stmt* pStmt, int index) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.column_name(pStmt, index);
+	}
+
+	int column_type(sqlite3_stmt* pStmt, int index) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.column_type(pStmt, index);
+	}
+
+	int errcode(sqlite3* db) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.errcode(db);
+	}
+
+	const char* errstr(int ec) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.errstr(ec);
+	}
+
+	const char* errmsg(sqlite3* db) override
+	{
+		uncounted_allocations uncounted{};
+		return this->api_.errmsg(db);
+	}
+};
+
+} // namespace
+
+/// A prepared statement on a table in an in-memory SQLite database
+class SqliteAllocationTests : public testing::Test
+{
+public:
+	connection         db{ ":memory:" };
+	prepared_statement select{ db, "SELECT id, name FROM t WHERE id >= :min" };
+	int                id{};
+	std::string        name{};
+
+	SqliteAllocationTests()
+	{
+		statement{ this->db, "CREATE TABLE t(id INTEGER, name TEXT)" }.execute();
+		statement insert{ this->db, "INSERT INTO t VALUES (:id, :name)" };
+		for (int i = 1; i <= 10; ++i)
+		{
+			insert.bind("id", i).bind("name", std::string_view{ g_long_name }).execute();
+		}
+
+		this->select.bind("min", 1).bind_result(this->id).bind_result(this->name);
+		this->select.execute();
+		while (this->select.fetch())
+		{
+		}
+	}
+};
+
+TEST_F(SqliteAllocationTests, ReexecuteStaysWithinBudget)
+{
+	allocation_counter counter{};
+	this->select.execute();
+	EXPECT_LE(counter.allocations(), execute_budget(2u));
+}
+
+TEST_F(SqliteAllocationTests, RebindAllocatesNothing)
+{
+	allocation_counter counter{};
+	for (int min = 1; min <= 10; ++min)
+	{
+		this->select.bind("min", min);
+	}
+	EXPECT_EQ(counter.allocations(), 0u);
+}
+
+TEST_F(SqliteAllocationTests, FetchAllocatesNothing)
+{
+	this->select.execute();
+	ASSERT_TRUE(this->select.fetch());
+	EXPECT_EQ(this->name, g_long_name);
+
+	allocation_counter counter{};
+	int                rows = 1;
+	while (this->select.fetch())
+	{
+		++rows;
+	}
+	EXPECT_EQ(rows, 10);
+	EXPECT_EQ(counter.allocations(), 0u);
+}
+
+/// A prepared statement on sqlite_api_mock, with a result of @a rows rows of an INTEGER and a TEXT column
+class MockAllocationTests : public testing::Test
+{
+public:
+	sqlite_api_mock_nice                mock{};
+	uncounted_api                       api{ mock };
+	int                                 rows{};
+	std::unique_ptr<connection>         db{};
+	std::unique_ptr<prepared_statement> select{};
+	int                                 id{};
+	std::string                         name{};
+
+	MockAllocationTests()
+	{
+		using testing::_;
+
+		ON_CALL(this->mock, open(_, _)).WillByDefault([](const char*, sqlite3** ppDb) {
+			*ppDb = sqlite_api_mock::test_connection;
+			return SQLITE_OK;
+		});
+		ON_CALL(this->mock, prepare_v3(_, _, _, _, _, _))
+		    .WillByDefault([](sqlite3*, const char*, int, unsigned, sqlite3_stmt** ppStmt, const char**) {
+			    *ppStmt = sqlite_api_mock::test_statement;
+			    return SQLITE_OK;
+		    });
+		ON_CALL(this->mock, step(_)).WillByDefault([this](sqlite3_stmt*) { return this->rows-- > 0 ? SQLITE_ROW : SQLITE_DONE; });
+		ON_CALL(this->mock, bind_parameter_index(_, _)).WillByDefault(testing::Return(1));
+		ON_CALL(this->mock, column_count(_)).WillByDefault(testing::Return(2));
+		ON_CALL(this->mock, column_name(_, 0)).WillByDefault(testing::Return("id"));
+		ON_CALL(this->mock, column_name(_, 1)).WillByDefault(testing::Return("name"));
+		ON_CALL(this->mock, column_type(_, 0)).WillByDefault(testing::Return(SQLITE_INTEGER));
+		ON_CALL(this->mock, column_type(_, 1)).WillByDefault(testing::Return(SQLITE_TEXT));
+		ON_CALL(this->mock, column_int(_, 0)).WillByDefault(testing::Return(42));
+		ON_CALL(this->mock, column_int64(_, 0)).WillByDefault(testing::Return(42));
+		ON_CALL(this->mock, column_text(_, 1)).WillByDefault(testing::Return(reinterpret_cast<const unsigned char*>(g_long_name)));
+		ON_CALL(this->mock, column_bytes(_, 1)).WillByDefault(testing::Return(static_cast<int>(std::strlen(g_long_name))));
+
+		this->db     = std::make_unique<connection>(this->api, "the connection info");
+		this->select = std::make_unique<prepared_statement>(*this->db, "SELECT id, name FROM t WHERE id >= :min");
+		this->select->bind("min", 1).bind_result(this->id).bind_result(this->name);
+		this->execute(10);
+		while (this->select->fetch())
+		{
+		}
+	}
+
+	void execute(int result_rows)
+	{
+		this->rows = result_rows;
+		this->select->execute();
+	}
+};
+
+TEST_F(MockAllocationTests, ReexecuteStaysWithinBudget)
+{
+	allocation_counter counter{};
+	this->execute(10);
+	EXPECT_LE(counter.allocations(), execute_budget(2u));
+}
+
+TEST_F(MockAllocationTests, RebindAllocatesNothing)
+{
+	allocation_counter counter{};
+	for (int min = 1; min <= 10; ++min)
+	{
+		this->select->bind("min", min);
+	}
+	this->select->bind_ref("min", this->id);
+	EXPECT_EQ(counter.allocations(), 0u);
+}
+
+TEST_F(MockAllocationTests, FetchAllocatesNothing)
+{
+	this->execute(10);
+	ASSERT_TRUE(this->select->fetch());
+	EXPECT_EQ(this->id, 42);
+	EXPECT_EQ(this->name, g_long_name);
+
+	allocation_counter counter{};
+	int                rows = 1;
+	while (this->select->fetch())
+	{
+		++rows;
+	}
+	EXPECT_EQ(rows, 10);
+	EXPECT_EQ(counter.allocations(), 0u);
+}
+
+TEST(AllocationCounterTests, CountsOnlyTheCountedAllocations)
+{
+	// Calls of operator new itself, which, unlike new expressions, cannot be optimized away
+	allocation_counter counter{};
+	const auto         counted = ::operator new(24u);
+	{
+		uncounted_allocations uncounted{};
+		::operator delete(::operator new(8u));
+	}
+	::operator delete(counted);
+	EXPECT_EQ(counter.allocations(), 1u);
+	EXPECT_EQ(counter.bytes(), 24u);
+
+	counter.reset();
+	EXPECT_EQ(counter.allocations(), 0u);
+}
+
+} // namespace sqlite
+} // namespace squid
@@ -43,6 +43,37 @@ TEST(BackendConnectionTests, TestOpenAndClose)
 	EXPECT_EQ(&c.handle(), sqlite_api_mock::test_connection);
 }
 
+TEST(BackendConnectionTests, TestCancelInterrupts)
+{
+	auto api = sqlite_api_mock_nice{};
+
+	EXPECT_CALL(api, open(testing::StrEq(g_connection_info), testing::NotNull()))
+	    .WillOnce(testing::DoAll(&set_connection_handle, testing::Return(SQLITE_OK)));
+
+	EXPECT_CALL(api, interrupt(sqlite_api_mock::test_connection)).Times(1);
+
+	auto c = backend_connection{ api, g_connection_info };
+	EXPECT_TRUE(c.cancel());
+}
+
+TEST(BackendConnectionTests, TestPreparedStatementCache)
+{
+	auto api = sqlite_api_mock_nice{};
+
+	EXPECT_CALL(api, open(testing::StrEq(g_connection_info), testing::NotNull()))
+	    .WillOnce(testing::DoAll(&set_connection_handle, testing::Return(SQLITE_OK)));
+
+	auto c     = backend_connection{ api, g_connection_info };
+	auto stats = c.prepared_statement_cache_stats();
+	EXPECT_EQ(stats.hits, 0u);
+	EXPECT_EQ(stats.misses, 0u);
+	EXPECT_EQ(stats.size, 0u);
+	EXPECT_GT(stats.capacity, 0u);
+
+	c.set_prepared_statement_cache_capacity(4u);
+	EXPECT_EQ(c.prepared_statement_cache_stats().capacity, 4u);
+}
+
 TEST(BackendConnectionTests, TestOpenReturnsError)
 {
 	auto api = sqlite_api_mock_nice{};
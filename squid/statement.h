@@ -39,8 +39,12 @@ public:
 	using basic_statement::bind_ref;
 	using basic_statement::bind_result;
 	using basic_statement::bind_results;
+	using basic_statement::cancel;
 	using basic_statement::execute;
+	using basic_statement::execute_async;
 	using basic_statement::fetch;
+	using basic_statement::fetch_all;
+	using basic_statement::fetch_all_async;
 	using basic_statement::field_count;
 	using basic_statement::field_name;
 };
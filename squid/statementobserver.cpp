@@ -0,0 +1,115 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/statementobserver.h"
+
+#include "squid/detail/concurrenthistogram.h"
+#include "squid/detail/prometheus.h"
+
+#include <atomic>
+#include <locale>
+#include <sstream>
+
+namespace squid {
+
+namespace {
+
+constexpr std::array<std::string_view, statement_phase_count> phase_names{ "prepare", "bind", "execute", "transfer", "decode" };
+
+} // namespace
+
+statement_observer::~statement_observer() noexcept
+{
+}
+
+void statement_observer::on_error(std::string_view) noexcept
+{
+}
+
+const duration_histogram& statement_latency_stats::operator[](statement_phase phase) const noexcept
+{
+	return this->phases[static_cast<std::size_t>(phase)];
+}
+
+std::string to_prometheus_text(const statement_latency_stats& stats, std::string_view pool_name, std::string_view prefix)
+{
+	std::ostringstream out{};
+	out.imbue(std::locale::classic());
+	out.precision(9);
+
+	for (std::size_t phase = 0; phase < statement_phase_count; ++phase)
+	{
+		const auto help = "Time spent in the " + std::string{ phase_names[phase] } + " phase of statements.";
+		write_histogram(out, prefix, phase_names[phase], help, pool_name, stats.phases[phase]);
+	}
+	write_metric(out, prefix, "rows_total", "counter", "Number of rows decoded.", pool_name, stats.rows);
+	write_metric(out, prefix, "bytes_total", "counter", "Number of bytes of row data received.", pool_name, stats.bytes);
+
+	return out.str();
+}
+
+class latency_observer::impl
+{
+	std::array<concurrent_histogram, statement_phase_count> phases_;
+	std::atomic<std::uint64_t>                              rows_;
+	std::atomic<std::uint64_t>                              bytes_;
+
+public:
+	impl()
+	    : phases_{}
+	    , rows_{}
+	    , bytes_{}
+	{
+	}
+
+	void on_phase(const statement_event& event) noexcept
+	{
+		this->phases_[static_cast<std::size_t>(event.phase)].record(event.duration);
+		if (event.phase == statement_phase::decode)
+		{
+			this->rows_.fetch_add(event.rows, std::memory_order_relaxed);
+		}
+		if (event.bytes)
+		{
+			this->bytes_.fetch_add(event.bytes, std::memory_order_relaxed);
+		}
+	}
+
+	statement_latency_stats stats() const
+	{
+		statement_latency_stats stats{};
+		for (std::size_t phase = 0; phase < statement_phase_count; ++phase)
+		{
+			this->phases_[phase].add_to(stats.phases[phase]);
+		}
+		stats.rows  = this->rows_.load(std::memory_order_relaxed);
+		stats.bytes = this->bytes_.load(std::memory_order_relaxed);
+		return stats;
+	}
+};
+
+latency_observer::latency_observer()
+    : statement_observer{}
+    , pimpl_{ std::make_unique<impl>() }
+{
+}
+
+latency_observer::~latency_observer() noexcept
+{
+}
+
+void latency_observer::on_phase(const statement_event& event) noexcept
+{
+	this->pimpl_->on_phase(event);
+}
+
+statement_latency_stats latency_observer::stats() const
+{
+	return this->pimpl_->stats();
+}
+
+} // namespace squid
@@ -0,0 +1,107 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "squid/api.h"
+#include "squid/durationhistogram.h"
+#include "squid/parameter.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace squid {
+
+/// Phases of the execution of a statement, see statement_observer
+enum class statement_phase
+{
+	prepare,  /// preparing the statement, on the server if the backend does that
+	bind,     /// encoding the bound parameters
+	execute,  /// executing the statement until its result, or its first row, is available
+	transfer, /// receiving the rows, if the backend does that separately from executing and fetching
+	decode    /// converting the fetched rows into the bound results
+};
+
+/// Number of statement phases
+inline constexpr std::size_t statement_phase_count = 5;
+
+/// A phase of the execution of a statement.
+/// The decode phase, and for backends that produce rows while fetching also the transfer phase, is summed over the
+/// rows and reported once: when the last row was fetched, or when the statement is executed again.
+struct SQUID_EXPORT statement_event
+{
+	statement_phase                       phase;
+	std::string_view                      query;    /// query text as passed to the backend
+	std::chrono::steady_clock::time_point start;    /// when the phase started
+	std::chrono::nanoseconds              duration; /// time spent in the phase
+	std::uint64_t                         rows;     /// number of rows received (execute, transfer) or decoded (decode)
+	std::uint64_t                         bytes;    /// number of bytes of row data received, 0 if the backend does not know
+
+	/// Bound parameters of the execution, nullptr for the phases that are reported while fetching
+	const std::map<std::string, parameter>* parameters = nullptr;
+};
+
+/// Observer of the phases of the statements executed on a connection.
+/// Register it with connection::set_observer, or for all connections of a pool with connection_pool_options::observer.
+/// Without observer, the phases are not timed.
+class SQUID_EXPORT statement_observer
+{
+public:
+	virtual ~statement_observer() noexcept;
+
+	/// Called at the end of every phase, on the thread that uses the statement.
+	/// An observer that is shared by connections used by multiple threads must be thread-safe. Must not throw.
+	virtual void on_phase(const statement_event& event) noexcept = 0;
+
+	/// Called instead of on_phase when the execution of @a query fails, like on_phase.
+	/// The default implementation does nothing.
+	virtual void on_error(std::string_view query) noexcept;
+};
+
+/// Snapshot of a latency_observer
+struct SQUID_EXPORT statement_latency_stats
+{
+	std::array<duration_histogram, statement_phase_count> phases; /// durations, indexed by statement_phase
+	std::uint64_t                                         rows;   /// number of rows decoded
+	std::uint64_t                                         bytes;  /// number of bytes of row data received
+
+	const duration_histogram& operator[](statement_phase phase) const noexcept;
+};
+
+/// Format @a stats in the Prometheus text exposition format, with a histogram per phase named @a prefix_<phase>_seconds.
+/// The metric names start with @a prefix. If @a pool_name is not empty, all samples get a label pool="@a pool_name".
+SQUID_EXPORT std::string to_prometheus_text(const statement_latency_stats& stats,
+                                            std::string_view               pool_name = {},
+                                            std::string_view               prefix    = "squid_statement");
+
+/// A thread-safe statement_observer that records the duration of every phase in a histogram, without locking.
+class SQUID_EXPORT latency_observer final : public statement_observer
+{
+	class impl;
+	std::unique_ptr<impl> pimpl_;
+
+public:
+	latency_observer();
+	~latency_observer() noexcept override;
+
+	latency_observer(const latency_observer&)            = delete;
+	latency_observer(latency_observer&& src)             = delete;
+	latency_observer& operator=(const latency_observer&) = delete;
+	latency_observer& operator=(latency_observer&&)      = delete;
+
+	void on_phase(const statement_event& event) noexcept override;
+
+	statement_latency_stats stats() const;
+};
+
+} // namespace squid
@@ -0,0 +1,228 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Acquire/release throughput of connection_pool under contention, with a single and with multiple shards,
+// versus the reference pool of earlier versions of this library, which used a mutex protected queue and wrapped
+// each acquired connection in a heap allocated wrapper with a std::function release callback.
+
+#include <squid/connectionpool.h>
+#include <squid/ibackendconnection.h>
+#include <squid/ibackendconnectionfactory.h>
+#include <squid/ibackendstatement.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocations{};
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (auto p = std::malloc(size ? size : 1))
+	{
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace squid {
+
+namespace {
+
+constexpr std::size_t pool_size          = 8;
+constexpr int         operations_per_run = 400000;
+
+class fake_backend_connection : public ibackend_connection
+{
+public:
+	std::unique_ptr<ibackend_statement> create_statement(std::string_view) override
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view) override
+	{
+		return nullptr;
+	}
+
+	void execute(const std::string&) override
+	{
+	}
+};
+
+class fake_backend_connection_factory : public ibackend_connection_factory
+{
+public:
+	std::shared_ptr<ibackend_connection> create_backend_connection(std::string_view) const override
+	{
+		return std::make_shared<fake_backend_connection>();
+	}
+};
+
+class reference_pool
+{
+	class wrapper : public ibackend_connection
+	{
+		std::shared_ptr<ibackend_connection>                        connection_;
+		std::function<void(std::shared_ptr<ibackend_connection>&&)> release_;
+
+		std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override
+		{
+			return this->connection_->create_statement(query);
+		}
+
+		std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override
+		{
+			return this->connection_->create_prepared_statement(query);
+		}
+
+		void execute(const std::string& query) override
+		{
+			this->connection_->execute(query);
+		}
+
+	public:
+		wrapper(std::shared_ptr<ibackend_connection>&& connection, std::function<void(std::shared_ptr<ibackend_connection>&&)>&& release)
+		    : connection_{ std::move(connection) }
+		    , release_{ std::move(release) }
+		{
+		}
+
+		~wrapper()
+		{
+			this->release_(std::move(this->connection_));
+		}
+	};
+
+	std::queue<std::shared_ptr<ibackend_connection>> queue_;
+	std::mutex                                       mutex_;
+	std::condition_variable                          cv_;
+
+public:
+	reference_pool(const ibackend_connection_factory& factory, std::size_t count)
+	{
+		while (count--)
+		{
+			this->queue_.push(factory.create_backend_connection(""));
+		}
+	}
+
+	std::shared_ptr<ibackend_connection> acquire()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (this->queue_.empty())
+		{
+			this->cv_.wait(lock);
+		}
+		auto connection = this->queue_.front();
+		this->queue_.pop();
+		return std::make_shared<wrapper>(std::move(connection), [this](std::shared_ptr<ibackend_connection>&& connection) {
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				this->queue_.push(connection);
+			}
+			this->cv_.notify_one();
+		});
+	}
+};
+
+struct run_result
+{
+	double operations_per_second;
+	double allocations_per_operation;
+};
+
+template<class Pool>
+run_result run(Pool& pool, int thread_count)
+{
+	const auto               operations_per_thread = operations_per_run / thread_count;
+	std::atomic<bool>        go{ false };
+	std::vector<std::thread> threads{};
+
+	for (int t = 0; t < thread_count; ++t)
+	{
+		threads.emplace_back([&] {
+			while (!go.load(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+			for (int n = 0; n < operations_per_thread; ++n)
+			{
+				auto connection = pool.acquire();
+				connection->execute({});
+			}
+		});
+	}
+
+	const auto allocations = g_allocations.load();
+	const auto start       = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	const auto elapsed = std::chrono::duration<double>{ std::chrono::steady_clock::now() - start }.count();
+
+	const auto operations = static_cast<double>(operations_per_thread) * thread_count;
+	return run_result{ operations / elapsed, static_cast<double>(g_allocations.load() - allocations) / operations };
+}
+
+} // namespace
+
+} // namespace squid
+
+int main()
+{
+	using namespace squid;
+
+	fake_backend_connection_factory factory{};
+	reference_pool                  reference{ factory, pool_size };
+	connection_pool                 pool{ factory, "", pool_size };
+	connection_pool                 sharded{ factory, "", pool_size, connection_pool_options{ .shards = pool_size } };
+	connection_pool                 affine{ factory, "", pool_size, connection_pool_options{ .thread_affinity = true } };
+
+	std::cout << "pool size " << pool_size << ", " << std::thread::hardware_concurrency() << " hardware threads\n";
+	std::cout << "threads   reference ops/s  (allocs/op)   connection_pool ops/s  (allocs/op)   " << pool_size
+	          << " shards ops/s   affinity ops/s\n";
+	for (int thread_count : { 1, 2, 4, 8, 16, 32, 64 })
+	{
+		const auto old_result     = run(reference, thread_count);
+		const auto new_result     = run(pool, thread_count);
+		const auto sharded_result = run(sharded, thread_count);
+		const auto affine_result  = run(affine, thread_count);
+
+		std::cout << std::setw(7) << thread_count << std::setw(19) << static_cast<std::uint64_t>(old_result.operations_per_second) << "  ("
+		          << std::setprecision(3) << old_result.allocations_per_operation << ")" << std::setw(26)
+		          << static_cast<std::uint64_t>(new_result.operations_per_second) << "  (" << new_result.allocations_per_operation << ")"
+		          << std::setw(19) << static_cast<std::uint64_t>(sharded_result.operations_per_second) << std::setw(17)
+		          << static_cast<std::uint64_t>(affine_result.operations_per_second) << "\n";
+	}
+}
@@ -0,0 +1,134 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Parsing throughput of string_to_time_point, string_to_date and string_to_time_of_day
+// versus a std::regex based reference parser, as used by earlier versions of this library.
+
+#include <squid/detail/conversions.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace squid {
+
+namespace {
+
+constexpr int repetitions = 5;
+constexpr int iterations  = 200000;
+
+volatile std::int64_t sink{};
+
+time_point regex_string_to_time_point(std::string_view in)
+{
+	static const std::regex re{ R"(^(\d{4})-(\d{2})-(\d{2})[T ](\d{2}):(\d{2}):(\d{2})(\.\d*)?( ?([+-]\d{2})(:?(\d{2}))?|Z)?$)" };
+
+	std::match_results<std::string_view::const_iterator> matches;
+	if (!std::regex_match(in.begin(), in.end(), matches, re))
+	{
+		throw std::invalid_argument{ "invalid time point format" };
+	}
+
+	time_point out = std::chrono::sys_days{ std::chrono::year{ string_to_number<int>(matches[1].str()) } /
+		                                    std::chrono::month{ string_to_number<unsigned>(matches[2].str()) } /
+		                                    string_to_number<unsigned>(matches[3].str()) } +
+	                 std::chrono::hours{ string_to_number<unsigned>(matches[4].str()) } +
+	                 std::chrono::minutes{ string_to_number<unsigned>(matches[5].str()) } +
+	                 std::chrono::seconds{ string_to_number<unsigned>(matches[6].str()) };
+
+	if (matches.length(7) > 1)
+	{
+		out += std::chrono::microseconds{ static_cast<uint32_t>(string_to_number<double>(matches[7].str()) * 1e6 + .5) };
+	}
+
+	if (matches.length(9))
+	{
+		const auto hours            = matches[9].str();
+		const auto utc_offset_hours = string_to_number<int>((hours.front() == '+') ? &hours[1] : hours);
+		out -= std::chrono::hours{ utc_offset_hours };
+		if (matches.length(11))
+		{
+			out -= std::chrono::minutes{ string_to_number<int>(matches[11].str()) * (utc_offset_hours < 0 ? -1 : 1) };
+		}
+	}
+
+	return out;
+}
+
+template<typename F>
+double ns_per_call(const std::vector<std::string>& inputs, F&& parse)
+{
+	auto best = 0.0;
+	for (int run = 0; run < repetitions; ++run)
+	{
+		std::int64_t checksum{};
+
+		const auto start = std::chrono::steady_clock::now();
+		for (int n = 0; n < iterations; ++n)
+		{
+			checksum += parse(inputs[static_cast<std::size_t>(n) % inputs.size()]);
+		}
+		const auto elapsed = std::chrono::duration<double, std::nano>{ std::chrono::steady_clock::now() - start }.count() / iterations;
+
+		sink = checksum; // keeps the optimizer from discarding the loop
+
+		best = (run == 0) ? elapsed : std::min(best, elapsed);
+	}
+	return best;
+}
+
+} // namespace
+
+} // namespace squid
+
+int main()
+{
+	using namespace squid;
+
+	try
+	{
+		const std::vector<std::string> time_points{ "2022-03-18 23:59:45.123456+04:30",
+			                                        "2023-11-02 08:15:00.5+00",
+			                                        "1999-12-31T23:59:59Z",
+			                                        "2000-01-01 00:00:00" };
+		const std::vector<std::string> dates{ "2022-03-18", "1999-12-31", "-88-03-18" };
+		const std::vector<std::string> times{ "23:59:45.123456+04:30", "08:15:00", "12:00:00.5 -02" };
+
+		const auto hand_written = ns_per_call(time_points, [](const std::string& in) {
+			return static_cast<std::int64_t>(string_to_time_point(in).time_since_epoch().count());
+		});
+
+		const auto regex = ns_per_call(time_points, [](const std::string& in) {
+			return static_cast<std::int64_t>(regex_string_to_time_point(in).time_since_epoch().count());
+		});
+
+		const auto date = ns_per_call(dates, [](const std::string& in) {
+			return static_cast<std::int64_t>(std::chrono::sys_days{ string_to_date(in) }.time_since_epoch().count());
+		});
+
+		const auto time = ns_per_call(times, [](const std::string& in) {
+			return static_cast<std::int64_t>(string_to_time_of_day(in).to_duration().count());
+		});
+
+		std::cout << "string_to_time_point:    " << hand_written << " ns/call\n";
+		std::cout << "regex reference:         " << regex << " ns/call\n";
+		std::cout << "speedup:                 " << regex / hand_written << "x\n";
+		std::cout << "string_to_date:          " << date << " ns/call\n";
+		std::cout << "string_to_time_of_day:   " << time << " ns/call\n";
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,206 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "squid/test/support/allocationcounter.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace squid {
+
+namespace {
+
+// Constant initialized, so that they can be used by allocations during the start of a thread
+constinit thread_local std::uint64_t g_allocations = 0;
+constinit thread_local std::uint64_t g_bytes       = 0;
+constinit thread_local unsigned      g_uncounted   = 0; // number of uncounted_allocations scopes
+
+void count(std::size_t size) noexcept
+{
+	if (!g_uncounted)
+	{
+		++g_allocations;
+		g_bytes += size;
+	}
+}
+
+void* allocate(std::size_t size)
+{
+	count(size);
+	return std::malloc(size ? size : 1u);
+}
+
+void* allocate(std::size_t size, std::align_val_t alignment)
+{
+	count(size);
+	const auto align = static_cast<std::size_t>(alignment);
+#ifdef _MSC_VER
+	// There is no aligned_alloc, its memory could not be freed with free
+	return _aligned_malloc(size ? size : 1u, align);
+#else
+	// aligned_alloc requires a size that is a multiple of the alignment
+	return std::aligned_alloc(align, (size + align - 1u) / align * align);
+#endif
+}
+
+/// Frees memory of allocate with an alignment
+void deallocate_aligned(void* p) noexcept
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+} // namespace
+
+allocation_counter::allocation_counter() noexcept
+    : allocations_{ g_allocations }
+    , bytes_{ g_bytes }
+{
+}
+
+std::uint64_t allocation_counter::allocations() const noexcept
+{
+	return g_allocations - this->allocations_;
+}
+
+std::uint64_t allocation_counter::bytes() const noexcept
+{
+	return g_bytes - this->bytes_;
+}
+
+void allocation_counter::reset() noexcept
+{
+	this->allocations_ = g_allocations;
+	this->bytes_       = g_bytes;
+}
+
+uncounted_allocations::uncounted_allocations() noexcept
+{
+	++g_uncounted;
+}
+
+uncounted_allocations::~uncounted_allocations() noexcept
+{
+	--g_uncounted;
+}
+
+} // namespace squid
+
+void* operator new(std::size_t size)
+{
+	if (auto p = squid::allocate(size))
+	{
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return squid::allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return squid::allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	if (auto p = squid::allocate(size, alignment))
+	{
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return ::operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return squid::allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return squid::allocate(size, alignment);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	squid::deallocate_aligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	squid::deallocate_aligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	squid::deallocate_aligned(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	squid::deallocate_aligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	squid::deallocate_aligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	squid::deallocate_aligned(p);
+}
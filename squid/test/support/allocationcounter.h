@@ -0,0 +1,53 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <cstdint>
+
+namespace squid {
+
+/// Counts the allocations of the calling thread with the global operator new, from its construction on.
+/// The test support library replaces the global operator new and delete, so only a test executable that links it can
+/// count allocations. Other threads, e.g. of the test framework, do not disturb the counts.
+///
+///   allocation_counter counter{};
+///   statement.execute();
+///   EXPECT_EQ(counter.allocations(), 0u);
+class allocation_counter final
+{
+	std::uint64_t allocations_;
+	std::uint64_t bytes_;
+
+public:
+	allocation_counter() noexcept;
+
+	/// Number of allocations since construction, or since the last reset()
+	std::uint64_t allocations() const noexcept;
+
+	/// Number of bytes allocated since construction, or since the last reset()
+	std::uint64_t bytes() const noexcept;
+
+	/// Start counting again from 0
+	void reset() noexcept;
+};
+
+/// Excludes the allocations of the calling thread from the counts during its lifetime, e.g. those of a mock that
+/// stands in for a backend API, so that only the allocations of the code under test are counted.
+class uncounted_allocations final
+{
+public:
+	uncounted_allocations() noexcept;
+	~uncounted_allocations() noexcept;
+
+	uncounted_allocations(const uncounted_allocations&)            = delete;
+	uncounted_allocations(uncounted_allocations&& src)             = delete;
+	uncounted_allocations& operator=(const uncounted_allocations&) = delete;
+	uncounted_allocations& operator=(uncounted_allocations&&)      = delete;
+};
+
+} // namespace squid
@@ -0,0 +1,249 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/statement.h>
+#include <squid/connection.h>
+#include <squid/connectionpool.h>
+#include <squid/ibackendconnection.h>
+#include <squid/ibackendconnectionfactory.h>
+#include <squid/ibackendstatement.h>
+#include <squid/error.h>
+
+#include <atomic>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace squid {
+
+namespace {
+
+/// A statement for a query of the form "sleep:<ms>", which takes that long unless it is cancelled
+class fake_backend_statement : public ibackend_statement
+{
+	std::string        query_;
+	std::atomic<bool>& cancelled_;
+
+	void run()
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{ std::stoi(this->query_.substr(6)) };
+		while (std::chrono::steady_clock::now() < deadline)
+		{
+			if (this->cancelled_.exchange(false))
+			{
+				throw error{ "canceling statement due to user request" };
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+	}
+
+public:
+	explicit fake_backend_statement(std::string_view query, std::atomic<bool>& cancelled)
+	    : query_{ query }
+	    , cancelled_{ cancelled }
+	{
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::vector<result>&) override
+	{
+		this->run();
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::map<std::string, result>&) override
+	{
+		this->run();
+	}
+
+	bool fetch() override
+	{
+		return false;
+	}
+
+	std::size_t field_count() override
+	{
+		return 0;
+	}
+
+	std::string field_name(std::size_t) override
+	{
+		return {};
+	}
+
+	std::uint64_t affected_rows() override
+	{
+		return 0;
+	}
+};
+
+class fake_backend_connection : public ibackend_connection
+{
+public:
+	std::atomic<bool> cancelled{};
+	std::atomic<int>  cancels{};
+	std::atomic<bool> failing_cancel{};
+
+	std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query, this->cancelled);
+	}
+
+	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query, this->cancelled);
+	}
+
+	void execute(const std::string&) override
+	{
+	}
+
+	bool cancel() override
+	{
+		++this->cancels;
+		if (this->failing_cancel)
+		{
+			throw std::bad_alloc{};
+		}
+		this->cancelled = true;
+		return true;
+	}
+};
+
+class fake_backend_connection_factory : public ibackend_connection_factory
+{
+public:
+	std::shared_ptr<ibackend_connection> create_backend_connection(std::string_view) const override
+	{
+		return std::make_shared<fake_backend_connection>();
+	}
+};
+
+int cancels(connection& connection)
+{
+	return dynamic_cast<fake_backend_connection&>(*connection.backend()).cancels;
+}
+
+} // namespace
+
+TEST(BasicStatementTest, StatementWithinDeadlineCompletes)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	connection                      connection{ pool };
+
+	statement statement{ connection, "sleep:5" };
+	EXPECT_NO_THROW(statement.execute(std::chrono::seconds{ 5 }));
+	EXPECT_NO_THROW(statement.execute(std::chrono::steady_clock::now() + std::chrono::seconds{ 5 }));
+	EXPECT_EQ(cancels(connection), 0);
+}
+
+TEST(BasicStatementTest, StatementPastDeadlineIsCancelled)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	connection                      connection{ pool };
+
+	statement  statement{ connection, "sleep:5000" };
+	const auto start = std::chrono::steady_clock::now();
+	EXPECT_THROW(statement.execute(std::chrono::milliseconds{ 20 }), timeout_error);
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{ 2 });
+	EXPECT_EQ(cancels(connection), 1);
+
+	// The connection can be used again
+	EXPECT_NO_THROW((squid::statement{ connection, "sleep:5" }.execute(std::chrono::seconds{ 5 })));
+	EXPECT_EQ(cancels(connection), 1);
+}
+
+TEST(BasicStatementTest, FailingToCancelLetsTheStatementComplete)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	connection                      connection{ pool };
+
+	dynamic_cast<fake_backend_connection&>(*connection.backend()).failing_cancel = true;
+	statement statement{ connection, "sleep:50" };
+	EXPECT_NO_THROW(statement.execute(std::chrono::milliseconds{ 10 }));
+	EXPECT_EQ(cancels(connection), 1);
+
+	// The watchdog still cancels statements
+	dynamic_cast<fake_backend_connection&>(*connection.backend()).failing_cancel = false;
+	EXPECT_THROW(statement.execute(std::chrono::milliseconds{ 10 }), timeout_error);
+	EXPECT_EQ(cancels(connection), 2);
+}
+
+TEST(BasicStatementTest, PassedDeadlineDoesNotExecute)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	connection                      connection{ pool };
+
+	statement  statement{ connection, "sleep:5000" };
+	const auto start = std::chrono::steady_clock::now();
+	EXPECT_THROW(statement.execute(start - std::chrono::seconds{ 1 }), timeout_error);
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{ 2 });
+	EXPECT_EQ(cancels(connection), 0);
+}
+
+TEST(BasicStatementTest, CancelFromAnotherThread)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	connection                      connection{ pool };
+
+	statement   statement{ connection, "sleep:5000" };
+	std::thread canceller{ [&statement] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+		EXPECT_TRUE(statement.cancel());
+	} };
+	try
+	{
+		statement.execute();
+		ADD_FAILURE() << "the statement was not cancelled";
+	}
+	catch (const timeout_error&)
+	{
+		ADD_FAILURE() << "a cancelled statement without deadline does not time out";
+	}
+	catch (const error&)
+	{
+	}
+	canceller.join();
+}
+
+TEST(BasicStatementTest, ManyDeadlines)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 4 };
+
+	std::atomic<int>         timeouts{};
+	std::vector<std::thread> threads{};
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&pool, &timeouts, t] {
+			connection connection{ pool };
+			for (int n = 0; n < 10; ++n)
+			{
+				statement statement{ connection, t % 2 ? "sleep:1" : "sleep:5000" };
+				try
+				{
+					statement.execute(std::chrono::milliseconds{ t % 2 ? 5000 : 5 });
+				}
+				catch (const timeout_error&)
+				{
+					++timeouts;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_EQ(timeouts, 20);
+}
+
+} // namespace squid
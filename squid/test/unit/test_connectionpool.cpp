@@ -0,0 +1,936 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/connectionpool.h>
+#include <squid/connection.h>
+#include <squid/preparedstatement.h>
+#include <squid/ibackendconnection.h>
+#include <squid/ibackendconnectionfactory.h>
+#include <squid/ibackendstatement.h>
+#include <squid/error.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace squid {
+
+namespace {
+
+std::atomic<int> g_destroyed_connections{};
+
+/// Prepared on the first execution, unless it is prepared before, like the statements of the real backends
+class fake_backend_statement : public ibackend_statement
+{
+	int& prepared_; // number of statements prepared on the connection
+	bool is_prepared_;
+
+public:
+	std::string query;
+	int         executions{};
+
+	explicit fake_backend_statement(std::string_view query, int& prepared)
+	    : prepared_{ prepared }
+	    , is_prepared_{}
+	    , query{ query }
+	{
+	}
+
+	void prepare() override
+	{
+		if (this->is_prepared_)
+		{
+			return;
+		}
+		if (this->query.empty())
+		{
+			throw error{ "syntax error" };
+		}
+		++this->prepared_;
+		this->is_prepared_ = true;
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::vector<result>&) override
+	{
+		this->prepare();
+		++this->executions;
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::map<std::string, result>&) override
+	{
+		this->prepare();
+		++this->executions;
+	}
+
+	bool fetch() override
+	{
+		return false;
+	}
+
+	std::size_t field_count() override
+	{
+		return 0;
+	}
+
+	std::string field_name(std::size_t) override
+	{
+		return {};
+	}
+
+	std::uint64_t affected_rows() override
+	{
+		return 0;
+	}
+};
+
+class fake_backend_connection : public ibackend_connection
+{
+public:
+	std::atomic<bool> broken{};
+	std::atomic<bool> healthy{ true };
+	int               prepared{};
+
+	~fake_backend_connection() noexcept
+	{
+		++g_destroyed_connections;
+	}
+
+	std::unique_ptr<ibackend_statement> create_statement(std::string_view) override
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query, this->prepared);
+	}
+
+	void execute(const std::string&) override
+	{
+	}
+
+	bool is_broken() const noexcept override
+	{
+		return this->broken;
+	}
+
+	bool ping() override
+	{
+		return this->healthy && !this->broken;
+	}
+};
+
+class fake_backend_connection_factory : public ibackend_connection_factory
+{
+public:
+	mutable std::atomic<int>          created{};
+	mutable std::atomic<int>          failed{};
+	mutable std::mutex                mutex{};
+	mutable std::set<std::thread::id> threads{};
+	std::chrono::milliseconds         delay{};
+	std::atomic<bool>                 failing{};
+
+	std::shared_ptr<ibackend_connection> create_backend_connection(std::string_view) const override
+	{
+		{
+			std::lock_guard<std::mutex> lock{ this->mutex };
+			this->threads.insert(std::this_thread::get_id());
+		}
+		std::this_thread::sleep_for(this->delay);
+		if (this->failing)
+		{
+			++this->failed;
+			throw std::runtime_error{ "connection refused" };
+		}
+		++this->created;
+		return std::make_shared<fake_backend_connection>();
+	}
+};
+
+template<typename Predicate>
+bool eventually(Predicate&& predicate)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 10 };
+	while (!predicate())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	}
+	return true;
+}
+
+} // namespace
+
+TEST(ConnectionPoolTest, CountMustBeGreaterThanZero)
+{
+	fake_backend_connection_factory factory{};
+	EXPECT_THROW((connection_pool{ factory, "", 0 }), std::invalid_argument);
+}
+
+TEST(ConnectionPoolTest, CreatesAllConnectionsUpFront)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 3 };
+	EXPECT_EQ(factory.created, 3);
+}
+
+TEST(ConnectionPoolTest, TryAcquireReturnsNullWhenExhausted)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 2 };
+
+	auto first  = pool.try_acquire();
+	auto second = pool.try_acquire();
+	ASSERT_NE(first, nullptr);
+	ASSERT_NE(second, nullptr);
+	EXPECT_NE(first, second);
+	EXPECT_EQ(pool.try_acquire(), nullptr);
+
+	second.reset();
+	EXPECT_NE(pool.try_acquire(), nullptr);
+}
+
+TEST(ConnectionPoolTest, AcquiredConnectionIsTheBackendConnection)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	auto connection = pool.acquire();
+	EXPECT_NE(std::dynamic_pointer_cast<fake_backend_connection>(connection), nullptr);
+}
+
+TEST(ConnectionPoolTest, ConnectionIsReturnedWhenLastCopyIsReleased)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	auto connection = pool.acquire();
+	auto copy       = connection;
+	connection.reset();
+	EXPECT_EQ(pool.try_acquire(), nullptr);
+
+	const auto* raw = copy.get();
+	copy.reset();
+	auto again = pool.try_acquire();
+	EXPECT_EQ(again.get(), raw);
+}
+
+TEST(ConnectionPoolTest, AcquireWithTimeout)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	auto connection = pool.acquire(std::chrono::milliseconds{ 10 });
+	ASSERT_NE(connection, nullptr);
+	EXPECT_EQ(pool.acquire(std::chrono::milliseconds{ 10 }), nullptr);
+}
+
+TEST(ConnectionPoolTest, WaitingThreadIsWokenOnRelease)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	auto connection = pool.acquire();
+
+	std::thread waiter{ [&pool] {
+		auto acquired = pool.acquire(std::chrono::seconds{ 10 });
+		EXPECT_NE(acquired, nullptr);
+	} };
+
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+	connection.reset();
+	waiter.join();
+}
+
+TEST(ConnectionPoolTest, ShardedPoolStealsFromOtherShards)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 5, connection_pool_options{ .shards = 4 } };
+
+	std::vector<std::shared_ptr<ibackend_connection>> held{};
+	for (int n = 0; n < 5; ++n)
+	{
+		held.push_back(pool.try_acquire());
+		EXPECT_NE(held.back(), nullptr);
+	}
+	EXPECT_EQ(pool.try_acquire(), nullptr);
+	EXPECT_EQ(pool.acquire(std::chrono::milliseconds{ 1 }), nullptr);
+
+	held.pop_back();
+	EXPECT_NE(pool.try_acquire(), nullptr);
+}
+
+TEST(ConnectionPoolTest, ShardedPoolWaitingThreadIsWokenOnReleaseByOtherThread)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 2, connection_pool_options{ .shards = 2 } };
+
+	auto first  = pool.acquire();
+	auto second = pool.acquire();
+
+	std::thread waiter{ [&pool] {
+		auto acquired = pool.acquire();
+		EXPECT_NE(acquired, nullptr);
+	} };
+
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+	second.reset();
+	waiter.join();
+}
+
+TEST(ConnectionPoolTest, MinConnectionsMustNotExceedCount)
+{
+	fake_backend_connection_factory factory{};
+	EXPECT_THROW((connection_pool{ factory, "", 2, connection_pool_options{ .min_connections = 3 } }), std::invalid_argument);
+}
+
+TEST(ConnectionPoolTest, InitialConnectionsAreOpenedInParallel)
+{
+	fake_backend_connection_factory factory{};
+	factory.delay = std::chrono::milliseconds{ 20 };
+
+	connection_pool pool{ factory, "", 8, connection_pool_options{ .connect_concurrency = 4 } };
+	EXPECT_EQ(factory.created, 8);
+	EXPECT_EQ(pool.size(), 8u);
+	EXPECT_EQ(factory.threads.size(), 4u);
+}
+
+TEST(ConnectionPoolTest, ElasticPoolGrowsWhenThreadsWait)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory,
+                              "",
+                              3,
+                              connection_pool_options{ .min_connections = 1, .target_acquire_wait = std::chrono::seconds{ 1 } } };
+	EXPECT_EQ(factory.created, 1);
+	EXPECT_EQ(pool.size(), 1u);
+
+	auto first  = pool.acquire();
+	auto second = pool.acquire(std::chrono::seconds{ 10 });
+	auto third  = pool.acquire(std::chrono::seconds{ 10 });
+	EXPECT_NE(second, nullptr);
+	EXPECT_NE(third, nullptr);
+	EXPECT_EQ(pool.size(), 3u);
+	EXPECT_EQ(pool.acquire(std::chrono::milliseconds{ 10 }), nullptr);
+	EXPECT_EQ(pool.size(), 3u);
+}
+
+TEST(ConnectionPoolTest, IdleConnectionsAboveMinimumAreEvicted)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory,
+                              "",
+                              3,
+                              connection_pool_options{ .min_connections      = 1,
+                                                       .idle_timeout         = std::chrono::milliseconds{ 20 },
+                                                       .target_acquire_wait  = std::chrono::seconds{ 1 },
+                                                       .maintenance_interval = std::chrono::milliseconds{ 5 } } };
+	{
+		auto first  = pool.acquire();
+		auto second = pool.acquire();
+		auto third  = pool.acquire();
+		EXPECT_EQ(pool.size(), 3u);
+	}
+
+	const auto destroyed = g_destroyed_connections.load();
+	EXPECT_TRUE(eventually([&] { return pool.size() == 1u; }));
+	EXPECT_EQ(g_destroyed_connections - destroyed, 2);
+	EXPECT_NE(pool.try_acquire(), nullptr);
+}
+
+TEST(ConnectionPoolTest, ConnectionsAreRecycledAfterMaxLifetime)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory,
+                              "",
+                              2,
+                              connection_pool_options{ .max_lifetime         = std::chrono::milliseconds{ 10 },
+                                                       .maintenance_interval = std::chrono::milliseconds{ 5 } } };
+
+	EXPECT_TRUE(eventually([&] { return factory.created >= 6; }));
+	EXPECT_EQ(pool.size(), 2u);
+	auto first  = pool.acquire(std::chrono::seconds{ 10 });
+	auto second = pool.acquire(std::chrono::seconds{ 10 });
+	EXPECT_NE(first, nullptr);
+	EXPECT_NE(second, nullptr);
+}
+
+TEST(ConnectionPoolTest, ReconnectBackoffMustBeValid)
+{
+	fake_backend_connection_factory factory{};
+	EXPECT_THROW((connection_pool{ factory, "", 1, connection_pool_options{ .reconnect_backoff = std::chrono::milliseconds::zero() } }),
+	             std::invalid_argument);
+	EXPECT_THROW((connection_pool{ factory,
+	                               "",
+	                               1,
+	                               connection_pool_options{ .reconnect_backoff     = std::chrono::seconds{ 2 },
+	                                                        .max_reconnect_backoff = std::chrono::seconds{ 1 } } }),
+	             std::invalid_argument);
+}
+
+TEST(ConnectionPoolTest, BrokenConnectionIsReplacedOnRelease)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	fake_backend_connection* broken{ nullptr };
+	{
+		auto connection = pool.acquire();
+		broken          = dynamic_cast<fake_backend_connection*>(connection.get());
+		ASSERT_NE(broken, nullptr);
+		broken->broken = true;
+	}
+
+	auto connection = pool.acquire(std::chrono::seconds{ 10 });
+	ASSERT_NE(connection, nullptr);
+	EXPECT_FALSE(connection->is_broken());
+	EXPECT_EQ(factory.created, 2);
+	EXPECT_EQ(pool.size(), 1u);
+}
+
+TEST(ConnectionPoolTest, IdleConnectionFailingHealthCheckIsReplaced)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory,
+                              "",
+                              1,
+                              connection_pool_options{ .health_check_interval = std::chrono::milliseconds{ 5 },
+                                                       .maintenance_interval  = std::chrono::milliseconds{ 5 } } };
+	{
+		auto connection = pool.acquire();
+		dynamic_cast<fake_backend_connection&>(*connection).healthy = false;
+	}
+
+	EXPECT_TRUE(eventually([&] { return factory.created == 2; }));
+	auto connection = pool.acquire(std::chrono::seconds{ 10 });
+	ASSERT_NE(connection, nullptr);
+	EXPECT_TRUE(connection->ping());
+}
+
+TEST(ConnectionPoolTest, MaintenanceLeavesIdleConnectionsThatAreNotDueInPlace)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory,
+                              "",
+                              2,
+                              connection_pool_options{ .health_check_interval = std::chrono::hours{ 1 },
+                                                       .maintenance_interval  = std::chrono::milliseconds{ 1 },
+                                                       .thread_affinity       = true } };
+
+	// The connection of this thread is released first, so it would be below the other one if both were idle
+	auto       own = pool.acquire();
+	const auto raw = own.get();
+	own.reset();
+	std::thread{ [&pool] { pool.acquire(); } }.join();
+
+	for (int n = 0; n < 100; ++n)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		auto connection = pool.try_acquire();
+		ASSERT_NE(connection, nullptr);
+		EXPECT_EQ(connection.get(), raw);
+	}
+	EXPECT_EQ(factory.created, 2);
+}
+
+TEST(ConnectionPoolTest, ReconnectBacksOffWhileConnectingFails)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory,
+                              "",
+                              1,
+                              connection_pool_options{ .reconnect_backoff     = std::chrono::milliseconds{ 20 },
+                                                       .max_reconnect_backoff = std::chrono::milliseconds{ 40 } } };
+
+	factory.failing = true;
+	{
+		auto connection = pool.acquire();
+		dynamic_cast<fake_backend_connection&>(*connection).broken = true;
+	}
+
+	EXPECT_EQ(pool.acquire(std::chrono::milliseconds{ 200 }), nullptr);
+	// Without backoff, the maintenance thread would have retried continuously.
+	// With a delay of at least 10 ms, at most 21 attempts fit in 200 ms.
+	EXPECT_GE(factory.failed, 2);
+	EXPECT_LE(factory.failed, 21);
+
+	factory.failing = false;
+	auto connection = pool.acquire(std::chrono::seconds{ 10 });
+	ASSERT_NE(connection, nullptr);
+	EXPECT_FALSE(connection->is_broken());
+}
+
+TEST(ConnectionPoolTest, StatsCountAcquisitionsAndTimeouts)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 2 };
+
+	{
+		auto first  = pool.acquire();
+		auto second = pool.try_acquire();
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 2 });
+		EXPECT_EQ(pool.acquire(std::chrono::milliseconds{ 1 }), nullptr);
+		EXPECT_EQ(pool.try_acquire(), nullptr);
+
+		const auto stats = pool.stats();
+		EXPECT_EQ(stats.total, 2u);
+		EXPECT_EQ(stats.in_use, 2u);
+		EXPECT_EQ(stats.idle, 0u);
+		EXPECT_EQ(stats.waiters, 0u);
+		EXPECT_EQ(stats.acquisitions, 2u);
+		EXPECT_EQ(stats.timeouts, 1u);
+		EXPECT_EQ(stats.acquire_wait.count(), 2u);
+	}
+
+	const auto stats = pool.stats();
+	EXPECT_EQ(stats.in_use, 0u);
+	EXPECT_EQ(stats.idle, 2u);
+	EXPECT_EQ(stats.acquisitions, 2u);
+	EXPECT_EQ(stats.connections_created, 2u);
+	EXPECT_EQ(stats.connections_destroyed, 0u);
+	EXPECT_EQ(stats.connect_failures, 0u);
+}
+
+TEST(ConnectionPoolTest, StatsSampleHoldTimes)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	// A new thread, so that its first acquisition is sampled
+	std::thread{ [&pool] {
+		for (std::uint32_t n = 0; n <= connection_pool_stats::hold_time_sampling; ++n)
+		{
+			auto connection = pool.acquire();
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 2 });
+		}
+	} }.join();
+
+	const auto stats = pool.stats();
+	EXPECT_EQ(stats.acquisitions, connection_pool_stats::hold_time_sampling + 1u);
+	EXPECT_EQ(stats.hold_time.count(), 2u);
+	EXPECT_GE(stats.hold_time.quantile(0.0), std::chrono::milliseconds{ 2 });
+}
+
+TEST(ConnectionPoolTest, StatsCountAcquisitionsOfAllShards)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 4, connection_pool_options{ .shards = 4 } };
+
+	std::vector<std::thread> threads{};
+	for (int n = 0; n < 4; ++n)
+	{
+		threads.emplace_back([&pool] {
+			for (int i = 0; i < 1000; ++i)
+			{
+				pool.acquire();
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	const auto stats = pool.stats();
+	EXPECT_EQ(stats.acquisitions, 4000u);
+	EXPECT_EQ(stats.acquire_wait.count(), 4000u);
+	EXPECT_EQ(stats.idle, 4u);
+}
+
+TEST(ConnectionPoolTest, StatsRecordWaitTime)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	auto        connection = pool.acquire();
+	std::thread releaser{ [&connection] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 5 });
+		connection.reset();
+	} };
+	EXPECT_NE(pool.acquire(std::chrono::seconds{ 10 }), nullptr);
+	releaser.join();
+
+	const auto stats = pool.stats();
+	EXPECT_EQ(stats.acquire_wait.count(), 2u);
+	EXPECT_EQ(stats.acquire_wait.quantile(0.0), std::chrono::nanoseconds{ 1 });
+	EXPECT_GE(stats.acquire_wait.quantile(1.0), std::chrono::milliseconds{ 1 });
+}
+
+TEST(ConnectionPoolTest, StatsCountReplacedConnections)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	factory.failing = true;
+	pool.acquire()->execute(""); // a usable connection
+	{
+		auto connection = pool.acquire();
+		dynamic_cast<fake_backend_connection&>(*connection).broken = true;
+	}
+	EXPECT_TRUE(eventually([&] { return pool.stats().connect_failures > 0; }));
+	factory.failing = false;
+	EXPECT_NE(pool.acquire(std::chrono::seconds{ 10 }), nullptr);
+
+	const auto stats = pool.stats();
+	EXPECT_EQ(stats.connections_created, 2u);
+	EXPECT_EQ(stats.connections_destroyed, 1u);
+	EXPECT_GE(stats.connect_failures, 1u);
+}
+
+TEST(ConnectionPoolTest, PrometheusText)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 2 };
+	{
+		auto connection = pool.acquire();
+	}
+
+	const auto text = to_prometheus_text(pool.stats(), "main \"db\"");
+	EXPECT_NE(text.find("# TYPE squid_connection_pool_connections gauge\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_connection_pool_connections{pool=\"main \\\"db\\\"\"} 2\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_connection_pool_acquisitions_total{pool=\"main \\\"db\\\"\"} 1\n"), std::string::npos);
+	EXPECT_NE(text.find("# TYPE squid_connection_pool_acquire_wait_seconds histogram\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_connection_pool_acquire_wait_seconds_bucket{pool=\"main \\\"db\\\"\",le=\"1e-06\"} 1\n"),
+	          std::string::npos);
+	EXPECT_NE(text.find("squid_connection_pool_acquire_wait_seconds_bucket{pool=\"main \\\"db\\\"\",le=\"+Inf\"} 1\n"),
+	          std::string::npos);
+	EXPECT_NE(text.find("squid_connection_pool_acquire_wait_seconds_count{pool=\"main \\\"db\\\"\"} 1\n"), std::string::npos);
+	EXPECT_NE(text.find("# TYPE squid_connection_pool_hold_time_seconds histogram\n"), std::string::npos);
+
+	const auto unlabeled = to_prometheus_text(pool.stats(), {}, "app_pool");
+	EXPECT_NE(unlabeled.find("app_pool_idle_connections 2\n"), std::string::npos);
+	EXPECT_NE(unlabeled.find("app_pool_acquire_wait_seconds_bucket{le=\"10\"} 1\n"), std::string::npos);
+}
+
+TEST(ConnectionPoolTest, HigherPriorityIsServedFirst)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	std::mutex                       mutex{};
+	std::vector<connection_priority> served{};
+
+	auto held   = pool.acquire();
+	auto waiter = [&](connection_priority priority) {
+		return std::thread{ [&, priority] {
+			auto connection = pool.acquire(priority);
+			std::lock_guard<std::mutex> lock{ mutex };
+			served.push_back(priority);
+		} };
+	};
+
+	auto low = waiter(connection_priority::low);
+	ASSERT_TRUE(eventually([&] { return pool.stats().waiters == 1u; }));
+	auto normal = waiter(connection_priority::normal);
+	ASSERT_TRUE(eventually([&] { return pool.stats().waiters == 2u; }));
+	auto high = waiter(connection_priority::high);
+	ASSERT_TRUE(eventually([&] { return pool.stats().waiters == 3u; }));
+
+	EXPECT_EQ(pool.try_acquire(connection_priority::high), nullptr);
+	held.reset();
+	low.join();
+	normal.join();
+	high.join();
+
+	const std::vector<connection_priority> expected{ connection_priority::high, connection_priority::normal, connection_priority::low };
+	EXPECT_EQ(served, expected);
+}
+
+TEST(ConnectionPoolTest, LowerPriorityIsServedWhenHigherPriorityGivesUp)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	auto                              held = pool.acquire();
+	std::shared_ptr<ibackend_connection> low_connection{};
+	std::thread low{ [&] { low_connection = pool.acquire(std::chrono::seconds{ 10 }, connection_priority::low); } };
+	ASSERT_TRUE(eventually([&] { return pool.stats().waiters == 1u; }));
+
+	std::thread high{ [&] { EXPECT_EQ(pool.acquire(std::chrono::milliseconds{ 100 }, connection_priority::high), nullptr); } };
+	ASSERT_TRUE(eventually([&] { return pool.stats().waiters == 2u; }));
+	high.join();
+
+	held.reset();
+	low.join();
+	EXPECT_NE(low_connection, nullptr);
+}
+
+TEST(ConnectionPoolTest, ReleasesThatWakeTheSameThreadServeOtherPriorities)
+{
+	// Both releases wake the thread of high priority only if it does not run in between, so try a few times
+	for (int attempt = 0; attempt < 20; ++attempt)
+	{
+		fake_backend_connection_factory factory{};
+		connection_pool                 pool{ factory, "", 2 };
+
+		auto                                 first  = pool.acquire();
+		auto                                 second = pool.acquire();
+		std::shared_ptr<ibackend_connection> high_connection{};
+		std::atomic<bool>                    normal_served{};
+		std::thread high{ [&] { high_connection = pool.acquire(std::chrono::seconds{ 10 }, connection_priority::high); } };
+		ASSERT_TRUE(eventually([&] { return pool.stats().waiters == 1u; }));
+		std::thread normal{ [&] {
+			auto connection = pool.acquire();
+			normal_served   = true;
+		} };
+		ASSERT_TRUE(eventually([&] { return pool.stats().waiters == 2u; }));
+
+		first.reset();
+		second.reset();
+		high.join();
+		EXPECT_NE(high_connection, nullptr);
+		EXPECT_TRUE(eventually([&] { return normal_served.load(); }));
+
+		// Unblocks the thread of normal priority if it was not served
+		high_connection.reset();
+		normal.join();
+	}
+}
+
+TEST(ConnectionPoolTest, MaxWaitersRejectsImmediately)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1, connection_pool_options{ .max_waiters = 1 } };
+
+	auto        held = pool.acquire();
+	std::thread waiter{ [&] { EXPECT_NE(pool.acquire(std::chrono::seconds{ 10 }), nullptr); } };
+	ASSERT_TRUE(eventually([&] { return pool.stats().waiters == 1u; }));
+
+	const auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(pool.acquire(std::chrono::seconds{ 10 }), nullptr);
+	EXPECT_THROW(pool.acquire(), error);
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{ 5 });
+	EXPECT_EQ(pool.stats().rejections, 2u);
+
+	held.reset();
+	waiter.join();
+}
+
+TEST(ConnectionPoolTest, UnreachableDeadlineIsRejected)
+{
+	EXPECT_FALSE(connection_pool_options{}.reject_unreachable_deadlines);
+
+	for (const auto reject : { true, false })
+	{
+		fake_backend_connection_factory factory{};
+		connection_pool                 pool{ factory,
+                                  "",
+                                  1,
+                                  connection_pool_options{ .maintenance_interval = std::chrono::milliseconds{ 10 },
+                                                           .reject_unreachable_deadlines = reject } };
+
+		// Two threads take turns holding the only connection for 20 ms
+		std::atomic<bool>        stop{};
+		std::vector<std::thread> workers{};
+		for (int n = 0; n < 2; ++n)
+		{
+			workers.emplace_back([&] {
+				while (!stop)
+				{
+					auto connection = pool.acquire();
+					std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+				}
+			});
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 200 });
+		for (int n = 0; n < 10; ++n)
+		{
+			EXPECT_EQ(pool.acquire(std::chrono::milliseconds{ 1 }), nullptr);
+		}
+		stop = true;
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		const auto stats = pool.stats();
+		if (reject)
+		{
+			EXPECT_GT(stats.rejections, 0u);
+		}
+		else
+		{
+			EXPECT_EQ(stats.rejections, 0u);
+			EXPECT_EQ(stats.timeouts, 10u);
+		}
+	}
+}
+
+TEST(ConnectionPoolTest, ThreadAffinityReturnsTheLastConnectionOfTheThread)
+{
+	for (const auto affinity : { true, false })
+	{
+		fake_backend_connection_factory factory{};
+		connection_pool                 pool{ factory, "", 2, connection_pool_options{ .shards = 1, .thread_affinity = affinity } };
+
+		auto       own = pool.acquire();
+		const auto raw = own.get();
+		std::shared_ptr<ibackend_connection> other{};
+		std::thread{ [&] { other = pool.acquire(); } }.join();
+
+		// Without affinity, the connection that was released last is acquired first
+		own.reset();
+		std::thread{ [&] { other.reset(); } }.join();
+		EXPECT_EQ(pool.acquire().get() == raw, affinity);
+	}
+}
+
+TEST(ConnectionPoolTest, ParkedConnectionsAreTakenByOtherThreads)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 2, connection_pool_options{ .thread_affinity = true } };
+
+	std::thread{ [&pool] {
+		auto first  = pool.acquire();
+		auto second = pool.acquire();
+	} }.join();
+	EXPECT_EQ(pool.stats().idle, 2u);
+
+	auto first  = pool.try_acquire();
+	auto second = pool.try_acquire();
+	EXPECT_NE(first, nullptr);
+	EXPECT_NE(second, nullptr);
+	EXPECT_NE(first, second);
+	EXPECT_EQ(pool.try_acquire(), nullptr);
+
+	const auto stats = pool.stats();
+	EXPECT_EQ(stats.idle, 0u);
+	EXPECT_EQ(stats.acquisitions, 4u);
+}
+
+TEST(ConnectionPoolTest, ThreadAffinityServesWaiters)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1, connection_pool_options{ .thread_affinity = true } };
+
+	auto                                 connection = pool.acquire();
+	const auto                           raw        = connection.get();
+	std::shared_ptr<ibackend_connection> waited{};
+	std::thread                          waiter{ [&] { waited = pool.acquire(std::chrono::seconds{ 10 }); } };
+	EXPECT_TRUE(eventually([&] { return pool.stats().waiters == 1u; }));
+	connection.reset();
+	waiter.join();
+
+	EXPECT_EQ(waited.get(), raw);
+	EXPECT_EQ(pool.try_acquire(), nullptr);
+}
+
+TEST(ConnectionPoolTest, RegisteredStatementsArePreparedOnEveryConnection)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory,
+                              "",
+                              2,
+                              connection_pool_options{ .statements = { { "one", "SELECT 1" }, { "two", "SELECT 2" } } } };
+
+	connection first{ pool };
+	connection second{ pool };
+	for (const auto& connection : { &first, &second })
+	{
+		EXPECT_EQ(dynamic_cast<fake_backend_connection&>(*connection->backend()).prepared, 2);
+	}
+
+	auto* one = dynamic_cast<fake_backend_statement*>(connection_pool::registered_statement(first.backend(), "one"));
+	ASSERT_NE(one, nullptr);
+	EXPECT_EQ(one->query, "SELECT 1");
+	EXPECT_EQ(connection_pool::registered_statement(first.backend(), "three"), nullptr);
+	EXPECT_NE(connection_pool::registered_statement(second.backend(), "one"), one);
+
+	// Executing a registered statement does not prepare it again
+	prepared_statement::registered(first, "one").execute();
+	auto statement = prepared_statement::registered(first, "one");
+	statement.bind("x", 1).execute();
+	EXPECT_EQ(one->executions, 2);
+	EXPECT_EQ(dynamic_cast<fake_backend_connection&>(*first.backend()).prepared, 2);
+
+	EXPECT_THROW(prepared_statement::registered(first, "three"), error);
+	connection unpooled{ factory, "" };
+	EXPECT_THROW(prepared_statement::registered(unpooled, "one"), error);
+
+	// Without a pool, a statement is only prepared when it is executed
+	prepared_statement lazy{ unpooled, "SELECT 3" };
+	EXPECT_EQ(dynamic_cast<fake_backend_connection&>(*unpooled.backend()).prepared, 0);
+	lazy.execute();
+	EXPECT_EQ(dynamic_cast<fake_backend_connection&>(*unpooled.backend()).prepared, 1);
+}
+
+TEST(ConnectionPoolTest, ReplacementConnectionsPrepareRegisteredStatements)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1, connection_pool_options{ .statements = { { "one", "SELECT 1" } } } };
+
+	{
+		auto connection = pool.acquire();
+		dynamic_cast<fake_backend_connection&>(*connection).broken = true;
+	}
+	auto connection = pool.acquire(std::chrono::seconds{ 10 });
+	ASSERT_NE(connection, nullptr);
+	EXPECT_EQ(pool.stats().connections_created, 2u);
+	EXPECT_EQ(dynamic_cast<fake_backend_connection&>(*connection).prepared, 1);
+	EXPECT_NE(connection_pool::registered_statement(connection, "one"), nullptr);
+}
+
+TEST(ConnectionPoolTest, FailingToPrepareFailsToConnect)
+{
+	fake_backend_connection_factory factory{};
+	EXPECT_THROW((connection_pool{ factory, "", 1, connection_pool_options{ .statements = { { "bad", "" } } } }), error);
+
+	connection_pool pool{ factory, "", 1, connection_pool_options{ .min_connections = 0, .statements = { { "bad", "" } } } };
+	EXPECT_EQ(pool.acquire(std::chrono::milliseconds{ 50 }), nullptr);
+	EXPECT_TRUE(eventually([&pool] { return pool.stats().connect_failures > 0u; }));
+	EXPECT_EQ(pool.size(), 0u);
+}
+
+class ConnectionPoolConcurrencyTest : public testing::TestWithParam<std::size_t>
+{
+};
+
+TEST_P(ConnectionPoolConcurrencyTest, ConcurrentAcquireAndRelease)
+{
+	for (const auto affinity : { false, true })
+	{
+		fake_backend_connection_factory factory{};
+		connection_pool pool{ factory, "", 3, connection_pool_options{ .shards = GetParam(), .thread_affinity = affinity } };
+
+		std::vector<std::thread> threads{};
+		for (int t = 0; t < 8; ++t)
+		{
+			threads.emplace_back([&pool] {
+				for (int n = 0; n < 1000; ++n)
+				{
+					auto connection = (n % 2) ? pool.acquire() : pool.acquire(std::chrono::seconds{ 10 });
+					EXPECT_NE(connection, nullptr);
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		std::set<ibackend_connection*>                    connections{};
+		std::vector<std::shared_ptr<ibackend_connection>> held{};
+		while (auto connection = pool.try_acquire())
+		{
+			connections.insert(connection.get());
+			held.push_back(std::move(connection));
+		}
+		EXPECT_EQ(connections.size(), 3u);
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(Shards, ConnectionPoolConcurrencyTest, testing::Values(1u, 2u, 3u, 0u));
+
+} // namespace squid
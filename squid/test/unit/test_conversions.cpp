@@ -303,4 +303,31 @@ TEST(ConversionsTest, TimeOfDayToString)
 	EXPECT_EQ(time_of_day_to_string(make_time_of_day_micro(3, 4, 5.1234567)), "03:04:05.123457");
 }
 
+TEST(ConversionsTest, DateToStringNegativeYear)
+{
+	EXPECT_EQ(date_to_string(make_date(-88, 3, 1)), "-088-03-01");
+}
+
+TEST(ConversionsTest, DateTimeToCharsBufferTooSmall)
+{
+	char buffer[max_date_time_chars];
+	auto res = time_point_to_chars(buffer, buffer + 19, make_time_point(2022, 3, 1, 3, 4, 5));
+	EXPECT_EQ(res.ec, std::errc::value_too_large);
+	res = time_point_to_chars(buffer, buffer + 20, make_time_point(2022, 3, 1, 3, 4, 5));
+	EXPECT_EQ(res.ec, std::errc{});
+	EXPECT_EQ(std::string_view(buffer, res.ptr - buffer), "2022-03-01 03:04:05Z");
+
+	EXPECT_EQ(date_to_chars(buffer, buffer + 9, make_date(2022, 3, 1)).ec, std::errc::value_too_large);
+	EXPECT_EQ(time_of_day_to_chars(buffer, buffer + 7, make_time_of_day(3, 4, 5)).ec, std::errc::value_too_large);
+}
+
+TEST(ConversionsTest, NumberToChars)
+{
+	char buffer[64];
+	EXPECT_EQ(std::string_view(buffer, number_to_chars(buffer, std::end(buffer), 0.1 + 0.2) - buffer), "0.30000000000000004");
+	EXPECT_EQ(std::string_view(buffer, number_to_chars(buffer, std::end(buffer), 42.42f) - buffer), "42.42");
+	EXPECT_EQ(std::string_view(buffer, number_to_chars(buffer, std::end(buffer), std::int64_t{ -42 }) - buffer), "-42");
+	EXPECT_THROW(number_to_chars(buffer, buffer + 2, 12345), std::system_error);
+}
+
 } // namespace squid
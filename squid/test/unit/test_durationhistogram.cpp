@@ -0,0 +1,124 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/durationhistogram.h>
+
+#include "squid/detail/concurrenthistogram.h"
+
+#include <thread>
+#include <vector>
+
+namespace squid {
+
+using namespace std::chrono_literals;
+
+TEST(DurationHistogramTest, BucketsAreContiguous)
+{
+	EXPECT_EQ(duration_histogram::lower_bound(0), 0ns);
+	for (std::size_t bucket = 0; bucket + 1 < duration_histogram::bucket_count; ++bucket)
+	{
+		const auto lower = duration_histogram::lower_bound(bucket);
+		const auto upper = duration_histogram::upper_bound(bucket);
+		ASSERT_LT(lower, upper);
+		ASSERT_EQ(duration_histogram::bucket_of(static_cast<std::uint64_t>(lower.count())), bucket);
+		ASSERT_EQ(duration_histogram::bucket_of(static_cast<std::uint64_t>(upper.count()) - 1u), bucket);
+		ASSERT_EQ(duration_histogram::bucket_of(static_cast<std::uint64_t>(upper.count())), bucket + 1);
+	}
+}
+
+TEST(DurationHistogramTest, RelativeBucketWidthIsBounded)
+{
+	for (std::size_t bucket = duration_histogram::sub_buckets; bucket + 1 < duration_histogram::bucket_count; ++bucket)
+	{
+		const auto lower = duration_histogram::lower_bound(bucket).count();
+		const auto width = duration_histogram::upper_bound(bucket).count() - lower;
+		ASSERT_LE(width * static_cast<std::int64_t>(duration_histogram::sub_buckets), lower);
+	}
+}
+
+TEST(DurationHistogramTest, Quantiles)
+{
+	concurrent_histogram recorder{};
+	for (int n = 1; n <= 100; ++n)
+	{
+		recorder.record(std::chrono::microseconds{ n });
+	}
+
+	duration_histogram histogram{};
+	recorder.add_to(histogram);
+
+	EXPECT_EQ(histogram.count(), 100u);
+	EXPECT_EQ(histogram.mean(), 50500ns);
+
+	const auto p50 = histogram.quantile(0.5);
+	EXPECT_GE(p50, 50us);
+	EXPECT_LE(p50, 50us + 50us / 16);
+
+	const auto p99 = histogram.quantile(0.99);
+	EXPECT_GE(p99, 99us);
+	EXPECT_LE(p99, 99us + 99us / 16);
+
+	EXPECT_EQ(histogram.quantile(0.0), histogram.quantile(0.01));
+	EXPECT_GE(histogram.quantile(1.0), 100us);
+}
+
+TEST(DurationHistogramTest, EmptyHistogram)
+{
+	const duration_histogram histogram{};
+	EXPECT_EQ(histogram.count(), 0u);
+	EXPECT_EQ(histogram.mean(), 0ns);
+	EXPECT_EQ(histogram.quantile(0.99), 0ns);
+}
+
+TEST(DurationHistogramTest, CountAtMostRoundsDownToWholeBuckets)
+{
+	concurrent_histogram recorder{};
+	recorder.record(1000ns);
+	recorder.record(1001ns);
+	recorder.record(2ms);
+	recorder.record(-5ns); // clock skew, counted as 0
+
+	duration_histogram histogram{};
+	recorder.add_to(histogram);
+
+	EXPECT_EQ(histogram.count_at_most(0ns), 1u);
+	// 1000 and 1001 share the bucket [992, 1024)
+	EXPECT_EQ(histogram.count_at_most(1000ns), 1u);
+	EXPECT_EQ(histogram.count_at_most(1023ns), 3u);
+	EXPECT_EQ(histogram.count_at_most(1s), 4u);
+}
+
+TEST(DurationHistogramTest, ConcurrentRecording)
+{
+	concurrent_histogram recorder{};
+
+	std::vector<std::thread> threads{};
+	for (int n = 0; n < 4; ++n)
+	{
+		threads.emplace_back([&recorder] {
+			for (int i = 0; i < 10000; ++i)
+			{
+				recorder.record(std::chrono::nanoseconds{ i });
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	duration_histogram histogram{};
+	recorder.add_to(histogram);
+	EXPECT_EQ(histogram.count(), 40000u);
+	EXPECT_EQ(histogram.total_nanoseconds, 4u * (9999u * 10000u / 2u));
+
+	histogram += histogram;
+	EXPECT_EQ(histogram.count(), 80000u);
+}
+
+} // namespace squid
@@ -0,0 +1,416 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/executor.h>
+#include <squid/connectionpool.h>
+#include <squid/statement.h>
+#include <squid/ibackendconnection.h>
+#include <squid/ibackendconnectionfactory.h>
+#include <squid/ibackendstatement.h>
+#include <squid/error.h>
+
+#include <atomic>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace squid {
+
+namespace {
+
+std::atomic<bool> g_hold_cancel{};   // while set, cancel requests are not sent yet
+std::atomic<bool> g_sending_cancel{}; // whether a cancel request is being sent
+
+/// A statement for a query of the form "rows:<count>", returning rows (n, "n") for n in [0, count),
+/// or "sleep:<ms>", which takes that long unless it is cancelled
+class fake_backend_statement : public ibackend_statement
+{
+	std::string                          query_;
+	std::atomic<bool>&                   cancelled_;
+	const std::vector<result>*           results_;       // bindings of the statement, which outlive the execution
+	const std::map<std::string, result>* named_results_; // idem
+	int                                  count_;
+	int                                  row_;
+
+	void run()
+	{
+		this->row_   = 0;
+		this->count_ = 0;
+		if (this->query_.starts_with("rows:"))
+		{
+			this->count_ = std::stoi(this->query_.substr(5));
+		}
+		else if (this->query_.starts_with("sleep:"))
+		{
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{ std::stoi(this->query_.substr(6)) };
+			while (std::chrono::steady_clock::now() < deadline)
+			{
+				if (this->cancelled_.exchange(false))
+				{
+					throw error{ "canceling statement due to user request" };
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+			}
+		}
+	}
+
+public:
+	explicit fake_backend_statement(std::string_view query, std::atomic<bool>& cancelled)
+	    : query_{ query }
+	    , cancelled_{ cancelled }
+	    , results_{}
+	    , named_results_{}
+	    , count_{}
+	    , row_{}
+	{
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::vector<result>& results) override
+	{
+		this->results_       = &results;
+		this->named_results_ = nullptr;
+		this->run();
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::map<std::string, result>& results) override
+	{
+		this->results_       = nullptr;
+		this->named_results_ = &results;
+		this->run();
+	}
+
+	bool fetch() override
+	{
+		if (this->row_ == this->count_)
+		{
+			return false;
+		}
+		const auto set = [](const result& result, int value) {
+			const auto& pointer = std::get<result::non_nullable_type>(result.value());
+			if (std::holds_alternative<std::int32_t*>(pointer))
+			{
+				*std::get<std::int32_t*>(pointer) = value;
+			}
+			else
+			{
+				*std::get<std::string*>(pointer) = std::to_string(value);
+			}
+		};
+		if (this->results_)
+		{
+			for (const auto& result : *this->results_)
+			{
+				set(result, this->row_);
+			}
+		}
+		if (this->named_results_)
+		{
+			for (const auto& [name, result] : *this->named_results_)
+			{
+				set(result, this->row_);
+			}
+		}
+		++this->row_;
+		return true;
+	}
+
+	std::size_t field_count() override
+	{
+		return 2;
+	}
+
+	std::string field_name(std::size_t index) override
+	{
+		return index ? "name" : "id";
+	}
+
+	std::uint64_t affected_rows() override
+	{
+		return 0;
+	}
+};
+
+class fake_backend_connection : public ibackend_connection
+{
+public:
+	std::atomic<bool> cancelled{};
+
+	std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query, this->cancelled);
+	}
+
+	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query, this->cancelled);
+	}
+
+	void execute(const std::string& query) override
+	{
+		const std::vector<result> results{};
+		fake_backend_statement{ query, this->cancelled }.execute({}, results);
+	}
+
+	bool cancel() override
+	{
+		g_sending_cancel = true;
+		this->cancelled  = true;
+		while (g_hold_cancel)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+		g_sending_cancel = false;
+		return true;
+	}
+};
+
+class fake_backend_connection_factory : public ibackend_connection_factory
+{
+public:
+	std::shared_ptr<ibackend_connection> create_backend_connection(std::string_view) const override
+	{
+		return std::make_shared<fake_backend_connection>();
+	}
+};
+
+template<typename Predicate>
+bool eventually(Predicate&& predicate)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 10 };
+	while (!predicate())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	}
+	return true;
+}
+
+/// A read that takes @a milliseconds
+int sleep(connection& connection, int milliseconds)
+{
+	connection.execute("sleep:" + std::to_string(milliseconds));
+	return milliseconds;
+}
+
+struct row
+{
+	std::int32_t id;
+	std::string  name;
+
+	template<typename Binder>
+	void bind(Binder& binder)
+	{
+		binder.bind("id", this->id);
+		binder.bind("name", this->name);
+	}
+};
+
+} // namespace
+
+TEST(ExecutorTest, ThreadsMatchThePoolCapacity)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 3 };
+	EXPECT_EQ(executor{ pool }.thread_count(), 3u);
+	EXPECT_EQ((executor{ pool, executor_options{ .threads = 1 } }.thread_count()), 1u);
+}
+
+TEST(ExecutorTest, SubmitRunsOnAWorkerWithAPooledConnection)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 2 };
+	executor                        executor{ pool };
+
+	auto result = executor.submit([](connection& connection) {
+		connection.execute("rows:1");
+		return std::this_thread::get_id();
+	});
+	EXPECT_NE(result.get(), std::this_thread::get_id());
+	EXPECT_TRUE(result.ready());
+	EXPECT_TRUE(eventually([&] { return pool.stats().idle == 2u; }));
+}
+
+TEST(ExecutorTest, ErrorOfTheOperationIsThrown)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	executor                        executor{ pool };
+
+	auto result = executor.submit([](connection&) -> int { throw std::runtime_error{ "failed" }; });
+	EXPECT_THROW(result.get(), std::runtime_error);
+}
+
+TEST(ExecutorTest, StatementsRunAsynchronously)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	executor                        executor{ pool };
+	connection                      connection{ pool };
+
+	statement    statement{ connection, "rows:3" };
+	std::int32_t bound{ -1 };
+	statement.bind_result(bound);
+
+	EXPECT_EQ(statement.fetch_all<std::int32_t>(), (std::vector<std::int32_t>{ 0, 1, 2 }));
+	EXPECT_EQ(statement.fetch_all_async<std::int32_t>(executor).get(), (std::vector<std::int32_t>{ 0, 1, 2 }));
+
+	const auto rows = statement.fetch_all_async<row>(executor).get();
+	ASSERT_EQ(rows.size(), 3u);
+	EXPECT_EQ(rows[2].id, 2);
+	EXPECT_EQ(rows[2].name, "2");
+
+	// The result bindings of the statement are left unchanged
+	statement.execute_async(executor).get();
+	EXPECT_TRUE(statement.fetch());
+	EXPECT_EQ(bound, 0);
+}
+
+TEST(ExecutorTest, CompletionCallbacksAreCalled)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	executor                        executor{ pool };
+
+	std::atomic<int> calls{};
+	auto             result = executor.submit([](connection& connection) { return sleep(connection, 20); });
+	result.on_complete([&calls] { ++calls; });
+	result.wait();
+	EXPECT_TRUE(eventually([&] { return calls == 1; }));
+
+	// A callback registered after completion is called immediately
+	result.on_complete([&calls] { ++calls; });
+	EXPECT_EQ(calls, 2);
+	EXPECT_EQ(result.get(), 20);
+}
+
+TEST(ExecutorTest, OperationsCanBeCancelled)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	executor                        executor{ pool };
+
+	auto running = executor.submit([](connection& connection) { return sleep(connection, 5000); });
+	auto pending = executor.submit([](connection&) { return 2; });
+
+	EXPECT_TRUE(pending.cancel());
+	EXPECT_THROW(pending.get(), error);
+	EXPECT_FALSE(pending.cancel());
+
+	// The running operation is cancelled on the server, as soon as it has a connection
+	EXPECT_FALSE(running.wait_for(std::chrono::milliseconds{ 10 }));
+	EXPECT_TRUE(running.cancel());
+	EXPECT_TRUE(running.wait_for(std::chrono::seconds{ 2 }));
+	EXPECT_THROW(running.get(), error);
+}
+
+TEST(ExecutorTest, StatementCanBeCancelled)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	executor                        executor{ pool };
+	connection                      connection{ pool };
+
+	statement statement{ connection, "sleep:5000" };
+	auto      result = statement.execute_async(executor);
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+	EXPECT_TRUE(result.cancel());
+	EXPECT_TRUE(result.wait_for(std::chrono::seconds{ 2 }));
+	EXPECT_THROW(result.get(), error);
+}
+
+TEST(ExecutorTest, OperationCompletesAfterTheCancelRequestWasSent)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+	executor                        executor{ pool };
+
+	std::atomic<bool> started{};
+
+	auto running = executor.submit([&started](connection& connection) {
+		started = true;
+		return sleep(connection, 5000);
+	});
+	ASSERT_TRUE(eventually([&] { return started.load(); }));
+
+	g_hold_cancel = true;
+	std::thread canceller{ [&] { EXPECT_TRUE(running.cancel()); } };
+	ASSERT_TRUE(eventually([&] { return g_sending_cancel.load(); }));
+
+	// The statement fails right away, but the connection is not given back while the request is being sent
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+	EXPECT_FALSE(running.ready());
+	EXPECT_EQ(pool.try_acquire(), nullptr);
+
+	g_hold_cancel = false;
+	canceller.join();
+	EXPECT_TRUE(running.wait_for(std::chrono::seconds{ 2 }));
+	EXPECT_THROW(running.get(), error);
+	EXPECT_NE(pool.try_acquire(), nullptr);
+}
+
+TEST(ExecutorTest, DestructionFailsOperationsThatDidNotStart)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	std::atomic<bool>       started{};
+	std::optional<executor> executor{ std::in_place, pool, executor_options{ .threads = 1 } };
+
+	auto running = executor->submit([&started](connection& connection) {
+		started = true;
+		return sleep(connection, 20);
+	});
+	ASSERT_TRUE(eventually([&] { return started.load(); }));
+	auto pending = executor->submit([](connection&) { return 2; });
+	executor.reset();
+
+	EXPECT_EQ(running.get(), 20);
+	ASSERT_TRUE(pending.ready());
+	EXPECT_THROW(pending.get(), error);
+}
+
+TEST(ExecutorTest, ManyOperationsFromManyThreads)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 4 };
+	executor                        executor{ pool };
+
+	std::atomic<int>         nested{};
+	std::vector<std::thread> threads{};
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&] {
+			std::vector<async_result<int>> results{};
+			for (int n = 0; n < 250; ++n)
+			{
+				results.push_back(executor.submit([&executor, &nested, n](connection&) {
+					// Operations submitted from a worker thread are queued on that thread
+					executor.submit([&nested](connection&) { return ++nested; });
+					return n;
+				}));
+			}
+			for (int n = 0; n < 250; ++n)
+			{
+				EXPECT_EQ(results[n].get(), n);
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_TRUE(eventually([&] { return nested == 1000; }));
+}
+
+} // namespace squid
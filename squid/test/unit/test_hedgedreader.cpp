@@ -0,0 +1,271 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/hedgedreader.h>
+#include <squid/routingpool.h>
+#include <squid/ibackendconnection.h>
+#include <squid/ibackendconnectionfactory.h>
+#include <squid/ibackendstatement.h>
+#include <squid/error.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace squid {
+
+namespace {
+
+/// A connection to a server that answers every read after a fixed delay, unless the read is cancelled
+class fake_backend_connection : public ibackend_connection
+{
+public:
+	std::string               server;
+	std::chrono::milliseconds delay;
+	std::atomic<bool>         cancelled{};
+
+	explicit fake_backend_connection(std::string_view server, std::chrono::milliseconds delay)
+	    : server{ server }
+	    , delay{ delay }
+	{
+	}
+
+	std::unique_ptr<ibackend_statement> create_statement(std::string_view) override
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view) override
+	{
+		return nullptr;
+	}
+
+	void execute(const std::string&) override
+	{
+		const auto deadline = std::chrono::steady_clock::now() + this->delay;
+		while (std::chrono::steady_clock::now() < deadline)
+		{
+			if (this->cancelled.exchange(false))
+			{
+				throw error{ "canceling statement due to user request" };
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+	}
+
+	bool cancel() override
+	{
+		this->cancelled = true;
+		return true;
+	}
+};
+
+/// Connection strings are of the form "<name>" or "<name>:<delay in ms>"
+class fake_backend_connection_factory : public ibackend_connection_factory
+{
+public:
+	std::shared_ptr<ibackend_connection> create_backend_connection(std::string_view connection_info) const override
+	{
+		const auto colon = connection_info.find(':');
+		const auto delay = colon == std::string_view::npos ? 0 : std::stoi(std::string{ connection_info.substr(colon + 1) });
+		return std::make_shared<fake_backend_connection>(connection_info.substr(0, colon), std::chrono::milliseconds{ delay });
+	}
+};
+
+/// A read that returns the name of the server that answered it
+std::string read_server(connection& connection)
+{
+	connection.execute("SELECT 1");
+	return dynamic_cast<fake_backend_connection&>(*connection.backend()).server;
+}
+
+} // namespace
+
+TEST(HedgedReaderTest, OptionsMustBeValid)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica" }, 1 };
+	EXPECT_THROW((hedged_reader{ pool, hedging_options{ .quantile = 0.0 } }), std::invalid_argument);
+	EXPECT_THROW((hedged_reader{ pool, hedging_options{ .min_delay = std::chrono::seconds{ 2 } } }), std::invalid_argument);
+	EXPECT_THROW((hedged_reader{ pool, hedging_options{ .window = std::chrono::milliseconds::zero() } }), std::invalid_argument);
+	EXPECT_THROW((hedged_reader{ pool, hedging_options{ .max_hedges = 0 } }), std::invalid_argument);
+}
+
+TEST(HedgedReaderTest, FastReadsAreNotHedged)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica1", "replica2" }, 2 };
+	hedged_reader                   reader{ pool };
+
+	for (int n = 0; n < 20; ++n)
+	{
+		EXPECT_NE(reader.read(read_server), "primary");
+	}
+
+	const auto stats = reader.stats();
+	EXPECT_EQ(stats.reads, 20u);
+	EXPECT_EQ(stats.hedges, 0u);
+	EXPECT_EQ(stats.latency.count(), 20u);
+	EXPECT_EQ(stats.delay, std::chrono::seconds{ 1 });
+}
+
+TEST(HedgedReaderTest, SlowReadIsHedgedOnAnotherReplica)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "slow:5000", "fast" }, 2 };
+	hedged_reader                   reader{ pool,
+                              hedging_options{ .min_delay = std::chrono::milliseconds{ 20 },
+	                                           .max_delay = std::chrono::milliseconds{ 20 } } };
+
+	// Reads go to both replicas in turn until the slow one has a latency sample
+	for (int n = 0; n < 4; ++n)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		EXPECT_EQ(reader.read(read_server), "fast");
+		EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{ 2 });
+	}
+
+	const auto stats = reader.stats();
+	EXPECT_EQ(stats.reads, 4u);
+	EXPECT_GE(stats.hedges, 1u);
+	EXPECT_EQ(stats.hedge_wins, stats.hedges);
+	EXPECT_EQ(stats.cancellations, stats.hedges);
+	EXPECT_EQ(stats.skipped, 0u);
+}
+
+TEST(HedgedReaderTest, HedgeIsSkippedWithoutAnotherReplica)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica:50" }, 1 };
+	hedged_reader                   reader{ pool,
+                              hedging_options{ .min_delay = std::chrono::milliseconds{ 5 }, .max_delay = std::chrono::milliseconds{ 5 } } };
+
+	EXPECT_EQ(reader.read(read_server), "replica");
+
+	const auto stats = reader.stats();
+	EXPECT_EQ(stats.hedges, 0u);
+	EXPECT_EQ(stats.skipped, 1u);
+}
+
+TEST(HedgedReaderTest, DelayFollowsTheLatencyQuantile)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica1:5", "replica2:5" }, 2 };
+	hedged_reader                   reader{ pool,
+                              hedging_options{ .window = std::chrono::milliseconds{ 100 }, .min_samples = 10 } };
+
+	for (int n = 0; n < 10; ++n)
+	{
+		reader.read(read_server);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 200 });
+
+	const auto stats = reader.stats();
+	EXPECT_GE(stats.delay, std::chrono::milliseconds{ 5 });
+	EXPECT_LT(stats.delay, std::chrono::milliseconds{ 500 });
+}
+
+TEST(HedgedReaderTest, ReadIsHedgedWhenDueBeforeReadsOfAnEarlierWindow)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica1", "replica2" }, 2 };
+	hedged_reader                   reader{ pool,
+                              hedging_options{ .min_delay   = std::chrono::milliseconds{ 20 },
+	                                           .max_delay   = std::chrono::seconds{ 5 },
+	                                           .window      = std::chrono::milliseconds{ 100 },
+	                                           .min_samples = 5 } };
+
+	// A read that is due for a hedge only after the maximum delay
+	const auto released = std::make_shared<std::atomic<bool>>(false);
+	std::thread blocked{ [&reader, released] {
+		reader.read([released](connection&) {
+			while (!*released)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+			}
+			return 0;
+		});
+	} };
+
+	for (int n = 0; n < 10; ++n)
+	{
+		reader.read(read_server);
+	}
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 2 };
+	while (reader.stats().delay == std::chrono::seconds{ 5 } && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+	}
+	EXPECT_EQ(reader.stats().delay, std::chrono::milliseconds{ 20 });
+
+	// The first attempt of this read is slow, it must be hedged after the shorter delay
+	const auto invocations = std::make_shared<std::atomic<int>>(0);
+	const auto invocation  = reader.read([invocations](connection&) {
+        const auto invocation = (*invocations)++;
+        if (invocation == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 500 });
+        }
+        return invocation;
+    });
+	EXPECT_EQ(invocation, 1);
+
+	*released = true;
+	blocked.join();
+}
+
+TEST(HedgedReaderTest, ConcurrentHedgesAreLimited)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica1", "replica2" }, 2 };
+	hedged_reader                   reader{ pool,
+                              hedging_options{ .min_delay  = std::chrono::milliseconds{ 20 },
+	                                           .max_delay  = std::chrono::milliseconds{ 20 },
+	                                           .max_hedges = 1 } };
+
+	const auto slow_read = [](connection&) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 200 });
+		return 0;
+	};
+	std::thread other{ [&reader, slow_read] { reader.read(slow_read); } };
+	reader.read(slow_read);
+	other.join();
+
+	const auto stats = reader.stats();
+	EXPECT_EQ(stats.reads, 2u);
+	EXPECT_EQ(stats.hedges, 1u);
+	EXPECT_EQ(stats.skipped, 1u);
+}
+
+TEST(HedgedReaderTest, ErrorOfTheReadIsThrown)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica" }, 1 };
+	hedged_reader                   reader{ pool };
+
+	EXPECT_THROW(reader.read([](connection&) -> int { throw std::runtime_error{ "failed" }; }), std::runtime_error);
+	EXPECT_EQ(reader.stats().latency.count(), 0u);
+}
+
+TEST(HedgedReaderTest, PrometheusText)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica" }, 1 };
+	hedged_reader                   reader{ pool };
+	reader.read(read_server);
+
+	const auto text = to_prometheus_text(reader.stats(), "main");
+	EXPECT_NE(text.find("squid_hedged_reads_reads_total{pool=\"main\"} 1\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_hedged_reads_hedges_total{pool=\"main\"} 0\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_hedged_reads_delay_seconds{pool=\"main\"} 1\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_hedged_reads_latency_seconds_count{pool=\"main\"} 1\n"), std::string::npos);
+}
+
+} // namespace squid
@@ -0,0 +1,169 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/querystats.h>
+
+#include <squid/detail/phasetimer.h>
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace squid {
+
+namespace {
+
+void execute(statement_observer& observer, std::string_view query, std::chrono::nanoseconds latency, std::uint64_t rows = 0)
+{
+	const auto report = [&observer, query](statement_phase phase, std::chrono::nanoseconds duration, std::uint64_t count) {
+		observer.on_phase(statement_event{
+		    .phase = phase, .query = query, .start = std::chrono::steady_clock::now(), .duration = duration, .rows = count, .bytes = 0 });
+	};
+	report(statement_phase::bind, std::chrono::milliseconds{ 1 }, 0);
+	report(statement_phase::execute, latency, rows);
+	if (rows)
+	{
+		report(statement_phase::decode, std::chrono::milliseconds{ 1 }, rows);
+	}
+}
+
+const query_stats& find(const std::vector<query_stats>& stats, std::string_view query)
+{
+	for (const auto& entry : stats)
+	{
+		if (entry.fingerprint == query_fingerprint(query))
+		{
+			return entry;
+		}
+	}
+	throw std::runtime_error{ "query not found" };
+}
+
+} // namespace
+
+TEST(QueryStatsTest, FingerprintIgnoresWhitespace)
+{
+	EXPECT_EQ(query_fingerprint("SELECT a FROM t WHERE b = $1"), query_fingerprint("  SELECT a\n\tFROM t  WHERE b = $1\n"));
+	EXPECT_NE(query_fingerprint("SELECT a FROM t WHERE b = $1"), query_fingerprint("SELECT a FROM t WHERE b = $2"));
+	EXPECT_NE(query_fingerprint("SELECT ab"), query_fingerprint("SELECT a b"));
+}
+
+TEST(QueryStatsTest, ExecutionsAreAggregatedPerQuery)
+{
+	query_stats_observer observer{};
+	execute(observer, "SELECT a FROM t WHERE b = ?", std::chrono::milliseconds{ 2 }, 3);
+	execute(observer, "SELECT a FROM t  WHERE b = ?", std::chrono::milliseconds{ 4 }, 1);
+	execute(observer, "UPDATE t SET a = ?", std::chrono::milliseconds{ 8 });
+
+	const auto stats = observer.snapshot();
+	ASSERT_EQ(stats.size(), 2u);
+
+	const auto& select = find(stats, "SELECT a FROM t WHERE b = ?");
+	EXPECT_EQ(select.query, "SELECT a FROM t WHERE b = ?");
+	EXPECT_EQ(select.calls, 2u);
+	EXPECT_EQ(select.errors, 0u);
+	EXPECT_EQ(select.rows, 4u);
+	EXPECT_EQ(select.total_time, std::chrono::milliseconds{ 10 });
+	EXPECT_EQ(select.min_latency, std::chrono::milliseconds{ 2 });
+	EXPECT_EQ(select.max_latency, std::chrono::milliseconds{ 4 });
+	EXPECT_EQ(select.latency.count(), 2u);
+
+	const auto& update = find(stats, "UPDATE t SET a = ?");
+	EXPECT_EQ(update.calls, 1u);
+	EXPECT_EQ(update.rows, 0u);
+	EXPECT_EQ(update.total_time, std::chrono::milliseconds{ 9 });
+}
+
+TEST(QueryStatsTest, FailedExecutionsAreCountedAsErrors)
+{
+	query_stats_observer observer{};
+	try
+	{
+		phase_timer timer{ &observer, "SELECT 1/0" };
+		timer.lap(statement_phase::bind);
+		throw std::runtime_error{ "division by zero" };
+	}
+	catch (const std::runtime_error&)
+	{
+	}
+
+	const auto stats = observer.snapshot();
+	ASSERT_EQ(stats.size(), 1u);
+	EXPECT_EQ(stats[0].calls, 0u);
+	EXPECT_EQ(stats[0].errors, 1u);
+	EXPECT_EQ(stats[0].min_latency, std::chrono::nanoseconds::zero());
+}
+
+TEST(QueryStatsTest, TopOrdersQueries)
+{
+	query_stats_observer observer{};
+	execute(observer, "A", std::chrono::milliseconds{ 50 });
+	for (int i = 0; i < 3; ++i)
+	{
+		execute(observer, "B", std::chrono::milliseconds{ 10 });
+	}
+	execute(observer, "C", std::chrono::milliseconds{ 1 }, 100);
+
+	const auto by_time = observer.top(2);
+	ASSERT_EQ(by_time.size(), 2u);
+	EXPECT_EQ(by_time[0].query, "A");
+	EXPECT_EQ(by_time[1].query, "B");
+
+	EXPECT_EQ(observer.top(1, query_stats_order::calls)[0].query, "B");
+	EXPECT_EQ(observer.top(1, query_stats_order::rows)[0].query, "C");
+	EXPECT_EQ(observer.top(10).size(), 3u);
+
+	const auto text = to_text(by_time);
+	EXPECT_NE(text.find("calls"), std::string::npos);
+	EXPECT_NE(text.find("  A\n"), std::string::npos);
+	EXPECT_NE(text.find("  B\n"), std::string::npos);
+}
+
+TEST(QueryStatsTest, ResetAndMaxQueries)
+{
+	query_stats_observer observer{ query_stats_options{ .shards = 4, .max_queries = 2 } };
+	execute(observer, "A", std::chrono::milliseconds{ 1 });
+	execute(observer, "B", std::chrono::milliseconds{ 1 });
+	execute(observer, "C", std::chrono::milliseconds{ 1 });
+	EXPECT_EQ(observer.snapshot().size(), 2u);
+	EXPECT_EQ(observer.dropped(), 2u); // bind and execute of C
+
+	observer.reset();
+	EXPECT_TRUE(observer.snapshot().empty());
+	EXPECT_EQ(observer.dropped(), 0u);
+
+	execute(observer, "C", std::chrono::milliseconds{ 1 });
+	EXPECT_EQ(observer.snapshot().size(), 1u);
+}
+
+TEST(QueryStatsTest, ConcurrentExecutions)
+{
+	query_stats_observer     observer{};
+	std::vector<std::thread> threads{};
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&observer] {
+			for (int n = 0; n < 1000; ++n)
+			{
+				execute(observer, n % 2 ? "A" : "B", std::chrono::microseconds{ 10 }, 1);
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	const auto stats = observer.snapshot();
+	ASSERT_EQ(stats.size(), 2u);
+	EXPECT_EQ(stats[0].calls + stats[1].calls, 4000u);
+	EXPECT_EQ(stats[0].rows + stats[1].rows, 4000u);
+}
+
+} // namespace squid
@@ -0,0 +1,239 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/resultmemory.h>
+#include <squid/connection.h>
+#include <squid/connectionpool.h>
+#include <squid/statement.h>
+#include <squid/preparedstatement.h>
+#include <squid/ibackendconnection.h>
+#include <squid/ibackendconnectionfactory.h>
+#include <squid/ibackendstatement.h>
+#include <squid/error.h>
+
+#include <string>
+#include <utility>
+
+namespace squid {
+
+namespace {
+
+/// A statement whose result buffers 10 bytes per row, accounted while the rows are received, like the backends do
+class fake_backend_statement : public ibackend_statement
+{
+	int rows_;
+
+	void receive()
+	{
+		auto& account = this->results_account();
+		account.release();
+		try
+		{
+			for (int row = 0; row < this->rows_; ++row)
+			{
+				account.add(10u);
+			}
+		}
+		catch (...)
+		{
+			account.release();
+			throw;
+		}
+	}
+
+public:
+	explicit fake_backend_statement(std::string_view query)
+	    : rows_{ std::stoi(std::string{ query }) }
+	{
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::vector<result>&) override
+	{
+		this->receive();
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::map<std::string, result>&) override
+	{
+		this->receive();
+	}
+
+	bool fetch() override
+	{
+		return false;
+	}
+
+	std::size_t field_count() override
+	{
+		return 0;
+	}
+
+	std::string field_name(std::size_t) override
+	{
+		return {};
+	}
+
+	std::uint64_t affected_rows() override
+	{
+		return 0;
+	}
+};
+
+class fake_backend_connection : public ibackend_connection
+{
+public:
+	std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query);
+	}
+
+	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query);
+	}
+
+	void execute(const std::string&) override
+	{
+	}
+};
+
+class fake_backend_connection_factory : public ibackend_connection_factory
+{
+public:
+	std::shared_ptr<ibackend_connection> create_backend_connection(std::string_view) const override
+	{
+		return std::make_shared<fake_backend_connection>();
+	}
+};
+
+} // namespace
+
+TEST(ResultMemoryTest, AccountsBytesAndPeak)
+{
+	result_memory memory{};
+	memory.acquire(0u, 30u);
+	memory.acquire(30u, 20u);
+	EXPECT_EQ(memory.bytes(), 50u);
+	memory.release(40u);
+	EXPECT_EQ(memory.bytes(), 10u);
+	EXPECT_EQ(memory.peak(), 50u);
+	memory.reset_peak();
+	EXPECT_EQ(memory.peak(), 10u);
+}
+
+TEST(ResultMemoryTest, LimitsAreChecked)
+{
+	result_memory memory{};
+	memory.set_limits(result_limits{ .statement_bytes = 100u, .connection_bytes = 150u });
+
+	memory.acquire(0u, 100u);
+	EXPECT_THROW(memory.acquire(100u, 1u), result_limit_error);
+	memory.acquire(0u, 50u);
+	EXPECT_THROW(memory.acquire(0u, 1u), result_limit_error);
+	EXPECT_EQ(memory.bytes(), 150u);
+}
+
+TEST(ResultMemoryTest, AccountReleasesOnDestructionAndMove)
+{
+	result_memory memory{};
+	{
+		result_account account{};
+		account.attach(&memory);
+		EXPECT_FALSE(account.limited());
+		account.add(25u);
+		EXPECT_EQ(memory.bytes(), 25u);
+
+		result_account moved{ std::move(account) };
+		EXPECT_EQ(account.bytes(), 0u);
+		EXPECT_EQ(moved.bytes(), 25u);
+		EXPECT_EQ(memory.bytes(), 25u);
+	}
+	EXPECT_EQ(memory.bytes(), 0u);
+}
+
+TEST(ResultMemoryTest, AccountAttachedElsewhereReleases)
+{
+	result_memory  first{};
+	result_memory  second{};
+	result_account account{};
+	account.attach(&first);
+	account.add(5u);
+	account.attach(&first);
+	EXPECT_EQ(first.bytes(), 5u);
+	account.attach(&second);
+	EXPECT_EQ(first.bytes(), 0u);
+	EXPECT_EQ(account.bytes(), 0u);
+	second.set_limits(result_limits{ .statement_bytes = 1u });
+	EXPECT_TRUE(account.limited());
+}
+
+TEST(ResultMemoryTest, StatementsAccountOnTheirConnection)
+{
+	fake_backend_connection_factory factory{};
+	connection                      connection{ factory, "" };
+
+	statement first{ connection, "3" };
+	statement second{ connection, "2" };
+	first.execute();
+	second.execute();
+	EXPECT_EQ(first.result_bytes(), 30u);
+	EXPECT_EQ(second.result_bytes(), 20u);
+	EXPECT_EQ(connection.result_bytes(), 50u);
+
+	first.execute();
+	EXPECT_EQ(connection.result_bytes(), 50u);
+	EXPECT_EQ(connection.peak_result_bytes(), 50u);
+}
+
+TEST(ResultMemoryTest, StatementExceedingALimitFails)
+{
+	fake_backend_connection_factory factory{};
+	connection                      connection{ factory, "" };
+	connection.set_result_limits(result_limits{ .statement_bytes = 25u, .connection_bytes = 45u });
+
+	statement first{ connection, "2" };
+	first.execute();
+
+	statement large{ connection, "3" };
+	EXPECT_THROW(large.execute(), result_limit_error);
+	EXPECT_EQ(large.result_bytes(), 0u);
+	EXPECT_EQ(connection.result_bytes(), 20u);
+
+	statement second{ connection, "2" };
+	second.execute();
+	statement other{ connection, "1" };
+	EXPECT_THROW(other.execute(), result_limit_error);
+	EXPECT_EQ(connection.result_bytes(), 40u);
+}
+
+TEST(ResultMemoryTest, PoolAppliesTheLimits)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool pool{ factory, "", 1, connection_pool_options{ .result_limits = result_limits{ .statement_bytes = 15u } } };
+	connection      connection{ pool };
+
+	statement statement{ connection, "2" };
+	EXPECT_THROW(statement.execute(), result_limit_error);
+}
+
+TEST(ResultMemoryTest, RegisteredStatementsAreAccountedAndLimited)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1, connection_pool_options{ .statements = { { "two", "2" } } } };
+	connection                      connection{ pool };
+
+	auto statement = prepared_statement::registered(connection, "two");
+	statement.execute();
+	EXPECT_EQ(statement.result_bytes(), 20u);
+	EXPECT_EQ(connection.result_bytes(), 20u);
+
+	connection.set_result_limits(result_limits{ .statement_bytes = 15u });
+	EXPECT_THROW(prepared_statement::registered(connection, "two").execute(), result_limit_error);
+	EXPECT_EQ(connection.result_bytes(), 0u);
+}
+
+} // namespace squid
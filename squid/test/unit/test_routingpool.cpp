@@ -0,0 +1,291 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/routingpool.h>
+#include <squid/connection.h>
+#include <squid/ibackendconnection.h>
+#include <squid/ibackendconnectionfactory.h>
+#include <squid/ibackendstatement.h>
+#include <squid/error.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace squid {
+
+namespace {
+
+class fake_backend_connection : public ibackend_connection
+{
+public:
+	std::string       server;
+	std::atomic<bool> broken{};
+
+	explicit fake_backend_connection(std::string_view server)
+	    : server{ server }
+	{
+	}
+
+	std::unique_ptr<ibackend_statement> create_statement(std::string_view) override
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view) override
+	{
+		return nullptr;
+	}
+
+	void execute(const std::string&) override
+	{
+	}
+
+	bool is_broken() const noexcept override
+	{
+		return this->broken;
+	}
+};
+
+class fake_backend_connection_factory : public ibackend_connection_factory
+{
+public:
+	std::shared_ptr<ibackend_connection> create_backend_connection(std::string_view connection_info) const override
+	{
+		if (connection_info == "down")
+		{
+			throw std::runtime_error{ "connection refused" };
+		}
+		return std::make_shared<fake_backend_connection>(connection_info);
+	}
+};
+
+std::string server_of(const std::shared_ptr<ibackend_connection>& connection)
+{
+	return connection ? dynamic_cast<fake_backend_connection&>(*connection).server : std::string{};
+}
+
+/// Acquire a read-only connection, hold it for @a hold and return the server it was connected to
+std::string read(routing_pool& pool, std::chrono::milliseconds hold = {})
+{
+	auto connection = pool.acquire(access_mode::read_only);
+	std::this_thread::sleep_for(hold);
+	return server_of(connection);
+}
+
+} // namespace
+
+TEST(RoutingPoolTest, OptionsMustBeValid)
+{
+	fake_backend_connection_factory factory{};
+	EXPECT_THROW((routing_pool{ factory, "primary", { "replica" }, 1, routing_pool_options{ .latency_smoothing = 0.0 } }),
+	             std::invalid_argument);
+	EXPECT_THROW((routing_pool{ factory, "primary", { "replica" }, 1, routing_pool_options{ .failure_threshold = 0 } }),
+	             std::invalid_argument);
+}
+
+TEST(RoutingPoolTest, WritesGoToPrimary)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica1", "replica2" }, 2 };
+
+	EXPECT_EQ(pool.replica_count(), 2u);
+	EXPECT_EQ(server_of(pool.acquire(access_mode::read_write)), "primary");
+	EXPECT_EQ(server_of(pool.acquire(access_mode::read_write, std::chrono::seconds{ 1 })), "primary");
+	EXPECT_EQ(server_of(pool.try_acquire(access_mode::read_write)), "primary");
+}
+
+TEST(RoutingPoolTest, ConnectionAcquiresForAccessMode)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica" }, 1 };
+
+	connection read_write{ pool, access_mode::read_write };
+	connection read_only{ pool, access_mode::read_only, std::chrono::seconds{ 1 } };
+	EXPECT_EQ(server_of(read_write.backend()), "primary");
+	EXPECT_EQ(server_of(read_only.backend()), "replica");
+}
+
+TEST(RoutingPoolTest, ReadsAreSpreadOverReplicas)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica1", "replica2" }, 2 };
+
+	// A replica with an acquired connection has a higher load
+	auto first  = pool.acquire(access_mode::read_only);
+	auto second = pool.acquire(access_mode::read_only, std::chrono::seconds{ 1 });
+	EXPECT_NE(server_of(first), "primary");
+	EXPECT_NE(server_of(second), "primary");
+	EXPECT_NE(server_of(first), server_of(second));
+
+	const auto stats = pool.stats();
+	ASSERT_EQ(stats.replicas.size(), 2u);
+	EXPECT_EQ(stats.replicas[0].outstanding, 1u);
+	EXPECT_EQ(stats.replicas[1].outstanding, 1u);
+	EXPECT_EQ(stats.replicas[0].requests, 1u);
+	EXPECT_EQ(stats.primary_fallbacks, 0u);
+
+	first.reset();
+	second.reset();
+	EXPECT_EQ(pool.stats().replicas[0].outstanding, 0u);
+}
+
+TEST(RoutingPoolTest, ReadsPreferTheFasterReplica)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "slow", "fast" }, 2 };
+
+	// One sample each: "slow" is held for 20 ms, "fast" is released immediately
+	auto first  = pool.acquire(access_mode::read_only);
+	auto second = pool.acquire(access_mode::read_only);
+	auto& slow  = server_of(first) == "slow" ? first : second;
+	auto& fast  = server_of(first) == "slow" ? second : first;
+	ASSERT_EQ(server_of(fast), "fast");
+	fast.reset();
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+	slow.reset();
+
+	const auto stats = pool.stats();
+	EXPECT_GT(stats.replicas[0].latency, stats.replicas[1].latency);
+
+	for (int n = 0; n < 10; ++n)
+	{
+		EXPECT_EQ(read(pool), "fast");
+	}
+}
+
+TEST(RoutingPoolTest, FailingReplicaIsExcluded)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory,
+                           "primary",
+                           { "replica1", "replica2" },
+                           1,
+                           routing_pool_options{ .failure_threshold = 2, .ejection_time = std::chrono::milliseconds{ 200 } } };
+
+	// Break the connections of replica1 until it is excluded
+	int broken{};
+	while (broken < 2)
+	{
+		auto connection = pool.acquire(access_mode::read_only);
+		if (server_of(connection) == "replica1")
+		{
+			dynamic_cast<fake_backend_connection&>(*connection).broken = true;
+			++broken;
+		}
+	}
+
+	auto stats = pool.stats();
+	EXPECT_FALSE(stats.replicas[0].healthy);
+	EXPECT_TRUE(stats.replicas[1].healthy);
+	EXPECT_EQ(stats.replicas[0].failures, 2u);
+	EXPECT_EQ(stats.replicas[0].ejections, 1u);
+
+	for (int n = 0; n < 10; ++n)
+	{
+		EXPECT_EQ(read(pool), "replica2");
+	}
+
+	// After the ejection time, the replica is routed to again (its pool replaced the broken connection)
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 250 });
+	EXPECT_TRUE(pool.stats().replicas[0].healthy);
+	auto first  = pool.acquire(access_mode::read_only);
+	auto second = pool.acquire(access_mode::read_only);
+	EXPECT_NE(server_of(first), server_of(second));
+}
+
+TEST(RoutingPoolTest, BusyReplicasAreNotExcluded)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory,
+                           "primary",
+                           { "replica1", "replica2" },
+                           1,
+                           routing_pool_options{ .failure_threshold = 1, .replica_acquire_timeout = std::chrono::milliseconds{ 10 } } };
+
+	auto first  = pool.acquire(access_mode::read_only);
+	auto second = pool.acquire(access_mode::read_only);
+
+	// Both replicas are busy: the acquisition waits on them in turn, and does not go to the primary
+	EXPECT_EQ(pool.acquire(access_mode::read_only, std::chrono::milliseconds{ 50 }), nullptr);
+
+	std::string server{};
+	std::thread reader{ [&] { server = read(pool); } };
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+	const auto released = server_of(second);
+	second.reset();
+	reader.join();
+	EXPECT_EQ(server, released);
+
+	const auto stats = pool.stats();
+	EXPECT_TRUE(stats.replicas[0].healthy);
+	EXPECT_TRUE(stats.replicas[1].healthy);
+	EXPECT_EQ(stats.replicas[0].failures, 0u);
+	EXPECT_EQ(stats.replicas[1].failures, 0u);
+	EXPECT_EQ(stats.primary_fallbacks, 0u);
+}
+
+TEST(RoutingPoolTest, ReplicaFailingToConnectIsExcluded)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory,
+                           "primary",
+                           { "down" },
+                           1,
+                           routing_pool_options{ .replica                 = connection_pool_options{ .min_connections = 0 },
+                                                 .failure_threshold       = 1,
+                                                 .replica_acquire_timeout = std::chrono::milliseconds{ 20 } } };
+
+	EXPECT_EQ(read(pool), "primary");
+	const auto stats = pool.stats();
+	EXPECT_FALSE(stats.replicas[0].healthy);
+	EXPECT_EQ(stats.replicas[0].failures, 1u);
+	EXPECT_EQ(stats.replicas[0].ejections, 1u);
+	EXPECT_EQ(stats.primary_fallbacks, 1u);
+}
+
+TEST(RoutingPoolTest, TryAcquireOtherReplica)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", { "replica1", "replica2" }, 1 };
+
+	auto first  = pool.acquire(access_mode::read_only);
+	auto second = pool.try_acquire_other(first);
+	EXPECT_NE(second, nullptr);
+	EXPECT_NE(server_of(second), server_of(first));
+	EXPECT_NE(server_of(second), "primary");
+
+	// The other replica has no connection left, and a primary connection has no replica
+	EXPECT_EQ(pool.try_acquire_other(first), nullptr);
+	EXPECT_EQ(pool.try_acquire_other(pool.acquire(access_mode::read_write)), nullptr);
+}
+
+TEST(RoutingPoolTest, ReadsFallBackToPrimary)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", {}, 1 };
+
+	EXPECT_EQ(read(pool), "primary");
+	EXPECT_EQ(server_of(pool.try_acquire(access_mode::read_only)), "primary");
+	EXPECT_EQ(pool.stats().primary_fallbacks, 2u);
+}
+
+TEST(RoutingPoolTest, ReadsWithoutFallbackFailWithoutHealthyReplica)
+{
+	fake_backend_connection_factory factory{};
+	routing_pool                    pool{ factory, "primary", {}, 1, routing_pool_options{ .fallback_to_primary = false } };
+
+	EXPECT_THROW(pool.acquire(access_mode::read_only), error);
+	EXPECT_EQ(pool.acquire(access_mode::read_only, std::chrono::milliseconds{ 10 }), nullptr);
+	EXPECT_EQ(pool.try_acquire(access_mode::read_only), nullptr);
+	EXPECT_EQ(pool.stats().primary_fallbacks, 0u);
+}
+
+} // namespace squid
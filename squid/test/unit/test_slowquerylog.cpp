@@ -0,0 +1,188 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/slowquerylog.h>
+#include <squid/connectionpool.h>
+#include <squid/ibackendconnection.h>
+#include <squid/ibackendconnectionfactory.h>
+#include <squid/ibackendstatement.h>
+#include <squid/error.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace squid {
+
+namespace {
+
+/// A statement that fails, for the plans of the slow query log
+class fake_backend_statement : public ibackend_statement
+{
+	std::string query_;
+
+public:
+	explicit fake_backend_statement(std::string_view query)
+	    : query_{ query }
+	{
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::vector<result>&) override
+	{
+		throw error{ "cannot explain " + this->query_ };
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::map<std::string, result>&) override
+	{
+		throw error{ "cannot explain " + this->query_ };
+	}
+
+	bool fetch() override
+	{
+		return false;
+	}
+
+	std::size_t field_count() override
+	{
+		return 0;
+	}
+
+	std::string field_name(std::size_t) override
+	{
+		return {};
+	}
+
+	std::uint64_t affected_rows() override
+	{
+		return 0;
+	}
+};
+
+class fake_backend_connection : public ibackend_connection
+{
+public:
+	std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query);
+	}
+
+	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query);
+	}
+
+	void execute(const std::string&) override
+	{
+	}
+};
+
+class fake_backend_connection_factory : public ibackend_connection_factory
+{
+public:
+	std::shared_ptr<ibackend_connection> create_backend_connection(std::string_view) const override
+	{
+		return std::make_shared<fake_backend_connection>();
+	}
+};
+
+void execute(statement_observer&                     observer,
+             std::string_view                        query,
+             std::chrono::milliseconds               duration,
+             const std::map<std::string, parameter>& parameters = {})
+{
+	observer.on_phase(statement_event{ .phase      = statement_phase::execute,
+	                                   .query      = query,
+	                                   .start      = std::chrono::steady_clock::now(),
+	                                   .duration   = duration,
+	                                   .rows       = 7,
+	                                   .bytes      = 0,
+	                                   .parameters = &parameters });
+}
+
+} // namespace
+
+TEST(SlowQueryLogTest, OnlySlowQueriesAreRecorded)
+{
+	slow_query_log log{ slow_query_log_options{ .threshold = std::chrono::milliseconds{ 10 } } };
+	execute(log, "SELECT fast", std::chrono::milliseconds{ 9 });
+	execute(log, "SELECT slow", std::chrono::milliseconds{ 10 });
+	log.flush();
+
+	const auto recent = log.recent();
+	ASSERT_EQ(recent.size(), 1u);
+	EXPECT_EQ(recent[0].query, "SELECT slow");
+	EXPECT_EQ(recent[0].duration, std::chrono::milliseconds{ 10 });
+	EXPECT_EQ(recent[0].rows, 7u);
+	EXPECT_TRUE(recent[0].plan.empty());
+}
+
+TEST(SlowQueryLogTest, ParametersAreFormattedAndRedacted)
+{
+	slow_query_log log{ slow_query_log_options{ .threshold            = std::chrono::milliseconds{ 1 },
+		                                        .redact               = [](std::string_view name) { return name == "password"; },
+		                                        .max_parameter_length = 10 } };
+
+	std::map<std::string, parameter> parameters{};
+	parameters.emplace("id", parameter{ 42, parameter::by_value{} });
+	parameters.emplace("name", parameter{ std::string{ "O'Brien" }, parameter::by_value{} });
+	parameters.emplace("note", parameter{ std::string{ "a long note" }, parameter::by_value{} });
+	parameters.emplace("missing", parameter{ std::optional<int>{}, parameter::by_value{} });
+	parameters.emplace("password", parameter{ std::string{ "secret" }, parameter::by_value{} });
+	execute(log, "UPDATE t", std::chrono::milliseconds{ 5 }, parameters);
+	log.flush();
+
+	const auto recent = log.recent();
+	ASSERT_EQ(recent.size(), 1u);
+	const std::vector<std::pair<std::string, std::string>> expected{
+		{ "id", "42" }, { "missing", "NULL" }, { "name", "'O''Brien'" }, { "note", "'a long no..." }, { "password", "<redacted>" }
+	};
+	EXPECT_EQ(recent[0].parameters, expected);
+}
+
+TEST(SlowQueryLogTest, SinkAndPlanRunOnTheBackgroundThread)
+{
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1 };
+
+	std::vector<slow_query> sunk{};
+	slow_query_log          log{ slow_query_log_options{ .threshold      = std::chrono::milliseconds{ 1 },
+		                                                 .explain_pool   = &pool,
+		                                                 .explain_prefix = "EXPLAIN ",
+		                                                 .sink           = [&sunk](const slow_query& query) { sunk.push_back(query); } } };
+	execute(log, "SELECT 1", std::chrono::milliseconds{ 5 });
+	log.flush();
+
+	ASSERT_EQ(sunk.size(), 1u);
+	EXPECT_EQ(sunk[0].plan, "EXPLAIN failed: cannot explain EXPLAIN SELECT 1");
+}
+
+TEST(SlowQueryLogTest, FullQueueDropsTheOldestRecords)
+{
+	std::atomic<bool> release{};
+	const auto        sink = [&release](const slow_query&) {
+		while (!release)
+		{
+			std::this_thread::yield();
+		}
+	};
+	slow_query_log log{ slow_query_log_options{ .threshold = std::chrono::milliseconds{ 1 }, .capacity = 2, .sink = sink } };
+	for (int i = 0; i < 5; ++i)
+	{
+		execute(log, "SELECT " + std::to_string(i), std::chrono::milliseconds{ 5 });
+	}
+	release = true;
+	log.flush();
+
+	EXPECT_GE(log.dropped(), 2u);
+	const auto recent = log.recent();
+	ASSERT_EQ(recent.size(), 2u);
+	EXPECT_EQ(recent[1].query, "SELECT 4");
+}
+
+} // namespace squid
@@ -0,0 +1,248 @@
+//
+// Copyright (C) 2022-2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <gtest/gtest.h>
+#include <squid/statement.h>
+#include <squid/preparedstatement.h>
+#include <squid/statementobserver.h>
+#include <squid/connection.h>
+#include <squid/connectionpool.h>
+#include <squid/ibackendconnection.h>
+#include <squid/ibackendconnectionfactory.h>
+#include <squid/ibackendstatement.h>
+
+#include <squid/detail/phasetimer.h>
+
+#include <string>
+#include <vector>
+
+namespace squid {
+
+namespace {
+
+/// A statement that reports its phases like a backend does, and returns 3 rows
+class fake_backend_statement : public ibackend_statement
+{
+	std::string       query_;
+	int               rows_;
+	phase_accumulator decode_;
+
+	void run()
+	{
+		phase_timer timer{ this->observer(), this->query_ };
+		timer.lap(statement_phase::bind);
+		timer.lap(statement_phase::execute, 3, 30);
+		this->rows_ = 3;
+	}
+
+public:
+	explicit fake_backend_statement(std::string_view query)
+	    : query_{ query }
+	    , rows_{}
+	    , decode_{}
+	{
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::vector<result>&) override
+	{
+		this->run();
+	}
+
+	void execute(const std::map<std::string, parameter>&, const std::map<std::string, result>&) override
+	{
+		this->run();
+	}
+
+	bool fetch() override
+	{
+		if (!this->rows_)
+		{
+			this->decode_.report(this->observer(), statement_phase::decode, this->query_);
+			return false;
+		}
+		--this->rows_;
+		this->decode_.add(std::chrono::steady_clock::now());
+		return true;
+	}
+
+	std::size_t field_count() override
+	{
+		return 0;
+	}
+
+	std::string field_name(std::size_t) override
+	{
+		return {};
+	}
+
+	std::uint64_t affected_rows() override
+	{
+		return 0;
+	}
+};
+
+class fake_backend_connection : public ibackend_connection
+{
+public:
+	std::unique_ptr<ibackend_statement> create_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query);
+	}
+
+	std::unique_ptr<ibackend_statement> create_prepared_statement(std::string_view query) override
+	{
+		return std::make_unique<fake_backend_statement>(query);
+	}
+
+	void execute(const std::string&) override
+	{
+	}
+};
+
+class fake_backend_connection_factory : public ibackend_connection_factory
+{
+public:
+	std::shared_ptr<ibackend_connection> create_backend_connection(std::string_view) const override
+	{
+		return std::make_shared<fake_backend_connection>();
+	}
+};
+
+class recording_observer : public statement_observer
+{
+public:
+	struct event
+	{
+		statement_phase phase;
+		std::string     query;
+		std::uint64_t   rows;
+		std::uint64_t   bytes;
+	};
+
+	std::vector<event> events{};
+
+	void on_phase(const statement_event& event) noexcept override
+	{
+		this->events.push_back({ event.phase, std::string{ event.query }, event.rows, event.bytes });
+	}
+};
+
+void execute_and_fetch(connection& connection, std::string_view query)
+{
+	statement statement{ connection, query };
+	statement.execute();
+	while (statement.fetch())
+	{
+	}
+}
+
+} // namespace
+
+TEST(StatementObserverTest, PhasesAreReportedToThePoolObserver)
+{
+	auto                            observer = std::make_shared<recording_observer>();
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1, connection_pool_options{ .observer = observer } };
+	connection                      connection{ pool };
+
+	execute_and_fetch(connection, "SELECT x");
+
+	ASSERT_EQ(observer->events.size(), 3u);
+	EXPECT_EQ(observer->events[0].phase, statement_phase::bind);
+	EXPECT_EQ(observer->events[1].phase, statement_phase::execute);
+	EXPECT_EQ(observer->events[1].query, "SELECT x");
+	EXPECT_EQ(observer->events[1].rows, 3u);
+	EXPECT_EQ(observer->events[1].bytes, 30u);
+	EXPECT_EQ(observer->events[2].phase, statement_phase::decode);
+	EXPECT_EQ(observer->events[2].rows, 3u);
+}
+
+TEST(StatementObserverTest, RegisteredStatementsAreReportedToThePoolObserver)
+{
+	auto                            observer = std::make_shared<recording_observer>();
+	fake_backend_connection_factory factory{};
+	connection_pool pool{ factory, "", 1, connection_pool_options{ .statements = { { "x", "SELECT x" } }, .observer = observer } };
+	connection      connection{ pool };
+
+	auto statement = prepared_statement::registered(connection, "x");
+	statement.execute();
+	while (statement.fetch())
+	{
+	}
+
+	ASSERT_EQ(observer->events.size(), 3u);
+	EXPECT_EQ(observer->events[1].phase, statement_phase::execute);
+	EXPECT_EQ(observer->events[1].query, "SELECT x");
+	EXPECT_EQ(observer->events[2].phase, statement_phase::decode);
+	EXPECT_EQ(observer->events[2].rows, 3u);
+}
+
+TEST(StatementObserverTest, ConnectionObserverCanBeReplacedAndRemoved)
+{
+	auto                            first  = std::make_shared<recording_observer>();
+	auto                            second = std::make_shared<recording_observer>();
+	fake_backend_connection_factory factory{};
+	connection_pool                 pool{ factory, "", 1, connection_pool_options{ .observer = first } };
+	connection                      connection{ pool };
+
+	connection.set_observer(second);
+	execute_and_fetch(connection, "SELECT x");
+	EXPECT_TRUE(first->events.empty());
+	EXPECT_EQ(second->events.size(), 3u);
+
+	connection.set_observer(nullptr);
+	execute_and_fetch(connection, "SELECT x");
+	EXPECT_EQ(second->events.size(), 3u);
+}
+
+TEST(StatementObserverTest, NothingIsReportedWithoutObserver)
+{
+	fake_backend_connection_factory factory{};
+	connection                      connection{ factory, "" };
+	EXPECT_EQ(connection.backend()->observer(), nullptr);
+	EXPECT_NO_THROW(execute_and_fetch(connection, "SELECT x"));
+}
+
+TEST(StatementObserverTest, LatencyObserverRecordsEveryPhase)
+{
+	auto                            observer = std::make_shared<latency_observer>();
+	fake_backend_connection_factory factory{};
+	connection                      connection{ factory, "" };
+	connection.set_observer(observer);
+
+	execute_and_fetch(connection, "SELECT x");
+	execute_and_fetch(connection, "SELECT y");
+
+	const auto stats = observer->stats();
+	EXPECT_EQ(stats[statement_phase::prepare].count(), 0u);
+	EXPECT_EQ(stats[statement_phase::bind].count(), 2u);
+	EXPECT_EQ(stats[statement_phase::execute].count(), 2u);
+	EXPECT_EQ(stats[statement_phase::transfer].count(), 0u);
+	EXPECT_EQ(stats[statement_phase::decode].count(), 2u);
+	EXPECT_EQ(stats.rows, 6u);
+	EXPECT_EQ(stats.bytes, 60u);
+}
+
+TEST(StatementObserverTest, PrometheusText)
+{
+	latency_observer observer{};
+	observer.on_phase(statement_event{ .phase    = statement_phase::execute,
+	                                   .query    = "SELECT x",
+	                                   .start    = std::chrono::steady_clock::now(),
+	                                   .duration = std::chrono::milliseconds{ 2 },
+	                                   .rows     = 1,
+	                                   .bytes    = 8 });
+
+	const auto text = to_prometheus_text(observer.stats(), "main");
+	EXPECT_NE(text.find("# TYPE squid_statement_execute_seconds histogram\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_statement_execute_seconds_count{pool=\"main\"} 1\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_statement_decode_seconds_count{pool=\"main\"} 0\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_statement_rows_total{pool=\"main\"} 0\n"), std::string::npos);
+	EXPECT_NE(text.find("squid_statement_bytes_total{pool=\"main\"} 8\n"), std::string::npos);
+}
+
+} // namespace squid